@@ -36,6 +36,7 @@
 #include <list>
 #include <map>
 #include <unordered_map>
+#include <unordered_set>
 #include <memory>
 #include "librekey/kbx_blob.hpp"
 #include "sec_profile.hpp"
@@ -60,17 +61,116 @@ typedef std::unordered_map<pgp_fingerprint_t, std::list<pgp_key_t>::iterator> pg
 namespace rnp {
 class KeyStore {
   private:
-    pgp_key_t *             add_subkey(pgp_key_t &srckey, pgp_key_t *oldkey);
+    /* Location of the blob with primary key and its subkeys, and revisions of the keys
+     * which were written to it. Used to update KBX file in-place and to journal changes. */
+    struct KeyBlobRef {
+        size_t                         offset;
+        uint32_t                       length;
+        std::vector<pgp_fingerprint_t> fps;
+        std::vector<uint64_t>          revisions;
+    };
+
+    std::unordered_map<pgp_fingerprint_t, KeyBlobRef> kbx_refs_;
+    std::vector<KeyBlobRef> kbx_orphans_;  /* blobs which should be marked as empty */
+    std::string             kbx_path_;     /* path of the file kbx_refs_ correspond to */
+    size_t                  kbx_size_{};   /* size of the KBX file */
+    size_t                  kbx_wasted_{}; /* number of bytes taken by the empty blobs */
+
+    /* Index of KBX blobs with not yet parsed keyblocks, built from the blob's key and uid
+     * tables. Values are indexes in the blobs vector. */
+    std::unordered_multimap<pgp_fingerprint_t, size_t> kbx_deferred_fps_;
+    std::multimap<pgp_key_id_t, size_t>                kbx_deferred_ids_;
+    std::unordered_multimap<std::string, size_t>       kbx_deferred_uids_;
+    std::vector<bool>                                  kbx_deferred_;
+
+    /* G10 key files which are not loaded yet, indexed by the keygrip from the file name, and
+     * copy of the public keys provider which was passed to the load() call. */
+    std::map<pgp_key_grip_t, std::string> g10_deferred_;
+    KeyProvider                           g10_provider_;
+    bool                                  g10_loading_{};
+
+    /* Keys which are stored in the keyring file and its journal, and primary keys which were
+     * added or removed since then. See the journal field. */
+    std::unordered_map<pgp_fingerprint_t, KeyBlobRef> journal_refs_;
+    std::unordered_set<pgp_fingerprint_t>             journal_dirty_;
+    std::string journal_path_;         /* path of the keyring journal_refs_ correspond to */
+    size_t      journal_size_{};       /* size of the journal file */
+    uint64_t    journal_revision_{};   /* pgp_key_t::last_revision() at the last write */
+    uint64_t    journal_base_size_{};  /* size of the keyring file */
+    uint64_t    journal_base_inode_{}; /* inode of the keyring file, changed on each rewrite */
+    int64_t     journal_base_ctime_{}; /* status change time of the keyring file, in ns */
+
+    pgp_key_t *             add_subkey(pgp_key_t &srckey, pgp_key_t *oldkey, bool move);
+    pgp_key_t *             add_key(pgp_key_t &srckey, bool move);
     pgp_sig_import_status_t import_subkey_signature(pgp_key_t &            key,
                                                     const pgp_signature_t &sig);
     bool                    refresh_subkey_grips(pgp_key_t &key);
 
+    KeyBlobRef key_ref(const pgp_key_t &key, size_t offset, uint32_t length) const;
+    bool       key_ref_changed(const pgp_key_t &key, const KeyBlobRef &ref) const;
+    void       kbx_reset_refs();
+    bool       write_kbx(pgp_dest_t &dst, bool refs);
+    bool       update_kbx();
+    pgp_key_t *kbx_blob_primary(kbx_pgp_blob_t &blob, pgp_fingerprint_t &fp);
+
+    void kbx_defer_blob(size_t idx, size_t offset);
+    bool kbx_load_deferred(size_t idx);
+    bool kbx_load_deferred(const pgp_fingerprint_t &fp);
+    bool kbx_load_deferred(const KeySearch &search);
+    void kbx_reset_deferred();
+
+    bool load_g10_dir(const KeyProvider *key_provider);
+    bool load_g10_files(const std::vector<std::string> &paths,
+                        const KeyProvider *             key_provider);
+    bool add_g10_key(pgp_key_pkt_t &    seckey,
+                     const uint8_t *    data,
+                     size_t             size,
+                     const KeyProvider *key_provider);
+    bool g10_load_deferred(const pgp_key_grip_t &grip);
+    bool g10_load_deferred(const KeySearch &search);
+    bool g10_load_all_deferred();
+    const KeyProvider *g10_provider() const;
+
+    void journal_reset_refs();
+    void journal_touch(const pgp_key_t &key);
+    bool journal_replay(bool refs);
+    bool journal_update();
+    bool journal_rebase();
+
+    /* Trigram index over the lowercased userids, built by set_uid_index() and updated on
+     * each key change afterwards, so search() never modifies it. Each key gets sequence
+     * number, which follows the order of keys list, and the list of its trigrams. Keys are
+     * referenced by fingerprint and resolved via keybyfp, so index never keeps pointers. */
+    struct UidIndexEntry {
+        uint64_t              seq;
+        std::vector<uint32_t> trigrams;
+    };
+
+    std::unordered_map<uint32_t, std::unordered_set<uint64_t>> uid_trigrams_;
+    std::unordered_map<pgp_fingerprint_t, UidIndexEntry>       uid_indexed_;
+    std::map<uint64_t, pgp_fingerprint_t>                      uid_seqs_;
+    uint64_t                                                   uid_seq_{};
+    bool                                                       uid_index_{};
+
+    void uid_index_put(const pgp_key_t &key);
+    void uid_index_remove(const pgp_key_t &key);
+    void uid_index_reset();
+    bool uid_index_search(const KeySearch &search, std::vector<pgp_key_t *> &res);
+
   public:
     std::string            path;
     pgp_key_store_format_t format;
     rnp::SecurityContext & secctx;
     bool                   disable_validation =
       false; /* do not automatically validate keys, added to this key store */
+    bool defer_kbx =
+      false; /* parse KBX keyblocks only when key is requested via get_key() or search() */
+    bool journal = false; /* append changes of GPG keyring to the journal file on write */
+    bool defer_g10 =
+      false; /* read G10 key files only when key is requested via get_key() or search() */
+    size_t g10_threads = 1; /* number of threads used to parse G10 key files on load */
+    size_t max_certs =
+      SIZE_MAX; /* max number of third-party certifications, stored per userid */
 
     std::list<pgp_key_t>                     keys;
     pgp_key_fp_map_t                         keybyfp;
@@ -120,6 +220,19 @@ class KeyStore {
      */
     bool load_kbx(pgp_source_t &src, const KeyProvider *key_provider = nullptr);
 
+    /**
+     * @brief Parse all keyblocks and key files, which were deferred during the KBX/G10 load.
+     *        Must be called before iterating over the keys when defer_kbx or defer_g10 is set.
+     *        Note: key provider, passed to the G10 load(), is copied, but its userdata must
+     *        be still available.
+     */
+    bool load_deferred();
+
+    /**
+     * @brief Check whether keystore has no keys, including the deferred ones.
+     */
+    bool empty() const;
+
     /**
      * @brief Load keystore in g10 format.
      */
@@ -127,9 +240,30 @@ class KeyStore {
 
     /**
      * @brief Write keystore to the path.
+     *        GPG keyring with enabled journal is updated via the journal_file().
+     *        KBX keystore, which was loaded from or written to the same path, is updated
+     *        in-place: blobs of new and changed keys are appended and synced, and only then
+     *        old blobs are marked as empty. Crash during the update may leave both versions
+     *        of the key (merged on load) or truncated trailing blob, while full rewrite goes
+     *        via the temporary file. Once empty blobs take more than half of the file it is
+     *        rewritten, see compact().
      */
     bool write();
 
+    /**
+     * @brief Rewrite the whole keystore at the path, dropping empty KBX blobs which are left
+     *        after the in-place updates, or merging the journal into the GPG keyring.
+     */
+    bool compact();
+
+    /**
+     * @brief Get path of the journal file for GPG keyring.
+     *        If journal field is set then load() replays changes, stored in the journal, and
+     *        write() appends changed, added and removed keys to it instead of rewriting the
+     *        whole keyring. Keyring is compacted once journal becomes larger than it.
+     */
+    std::string journal_file() const;
+
     /**
      * @brief Write keystore to the dest.
      */
@@ -148,8 +282,21 @@ class KeyStore {
 
     void clear();
 
+    /**
+     * @brief Get the number of loaded keys. Keys from the deferred KBX blobs are not counted.
+     */
     size_t key_count() const;
 
+    /**
+     * @brief Get the approximate memory usage of the loaded keys. Lookup tables and raw KBX
+     *        blobs, kept in memory, are accounted in the total value only.
+     */
+    pgp_key_memory_t memory_usage() const;
+
+    /**
+     * @brief Get the key by its fingerprint. Non-const version also parses deferred KBX blob
+     *        which contains the key.
+     */
     pgp_key_t *      get_key(const pgp_fingerprint_t &fpr);
     const pgp_key_t *get_key(const pgp_fingerprint_t &fpr) const;
 
@@ -177,6 +324,14 @@ class KeyStore {
      */
     pgp_key_t *add_key(pgp_key_t &key);
 
+    /**
+     * @brief Add key to the keystore, moving it instead of copying if there is no such key
+     *        yet. Otherwise key is merged into the existing one.
+     * @return pointer to the added key or nullptr if failed. Source key should not be used
+     *         afterwards.
+     */
+    pgp_key_t *add_key(pgp_key_t &&key);
+
     /**
      * @brief Add signature of the specific key to the keystore, revalidating and refresing
      *        key's data.
@@ -252,6 +407,26 @@ class KeyStore {
     pgp_key_t *primary_key(const pgp_key_t &subkey);
 
     pgp_key_t *search(const KeySearch &search, pgp_key_t *after = nullptr);
+
+    /**
+     * @brief Get all the keys matching the search, in the keystore order. Deferred KBX
+     *        blobs and G10 files are loaded first.
+     */
+    std::vector<pgp_key_t *> search_all(const KeySearch &search);
+
+    /**
+     * @brief Update userid index after the key's userids were changed outside of the
+     *        keystore, i.e. added or removed via the key object.
+     *
+     * @param key key, it is ignored if it doesn't belong to this keystore.
+     */
+    void update_uid_index(const pgp_key_t &key);
+
+    /**
+     * @brief Enable or disable trigram index of userids, used for the substring and
+     *        case-insensitive search(). Index is built over the already added keys.
+     */
+    void set_uid_index(bool enable);
 };
 } // namespace rnp
 
@@ -82,6 +82,8 @@ typedef uint32_t rnp_result_t;
 #define RNP_LOAD_SAVE_PERMISSIVE (1U << 8)
 #define RNP_LOAD_SAVE_SINGLE (1U << 9)
 #define RNP_LOAD_SAVE_BASE64 (1U << 10)
+#define RNP_LOAD_SAVE_DEFERRED (1U << 11)
+#define RNP_LOAD_SAVE_JOURNAL (1U << 12)
 
 /**
  * Flags for the rnp_key_remove_signatures
@@ -99,6 +101,7 @@ typedef uint32_t rnp_result_t;
  */
 #define RNP_OUTPUT_FILE_OVERWRITE (1U << 0)
 #define RNP_OUTPUT_FILE_RANDOM (1U << 1)
+#define RNP_OUTPUT_MEMORY_SEGMENTED (1U << 2)
 
 /**
  * Flags for default key selection.
@@ -133,6 +136,7 @@ typedef uint32_t rnp_result_t;
  * Encryption flags
  */
 #define RNP_ENCRYPT_NOWRAP (1U << 0)
+#define RNP_ENCRYPT_ADAPTIVE_COMPRESSION (1U << 1)
 
 /**
  * Decryption/verification flags
@@ -140,6 +144,15 @@ typedef uint32_t rnp_result_t;
 #define RNP_VERIFY_IGNORE_SIGS_ON_DECRYPT (1U << 0)
 #define RNP_VERIFY_REQUIRE_ALL_SIGS (1U << 1)
 #define RNP_VERIFY_ALLOW_HIDDEN_RECIPIENT (1U << 2)
+#define RNP_VERIFY_KEEP_SESSION_KEY (1U << 3)
+#define RNP_VERIFY_KEEP_KEYS_UNLOCKED (1U << 4)
+
+/**
+ * State flags of the operation, running in background.
+ */
+#define RNP_OP_STATE_NEED_INPUT (1U << 0)
+#define RNP_OP_STATE_HAVE_OUTPUT (1U << 1)
+#define RNP_OP_STATE_DONE (1U << 2)
 
 /**
  * Revocation key flags.
@@ -168,6 +181,34 @@ typedef uint32_t rnp_result_t;
 
 #define RNP_KEY_SERVER_NO_MODIFY (1U << 7)
 
+/**
+ * Flags for the multi-key search.
+ */
+#define RNP_LOCATE_SECRET (1U << 0)
+#define RNP_LOCATE_SUBKEYS (1U << 1)
+#define RNP_LOCATE_SUBKEYS_AFTER (1U << 2)
+#define RNP_LOCATE_FIRST_ONLY (1U << 3)
+#define RNP_LOCATE_USAGE_CERTIFY (1U << 8)
+#define RNP_LOCATE_USAGE_SIGN (1U << 9)
+#define RNP_LOCATE_USAGE_ENCRYPT (1U << 10)
+#define RNP_LOCATE_USAGE_AUTH (1U << 11)
+
+/**
+ * Fields of the bulk key listing.
+ */
+#define RNP_LIST_KEYID (1U << 0)
+#define RNP_LIST_FPRINT (1U << 1)
+#define RNP_LIST_GRIP (1U << 2)
+#define RNP_LIST_ALG (1U << 3)
+#define RNP_LIST_TIMES (1U << 4)
+#define RNP_LIST_VALIDITY (1U << 5)
+#define RNP_LIST_USAGE (1U << 6)
+#define RNP_LIST_USERIDS (1U << 7)
+#define RNP_LIST_SECRET (1U << 8)
+#define RNP_LIST_PRIMARY (1U << 9)
+#define RNP_LIST_USERIDS_VALIDITY (1U << 10)
+#define RNP_LIST_ALL ((1U << 11) - 1)
+
 /**
  * Return a constant string describing the result code
  */
@@ -253,10 +294,13 @@ typedef struct rnp_output_st *             rnp_output_t;
 typedef struct rnp_op_generate_st *        rnp_op_generate_t;
 typedef struct rnp_op_sign_st *            rnp_op_sign_t;
 typedef struct rnp_op_sign_signature_st *  rnp_op_sign_signature_t;
+typedef struct rnp_op_sign_batch_st *      rnp_op_sign_batch_t;
 typedef struct rnp_op_verify_st *          rnp_op_verify_t;
 typedef struct rnp_op_verify_signature_st *rnp_op_verify_signature_t;
 typedef struct rnp_op_encrypt_st *         rnp_op_encrypt_t;
+typedef struct rnp_op_decrypt_range_st *   rnp_op_decrypt_range_t;
 typedef struct rnp_identifier_iterator_st *rnp_identifier_iterator_t;
+typedef struct rnp_key_iterator_st *       rnp_key_iterator_t;
 typedef struct rnp_uid_handle_st *         rnp_uid_handle_t;
 typedef struct rnp_signature_handle_st *   rnp_signature_handle_t;
 typedef struct rnp_sig_subpacket_st *      rnp_sig_subpacket_t;
@@ -283,6 +327,28 @@ typedef bool rnp_input_reader_t(void *app_ctx, void *buf, size_t len, size_t *re
  * @return void
  */
 typedef void rnp_input_closer_t(void *app_ctx);
+/**
+ * @brief Callback, used to notify application about the state change of the operation,
+ *        running in background. It is called from the background thread, so it should
+ *        just wake up the application's event loop, which then may check the operation's
+ *        state.
+ *
+ * @param app_ctx custom parameter, passed back to the function.
+ * @return void
+ */
+typedef void rnp_op_notify_t(void *app_ctx);
+
+/**
+ * @brief Callback, used to notify application about completion of the operation, executed
+ *        via one of the *_execute_async() functions. It is called from the ffi's worker
+ *        thread, so it should be lightweight: i.e. store the result and wake up the
+ *        application's event loop (for instance, by writing to the eventfd or pipe).
+ *
+ * @param app_ctx custom parameter, passed back to the function.
+ * @param result result of the operation, the same as synchronous *_execute() would return.
+ * @return void
+ */
+typedef void rnp_op_complete_t(void *app_ctx, rnp_result_t result);
 /**
  * @brief Callback, used to write data to the output stream.
  *
@@ -383,6 +449,21 @@ typedef void (*rnp_key_signatures_cb)(rnp_ffi_t              ffi,
                                       rnp_signature_handle_t sig,
                                       uint32_t *             action);
 
+/**
+ * @brief callback used to report status of each key, imported via the
+ *        rnp_import_keys_stream() function.
+ * @param ffi
+ * @param app_ctx custom context, provided by application.
+ * @param fingerprint hexadecimal fingerprint of the imported key or subkey.
+ * @param pub_status status of a public key, one of "new", "updated", "unchanged", "none".
+ * @param sec_status status of a secret key, same possible values as for public.
+ */
+typedef void (*rnp_import_key_cb)(rnp_ffi_t   ffi,
+                                  void *      app_ctx,
+                                  const char *fingerprint,
+                                  const char *pub_status,
+                                  const char *sec_status);
+
 /** create the top-level object used for interacting with the library
  *
  *  @param ffi pointer that will be set to the created ffi object
@@ -425,6 +506,40 @@ RNP_API rnp_result_t rnp_ffi_set_pass_provider(rnp_ffi_t       ffi,
                                                rnp_password_cb getpasscb,
                                                void *          getpasscb_ctx);
 
+/**
+ * @brief Set limits of the ffi's worker pool, used by the *_execute_async() functions.
+ *        Operations are executed in the order of submission. Key generation is executed
+ *        exclusively, since it modifies the keyrings, while others may run in parallel.
+ *        Callbacks (password and key providers) are called from the worker threads.
+ *        While asynchronous operations are pending, ffi object must not be modified by the
+ *        application, and objects used by the operations must not be destroyed.
+ *
+ * @param ffi initialized ffi object, cannot be NULL.
+ * @param threads maximum number of worker threads. 0 means the number of CPUs (default).
+ * @param queue maximum number of queued operations, waiting for the free worker. Once it is
+ *              reached *_execute_async() functions fail with RNP_ERROR_BAD_STATE, so
+ *              application may apply the backpressure. 0 means unlimited (default).
+ * @return RNP_SUCCESS on success, RNP_ERROR_BAD_STATE if there are pending asynchronous
+ *         operations, or any other value on error.
+ */
+RNP_API rnp_result_t rnp_ffi_set_async_limits(rnp_ffi_t ffi, size_t threads, size_t queue);
+
+/**
+ * @brief Get the statistics of the ffi's worker pool.
+ *
+ * @param ffi initialized ffi object, cannot be NULL.
+ * @param queued if not NULL then number of operations, waiting for the free worker, will be
+ *               stored here.
+ * @param running if not NULL then number of operations, being executed at the moment, will be
+ *                stored here.
+ * @param completed if not NULL then number of completed operations will be stored here.
+ * @return RNP_SUCCESS on success, or any other value on error.
+ */
+RNP_API rnp_result_t rnp_ffi_get_async_stats(rnp_ffi_t ffi,
+                                             size_t *  queued,
+                                             size_t *  running,
+                                             size_t *  completed);
+
 /* Operations on key rings */
 
 /** retrieve the default homedir (example: /home/user/.rnp)
@@ -648,6 +763,43 @@ RNP_API rnp_result_t rnp_request_password(rnp_ffi_t        ffi,
  */
 RNP_API rnp_result_t rnp_set_timestamp(rnp_ffi_t ffi, uint64_t time);
 
+/**
+ * @brief Limit the number of third-party certifications, stored for each userid of the
+ *        keys in the keyrings. Certifications above the limit are dropped during the key loading and
+ *        import. This protects from the certificates flooded with certifications.
+ *        Also note that third-party certifications are not validated during the key loading,
+ *        use rnp_signature_is_valid() to validate them.
+ *
+ * @param ffi initialized FFI structure
+ * @param limit maximum number of third-party certifications per userid. SIZE_MAX (default)
+ *              means no limit, 0 means that only self-signatures are stored.
+ * @return RNP_SUCCESS or other value on error.
+ */
+RNP_API rnp_result_t rnp_set_certifications_limit(rnp_ffi_t ffi, size_t limit);
+
+/**
+ * @brief Set the number of threads, used to read and parse G10 key files during the
+ *        rnp_load_keys() call, and on the first access to keys of the deferred G10 keyring.
+ *
+ * @param ffi initialized FFI structure
+ * @param threads number of threads, 1 (default) means that files are parsed by the calling
+ *                thread only. Must not be 0.
+ * @return RNP_SUCCESS or other value on error.
+ */
+RNP_API rnp_result_t rnp_set_key_load_threads(rnp_ffi_t ffi, size_t threads);
+
+/**
+ * @brief Enable or disable the trigram index over the keys' userids. The index speeds up
+ *        rnp_locate_key() and key searches by userid or its substring on large keyrings,
+ *        at the cost of extra memory and work on each key addition. Disabled by default.
+ *        If enabled for already loaded keys, the index is built immediately.
+ *
+ * @param ffi initialized FFI structure
+ * @param enable true to build and maintain the index, false to drop it.
+ * @return RNP_SUCCESS or other value on error.
+ */
+RNP_API rnp_result_t rnp_set_uid_index(rnp_ffi_t ffi, bool enable);
+
 /** load keys
  *
  * Note that for G10, the input must be a directory (which must already exist).
@@ -656,6 +808,24 @@ RNP_API rnp_result_t rnp_set_timestamp(rnp_ffi_t ffi, uint64_t time);
  * @param format the key format of the data (GPG, KBX, G10). Must not be NULL.
  * @param input source to read from.
  * @param flags the flags. See RNP_LOAD_SAVE_*.
+ *              If RNP_LOAD_SAVE_DEFERRED is set, and only public keys are loaded from the KBX
+ *              to the empty KBX public keyring, then keyblocks are parsed only when the key
+ *              is requested, i.e. via rnp_locate_key() or during the signature verification.
+ *              Getting the key count, iteration and saving of the keys parse all of the
+ *              remaining keyblocks.
+ *              The same applies to loading of only secret keys from the G10 directory to the
+ *              empty G10 secret keyring: key file is read when key is requested by its
+ *              keygrip, or by the public key from the public keyring or key provider.
+ *              Otherwise this flag is ignored.
+ *              If only public or only secret keys are loaded from the path to the empty
+ *              keyring of the same format, then keyring remembers this path, see
+ *              rnp_save_keys().
+ *              If RNP_LOAD_SAVE_JOURNAL is set as well, and keyring is in GPG format, then
+ *              changes, appended to the journal file (path with ".journal" suffix) by the
+ *              previous saves, are applied on load, and rnp_save_keys() appends changed,
+ *              added and removed keys to the journal instead of rewriting the whole keyring.
+ *              Keyring is compacted once journal becomes larger than it. Otherwise this flag
+ *              is ignored.
  * @return RNP_SUCCESS on success, or any other value on error
  */
 RNP_API rnp_result_t rnp_load_keys(rnp_ffi_t   ffi,
@@ -663,6 +833,19 @@ RNP_API rnp_result_t rnp_load_keys(rnp_ffi_t   ffi,
                                    rnp_input_t input,
                                    uint32_t    flags);
 
+/** copy keys from the other FFI object, merging them with the already loaded ones.
+ *  Unlike the rnp_save_keys()/rnp_load_keys() pair, secret keys which are unlocked in the
+ *  source FFI object stay unlocked in the copy, so they may be used by the other thread
+ *  without the password request.
+ *  Note: source FFI object must not be used by the other threads during this call.
+ * @param ffi destination FFI object.
+ * @param src source FFI object, must be different from ffi.
+ * @param flags choose which keys should be copied (public, secret or both).
+ *              See RNP_LOAD_SAVE_PUBLIC_KEYS/RNP_LOAD_SAVE_SECRET_KEYS.
+ * @return RNP_SUCCESS on success, or any other value on error.
+ */
+RNP_API rnp_result_t rnp_copy_keys(rnp_ffi_t ffi, rnp_ffi_t src, uint32_t flags);
+
 /** unload public and/or secret keys
  *  Note: After unloading all key handles will become invalid and must be destroyed.
  * @param ffi
@@ -718,6 +901,28 @@ RNP_API rnp_result_t rnp_import_keys(rnp_ffi_t   ffi,
                                      uint32_t    flags,
                                      char **     results);
 
+/** import keys to the keyring, reporting status of each key via the callback.
+ *  Unlike rnp_import_keys(), keys are read, merged into the keyring and reported one by one,
+ *  so memory usage doesn't depend on the size of the input.
+ *  Note: this will work only with keys in OpenPGP format.
+ * @param ffi
+ * @param input source to read from. Cannot be NULL.
+ * @param flags see RNP_LOAD_SAVE_* constants. RNP_LOAD_SAVE_PUBLIC_KEYS and/or
+ *              RNP_LOAD_SAVE_SECRET_KEYS must be specified. RNP_LOAD_SAVE_PERMISSIVE and
+ *              RNP_LOAD_SAVE_BASE64 have the same meaning as for rnp_import_keys().
+ *              With RNP_LOAD_SAVE_PERMISSIVE keys which cannot be loaded are skipped as
+ *              well, without calling the callback.
+ * @param cb callback which is called for each imported key or subkey. May be NULL.
+ * @param app_ctx custom context, passed to the callback.
+ * @return RNP_SUCCESS on success, or any other value on error. Keys which were imported
+ *         before the error are kept in the keyring.
+ */
+RNP_API rnp_result_t rnp_import_keys_stream(rnp_ffi_t         ffi,
+                                            rnp_input_t       input,
+                                            uint32_t          flags,
+                                            rnp_import_key_cb cb,
+                                            void *            app_ctx);
+
 /** import standalone signatures to the keyring and receive JSON list of the updated
  * signatures.
  *
@@ -765,6 +970,12 @@ RNP_API rnp_result_t rnp_import_signatures(rnp_ffi_t   ffi,
 /** save keys
  *
  * Note that for G10, the output must be a directory (which must already exist).
+ * If only public or only secret keys are saved to the path they were loaded from, see
+ * rnp_load_keys(), then keyring is updated in-place where possible: KBX keyring gets only
+ * new and changed blobs, and changes of GPG keyring are appended to the journal if it was
+ * loaded with RNP_LOAD_SAVE_JOURNAL flag. Output must be created via rnp_output_to_file() with
+ * RNP_OUTPUT_FILE_OVERWRITE and RNP_OUTPUT_FILE_RANDOM flags then (or via
+ * rnp_output_to_path() for G10 directory), and its temporary file is discarded.
  *
  * @param ffi
  * @param format the key format of the data (GPG, KBX, G10). Must not be NULL.
@@ -780,6 +991,24 @@ RNP_API rnp_result_t rnp_save_keys(rnp_ffi_t    ffi,
 RNP_API rnp_result_t rnp_get_public_key_count(rnp_ffi_t ffi, size_t *count);
 RNP_API rnp_result_t rnp_get_secret_key_count(rnp_ffi_t ffi, size_t *count);
 
+/**
+ * @brief Get the approximate amount of memory used by the keys, loaded into the FFI object.
+ *        May be used to estimate memory requirements of the host for the given keyrings.
+ *
+ * @param ffi initialized FFI object.
+ * @param result on success JSON with the memory usage will be stored here, separately for
+ *               the public and secret keyrings. Each keyring object contains number of
+ *               "keys", "signatures" and "userids", as well as "key bytes",
+ *               "signature bytes", "userid bytes" and "total bytes" values. The latter also
+ *               includes memory used by the lookup tables. Top-level "total bytes" is the
+ *               sum of both keyrings. Must be freed via rnp_buffer_destroy().
+ *               Note: this only reports memory usage, it doesn't change the storage. Key
+ *               material keeps each MPI in a fixed 2048-byte buffer, so "key bytes" depends
+ *               on the key algorithm rather than on the actual key size.
+ * @return RNP_SUCCESS on success, or any other value on error.
+ */
+RNP_API rnp_result_t rnp_get_memory_usage(rnp_ffi_t ffi, char **result);
+
 /** Search for the key
  *  Note: only valid userids are checked while searching by userid.
  *
@@ -799,6 +1028,96 @@ RNP_API rnp_result_t rnp_locate_key(rnp_ffi_t         ffi,
 
 RNP_API rnp_result_t rnp_key_handle_destroy(rnp_key_handle_t key);
 
+/** Search for all the keys matching the query.
+ *  Query is evaluated once over both keyrings, so this is much faster than iterating over
+ *  the identifiers and checking each key separately.
+ *
+ *  @param ffi initialized FFI object.
+ *  @param query search query. Empty string matches all the keys. If query is a hex string
+ *         (optionally prefixed with 0x, and containing spaces) then it is matched against the
+ *         key id (full, or its lower 32 bits), fingerprint or grip. Otherwise, or if nothing
+ *         was matched, it is used as a case-insensitive extended regular expression,
+ *         which is searched for in the primary key's userids.
+ *  @param flags search flags:
+ *         RNP_LOCATE_SECRET - return only keys which have secret part.
+ *         RNP_LOCATE_SUBKEYS - subkeys may be returned as well, otherwise only primary keys
+ *           are matched.
+ *         RNP_LOCATE_SUBKEYS_AFTER - each matched primary key is followed by all of its
+ *           subkeys, while subkeys are matched directly only if their primary key is not
+ *           available. Subkeys are checked against the secret and usage filters as well,
+ *           and are returned even if their primary key doesn't pass these filters.
+ *           Implies RNP_LOCATE_SUBKEYS.
+ *         RNP_LOCATE_FIRST_ONLY - stop after the first matching key (and its subkeys if
+ *           RNP_LOCATE_SUBKEYS_AFTER is specified).
+ *         RNP_LOCATE_USAGE_CERTIFY, RNP_LOCATE_USAGE_SIGN, RNP_LOCATE_USAGE_ENCRYPT,
+ *         RNP_LOCATE_USAGE_AUTH - return only keys which have all the specified usage flags.
+ *  @param it on success iterator over the matching keys will be stored here. It may be
+ *         empty if nothing matches. Must be destroyed via rnp_key_iterator_destroy().
+ *  @return RNP_SUCCESS on success (including case where no keys were found),
+ *          RNP_ERROR_BAD_PARAMETERS if regular expression is invalid, or any other value on
+ *          error.
+ */
+RNP_API rnp_result_t rnp_locate_keys(rnp_ffi_t           ffi,
+                                     const char *        query,
+                                     uint32_t            flags,
+                                     rnp_key_iterator_t *it);
+
+/** List all the keys matching the query, writing compact JSON object on a separate line for
+ *  each key. Keyrings are walked once, and only requested fields are written, so this is
+ *  much faster than calling rnp_key_to_json() or separate getters for each key.
+ *
+ *  @param ffi initialized FFI object.
+ *  @param query search query, see rnp_locate_keys(). NULL or empty string lists all keys.
+ *  @param flags search flags, see rnp_locate_keys().
+ *  @param fields fields to write, any combination of:
+ *         RNP_LIST_KEYID - "keyid".
+ *         RNP_LIST_FPRINT - "fingerprint".
+ *         RNP_LIST_GRIP - "grip".
+ *         RNP_LIST_ALG - "type", "length" and "curve" (for ECC keys only). With PQC
+ *           enabled, also "sphincsplus param" for SLH-DSA keys.
+ *         RNP_LIST_TIMES - "creation time" and "expiration".
+ *         RNP_LIST_VALIDITY - "valid", "expired" and "revoked".
+ *         RNP_LIST_USAGE - "usage" array, the same as in rnp_key_to_json().
+ *         RNP_LIST_USERIDS - "userids" array, for the primary keys only.
+ *         RNP_LIST_SECRET - "public" and "secret", showing which key parts are available.
+ *         RNP_LIST_PRIMARY - "primary", and "primary fingerprint" for the subkey if known.
+ *         RNP_LIST_USERIDS_VALIDITY - "userids validity" array of objects with "valid" and
+ *           "revoked" values, in the same order as "userids", for the primary keys only.
+ *         RNP_LIST_ALL - all of the above.
+ *  @param output keys will be written here, one JSON object per line.
+ *  @return RNP_SUCCESS on success (including case where no keys were found), or any other
+ *          value on error.
+ */
+RNP_API rnp_result_t rnp_list_keys(rnp_ffi_t    ffi,
+                                   const char * query,
+                                   uint32_t     flags,
+                                   uint32_t     fields,
+                                   rnp_output_t output);
+
+/** Get the number of keys in the key iterator.
+ *
+ *  @param it key iterator, created via rnp_locate_keys().
+ *  @param count total number of the found keys will be stored here.
+ *  @return RNP_SUCCESS on success, or any other value on error.
+ */
+RNP_API rnp_result_t rnp_key_iterator_get_count(rnp_key_iterator_t it, size_t *count);
+
+/** Get the next key from the key iterator.
+ *
+ *  @param it key iterator, created via rnp_locate_keys().
+ *  @param key next key handle will be stored here, or NULL if there are no more keys.
+ *             Must be destroyed via rnp_key_handle_destroy().
+ *  @return RNP_SUCCESS on success, or any other value on error.
+ */
+RNP_API rnp_result_t rnp_key_iterator_next(rnp_key_iterator_t it, rnp_key_handle_t *key);
+
+/** Destroy the key iterator.
+ *
+ *  @param it key iterator, may be NULL.
+ *  @return RNP_SUCCESS on success, or any other value on error.
+ */
+RNP_API rnp_result_t rnp_key_iterator_destroy(rnp_key_iterator_t it);
+
 /** generate a key or pair of keys using a JSON description
  *
  *  Notes:
@@ -1245,6 +1564,21 @@ RNP_API rnp_result_t rnp_op_generate_set_sphincsplus_param(rnp_op_generate_t op,
  */
 RNP_API rnp_result_t rnp_op_generate_execute(rnp_op_generate_t op);
 
+/** Queue the prepared key or subkey generation operation for the execution on the ffi's
+ *  worker pool. See rnp_ffi_set_async_limits() for the details. Operation must not be
+ *  modified or destroyed until completion callback is called, however destroying it waits
+ *  for the completion.
+ *
+ * @param op pointer to opaque key generation context.
+ * @param complete optional callback, called once the operation is completed.
+ * @param app_ctx context, passed to the complete callback.
+ * @return RNP_SUCCESS if operation was queued, RNP_ERROR_BAD_STATE if it is already pending
+ *         or the queue is full, or any other error code.
+ */
+RNP_API rnp_result_t rnp_op_generate_execute_async(rnp_op_generate_t  op,
+                                                   rnp_op_complete_t *complete,
+                                                   void *             app_ctx);
+
 /** Get the generated key's handle. Should be called only after successful execution of
  *  rnp_op_generate_execute().
  *
@@ -3047,6 +3381,40 @@ RNP_API rnp_result_t rnp_op_sign_set_file_mtime(rnp_op_sign_t op, uint32_t mtime
  */
 RNP_API rnp_result_t rnp_op_sign_execute(rnp_op_sign_t op);
 
+/** @brief Queue previously initialized signing operation for the execution on the ffi's
+ *         worker pool. See rnp_op_generate_execute_async() for the details.
+ *  @param op opaque signing context.
+ *  @param complete optional callback, called once the operation is completed.
+ *  @param app_ctx context, passed to the complete callback.
+ *  @return RNP_SUCCESS if operation was queued or error code otherwise.
+ */
+RNP_API rnp_result_t rnp_op_sign_execute_async(rnp_op_sign_t      op,
+                                               rnp_op_complete_t *complete,
+                                               void *             app_ctx);
+
+/** @brief Start execution of previously initialized signing operation in background, so data
+ *         may be processed incrementally via the push input and the pull output. See
+ *         rnp_op_verify_start() for the details.
+ *  @param op opaque signing context.
+ *  @param notify optional callback, which is called when operation needs more input, has some
+ *         output available, or is done.
+ *  @param app_ctx context, passed to the notify callback.
+ *  @return RNP_SUCCESS if operation was started or error code otherwise.
+ */
+RNP_API rnp_result_t rnp_op_sign_start(rnp_op_sign_t    op,
+                                       rnp_op_notify_t *notify,
+                                       void *           app_ctx);
+
+/** @brief Get the state of the signing operation, started via rnp_op_sign_start(). See
+ *         rnp_op_verify_get_state() for the details.
+ */
+RNP_API rnp_result_t rnp_op_sign_get_state(rnp_op_sign_t op, uint32_t *state);
+
+/** @brief Wait for the signing operation, started via rnp_op_sign_start(), to finish.
+ *  @return the same value as rnp_op_sign_execute() would return.
+ */
+RNP_API rnp_result_t rnp_op_sign_finish(rnp_op_sign_t op);
+
 /** @brief Free resources associated with signing operation.
  *  @param op opaque signing context. Must be successfully initialized with one of the
  *         rnp_op_sign_*_create functions.
@@ -3054,6 +3422,108 @@ RNP_API rnp_result_t rnp_op_sign_execute(rnp_op_sign_t op);
  */
 RNP_API rnp_result_t rnp_op_sign_destroy(rnp_op_sign_t op);
 
+/** @brief Create operation context for detached signing of multiple inputs with the same set
+ *         of signers. Signing keys are unlocked and prepared once, and inputs are hashed and
+ *         signed in parallel during the rnp_op_sign_batch_execute() call.
+ *         Signing keys, hash and other parameters are set via rnp_op_sign_batch_* functions.
+ *  @param op pointer to opaque batch signing context.
+ *  @param ffi
+ *  @return RNP_SUCCESS or error code if failed.
+ */
+RNP_API rnp_result_t rnp_op_sign_batch_create(rnp_op_sign_batch_t *op, rnp_ffi_t ffi);
+
+/** @brief Add input to be signed, and output for the detached signature.
+ *  @param op opaque batch signing context, created via rnp_op_sign_batch_create.
+ *  @param input stream with data to be signed. Must be destroyed by the caller after the
+ *         execute call, and must not be shared with other inputs as they are read in parallel.
+ *  @param signature stream to write the detached signature to. Must be destroyed by the caller
+ *         after the execute call.
+ *  @param idx if not NULL then index of the input will be stored here, it may be used later
+ *         to check the result via rnp_op_sign_batch_get_result.
+ *  @return RNP_SUCCESS or error code if failed.
+ */
+RNP_API rnp_result_t rnp_op_sign_batch_add_input(rnp_op_sign_batch_t op,
+                                                 rnp_input_t         input,
+                                                 rnp_output_t        signature,
+                                                 size_t *            idx);
+
+/** @brief Add signing key. See rnp_op_sign_add_signature for the details.
+ *  @param op opaque batch signing context, created via rnp_op_sign_batch_create.
+ *  @param key handle of the private key. Private key should be capable for signing.
+ *  @param sig pointer to opaque structure holding the signature information. May be NULL.
+ *         Signature parameters, set via rnp_op_sign_signature_* functions, are applied to all
+ *         of the inputs.
+ *  @return RNP_SUCCESS or error code if failed.
+ */
+RNP_API rnp_result_t rnp_op_sign_batch_add_signature(rnp_op_sign_batch_t      op,
+                                                     rnp_key_handle_t         key,
+                                                     rnp_op_sign_signature_t *sig);
+
+/** @brief Enable or disable armored (textual) output of the signatures.
+ *  @param op opaque batch signing context, created via rnp_op_sign_batch_create.
+ *  @param armored true if armoring is needed or false otherwise.
+ *  @return RNP_SUCCESS or error code if failed.
+ */
+RNP_API rnp_result_t rnp_op_sign_batch_set_armor(rnp_op_sign_batch_t op, bool armored);
+
+/** @brief Set hash algorithm used during signature calculation. See rnp_op_sign_set_hash.
+ *  @param op opaque batch signing context, created via rnp_op_sign_batch_create.
+ *  @param hash hash algorithm to be used.
+ *  @return RNP_SUCCESS or error code if failed.
+ */
+RNP_API rnp_result_t rnp_op_sign_batch_set_hash(rnp_op_sign_batch_t op, const char *hash);
+
+/** @brief Set signature creation time. See rnp_op_sign_set_creation_time.
+ *  @param op opaque batch signing context, created via rnp_op_sign_batch_create.
+ *  @param create creation time in seconds since Jan, 1 1970 UTC.
+ *  @return RNP_SUCCESS or error code if failed.
+ */
+RNP_API rnp_result_t rnp_op_sign_batch_set_creation_time(rnp_op_sign_batch_t op,
+                                                         uint32_t            create);
+
+/** @brief Set signature expiration time. See rnp_op_sign_set_expiration_time.
+ *  @param op opaque batch signing context, created via rnp_op_sign_batch_create.
+ *  @param expire expiration time in seconds since the creation time, 0 for non-expiring.
+ *  @return RNP_SUCCESS or error code if failed.
+ */
+RNP_API rnp_result_t rnp_op_sign_batch_set_expiration_time(rnp_op_sign_batch_t op,
+                                                           uint32_t            expire);
+
+/** @brief Set maximum number of threads used to process the inputs.
+ *  @param op opaque batch signing context, created via rnp_op_sign_batch_create.
+ *  @param threads number of threads, 0 to use the number of available CPUs (default).
+ *  @return RNP_SUCCESS or error code if failed.
+ */
+RNP_API rnp_result_t rnp_op_sign_batch_set_threads(rnp_op_sign_batch_t op, size_t threads);
+
+/** @brief Execute batch signing. Password provider is called once per protected signing key,
+ *         before any of the inputs is processed, and keys are locked back after the call.
+ *         Inputs and outputs are accessed from the worker threads, so callback-based streams
+ *         must not share the state without the synchronization.
+ *  @param op opaque batch signing context, created via rnp_op_sign_batch_create. At least one
+ *         signing key and one input should be added.
+ *  @return RNP_SUCCESS if all of the inputs were signed successfully, or error code of the
+ *          first failed input. Result for each input may be checked via
+ *          rnp_op_sign_batch_get_result.
+ */
+RNP_API rnp_result_t rnp_op_sign_batch_execute(rnp_op_sign_batch_t op);
+
+/** @brief Get result of the input signing, after the rnp_op_sign_batch_execute call.
+ *  @param op opaque batch signing context.
+ *  @param idx index of the input, in order of the rnp_op_sign_batch_add_input calls.
+ *  @param result on success result of the input signing will be stored here.
+ *  @return RNP_SUCCESS or error code if failed.
+ */
+RNP_API rnp_result_t rnp_op_sign_batch_get_result(rnp_op_sign_batch_t op,
+                                                  size_t              idx,
+                                                  rnp_result_t *      result);
+
+/** @brief Free resources associated with batch signing operation.
+ *  @param op opaque batch signing context.
+ *  @return RNP_SUCCESS or error code if failed.
+ */
+RNP_API rnp_result_t rnp_op_sign_batch_destroy(rnp_op_sign_batch_t op);
+
 /* Verification */
 
 /** @brief Create verification operation context. This method should be used for embedded
@@ -3100,6 +3570,11 @@ RNP_API rnp_result_t rnp_op_verify_detached_create(rnp_op_verify_t *op,
  *                valid for successful run of rnp_op_verify_execute().
  *              RNP_VERIFY_ALLOW_HIDDEN_RECIPIENT - allow hidden recipient during the
  *                decryption.
+ *              RNP_VERIFY_KEEP_SESSION_KEY - keep the session key, used for the decryption,
+ *                so it may be retrieved via rnp_op_verify_get_session_key().
+ *              RNP_VERIFY_KEEP_KEYS_UNLOCKED - do not lock back the secret key, unlocked to
+ *                decrypt the message, so subsequent operations may use it without the password
+ *                request and key derivation. Key may be locked via rnp_key_lock().
  *
  *              Note: all flags are set at once, if some flag is not present in the subsequent
  *              call then it will be unset.
@@ -3120,6 +3595,59 @@ RNP_API rnp_result_t rnp_op_verify_set_flags(rnp_op_verify_t op, uint32_t flags)
  */
 RNP_API rnp_result_t rnp_op_verify_execute(rnp_op_verify_t op);
 
+/** @brief Start execution of previously initialized verification operation in background.
+ *         This allows to process data incrementally, as it arrives: usually the operation's
+ *         input is created via rnp_input_from_push() and the output via
+ *         rnp_output_to_pull(), so the application pushes data chunks and pulls the
+ *         results without blocking. Once the operation is done rnp_op_verify_finish() must
+ *         be called to get the result. Until then the operation, its input and output must
+ *         not be destroyed, and ffi object must not be modified. Callbacks, like password
+ *         and key providers, are called from the background thread.
+ *         Operation is queued to the ffi's worker pool (see rnp_ffi_set_async_limits()).
+ *         While it waits for the pushed input it keeps the worker thread busy, so the number
+ *         of streams, processed at once, is limited by the number of pool's threads, and the
+ *         remaining ones wait in the queue until some stream is finished. Pushed input is
+ *         buffered in the meantime. The same is available for the signing and encryption,
+ *         see rnp_op_sign_start() and rnp_op_encrypt_start().
+ *  @param op opaque verification context. Must be successfully initialized.
+ *  @param notify optional callback, which is called when operation needs more input, has some
+ *         output available, or is done.
+ *  @param app_ctx context, passed to the notify callback.
+ *  @return RNP_SUCCESS if operation was started or error code otherwise.
+ */
+RNP_API rnp_result_t rnp_op_verify_start(rnp_op_verify_t  op,
+                                         rnp_op_notify_t *notify,
+                                         void *           app_ctx);
+
+/** @brief Get the state of the verification operation, started via rnp_op_verify_start().
+ *         This call never blocks.
+ *  @param op opaque verification context.
+ *  @param state combination of the RNP_OP_STATE_* flags will be stored here:
+ *         RNP_OP_STATE_NEED_INPUT : operation waits for data, pushed via rnp_input_push().
+ *         RNP_OP_STATE_HAVE_OUTPUT : output data may be taken via rnp_output_pull().
+ *         RNP_OP_STATE_DONE : processing is finished, rnp_op_verify_finish() would not block.
+ *  @return RNP_SUCCESS if call succeeded or error code otherwise.
+ */
+RNP_API rnp_result_t rnp_op_verify_get_state(rnp_op_verify_t op, uint32_t *state);
+
+/** @brief Wait for the verification operation, started via rnp_op_verify_start(), to finish.
+ *         Blocks if RNP_OP_STATE_DONE is not reported yet.
+ *  @param op opaque verification context.
+ *  @return the same value as rnp_op_verify_execute() would return.
+ */
+RNP_API rnp_result_t rnp_op_verify_finish(rnp_op_verify_t op);
+
+/** @brief Queue previously initialized verification operation for the execution on the ffi's
+ *         worker pool. See rnp_op_generate_execute_async() for the details.
+ *  @param op opaque verification context.
+ *  @param complete optional callback, called once the operation is completed.
+ *  @param app_ctx context, passed to the complete callback.
+ *  @return RNP_SUCCESS if operation was queued or error code otherwise.
+ */
+RNP_API rnp_result_t rnp_op_verify_execute_async(rnp_op_verify_t    op,
+                                                 rnp_op_complete_t *complete,
+                                                 void *             app_ctx);
+
 /** @brief Get number of the signatures for verified data.
  *  @param op opaque verification context. Must be initialized and have execute() called on it.
  *  @param count result will be stored here on success.
@@ -3186,6 +3714,24 @@ RNP_API rnp_result_t rnp_op_verify_get_protection_info(rnp_op_verify_t op,
                                                        char **         cipher,
                                                        bool *          valid);
 
+/**
+ * @brief Get the session key, used to decrypt the message. Flag RNP_VERIFY_KEEP_SESSION_KEY
+ *        must be set via rnp_op_verify_set_flags() before the execution. Session key allows
+ *        to decrypt the message without the secret key or password, so should be stored
+ *        securely. See rnp_op_decrypt_range_create().
+ *
+ * @param op opaque verification context. Must be initialized and have execute() called on it.
+ * @param key on success pointer to the allocated buffer with session key will be stored here.
+ *            Cannot be NULL. Must be freed via rnp_buffer_destroy(), it is good idea to
+ *            securely clear it via rnp_buffer_clear() before.
+ * @param key_len on success length of the session key will be stored here. Cannot be NULL.
+ * @return RNP_SUCCESS if call succeeded, RNP_ERROR_NOT_FOUND if message was not decrypted,
+ *         or other error code.
+ */
+RNP_API rnp_result_t rnp_op_verify_get_session_key(rnp_op_verify_t op,
+                                                   uint8_t **      key,
+                                                   size_t *        key_len);
+
 /**
  * @brief Get number of public keys (recipients) to whom message was encrypted to.
  *
@@ -3452,6 +3998,36 @@ RNP_API rnp_result_t rnp_input_from_callback(rnp_input_t *       input,
                                              rnp_input_closer_t *closer,
                                              void *              app_ctx);
 
+/**
+ * @brief Initialize input struct, data for which is pushed by the application via
+ *        rnp_input_push(). Reading from it blocks until data is pushed, so it is intended to
+ *        be used with operations, running in background (see rnp_op_verify_start()).
+ *
+ * @param input pointer to the input opaque structure
+ * @return RNP_SUCCESS if operation succeeded or error code otherwise
+ */
+RNP_API rnp_result_t rnp_input_from_push(rnp_input_t *input);
+
+/**
+ * @brief Push data to the input, created via rnp_input_from_push(). Data is copied
+ *        internally, and call never blocks.
+ *
+ * @param input input structure, created via rnp_input_from_push().
+ * @param buf data to push. May be NULL only if len is zero.
+ * @param len number of bytes in buf.
+ * @return RNP_SUCCESS if operation succeeded or error code otherwise. RNP_ERROR_BAD_STATE is
+ *         returned if rnp_input_push_finish() was already called.
+ */
+RNP_API rnp_result_t rnp_input_push(rnp_input_t input, const uint8_t *buf, size_t len);
+
+/**
+ * @brief Signal the end of data for the input, created via rnp_input_from_push().
+ *
+ * @param input input structure, created via rnp_input_from_push().
+ * @return RNP_SUCCESS if operation succeeded or error code otherwise.
+ */
+RNP_API rnp_result_t rnp_input_push_finish(rnp_input_t input);
+
 /**
  * @brief Close previously opened input and free all corresponding resources
  *
@@ -3506,6 +4082,25 @@ RNP_API rnp_result_t rnp_output_to_stdout(rnp_output_t *output);
  */
 RNP_API rnp_result_t rnp_output_to_memory(rnp_output_t *output, size_t max_alloc);
 
+/**
+ * @brief Initialize output structure to write to the memory, with additional options.
+ *
+ * @param output pointer to the opaque output structure.
+ * @param max_alloc maximum amount of memory to allocate. 0 value means unlimited.
+ * @param size_hint expected size of the output, or 0 if unknown. If it is known then memory
+ *                  may be allocated at once, avoiding reallocations while data is written.
+ * @param flags additional flags. Currently only RNP_OUTPUT_MEMORY_SEGMENTED is supported:
+ *              data is stored in a list of separately allocated segments, so growth of the
+ *              output doesn't require copying of already written data. Segments may be
+ *              accessed via rnp_output_memory_get_segment_at(), while
+ *              rnp_output_memory_get_buf() without copying merges them into a single buffer.
+ * @return RNP_SUCCESS if operation succeeded or error code otherwise.
+ */
+RNP_API rnp_result_t rnp_output_to_memory_ex(rnp_output_t *output,
+                                             size_t        max_alloc,
+                                             size_t        size_hint,
+                                             uint32_t      flags);
+
 /**
  * @brief Output data to armored stream (and then output to other destination), allowing
  *        streamed output.
@@ -3537,6 +4132,36 @@ RNP_API rnp_result_t rnp_output_memory_get_buf(rnp_output_t output,
                                                size_t *     len,
                                                bool         do_copy);
 
+/**
+ * @brief Get the number of memory segments, holding the output's data. Output, initialized by
+ *        rnp_output_to_memory(), has a single segment once any data was written to it.
+ *
+ * @param output output structure, initialized by rnp_output_to_memory or
+ *               rnp_output_to_memory_ex.
+ * @param count number of segments will be stored here. Cannot be NULL.
+ * @return RNP_SUCCESS if operation succeeded or error code otherwise.
+ */
+RNP_API rnp_result_t rnp_output_memory_get_segment_count(rnp_output_t output, size_t *count);
+
+/**
+ * @brief Get the memory segment of the output. Concatenation of all segments in order gives
+ *        the whole output's data.
+ *
+ * @param output output structure, initialized by rnp_output_to_memory or
+ *               rnp_output_to_memory_ex.
+ * @param idx index of the segment, starting from 0.
+ * @param buf pointer to the segment's data will be stored here. Cannot be NULL. It must not be
+ *            modified, and is valid until the next write to the output, call to
+ *            rnp_output_memory_get_buf(), or output destruction.
+ * @param len number of bytes in the segment will be stored here. Cannot be NULL.
+ * @return RNP_SUCCESS if operation succeeded, RNP_ERROR_NOT_FOUND if idx is out of range, or
+ *         other error code.
+ */
+RNP_API rnp_result_t rnp_output_memory_get_segment_at(rnp_output_t    output,
+                                                      size_t          idx,
+                                                      const uint8_t **buf,
+                                                      size_t *        len);
+
 /**
  * @brief Initialize output structure to write to callbacks.
  *
@@ -3551,6 +4176,35 @@ RNP_API rnp_result_t rnp_output_to_callback(rnp_output_t *       output,
                                             rnp_output_closer_t *closer,
                                             void *               app_ctx);
 
+/**
+ * @brief Initialize output structure, data from which is pulled by the application via
+ *        rnp_output_pull(). It is intended to be used with operations, running in background
+ *        (see rnp_op_verify_start()).
+ *
+ * @param output pointer to the opaque output structure. After use you must free it using the
+ *               rnp_output_destroy() function.
+ * @param max_buffered maximum number of bytes to keep buffered. Once reached, writing to the
+ *                     output blocks until the application pulls the data. 0 means unlimited.
+ * @return RNP_SUCCESS if operation succeeded or error code otherwise.
+ */
+RNP_API rnp_result_t rnp_output_to_pull(rnp_output_t *output, size_t max_buffered);
+
+/**
+ * @brief Take the data, written to the output created via rnp_output_to_pull(). Call never
+ *        blocks.
+ *
+ * @param output output structure, created via rnp_output_to_pull().
+ * @param buf buffer to store data. Cannot be NULL.
+ * @param len size of the buffer.
+ * @param read number of bytes stored in buf will be put here. Cannot be NULL. Zero means that
+ *             no data is available at the moment.
+ * @return RNP_SUCCESS if operation succeeded or error code otherwise.
+ */
+RNP_API rnp_result_t rnp_output_pull(rnp_output_t output,
+                                     uint8_t *    buf,
+                                     size_t       len,
+                                     size_t *     read);
+
 /**
  * @brief Initialize output structure which will discard all data
  *
@@ -3765,11 +4419,33 @@ RNP_API rnp_result_t rnp_op_encrypt_set_compression(rnp_op_encrypt_t op,
  *              Following flags are supported:
  *              RNP_ENCRYPT_NOWRAP - do not wrap the data in a literal data packet. This
  *              would allow to encrypt already signed data.
+ *              RNP_ENCRYPT_ADAPTIVE_COMPRESSION - compress the first block of data with the
+ *              fastest level to estimate the gain. If it is negligible then data is stored
+ *              without the compressed packet, if it is small then fastest level is used.
+ *              Otherwise compression goes as configured. See
+ *              rnp_op_encrypt_get_compression() for the applied compression.
  *
  * @return RNP_SUCCESS or error code if failed.
  */
 RNP_API rnp_result_t rnp_op_encrypt_set_flags(rnp_op_encrypt_t op, uint32_t flags);
 
+/**
+ * @brief Get the compression, actually applied to the data. Makes sense mostly with the
+ *        RNP_ENCRYPT_ADAPTIVE_COMPRESSION flag.
+ *
+ * @param op opaque encrypting context. Must be executed via rnp_op_encrypt_execute().
+ * @param compression on success name of the compression algorithm will be stored here, or
+ *                    "Uncompressed" if data was not compressed. Caller must free it using the
+ *                    rnp_buffer_destroy(). May be NULL if not needed.
+ * @param level on success compression level will be stored here, 0 if data was not
+ *              compressed. May be NULL if not needed.
+ * @return RNP_SUCCESS or error code if failed. RNP_ERROR_BAD_STATE is returned if operation
+ *         was not executed yet.
+ */
+RNP_API rnp_result_t rnp_op_encrypt_get_compression(rnp_op_encrypt_t op,
+                                                    char **          compression,
+                                                    int *            level);
+
 /**
  * @brief set the internally stored file name for the data being encrypted
  *
@@ -3793,6 +4469,22 @@ RNP_API rnp_result_t rnp_op_encrypt_set_file_name(rnp_op_encrypt_t op, const cha
 RNP_API rnp_result_t rnp_op_encrypt_set_file_mtime(rnp_op_encrypt_t op, uint32_t mtime);
 
 RNP_API rnp_result_t rnp_op_encrypt_execute(rnp_op_encrypt_t op);
+RNP_API rnp_result_t rnp_op_encrypt_execute_async(rnp_op_encrypt_t   op,
+                                                  rnp_op_complete_t *complete,
+                                                  void *             app_ctx);
+
+/** @brief Start execution of previously initialized encryption operation in background, so
+ *         data may be processed incrementally via the push input and the pull output. See
+ *         rnp_op_verify_start() for the details.
+ */
+RNP_API rnp_result_t rnp_op_encrypt_start(rnp_op_encrypt_t op,
+                                          rnp_op_notify_t *notify,
+                                          void *           app_ctx);
+/** @brief Get the state of the encryption operation, started via rnp_op_encrypt_start(). */
+RNP_API rnp_result_t rnp_op_encrypt_get_state(rnp_op_encrypt_t op, uint32_t *state);
+/** @brief Wait for the encryption operation, started via rnp_op_encrypt_start(), to finish.
+ */
+RNP_API rnp_result_t rnp_op_encrypt_finish(rnp_op_encrypt_t op);
 RNP_API rnp_result_t rnp_op_encrypt_destroy(rnp_op_encrypt_t op);
 
 /**
@@ -3810,6 +4502,56 @@ RNP_API rnp_result_t rnp_op_encrypt_destroy(rnp_op_encrypt_t op);
  */
 RNP_API rnp_result_t rnp_decrypt(rnp_ffi_t ffi, rnp_input_t input, rnp_output_t output);
 
+/**
+ * @brief Create operation which decrypts any byte range of the large AEAD-encrypted message
+ *        (AEAD v5 or SEIPD v2), using the known session key. Message is split into the
+ *        independently authenticated chunks, so only chunks covering the requested range
+ *        are read and decrypted. Message must contain non-compressed literal data, and be
+ *        stored in the binary (non-armored) form.
+ *        Partial lengths of the literal data are expected to be of the same size, as both
+ *        RNP and GnuPG write them: headers in between are not read when seeking over them.
+ *
+ * @param op pointer to opaque operation context will be stored here. Cannot be NULL.
+ * @param ffi initialized FFI object. Cannot be NULL.
+ * @param input seekable input with encrypted message, i.e. created via
+ *              rnp_input_from_path() or rnp_input_from_memory(). Must be kept until the
+ *              operation is destroyed. Cannot be NULL.
+ * @param key session key, see rnp_op_verify_get_session_key(). Cannot be NULL.
+ * @param key_len length of the session key.
+ * @return RNP_SUCCESS on success, RNP_ERROR_NOT_SUPPORTED if input is not seekable or
+ *         message doesn't allow random access, or other error code.
+ */
+RNP_API rnp_result_t rnp_op_decrypt_range_create(rnp_op_decrypt_range_t *op,
+                                                 rnp_ffi_t               ffi,
+                                                 rnp_input_t             input,
+                                                 const uint8_t *         key,
+                                                 size_t                  key_len);
+
+/**
+ * @brief Decrypt the range [offset, offset + length) of the literal data and write it to the
+ *        output. Function may be called multiple times, reusing the already located chunks.
+ *        If range goes beyond the end of data then less bytes will be written.
+ *
+ * @param op operation context, created via rnp_op_decrypt_range_create(). Cannot be NULL.
+ * @param offset offset of the first byte within the literal data.
+ * @param length number of bytes to decrypt.
+ * @param output decrypted data will be written here. Cannot be NULL.
+ * @return RNP_SUCCESS on success, RNP_ERROR_READ if data cannot be read or authenticated, or
+ *         other error code.
+ */
+RNP_API rnp_result_t rnp_op_decrypt_range_execute(rnp_op_decrypt_range_t op,
+                                                  uint64_t               offset,
+                                                  uint64_t               length,
+                                                  rnp_output_t           output);
+
+/**
+ * @brief Free resources associated with the range decryption operation.
+ *
+ * @param op operation context. May be NULL.
+ * @return RNP_SUCCESS or error code if failed.
+ */
+RNP_API rnp_result_t rnp_op_decrypt_range_destroy(rnp_op_decrypt_range_t op);
+
 /**
  *  @brief retrieve the raw data for a public key
  *
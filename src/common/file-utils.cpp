@@ -42,6 +42,7 @@
 #include "str-utils.h"
 #include <algorithm>
 #ifdef _WIN32
+#include <io.h> // for _commit
 #include <random> // for rnp_mkstemp
 #define CATCH_AND_RETURN(v) \
     catch (...)             \
@@ -120,6 +121,19 @@ rnp_fdopen(int fildes, const char *mode)
 #endif
 }
 
+int
+rnp_fsync(FILE *fp)
+{
+    if (fflush(fp)) {
+        return -1;
+    }
+#ifdef _WIN32
+    return _commit(_fileno(fp));
+#else
+    return fsync(fileno(fp));
+#endif
+}
+
 int
 rnp_access(const char *path, int mode)
 {
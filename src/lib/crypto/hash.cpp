@@ -26,6 +26,7 @@
 
 #include "hash_botan.hpp"
 #include "logging.h"
+#include "object-pool.hpp"
 #include <cassert>
 
 static const id_str_pair botan_alg_map[] = {
@@ -44,6 +45,39 @@ static const id_str_pair botan_alg_map[] = {
   {0, NULL},
 };
 
+namespace {
+struct hash_fn_release {
+    void
+    operator()(std::unique_ptr<Botan::HashFunction> &fn)
+    {
+        fn.reset();
+    }
+};
+
+typedef rnp::ObjectPool<std::unique_ptr<Botan::HashFunction>, hash_fn_release> hash_pool_t;
+
+/* Pool key for CRC24, which is outside of the pgp_hash_alg_t range */
+const uint32_t CRC24_POOL_KEY = 0x100;
+
+hash_pool_t &
+hash_pool()
+{
+    static thread_local hash_pool_t pool;
+    return pool;
+}
+
+void
+hash_fn_put(std::unique_ptr<Botan::HashFunction> &fn, uint32_t key)
+{
+    if (!fn) {
+        return;
+    }
+    fn->clear();
+    hash_pool().put(std::move(fn), key);
+    fn = nullptr;
+}
+} // namespace
+
 namespace rnp {
 
 Hash_Botan::Hash_Botan(pgp_hash_alg_t alg) : Hash(alg)
@@ -53,6 +87,9 @@ Hash_Botan::Hash_Botan(pgp_hash_alg_t alg) : Hash(alg)
         throw rnp_exception(RNP_ERROR_BAD_PARAMETERS);
     }
 
+    if (hash_pool().get(fn_, alg)) {
+        return;
+    }
     fn_ = Botan::HashFunction::create(name);
     if (!fn_) {
         RNP_LOG("Error creating hash object for '%s'", name);
@@ -72,6 +109,7 @@ Hash_Botan::Hash_Botan(const Hash_Botan &src) : Hash(src.alg_)
 
 Hash_Botan::~Hash_Botan()
 {
+    hash_fn_put(fn_, alg_);
 }
 
 std::unique_ptr<Hash_Botan>
@@ -105,7 +143,7 @@ Hash_Botan::finish(uint8_t *digest)
     if (digest) {
         fn_->final(digest);
     }
-    fn_ = nullptr;
+    hash_fn_put(fn_, alg_);
     size_ = 0;
     return outlen;
 }
@@ -118,6 +156,9 @@ Hash_Botan::name_backend(pgp_hash_alg_t alg)
 
 CRC24_Botan::CRC24_Botan()
 {
+    if (hash_pool().get(fn_, CRC24_POOL_KEY)) {
+        return;
+    }
     fn_ = Botan::HashFunction::create("CRC24");
     if (!fn_) {
         RNP_LOG("Error creating CRC24 object");
@@ -128,6 +169,7 @@ CRC24_Botan::CRC24_Botan()
 
 CRC24_Botan::~CRC24_Botan()
 {
+    hash_fn_put(fn_, CRC24_POOL_KEY);
 }
 
 std::unique_ptr<CRC24_Botan>
@@ -153,7 +195,7 @@ CRC24_Botan::finish()
     }
     std::array<uint8_t, 3> crc{};
     fn_->final(crc.data());
-    fn_ = nullptr;
+    hash_fn_put(fn_, CRC24_POOL_KEY);
     return crc;
 }
 
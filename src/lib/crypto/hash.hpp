@@ -54,6 +54,9 @@ class Hash {
     size_t         size() const;
 
     static std::unique_ptr<Hash>  create(pgp_hash_alg_t alg);
+    /* Create hash without SHA-1 collision detection, i.e. backend's implementation. Must be
+     * used only where collision detection adds nothing, like key fingerprints or MDC. */
+    static std::unique_ptr<Hash>  create_fast(pgp_hash_alg_t alg);
     virtual std::unique_ptr<Hash> clone() const = 0;
 
     virtual void   add(const void *buf, size_t len) = 0;
@@ -73,6 +73,12 @@ Hash::create(pgp_hash_alg_t alg)
     if (alg == PGP_HASH_SHA1) {
         return Hash_SHA1CD::create();
     }
+    return create_fast(alg);
+}
+
+std::unique_ptr<Hash>
+Hash::create_fast(pgp_hash_alg_t alg)
+{
 #if !defined(ENABLE_SM2)
     if (alg == PGP_HASH_SM3) {
         RNP_LOG("SM3 hash is not available.");
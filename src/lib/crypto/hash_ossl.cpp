@@ -34,6 +34,7 @@
 #include "utils.h"
 #include "str-utils.h"
 #include "defaults.h"
+#include "object-pool.hpp"
 
 static const id_str_pair openssl_alg_map[] = {
   {PGP_HASH_MD5, "md5"},
@@ -49,6 +50,45 @@ static const id_str_pair openssl_alg_map[] = {
   {0, NULL},
 };
 
+namespace {
+struct md_ctx_release {
+    void
+    operator()(EVP_MD_CTX *ctx)
+    {
+        EVP_MD_CTX_free(ctx);
+    }
+};
+
+typedef rnp::ObjectPool<EVP_MD_CTX *, md_ctx_release> md_ctx_pool_t;
+
+md_ctx_pool_t &
+md_ctx_pool()
+{
+    static thread_local md_ctx_pool_t pool;
+    return pool;
+}
+
+EVP_MD_CTX *
+md_ctx_get()
+{
+    EVP_MD_CTX *ctx = NULL;
+    return md_ctx_pool().get(ctx) ? ctx : EVP_MD_CTX_new();
+}
+
+void
+md_ctx_put(EVP_MD_CTX *ctx)
+{
+    if (!ctx) {
+        return;
+    }
+    if (EVP_MD_CTX_reset(ctx) != 1) {
+        EVP_MD_CTX_free(ctx); // LCOV_EXCL_LINE
+        return;               // LCOV_EXCL_LINE
+    }
+    md_ctx_pool().put(std::move(ctx));
+}
+} // namespace
+
 namespace rnp {
 Hash_OpenSSL::Hash_OpenSSL(pgp_hash_alg_t alg) : Hash(alg)
 {
@@ -58,7 +98,7 @@ Hash_OpenSSL::Hash_OpenSSL(pgp_hash_alg_t alg) : Hash(alg)
         RNP_LOG("Error creating hash object for '%s'", hash_name);
         throw rnp_exception(RNP_ERROR_BAD_STATE);
     }
-    fn_ = EVP_MD_CTX_new();
+    fn_ = md_ctx_get();
     if (!fn_) {
         RNP_LOG("Allocation failure");
         throw rnp_exception(RNP_ERROR_OUT_OF_MEMORY);
@@ -66,7 +106,7 @@ Hash_OpenSSL::Hash_OpenSSL(pgp_hash_alg_t alg) : Hash(alg)
     int res = EVP_DigestInit_ex(fn_, hash_tp, NULL);
     if (res != 1) {
         RNP_LOG("Digest initializataion error %d : %lu", res, ERR_peek_last_error());
-        EVP_MD_CTX_free(fn_);
+        md_ctx_put(fn_);
         throw rnp_exception(RNP_ERROR_BAD_STATE);
     }
     assert(size_ == (size_t) EVP_MD_size(hash_tp));
@@ -78,7 +118,7 @@ Hash_OpenSSL::Hash_OpenSSL(const Hash_OpenSSL &src) : Hash(src.alg_)
         throw rnp_exception(RNP_ERROR_BAD_PARAMETERS);
     }
 
-    fn_ = EVP_MD_CTX_new();
+    fn_ = md_ctx_get();
     if (!fn_) {
         RNP_LOG("Allocation failure");
         throw rnp_exception(RNP_ERROR_OUT_OF_MEMORY);
@@ -87,7 +127,7 @@ Hash_OpenSSL::Hash_OpenSSL(const Hash_OpenSSL &src) : Hash(src.alg_)
     int res = EVP_MD_CTX_copy(fn_, src.fn_);
     if (res != 1) {
         RNP_LOG("Digest copying error %d: %lu", res, ERR_peek_last_error());
-        EVP_MD_CTX_free(fn_);
+        md_ctx_put(fn_);
         throw rnp_exception(RNP_ERROR_BAD_STATE);
     }
 }
@@ -124,7 +164,7 @@ Hash_OpenSSL::finish(uint8_t *digest)
         return 0;
     }
     int res = digest ? EVP_DigestFinal_ex(fn_, digest, NULL) : 1;
-    EVP_MD_CTX_free(fn_);
+    md_ctx_put(fn_);
     fn_ = NULL;
     if (res != 1) {
         RNP_LOG("Digest finalization error %d: %lu", res, ERR_peek_last_error());
@@ -141,7 +181,7 @@ Hash_OpenSSL::~Hash_OpenSSL()
     if (!fn_) {
         return;
     }
-    EVP_MD_CTX_free(fn_);
+    md_ctx_put(fn_);
 }
 
 const char *
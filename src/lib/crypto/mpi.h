@@ -39,7 +39,8 @@
 namespace pgp {
 
 typedef struct mpi {
-    /* Change this to vector once opaqueness is not required anymore */
+    /* Change this to vector once opaqueness is not required anymore. Until then each MPI
+     * takes PGP_MPINT_SIZE bytes, which is reported by KeyMaterial::memory_usage(). */
     uint8_t mpi[PGP_MPINT_SIZE];
     size_t  len;
 
@@ -1975,7 +1975,7 @@ sha1_process(SHA1_CTX *ctx, const uint32_t block[16])
 
     if (ctx->detect_coll) {
         if (ctx->ubc_check) {
-            ubc_check(ctx->m1, ubc_dv_mask);
+            ubc_check_simd(ctx->m1, ubc_dv_mask);
         }
 
         if (ubc_dv_mask[0] != 0) {
@@ -798,6 +798,12 @@ ubc_check(const uint32_t W[80], uint32_t dvmask[1])
     if (mask & (DV_I_51_0_bit | DV_II_47_0_bit))
         mask &= ((((W[35] ^ (W[39] >> 25)) & (1 << 3)) - (1 << 3)) |
                  ~(DV_I_51_0_bit | DV_II_47_0_bit));
+    dvmask[0] = ubc_check_final(W, mask);
+}
+
+uint32_t
+ubc_check_final(const uint32_t W[80], uint32_t mask)
+{
     if (mask) {
         if (mask & DV_I_43_0_bit)
             if (!((W[61] ^ (W[62] >> 5)) & (1 << 1)) ||
@@ -900,7 +906,7 @@ ubc_check(const uint32_t W[80], uint32_t dvmask[1])
                 mask &= ~DV_II_56_0_bit;
     }
 
-    dvmask[0] = mask;
+    return mask;
 }
 
 #ifdef SHA1DC_CUSTOM_TRAILING_INCLUDE_UBC_CHECK_C
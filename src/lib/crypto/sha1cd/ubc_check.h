@@ -45,6 +45,10 @@ typedef struct {
 } dv_info_t;
 extern dv_info_t sha1_dvs[];
 void             ubc_check(const uint32_t W[80], uint32_t dvmask[DVMASKSIZE]);
+/* second stage of ubc_check(), checks remaining conditions for the DVs set in the mask */
+uint32_t ubc_check_final(const uint32_t W[80], uint32_t mask);
+/* same as ubc_check(), but uses SIMD instructions if available */
+void ubc_check_simd(const uint32_t W[80], uint32_t dvmask[DVMASKSIZE]);
 
 #define DOSTORESTATE58
 #define DOSTORESTATE65
@@ -0,0 +1,286 @@
+/*
+ * Copyright (c) 2024 Ribose Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Vectorized version of the first stage of ubc_check(): unavoidable bitconditions which
+ * just clear DV bits depending on the XOR of two bits of the expanded message. These are
+ * independent of each other, so they are grouped into blocks of 8 conditions with the same
+ * bit positions and distance between message words, and evaluated in parallel. Result is
+ * passed to ubc_check_final(), so output is bit-identical to ubc_check().
+ */
+
+#ifndef SHA1DC_NO_STANDARD_INCLUDES
+#include <stdint.h>
+#endif
+#include "ubc_check.h"
+
+#if !defined(SHA1DC_NO_SIMD)
+#if defined(__x86_64__) || defined(_M_X64) || (defined(__i386__) && defined(__SSE2__))
+#define UBC_SSE2
+#include <emmintrin.h>
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(__INTEL_COMPILER)
+#define UBC_AVX2
+#include <immintrin.h>
+#endif
+#elif defined(__aarch64__) || (defined(__ARM_NEON) && defined(__ARM_NEON__))
+#define UBC_NEON
+#include <arm_neon.h>
+#endif
+#endif
+
+#if defined(UBC_SSE2) || defined(UBC_NEON)
+/* blocks table is constant, so let compiler to inline it into the code */
+#if defined(__clang__)
+#define UBC_UNROLL _Pragma("unroll")
+#elif defined(__GNUC__) && (__GNUC__ >= 8)
+#define UBC_UNROLL _Pragma("GCC unroll 32")
+#else
+#define UBC_UNROLL
+#endif
+
+/*
+ * Lane j of the block checks bit pa of W[a + j] against bit pb of W[a + j + off]. If bits
+ * differ then mask is AND-ed with t1[j], otherwise with t0[j]. Unused lanes are all-ones.
+ * Generated from the first stage of ubc_check().
+ */
+typedef struct {
+    int      a;
+    int      off;
+    int      pa;
+    int      pb;
+    uint32_t t1[8];
+    uint32_t t0[8];
+} ubc_block_t;
+
+static const ubc_block_t ubc_blocks[] = {
+  {35, 1, 1, 6,
+   {0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff,
+    0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff},
+   {0xfffffbef, 0xfffbefbf, 0xffffbeff, 0xffffffff,
+    0xffbfefef, 0xfeffbfbf, 0xfbfbfeff, 0xffffffff}},
+  {44, 1, 1, 6,
+   {0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff,
+    0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff},
+   {0xffbfbfff, 0xffffffff, 0xffffffff, 0xffffffff,
+    0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff}},
+  {63, 1, 1, 6,
+   {0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff,
+    0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff},
+   {0xfffefffb, 0xffffffff, 0xffffffff, 0xffffffff,
+    0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff}},
+  {35, 4, 3, 28,
+   {0xfff7dfff, 0xffffffff, 0xffffffff, 0xffffffff,
+    0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff},
+   {0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff,
+    0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff}},
+  {35, 4, 4, 29,
+   {0xfff7ff7b, 0xffeefdf7, 0xffdff7ff, 0xff7fdfff,
+    0xfdff7fff, 0xffffffff, 0xffffffff, 0xffffffff},
+   {0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff,
+    0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff}},
+  {36, 2, 4, 4,
+   {0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff,
+    0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff},
+   {0xd7ffffff, 0xaffffffe, 0x5ffffffd, 0xbffffffa,
+    0x7ffffff5, 0xffffffff, 0xffffffff, 0xffffffff}},
+  {37, 3, 4, 29,
+   {0xaffdffde, 0x5ff7ff7d, 0xbfeffdfa, 0x7fdff7f5,
+    0xff7edfda, 0xfdfd7f75, 0xf7f7fdda, 0xefeff775},
+   {0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff,
+    0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff}},
+  {45, 3, 4, 29,
+   {0xdfdfdddb, 0xbf7f7777, 0x7dfedddf, 0xf7fd777f,
+    0xeff6ddff, 0xdfed77ff, 0xbfd7dfff, 0x7f6f7fff},
+   {0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff,
+    0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff}},
+  {53, 3, 4, 29,
+   {0xfddfffff, 0xf77fffff, 0xedffffff, 0xd7ffffff,
+    0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff},
+   {0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff,
+    0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff}},
+  {40, 1, 29, 29,
+   {0x7ff5ff5d, 0xffe7fd7b, 0xffcff5f7, 0xff5ed7df,
+    0xfd7c5f7f, 0xf5f57dff, 0xe7e7f7fe, 0xcfcfdffd},
+   {0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff,
+    0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff}},
+  {48, 1, 29, 29,
+   {0x9f5f7ffb, 0x3d7efff7, 0x75fdffdf, 0xe7f7ff7f,
+    0xcfeefdff, 0x9fddf7ff, 0x3f77dfff, 0x7def7fff},
+   {0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff,
+    0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff}},
+  {56, 1, 29, 29,
+   {0xf7dfffff, 0xef7fffff, 0xddffffff, 0xffffffff,
+    0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff},
+   {0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff,
+    0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff}},
+  {41, -1, 1, 6,
+   {0xffbfefff, 0xfeffbfff, 0xfbfbffff, 0xffffffff,
+    0xffffffff, 0xffffffff, 0xfeffffef, 0xfbffffbf},
+   {0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff,
+    0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff}},
+  {51, -1, 1, 6,
+   {0xfffbefff, 0xffffffff, 0xffffffff, 0xffffffff,
+    0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff},
+   {0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff,
+    0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff}},
+  {42, 2, 6, 6,
+   {0xfffffeef, 0xfffffbbf, 0xffffeeef, 0xffffbbbf,
+    0xffffeeff, 0xffffbbff, 0xfffbefff, 0xffffffff},
+   {0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff,
+    0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff}},
+  {44, 2, 29, 29,
+   {0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff,
+    0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff},
+   {0xffffffda, 0xffffff75, 0xfffffddb, 0xfffff777,
+    0xffffdddf, 0xffff777f, 0xfffeddff, 0xffffffff}},
+  {48, 7, 29, 29,
+   {0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff,
+    0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff},
+   {0xffff5fff, 0xffffffff, 0xffffffff, 0xffffffff,
+    0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff}},
+  {51, 3, 29, 29,
+   {0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff,
+    0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff},
+   {0xfff5f7ff, 0xffffffff, 0xffcf7fff, 0xffffffff,
+    0xffffffff, 0xf5ffffff, 0xffffffff, 0xffffffff}},
+  {60, 1, 0, 5,
+   {0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff,
+    0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff},
+   {0xfffefffb, 0xfffdfff7, 0xfff7ffdf, 0xffefff7f,
+    0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff}},
+  {61, 1, 2, 7,
+   {0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff,
+    0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff},
+   {0xfffbffef, 0xffffffff, 0xffffffff, 0xffffffff,
+    0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff}}};
+
+#define UBC_BLOCKS ((unsigned) (sizeof(ubc_blocks) / sizeof(ubc_blocks[0])))
+#endif
+
+#if defined(UBC_SSE2)
+static uint32_t
+ubc_mask_sse2(const uint32_t W[80])
+{
+    const __m128i one = _mm_set1_epi32(1);
+    __m128i       acc = _mm_set1_epi32(-1);
+    unsigned      i;
+    int           h;
+    UBC_UNROLL
+    for (i = 0; i < UBC_BLOCKS; i++) {
+        const ubc_block_t *blk = &ubc_blocks[i];
+        const __m128i      pa = _mm_cvtsi32_si128(blk->pa);
+        const __m128i      pb = _mm_cvtsi32_si128(blk->pb);
+        for (h = 0; h < 8; h += 4) {
+            __m128i wa = _mm_loadu_si128((const __m128i *) (W + blk->a + h));
+            __m128i wb = _mm_loadu_si128((const __m128i *) (W + blk->a + blk->off + h));
+            __m128i x = _mm_xor_si128(_mm_srl_epi32(wa, pa), _mm_srl_epi32(wb, pb));
+            __m128i sel = _mm_sub_epi32(_mm_setzero_si128(), _mm_and_si128(x, one));
+            __m128i t1 = _mm_loadu_si128((const __m128i *) (blk->t1 + h));
+            __m128i t0 = _mm_loadu_si128((const __m128i *) (blk->t0 + h));
+            acc = _mm_and_si128(
+              acc, _mm_or_si128(_mm_and_si128(sel, t1), _mm_andnot_si128(sel, t0)));
+        }
+    }
+    acc = _mm_and_si128(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+    acc = _mm_and_si128(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+    return (uint32_t) _mm_cvtsi128_si32(acc);
+}
+#endif
+
+#if defined(UBC_AVX2)
+__attribute__((target("avx2"))) static uint32_t
+ubc_mask_avx2(const uint32_t W[80])
+{
+    const __m256i one = _mm256_set1_epi32(1);
+    __m256i       acc = _mm256_set1_epi32(-1);
+    unsigned      i;
+    UBC_UNROLL
+    for (i = 0; i < UBC_BLOCKS; i++) {
+        const ubc_block_t *blk = &ubc_blocks[i];
+        const __m128i      pa = _mm_cvtsi32_si128(blk->pa);
+        const __m128i      pb = _mm_cvtsi32_si128(blk->pb);
+        __m256i            wa = _mm256_loadu_si256((const __m256i *) (W + blk->a));
+        __m256i wb = _mm256_loadu_si256((const __m256i *) (W + blk->a + blk->off));
+        __m256i x = _mm256_xor_si256(_mm256_srl_epi32(wa, pa), _mm256_srl_epi32(wb, pb));
+        __m256i sel = _mm256_sub_epi32(_mm256_setzero_si256(), _mm256_and_si256(x, one));
+        __m256i t1 = _mm256_loadu_si256((const __m256i *) blk->t1);
+        __m256i t0 = _mm256_loadu_si256((const __m256i *) blk->t0);
+        acc = _mm256_and_si256(
+          acc, _mm256_or_si256(_mm256_and_si256(sel, t1), _mm256_andnot_si256(sel, t0)));
+    }
+    __m128i res = _mm_and_si128(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+    res = _mm_and_si128(res, _mm_shuffle_epi32(res, _MM_SHUFFLE(1, 0, 3, 2)));
+    res = _mm_and_si128(res, _mm_shuffle_epi32(res, _MM_SHUFFLE(2, 3, 0, 1)));
+    return (uint32_t) _mm_cvtsi128_si32(res);
+}
+#endif
+
+#if defined(UBC_NEON)
+static uint32_t
+ubc_mask_neon(const uint32_t W[80])
+{
+    const uint32x4_t one = vdupq_n_u32(1);
+    uint32x4_t       acc = vdupq_n_u32(0xffffffff);
+    unsigned         i;
+    int              h;
+    UBC_UNROLL
+    for (i = 0; i < UBC_BLOCKS; i++) {
+        const ubc_block_t *blk = &ubc_blocks[i];
+        /* NEON shifts right by the negative left shift */
+        const int32x4_t pa = vdupq_n_s32(-blk->pa);
+        const int32x4_t pb = vdupq_n_s32(-blk->pb);
+        for (h = 0; h < 8; h += 4) {
+            uint32x4_t wa = vld1q_u32(W + blk->a + h);
+            uint32x4_t wb = vld1q_u32(W + blk->a + blk->off + h);
+            uint32x4_t x = veorq_u32(vshlq_u32(wa, pa), vshlq_u32(wb, pb));
+            uint32x4_t sel = vsubq_u32(vdupq_n_u32(0), vandq_u32(x, one));
+            /* select t1 where sel is all-ones, t0 otherwise */
+            uint32x4_t t = vbslq_u32(sel, vld1q_u32(blk->t1 + h), vld1q_u32(blk->t0 + h));
+            acc = vandq_u32(acc, t);
+        }
+    }
+    uint32x2_t res = vand_u32(vget_low_u32(acc), vget_high_u32(acc));
+    return vget_lane_u32(res, 0) & vget_lane_u32(res, 1);
+}
+#endif
+
+void
+ubc_check_simd(const uint32_t W[80], uint32_t dvmask[DVMASKSIZE])
+{
+#if defined(UBC_AVX2)
+    if (__builtin_cpu_supports("avx2")) {
+        dvmask[0] = ubc_check_final(W, ubc_mask_avx2(W));
+        return;
+    }
+#endif
+#if defined(UBC_SSE2)
+    dvmask[0] = ubc_check_final(W, ubc_mask_sse2(W));
+#elif defined(UBC_NEON)
+    dvmask[0] = ubc_check_final(W, ubc_mask_neon(W));
+#else
+    ubc_check(W, dvmask);
+#endif
+}
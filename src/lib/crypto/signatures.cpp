@@ -124,7 +124,8 @@ signature_calculate(pgp_signature_t &        sig,
         RNP_LOG("Signature and secret key do not agree on algorithm type.");
         throw rnp::rnp_exception(RNP_ERROR_BAD_PARAMETERS);
     }
-    /* Validate key material if didn't before */
+    /* Validate key material if didn't before. Signing streams validate it under the
+     * rnp::KeyLocker beforehand, so concurrent jobs only read the cached status here. */
     seckey.validate(ctx, false);
     if (!seckey.valid()) {
         RNP_LOG("Attempt to sign with invalid key material.");
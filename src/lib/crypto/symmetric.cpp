@@ -35,6 +35,25 @@
 #include "utils.h"
 #include "repgp/repgp_def.h"
 #include "symmetric.h"
+#include "object-pool.hpp"
+
+struct block_cipher_release {
+    void
+    operator()(botan_block_cipher_t obj)
+    {
+        botan_block_cipher_destroy(obj);
+    }
+};
+
+typedef rnp::ObjectPool<botan_block_cipher_t, block_cipher_release> block_cipher_pool_t;
+
+/* Block ciphers are pooled per algorithm, being cleared from the key before reuse */
+static block_cipher_pool_t &
+block_cipher_pool()
+{
+    static thread_local block_cipher_pool_t pool;
+    return pool;
+}
 
 static const char *
 pgp_sa_to_botan_string(int alg, bool silent = false)
@@ -149,7 +168,8 @@ pgp_cipher_cfb_start(pgp_crypt_t *  crypt,
     crypt->blocksize = pgp_block_size(alg);
 
     // This shouldn't happen if pgp_sa_to_botan_string returned a ptr
-    if (botan_block_cipher_init(&(crypt->cfb.obj), cipher_name) != 0) {
+    if (!block_cipher_pool().get(crypt->cfb.obj, alg) &&
+        (botan_block_cipher_init(&(crypt->cfb.obj), cipher_name) != 0)) {
         RNP_LOG("Block cipher '%s' not available", cipher_name);
         return false;
     }
@@ -178,7 +198,11 @@ pgp_cipher_cfb_finish(pgp_crypt_t *crypt)
         return 0;
     }
     if (crypt->cfb.obj) {
-        botan_block_cipher_destroy(crypt->cfb.obj);
+        if (!botan_block_cipher_clear(crypt->cfb.obj)) {
+            block_cipher_pool().put(std::move(crypt->cfb.obj), crypt->alg);
+        } else {
+            botan_block_cipher_destroy(crypt->cfb.obj); // LCOV_EXCL_LINE
+        }
         crypt->cfb.obj = NULL;
     }
     botan_scrub_mem((uint8_t *) crypt, sizeof(*crypt));
@@ -198,6 +222,29 @@ pgp_is_sa_supported(int alg, bool silent)
 }
 
 #if defined(ENABLE_AEAD)
+struct aead_cipher_release {
+    void
+    operator()(botan_cipher_t obj)
+    {
+        botan_cipher_destroy(obj);
+    }
+};
+
+typedef rnp::ObjectPool<botan_cipher_t, aead_cipher_release> aead_cipher_pool_t;
+
+static aead_cipher_pool_t &
+aead_cipher_pool()
+{
+    static thread_local aead_cipher_pool_t pool;
+    return pool;
+}
+
+static uint32_t
+aead_cipher_pool_key(pgp_symm_alg_t ealg, pgp_aead_alg_t aalg, bool decrypt)
+{
+    return ealg | (aalg << 8) | ((uint32_t) decrypt << 16);
+}
+
 bool
 pgp_cipher_aead_init(pgp_crypt_t *  crypt,
                      pgp_symm_alg_t ealg,
@@ -222,7 +269,8 @@ pgp_cipher_aead_init(pgp_crypt_t *  crypt,
 
     flags = decrypt ? BOTAN_CIPHER_INIT_FLAG_DECRYPT : BOTAN_CIPHER_INIT_FLAG_ENCRYPT;
 
-    if (botan_cipher_init(&(crypt->aead.obj), cipher_name, flags)) {
+    if (!aead_cipher_pool().get(crypt->aead.obj, aead_cipher_pool_key(ealg, aalg, decrypt)) &&
+        botan_cipher_init(&(crypt->aead.obj), cipher_name, flags)) {
         RNP_LOG("cipher %s is not available", cipher_name);
         return false;
     }
@@ -330,7 +378,12 @@ void
 pgp_cipher_aead_destroy(pgp_crypt_t *crypt)
 {
     if (crypt->aead.obj) {
-        botan_cipher_destroy(crypt->aead.obj);
+        auto key = aead_cipher_pool_key(crypt->alg, crypt->aead.alg, crypt->aead.decrypt);
+        if (!botan_cipher_clear(crypt->aead.obj)) {
+            aead_cipher_pool().put(std::move(crypt->aead.obj), key);
+        } else {
+            botan_cipher_destroy(crypt->aead.obj); // LCOV_EXCL_LINE
+        }
     }
     memset(crypt, 0x0, sizeof(*crypt));
 }
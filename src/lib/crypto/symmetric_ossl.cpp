@@ -36,6 +36,45 @@
 #include "utils.h"
 #include "repgp/repgp_def.h"
 #include "symmetric.h"
+#include "object-pool.hpp"
+
+struct cipher_ctx_release {
+    void
+    operator()(EVP_CIPHER_CTX *ctx)
+    {
+        EVP_CIPHER_CTX_free(ctx);
+    }
+};
+
+typedef rnp::ObjectPool<EVP_CIPHER_CTX *, cipher_ctx_release> cipher_ctx_pool_t;
+
+static cipher_ctx_pool_t &
+cipher_ctx_pool()
+{
+    static thread_local cipher_ctx_pool_t pool;
+    return pool;
+}
+
+static EVP_CIPHER_CTX *
+cipher_ctx_get()
+{
+    EVP_CIPHER_CTX *ctx = NULL;
+    return cipher_ctx_pool().get(ctx) ? ctx : EVP_CIPHER_CTX_new();
+}
+
+/* reset clears the key schedule, so context may be safely reused */
+static void
+cipher_ctx_put(EVP_CIPHER_CTX *ctx)
+{
+    if (!ctx) {
+        return;
+    }
+    if (EVP_CIPHER_CTX_reset(ctx) != 1) {
+        EVP_CIPHER_CTX_free(ctx); // LCOV_EXCL_LINE
+        return;                   // LCOV_EXCL_LINE
+    }
+    cipher_ctx_pool().put(std::move(ctx));
+}
 
 static const char *
 pgp_sa_to_openssl_string(int alg, bool silent = false)
@@ -104,12 +143,12 @@ pgp_cipher_cfb_start(pgp_crypt_t *  crypt,
     crypt->alg = alg;
     crypt->blocksize = pgp_block_size(alg);
 
-    EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+    EVP_CIPHER_CTX *ctx = cipher_ctx_get();
     int             res = EVP_EncryptInit_ex(ctx, cipher, NULL, key, iv);
     if (res != 1) {
         /* LCOV_EXCL_START */
         RNP_LOG("Failed to initialize cipher.");
-        EVP_CIPHER_CTX_free(ctx);
+        cipher_ctx_put(ctx);
         return false;
         /* LCOV_EXCL_END */
     }
@@ -131,7 +170,7 @@ pgp_cipher_cfb_finish(pgp_crypt_t *crypt)
         return 0; // LCOV_EXCL_LINE
     }
     if (crypt->cfb.obj) {
-        EVP_CIPHER_CTX_free(crypt->cfb.obj);
+        cipher_ctx_put(crypt->cfb.obj);
         crypt->cfb.obj = NULL;
     }
     OPENSSL_cleanse((uint8_t *) crypt, sizeof(*crypt));
@@ -201,7 +240,7 @@ pgp_cipher_aead_init(pgp_crypt_t *  crypt,
         /* LCOV_EXCL_END */
     }
     /* Create and setup context */
-    EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+    EVP_CIPHER_CTX *ctx = cipher_ctx_get();
     if (!ctx) {
         /* LCOV_EXCL_START */
         RNP_LOG("Failed to create cipher context: %lu", ERR_peek_last_error());
@@ -361,7 +400,7 @@ void
 pgp_cipher_aead_destroy(pgp_crypt_t *crypt)
 {
     if (crypt->aead.obj) {
-        EVP_CIPHER_CTX_free(crypt->aead.obj);
+        cipher_ctx_put(crypt->aead.obj);
     }
     delete crypt->aead.key;
     memset(crypt, 0x0, sizeof(*crypt));
@@ -29,10 +29,18 @@
 #include <json.h>
 #include "utils.h"
 #include <list>
+#include <vector>
 #include <unordered_set>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <crypto/mem.h>
 #include "sec_profile.hpp"
 #include "keygen.hpp"
+#include "thread-pool.hpp"
 
 struct rnp_key_handle_st {
     rnp_ffi_t  ffi;
@@ -119,6 +127,14 @@ struct rnp_ffi_st {
     rnp::KeyProvider        key_provider;
     pgp_password_provider_t pass_provider;
     rnp::SecurityContext    context;
+    /* pool for the operations, executed asynchronously. Created on the first use, so
+     * access to it is guarded by pool_lock. */
+    std::unique_ptr<rnp::ThreadPool> pool;
+    size_t                           pool_threads{};
+    size_t                           pool_queue{};
+    std::mutex                       pool_lock;
+    /* serializes key lookups from the operations, running in parallel */
+    std::recursive_mutex keys_lock;
 
     rnp_ffi_st(pgp_key_store_format_t pub_fmt, pgp_key_store_format_t sec_fmt);
     ~rnp_ffi_st();
@@ -127,10 +143,32 @@ struct rnp_ffi_st {
     rnp::SecurityProfile &profile() noexcept;
 };
 
+/* state of the operation, executed via *_execute_async(). Must be the last member of the
+ * operation's structure: then it is destroyed first, waiting for the execution to complete. */
+struct rnp_op_async_st {
+    std::mutex              lock;
+    std::condition_variable cond;
+    bool                    pending{};
+
+    /* wait until the operation is completed */
+    void
+    wait()
+    {
+        std::unique_lock<std::mutex> lk(lock);
+        cond.wait(lk, [this]() { return !pending; });
+    }
+
+    ~rnp_op_async_st()
+    {
+        wait();
+    }
+};
+
 struct rnp_input_st {
     /* either src or src_directory are valid, not both */
     pgp_source_t        src;
     std::string         src_directory;
+    std::string         src_path; /* path of the file, if src reads from it */
     rnp_input_reader_t *reader;
     rnp_input_closer_t *closer;
     void *              app_ctx;
@@ -144,10 +182,56 @@ struct rnp_input_st {
     rnp_input_st &operator=(rnp_input_st &&src);
 };
 
+/* buffer, passing data between the application and the operation running in background */
+struct rnp_stream_pipe_st {
+    std::mutex              lock;
+    std::condition_variable cond;
+    std::vector<uint8_t>    data;
+    size_t                  pos{};
+    size_t                  max{};     /* maximum number of buffered bytes, 0 for unlimited */
+    bool                    eof{};     /* no more data will be written */
+    bool                    aborted{}; /* operation is destroyed, both sides must stop */
+    bool                    waiting{}; /* reader waits for the data */
+    std::function<void()>   notify;    /* called on write and when reader starts waiting */
+
+    size_t
+    avail() const
+    {
+        return data.size() - pos;
+    }
+};
+
+/* state of the operation, started via rnp_op_*_start() on the ffi's worker pool. State is
+ * shared with the queued task, so operation destroyed before the start is just skipped by the
+ * worker. Must be placed after all of the members, used by the operation's execution. */
+struct rnp_op_stream_st {
+    struct State {
+        std::mutex              lock;
+        std::condition_variable cond;
+        bool                    running{};  /* picked up by the worker */
+        bool                    done{};     /* processing is finished */
+        bool                    notified{}; /* notify callback returned, task is over */
+        bool                    stopped{};  /* operation is being destroyed */
+        rnp_result_t            result{};
+    };
+    std::shared_ptr<State>            state; /* non-null once operation is started */
+    std::vector<rnp_stream_pipe_st *> inputs;
+    rnp_stream_pipe_st *              output{};
+
+    /* abort the running operation and wait for it, or drop it from the queue */
+    void stop();
+
+    ~rnp_op_stream_st()
+    {
+        stop();
+    }
+};
+
 struct rnp_output_st {
     /* either dst or dst_directory are valid, not both */
     pgp_dest_t           dst;
     char *               dst_directory;
+    char *               dst_path; /* target path, not touched until dst is finished */
     rnp_output_writer_t *writer;
     rnp_output_closer_t *closer;
     void *               app_ctx;
@@ -169,6 +253,7 @@ struct rnp_op_generate_st {
     rnp_key_protection_params_t protection{};
     rnp::CertParams             cert;
     rnp::BindingParams          binding;
+    rnp_op_async_st             async;
 
     rnp_op_generate_st(rnp_ffi_t affi, pgp_pubkey_alg_t alg)
         : ffi(affi), keygen(alg, affi->context)
@@ -192,6 +277,34 @@ struct rnp_op_sign_st {
     rnp_output_t             output{};
     rnp_ctx_t                rnpctx{};
     rnp_op_sign_signatures_t signatures{};
+    rnp_op_stream_st         stream;
+    rnp_op_async_st          async;
+};
+
+struct rnp_op_sign_batch_item_t {
+    rnp_input_t  input{};
+    rnp_output_t output{};
+    rnp_result_t result{RNP_ERROR_GENERIC};
+};
+
+struct rnp_op_sign_batch_st {
+    rnp_ffi_t                             ffi{};
+    rnp_ctx_t                             rnpctx{};
+    rnp_op_sign_signatures_t              signatures{};
+    std::vector<rnp_op_sign_batch_item_t> items{};
+    size_t                                threads{};
+    bool                                  executed{};
+};
+
+/* Batch signing worker: has own context and random generator, and empty providers since
+ * signers are resolved and unlocked before the workers are started. */
+struct rnp_op_sign_batch_worker_t {
+    rnp::SecurityContext    secctx;
+    rnp_ctx_t               rnpctx;
+    pgp_password_provider_t pass_provider;
+    rnp::KeyProvider        key_provider;
+
+    rnp_op_sign_batch_worker_t(rnp_op_sign_batch_t op);
 };
 
 struct rnp_op_verify_signature_st {
@@ -218,12 +331,17 @@ struct rnp_op_verify_st {
     bool           ignore_sigs{};
     bool           require_all_sigs{};
     bool           allow_hidden{};
+    bool           keep_sesskey{};
+    /* session key, if RNP_VERIFY_KEEP_SESSION_KEY is set */
+    rnp::secure_vector<uint8_t> sesskey;
     /* recipient/symenc information */
     std::vector<rnp_recipient_handle_st> recipients;
     rnp_recipient_handle_t               used_recipient{};
     std::vector<rnp_symenc_handle_st>    symencs;
     rnp_symenc_handle_t                  used_symenc{};
     size_t                               encrypted_layers{};
+    rnp_op_stream_st                     stream;
+    rnp_op_async_st                      async;
 
     ~rnp_op_verify_st();
 };
@@ -234,6 +352,16 @@ struct rnp_op_encrypt_st {
     rnp_output_t             output{};
     rnp_ctx_t                rnpctx{};
     rnp_op_sign_signatures_t signatures{};
+    rnp_op_stream_st         stream;
+    rnp_op_async_st          async;
+};
+
+struct rnp_op_decrypt_range_st {
+    rnp_ffi_t    ffi{};
+    rnp_input_t  input{};
+    pgp_source_t src{}; /* seekable source with the literal data */
+
+    ~rnp_op_decrypt_range_st();
 };
 
 #define RNP_LOCATOR_MAX_SIZE (MAX_ID_LENGTH + 1)
@@ -265,6 +393,17 @@ struct rnp_identifier_iterator_st {
     }
 };
 
+struct rnp_key_iterator_st {
+    rnp_ffi_t ffi;
+    /* public and secret parts of the found keys, any of those may be nullptr */
+    std::vector<std::pair<pgp_key_t *, pgp_key_t *>> keys;
+    size_t                                           idx;
+
+    rnp_key_iterator_st(rnp_ffi_t affi) : ffi(affi), idx(0)
+    {
+    }
+};
+
 struct rnp_decryption_kp_param_t {
     rnp_op_verify_t op;
     bool            has_hidden; /* key provider had hidden keyid request */
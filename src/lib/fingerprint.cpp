@@ -62,7 +62,8 @@ try {
 #endif
     {
         auto halg = key.version == PGP_V4 ? PGP_HASH_SHA1 : PGP_HASH_SHA256;
-        auto hash = rnp::Hash::create(halg);
+        /* fingerprint is calculated over the parsed key, collision detection is not needed */
+        auto hash = rnp::Hash::create_fast(halg);
         signature_hash_key(key, *hash, key.version);
         fp.length = hash->finish(fp.fingerprint);
         return RNP_SUCCESS;
@@ -24,8 +24,15 @@
  * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include "config.h"
 #include <string>
 #include <map>
+#include <algorithm>
+#ifndef RNP_USE_STD_REGEX
+#include <regex.h>
+#else
+#include <regex>
+#endif
 #include "key-provider.h"
 #include "pgp-key.h"
 #include "fingerprint.h"
@@ -150,6 +157,12 @@ KeyIDSearch::KeyIDSearch(const pgp_key_id_t &keyid)
     keyid_ = keyid;
 }
 
+const pgp_key_id_t &
+KeyIDSearch::get_keyid() const
+{
+    return keyid_;
+}
+
 bool
 KeyFingerprintSearch::matches(const pgp_key_t &key) const
 {
@@ -204,6 +217,12 @@ KeyGripSearch::KeyGripSearch(const pgp_key_grip_t &grip)
     grip_ = grip;
 }
 
+const pgp_key_grip_t &
+KeyGripSearch::get_grip() const
+{
+    return grip_;
+}
+
 bool
 KeyUIDSearch::matches(const pgp_key_t &key) const
 {
@@ -228,6 +247,126 @@ KeyUIDSearch::KeyUIDSearch(const std::string &uid)
     uid_ = uid;
 }
 
+struct KeyQuerySearch::Regex {
+#ifndef RNP_USE_STD_REGEX
+    regex_t re{};
+
+    Regex(const std::string &expr)
+    {
+        if (regcomp(&re, expr.c_str(), REG_EXTENDED | REG_ICASE)) {
+            RNP_LOG("Invalid regular expression: %s", expr.c_str());
+            throw rnp_exception(RNP_ERROR_BAD_PARAMETERS);
+        }
+    }
+
+    ~Regex()
+    {
+        regfree(&re);
+    }
+
+    bool
+    search(const std::string &str) const
+    {
+        return !regexec(&re, str.c_str(), 0, NULL, 0);
+    }
+#else
+    std::regex re;
+
+    Regex(const std::string &expr)
+    {
+        try {
+            re.assign(expr, std::regex_constants::ECMAScript | std::regex_constants::icase);
+        } catch (const std::exception &e) {
+            RNP_LOG("Invalid regular expression: %s, error %s", expr.c_str(), e.what());
+            throw rnp_exception(RNP_ERROR_BAD_PARAMETERS);
+        }
+    }
+
+    bool
+    search(const std::string &str) const
+    {
+        return std::regex_search(str, re);
+    }
+#endif
+};
+
+bool
+KeyQuerySearch::matches_hex(const pgp_key_t &key) const
+{
+    /* key id or its lower 32 bits */
+    auto &keyid = key.keyid();
+    if (((hex_.size() == keyid.size()) || (hex_.size() == keyid.size() / 2)) &&
+        !memcmp(hex_.data(), keyid.data() + keyid.size() - hex_.size(), hex_.size())) {
+        return true;
+    }
+    auto &fp = key.fp();
+    if ((hex_.size() == fp.length) && !memcmp(hex_.data(), fp.fingerprint, fp.length)) {
+        return true;
+    }
+    auto &grip = key.grip();
+    return (hex_.size() == grip.size()) && !memcmp(hex_.data(), grip.data(), grip.size());
+}
+
+bool
+KeyQuerySearch::matches(const pgp_key_t &key) const
+{
+    if (query_.empty()) {
+        return true;
+    }
+    if (!hex_.empty() && matches_hex(key)) {
+        return true;
+    }
+    /* hex string may be a part of the userid as well, but subkeys do not have them */
+    if (key.is_subkey()) {
+        return false;
+    }
+    for (size_t idx = 0; idx < key.uid_count(); idx++) {
+        if (re_->search(key.get_uid(idx).str)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+const std::string
+KeyQuerySearch::name() const
+{
+    return "query";
+}
+
+std::string
+KeyQuerySearch::value() const
+{
+    return query_;
+}
+
+bool
+KeyQuerySearch::literal() const
+{
+    return literal_;
+}
+
+KeyQuerySearch::KeyQuerySearch(const std::string &query)
+{
+    type_ = Type::Query;
+    query_ = query;
+    if (query_.empty()) {
+        return;
+    }
+    if (is_hex(query_) && (query_.length() >= PGP_KEY_ID_SIZE)) {
+        auto hexstr = strip_hex(query_);
+        if (!(hexstr.length() % 2)) {
+            hex_ = hex_to_bin(hexstr);
+        }
+    }
+    re_.reset(new Regex(query_));
+    literal_ = hex_.empty() && std::none_of(query_.begin(), query_.end(), [](char ch) {
+                   return (ch & 0x80) || strchr("\\^$.|?*+()[]{}", ch);
+               });
+}
+
+KeyQuerySearch::~KeyQuerySearch() = default;
+
 pgp_key_t *
 KeyProvider::request_key(const KeySearch &search, pgp_op_t op, bool secret) const
 {
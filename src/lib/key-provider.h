@@ -39,7 +39,7 @@ namespace rnp {
 
 class KeySearch {
   public:
-    enum class Type { Unknown, KeyID, Fingerprint, Grip, UserID };
+    enum class Type { Unknown, KeyID, Fingerprint, Grip, UserID, Query };
     static Type find_type(const std::string &name);
 
     virtual Type
@@ -73,6 +73,7 @@ class KeyIDSearch : public KeySearch {
     bool              hidden() const;
 
     KeyIDSearch(const pgp_key_id_t &keyid);
+    const pgp_key_id_t &get_keyid() const;
 };
 
 class KeyFingerprintSearch : public KeySearch {
@@ -95,6 +96,8 @@ class KeyGripSearch : public KeySearch {
     const std::string name() const;
     std::string       value() const;
 
+    const pgp_key_grip_t &get_grip() const;
+
     KeyGripSearch(const pgp_key_grip_t &grip);
 };
 
@@ -109,6 +112,31 @@ class KeyUIDSearch : public KeySearch {
     KeyUIDSearch(const std::string &uid);
 };
 
+/* Free-form search: hex key id (or its 32-bit suffix), fingerprint or grip, otherwise
+ * case-insensitive regular expression over the primary key's userids. */
+class KeyQuerySearch : public KeySearch {
+    struct Regex;
+
+    std::string            query_;
+    std::vector<uint8_t>   hex_;
+    std::unique_ptr<Regex> re_;
+    bool                   literal_{};
+
+    bool matches_hex(const pgp_key_t &key) const;
+
+  public:
+    bool              matches(const pgp_key_t &key) const;
+    const std::string name() const;
+    std::string       value() const;
+    /* query is ASCII string without regex special characters, and cannot be a hex id, so
+     * it is matched as case-insensitive substring of the userid */
+    bool literal() const;
+
+    /* throws rnp_exception(RNP_ERROR_BAD_PARAMETERS) on invalid regular expression */
+    KeyQuerySearch(const std::string &query);
+    ~KeyQuerySearch();
+};
+
 class KeyProvider {
   public:
     pgp_key_callback_t *callback;
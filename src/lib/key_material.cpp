@@ -383,6 +383,55 @@ KeyMaterial::grip() const
     return res;
 }
 
+size_t
+KeyMaterial::memory_usage() const noexcept
+{
+    switch (alg_) {
+    case PGP_PKA_RSA:
+    case PGP_PKA_RSA_ENCRYPT_ONLY:
+    case PGP_PKA_RSA_SIGN_ONLY:
+        return sizeof(RSAKeyMaterial);
+    case PGP_PKA_ELGAMAL:
+    case PGP_PKA_ELGAMAL_ENCRYPT_OR_SIGN:
+        return sizeof(EGKeyMaterial);
+    case PGP_PKA_DSA:
+        return sizeof(DSAKeyMaterial);
+    case PGP_PKA_ECDH:
+        return sizeof(ECDHKeyMaterial);
+    case PGP_PKA_ECDSA:
+        return sizeof(ECDSAKeyMaterial);
+    case PGP_PKA_EDDSA:
+        return sizeof(EDDSAKeyMaterial);
+#if defined(ENABLE_CRYPTO_REFRESH)
+    case PGP_PKA_ED25519:
+        return sizeof(Ed25519KeyMaterial);
+    case PGP_PKA_X25519:
+        return sizeof(X25519KeyMaterial);
+#endif
+    case PGP_PKA_SM2:
+        return sizeof(SM2KeyMaterial);
+#if defined(ENABLE_PQC)
+    case PGP_PKA_KYBER768_X25519:
+    case PGP_PKA_KYBER768_P256:
+    case PGP_PKA_KYBER1024_P384:
+    case PGP_PKA_KYBER768_BP256:
+    case PGP_PKA_KYBER1024_BP384:
+        return sizeof(MlkemEcdhKeyMaterial);
+    case PGP_PKA_DILITHIUM3_ED25519:
+    case PGP_PKA_DILITHIUM3_P256:
+    case PGP_PKA_DILITHIUM5_P384:
+    case PGP_PKA_DILITHIUM3_BP256:
+    case PGP_PKA_DILITHIUM5_BP384:
+        return sizeof(DilithiumEccKeyMaterial);
+    case PGP_PKA_SPHINCSPLUS_SHA2:
+    case PGP_PKA_SPHINCSPLUS_SHAKE:
+        return sizeof(SlhdsaKeyMaterial);
+#endif
+    default:
+        return sizeof(KeyMaterial);
+    }
+}
+
 std::unique_ptr<KeyMaterial>
 KeyMaterial::create(pgp_pubkey_alg_t alg)
 {
@@ -228,6 +228,8 @@ class KeyMaterial {
     virtual size_t         bits() const noexcept = 0;
     virtual pgp_curve_t    curve() const noexcept;
     pgp_key_grip_t         grip() const;
+    /* Approximate number of bytes occupied by the key material object in memory. */
+    size_t memory_usage() const noexcept;
 
     static std::unique_ptr<KeyMaterial> create(pgp_pubkey_alg_t alg);
     static std::unique_ptr<KeyMaterial> create(pgp_pubkey_alg_t alg, const rsa::Key &key);
@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2025 [Ribose Inc](https://www.ribose.com).
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1.  Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ * 2.  Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef RNP_OBJECT_POOL_HPP_
+#define RNP_OBJECT_POOL_HPP_
+
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/* Default number of objects, kept in the pool for each key */
+#define RNP_OBJECT_POOL_SIZE 4
+
+namespace rnp {
+
+/* Bounded cache of reusable objects (buffers, backend contexts), grouped by integer key like
+ * the algorithm id. It is not thread-safe and is intended to be used as a thread_local
+ * instance, so objects may be allocated in one thread and returned to the pool of another.
+ * Release functor destroys objects which do not fit into the pool or are left there on
+ * destruction. */
+template <typename T, typename Release> class ObjectPool {
+  private:
+    std::unordered_map<uint32_t, std::vector<T>> items_;
+    size_t                                       limit_;
+
+  public:
+    ObjectPool(size_t limit = RNP_OBJECT_POOL_SIZE) : limit_(limit){};
+    ObjectPool(const ObjectPool &) = delete;
+    ObjectPool(ObjectPool &&) = delete;
+
+    ~ObjectPool()
+    {
+        for (auto &items : items_) {
+            for (auto &item : items.second) {
+                Release()(item);
+            }
+        }
+    }
+
+    /* get object from the pool, returns false if there is nothing stored for the key */
+    bool
+    get(T &item, uint32_t key = 0)
+    {
+        auto it = items_.find(key);
+        if ((it == items_.end()) || it->second.empty()) {
+            return false;
+        }
+        item = std::move(it->second.back());
+        it->second.pop_back();
+        return true;
+    }
+
+    /* return object to the pool. It must be reset to the clean state by the caller. */
+    void
+    put(T &&item, uint32_t key = 0) noexcept
+    {
+        try {
+            auto &items = items_[key];
+            if (items.size() < limit_) {
+                items.reserve(limit_);
+                items.push_back(std::move(item));
+                return;
+            }
+        } catch (...) {
+            /* fall back to release */
+        }
+        Release()(item);
+    }
+};
+
+} // namespace rnp
+
+#endif
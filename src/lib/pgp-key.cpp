@@ -69,6 +69,9 @@
 #include <cassert>
 #include <time.h>
 #include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
 #include <stdexcept>
 #include "defaults.h"
 
@@ -260,6 +263,7 @@ pgp_key_t::write_sec_rawpkt(pgp_key_pkt_t &       seckey,
         }
 
         rawpkt_ = pgp_rawpacket_t((uint8_t *) memdst.memory(), memdst.writeb(), type());
+        touch();
         return true;
     } catch (const std::exception &e) {
         RNP_LOG("%s", e.what());
@@ -587,6 +591,12 @@ pgp_subsig_t::expired(uint64_t at) const
     return expiration + sig.creation() < at;
 }
 
+size_t
+pgp_subsig_t::memory_usage() const noexcept
+{
+    return sizeof(*this) - sizeof(sig) + sig.memory_usage() + rawpkt.raw.capacity();
+}
+
 pgp_userid_t::pgp_userid_t(const pgp_userid_pkt_t &uidpkt)
 {
     /* copy packet data */
@@ -655,6 +665,17 @@ pgp_userid_t::clear_sigs()
     sigs_.clear();
 }
 
+size_t
+pgp_userid_t::memory_usage() const noexcept
+{
+    size_t res = sizeof(*this) + pkt.uid.capacity() + rawpkt.raw.capacity();
+    /* std::string keeps short values inline */
+    if (str.capacity() >= sizeof(str)) {
+        res += str.capacity() + 1;
+    }
+    return res + sigs_.capacity() * sizeof(pgp_sig_id_t);
+}
+
 pgp_revoke_t::pgp_revoke_t(pgp_subsig_t &sig)
 {
     uid = sig.uid;
@@ -694,6 +715,7 @@ pgp_key_t::pgp_key_t(const pgp_key_pkt_t &keypkt) : pkt_(keypkt)
     /* add rawpacket */
     rawpkt_ = pgp_rawpacket_t(pkt_);
     format = PGP_KEY_STORE_GPG;
+    touch();
 }
 
 pgp_key_t::pgp_key_t(const pgp_key_pkt_t &pkt, pgp_key_t &primary) : pgp_key_t(pkt)
@@ -723,6 +745,7 @@ pgp_key_t::pgp_key_t(const pgp_key_t &src, bool pubonly)
     sigs_ = src.sigs_;
     sigs_map_ = src.sigs_map_;
     keysigs_ = src.keysigs_;
+    selfsigs_ = src.selfsigs_;
     subkey_fps_ = src.subkey_fps_;
     primary_fp_set_ = src.primary_fp_set_;
     primary_fp_ = src.primary_fp_;
@@ -739,6 +762,10 @@ pgp_key_t::pgp_key_t(const pgp_key_t &src, bool pubonly)
     format = src.format;
     validity_ = src.validity_;
     valid_till_ = src.valid_till_;
+    revision_ = src.revision_;
+    if (pubonly) {
+        touch();
+    }
 }
 
 pgp_key_t::pgp_key_t(const pgp_transferable_key_t &src) : pgp_key_t(src.key)
@@ -840,9 +867,41 @@ pgp_key_t::replace_sig(const pgp_sig_id_t &id, const pgp_signature_t &newsig)
     } else {
         uids_[uid].replace_sig(oldid, res.sigid);
     }
+    refresh_selfsigs();
+    touch();
     return res;
 }
 
+void
+pgp_key_t::add_selfsig(const pgp_subsig_t &sig, bool begin)
+{
+    /* sigs_ is grouped by userid, with direct-key signatures first, so insert to the end (or
+     * beginning) of the same userid's group to keep selfsigs_ in the same order without
+     * rescanning all of the signatures */
+    auto group = [](uint32_t uid) { return uid == PGP_UID_NONE ? 0 : (uint64_t) uid + 1; };
+    uint64_t grp = group(sig.uid);
+    auto     it = selfsigs_.begin();
+    while (it != selfsigs_.end()) {
+        uint64_t cur = group(get_sig(*it).uid);
+        if ((cur > grp) || (begin && (cur == grp))) {
+            break;
+        }
+        it++;
+    }
+    selfsigs_.insert(it, sig.sigid);
+}
+
+void
+pgp_key_t::refresh_selfsigs()
+{
+    selfsigs_.clear();
+    for (auto &sigid : sigs_) {
+        if (is_signer(get_sig(sigid))) {
+            selfsigs_.push_back(sigid);
+        }
+    }
+}
+
 pgp_subsig_t &
 pgp_key_t::add_sig(const pgp_signature_t &sig, size_t uid, bool begin)
 {
@@ -850,6 +909,10 @@ pgp_key_t::add_sig(const pgp_signature_t &sig, size_t uid, bool begin)
     sigs_map_.erase(sigid);
     pgp_subsig_t &res = sigs_map_.emplace(std::make_pair(sigid, sig)).first->second;
     res.uid = uid;
+    touch();
+    if (is_signer(res)) {
+        add_selfsig(res, begin);
+    }
     if (uid == PGP_UID_NONE) {
         size_t idx = begin ? 0 : keysigs_.size();
         sigs_.insert(sigs_.begin() + idx, sigid);
@@ -891,6 +954,11 @@ pgp_key_t::del_sig(const pgp_sig_id_t &sigid)
     if (it != sigs_.end()) {
         sigs_.erase(it);
     }
+    it = std::find(selfsigs_.begin(), selfsigs_.end(), sigid);
+    if (it != selfsigs_.end()) {
+        selfsigs_.erase(it);
+    }
+    touch();
     return sigs_map_.erase(sigid);
 }
 
@@ -922,9 +990,32 @@ pgp_key_t::del_sigs(const std::vector<pgp_sig_id_t> &sigs)
         }
     }
     sigs_ = std::move(newsigs);
+    if (res) {
+        refresh_selfsigs();
+        touch();
+    }
     return res;
 }
 
+size_t
+pgp_key_t::limit_certs(size_t limit)
+{
+    if (sigs_.size() - selfsigs_.size() <= limit) {
+        return 0;
+    }
+    std::vector<pgp_sig_id_t> extra;
+    for (auto &uid : uids_) {
+        size_t certs = 0;
+        for (size_t idx = 0; idx < uid.sig_count(); idx++) {
+            auto &sigid = uid.get_sig(idx);
+            if (!is_signer(get_sig(sigid)) && (++certs > limit)) {
+                extra.push_back(sigid);
+            }
+        }
+    }
+    return extra.empty() ? 0 : del_sigs(extra);
+}
+
 size_t
 pgp_key_t::keysig_count() const
 {
@@ -1018,7 +1109,9 @@ pgp_key_t::del_uid(size_t idx)
         newsigs.push_back(id);
     }
     sigs_ = std::move(newsigs);
+    refresh_selfsigs();
     uids_.erase(uids_.begin() + idx);
+    touch();
     /* update uids */
     if (idx == uids_.size()) {
         return;
@@ -1051,6 +1144,7 @@ pgp_key_t::add_uid(const pgp_transferable_userid_t &uid)
 {
     /* construct userid */
     uids_.emplace_back(uid.uid);
+    touch();
     /* add certifications */
     for (auto &sig : uid.signatures) {
         add_sig(sig, uid_count() - 1);
@@ -1496,6 +1590,28 @@ pgp_key_t::subkey_fps() const
     return subkey_fps_;
 }
 
+/* Revisions are unique across all of the key objects, so keys, constructed independently,
+ * would never get the same revision. */
+static std::atomic<uint64_t> key_last_revision{0};
+
+uint64_t
+pgp_key_t::revision() const noexcept
+{
+    return revision_;
+}
+
+uint64_t
+pgp_key_t::last_revision() noexcept
+{
+    return key_last_revision;
+}
+
+void
+pgp_key_t::touch() noexcept
+{
+    revision_ = ++key_last_revision;
+}
+
 size_t
 pgp_key_t::rawpkt_count() const
 {
@@ -1521,6 +1637,7 @@ void
 pgp_key_t::set_rawpkt(const pgp_rawpacket_t &src)
 {
     rawpkt_ = src;
+    touch();
 }
 
 bool
@@ -1687,6 +1804,35 @@ pgp_key_t::write(pgp_dest_t &dst) const
     }
 }
 
+void
+pgp_key_t::memory_usage(pgp_key_memory_t &usage) const
+{
+    size_t key_bytes = sizeof(*this) - sizeof(pkt_) + pkt_.memory_usage();
+    key_bytes += rawpkt_.raw.capacity();
+    key_bytes += (sigs_.capacity() + keysigs_.capacity() + selfsigs_.capacity()) *
+                 sizeof(pgp_sig_id_t);
+    key_bytes += (subkey_fps_.capacity() + revokers_.capacity()) * sizeof(pgp_fingerprint_t);
+
+    /* unordered_map allocates node per element, with the pointer to the next one */
+    size_t sig_bytes = sigs_map_.bucket_count() * sizeof(void *);
+    for (auto &sig : sigs_map_) {
+        sig_bytes += sizeof(sig.first) + sig.second.memory_usage() + sizeof(void *);
+    }
+
+    size_t uid_bytes = (uids_.capacity() - uids_.size()) * sizeof(pgp_userid_t);
+    for (auto &uid : uids_) {
+        uid_bytes += uid.memory_usage();
+    }
+
+    usage.keys++;
+    usage.signatures += sigs_map_.size();
+    usage.userids += uids_.size();
+    usage.key_bytes += key_bytes;
+    usage.sig_bytes += sig_bytes;
+    usage.uid_bytes += uid_bytes;
+    usage.total += key_bytes + sig_bytes + uid_bytes;
+}
+
 void
 pgp_key_t::write_xfer(pgp_dest_t &dst, const rnp::KeyStore *keyring) const
 {
@@ -1771,7 +1917,7 @@ pgp_key_t::latest_selfsig(uint32_t uid)
     uint32_t      latest = 0;
     pgp_subsig_t *res = nullptr;
 
-    for (auto &sigid : sigs_) {
+    for (auto &sigid : selfsigs_) {
         auto &sig = get_sig(sigid);
         if (!sig.valid()) {
             continue;
@@ -1783,7 +1929,7 @@ pgp_key_t::latest_selfsig(uint32_t uid)
             break;
         case PGP_UID_PRIMARY: {
             skip = !is_self_cert(sig) ||
-                   !sig.sig.get_subpkt(pgp::pkt::sigsub::Type::PrimaryUserID) ||
+                   !sig.sig.has_subpkt(PGP_SIG_SUBPKT_PRIMARY_USER_ID) ||
                    !sig.sig.primary_uid() || (sig.uid == PGP_UID_NONE);
             break;
         }
@@ -2054,7 +2200,10 @@ pgp_key_t::validate_sig(pgp_signature_info_t &      sinfo,
     }
 
     /* Check for unknown critical notations */
-    for (auto &subpkt : sinfo.sig->subpkts) {
+    if (!sinfo.sig->has_subpkt(PGP_SIG_SUBPKT_NOTATION_DATA, false)) {
+        return;
+    }
+    for (auto &subpkt : sinfo.sig->subpkts()) {
         if (!subpkt->critical() || (subpkt->type() != pgp::pkt::sigsub::Type::NotationData)) {
             continue;
         }
@@ -2148,14 +2297,12 @@ pgp_key_t::validate_key_rev(pgp_signature_info_t &      sinfo,
 void
 pgp_key_t::validate_self_signatures(const rnp::SecurityContext &ctx)
 {
-    for (auto &sigid : sigs_) {
+    /* third-party certifications are validated only on request */
+    for (auto &sigid : selfsigs_) {
         auto &sig = get_sig(sigid);
         if (sig.validity.validated) {
             continue;
         }
-        if (!is_signer(sig)) {
-            continue;
-        }
 
         if (is_direct_self(sig) || is_self_cert(sig) || is_uid_revocation(sig) ||
             is_revocation(sig)) {
@@ -2186,7 +2333,7 @@ pgp_key_t::validate_desig_revokes(rnp::KeyStore &keyring)
         return false;
     }
     bool refresh = false;
-    for (auto &sigid : sigs_) {
+    for (auto &sigid : keysigs_) {
         auto &sig = get_sig(sigid);
         if (!is_revocation(sig) || is_signer(sig)) {
             continue;
@@ -2228,7 +2375,7 @@ pgp_key_t::validate_primary(rnp::KeyStore &keyring)
     bool has_cert = false;
     bool has_expired = false;
     /* check whether key is revoked */
-    for (auto &sigid : sigs_) {
+    for (auto &sigid : keysigs_) {
         pgp_subsig_t &sig = get_sig(sigid);
         if (!sig.valid()) {
             continue;
@@ -2600,17 +2747,18 @@ void
 pgp_key_t::refresh_revocations()
 {
     clear_revokes();
-    for (size_t i = 0; i < sig_count(); i++) {
-        pgp_subsig_t &sig = get_sig(i);
-        if (!sig.valid()) {
-            continue;
-        }
-        if (is_revocation(sig)) {
-            if (revoked_) {
-                continue;
-            }
+    /* key revocation may be issued by the designated revoker as well */
+    for (auto &sigid : keysigs_) {
+        pgp_subsig_t &sig = get_sig(sigid);
+        if (sig.valid() && is_revocation(sig)) {
             revoked_ = true;
             revocation_ = pgp_revoke_t(sig);
+            break;
+        }
+    }
+    for (auto &sigid : selfsigs_) {
+        pgp_subsig_t &sig = get_sig(sigid);
+        if (!sig.valid()) {
             continue;
         }
         if (is_uid_revocation(sig)) {
@@ -2667,8 +2815,8 @@ pgp_key_t::refresh_data(const rnp::SecurityContext &ctx)
     }
     /* designated revokers */
     revokers_.clear();
-    for (size_t i = 0; i < sig_count(); i++) {
-        pgp_subsig_t &sig = get_sig(i);
+    for (auto &sigid : selfsigs_) {
+        pgp_subsig_t &sig = get_sig(sigid);
         /* pick designated revokers only from direct-key signatures */
         if (!sig.valid() || !is_direct_self(sig)) {
             continue;
@@ -2686,10 +2834,10 @@ pgp_key_t::refresh_data(const rnp::SecurityContext &ctx)
     for (size_t i = 0; i < uid_count(); i++) {
         get_uid(i).valid = false;
     }
-    for (size_t i = 0; i < sig_count(); i++) {
-        pgp_subsig_t &sig = get_sig(i);
+    for (auto &sigid : selfsigs_) {
+        pgp_subsig_t &sig = get_sig(sigid);
         /* consider userid as valid if it has at least one non-expired self-sig */
-        if (!sig.valid() || !sig.is_cert() || !is_signer(sig) || sig.expired(ctx.time())) {
+        if (!sig.valid() || !sig.is_cert() || sig.expired(ctx.time())) {
             continue;
         }
         if (sig.uid >= uid_count()) {
@@ -2777,6 +2925,7 @@ pgp_key_t::merge(const pgp_key_t &src)
     if (src.is_secret() && !is_secret()) {
         pkt_ = src.pkt();
         rawpkt_ = src.rawpkt();
+        touch();
         /* no subkey processing here - they are separated from the main key */
     }
 
@@ -2795,6 +2944,7 @@ pgp_key_t::merge(const pgp_key_t &src)
         if (uididx == PGP_UID_NONE) {
             uididx = uid_count();
             uids_.emplace_back(srcuid.pkt);
+            touch();
         }
         /* add uid signatures */
         for (size_t idx = 0; idx < srcuid.sig_count(); idx++) {
@@ -2830,6 +2980,7 @@ pgp_key_t::merge(const pgp_key_t &src, pgp_key_t *primary)
     if (src.is_secret() && !is_secret()) {
         pkt_ = src.pkt();
         rawpkt_ = src.rawpkt();
+        touch();
     }
 
     /* add subkey binding signatures */
@@ -2852,3 +3003,71 @@ pgp_key_t::merge(const pgp_key_t &src, pgp_key_t *primary)
     }
     return true;
 }
+
+namespace rnp {
+namespace {
+struct key_lock_state_t {
+    size_t     users{};
+    bool       relock{};
+    std::mutex access; /* serializes unlocking and validation of the key material */
+};
+
+std::mutex                                                               key_locks_lock;
+std::unordered_map<const pgp_key_t *, std::unique_ptr<key_lock_state_t>> key_locks;
+} // namespace
+
+KeyLocker::KeyLocker(pgp_key_t &key, bool relock) : key_(key)
+{
+    std::lock_guard<std::mutex> lock(key_locks_lock);
+    auto &                      state = key_locks[&key];
+    if (!state) {
+        state.reset(new key_lock_state_t());
+    }
+    state->users++;
+    state->relock = state->relock || (relock && key.is_locked());
+}
+
+KeyLocker::~KeyLocker()
+{
+    std::lock_guard<std::mutex> lock(key_locks_lock);
+    auto                        it = key_locks.find(&key_);
+    assert(it != key_locks.end());
+    if (--it->second->users) {
+        return;
+    }
+    if (it->second->relock && !key_.is_locked()) {
+        key_.lock();
+    }
+    key_locks.erase(it);
+}
+
+bool
+KeyLocker::unlock(const pgp_password_provider_t &provider, pgp_op_t op)
+{
+    key_lock_state_t *state = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(key_locks_lock);
+        state = key_locks.at(&key_).get();
+    }
+    /* state lives until this locker is destroyed, and password may be asked for a while */
+    std::lock_guard<std::mutex> lock(state->access);
+    return key_.unlock(provider, op);
+}
+
+bool
+KeyLocker::validate(rnp::SecurityContext &ctx)
+{
+    key_lock_state_t *state = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(key_locks_lock);
+        state = key_locks.at(&key_).get();
+    }
+    std::lock_guard<std::mutex> lock(state->access);
+    auto                        material = key_.material();
+    if (!material) {
+        return false;
+    }
+    material->validate(ctx, false);
+    return material->valid();
+}
+} // namespace rnp
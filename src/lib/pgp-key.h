@@ -97,6 +97,8 @@ typedef struct pgp_subsig_t {
     bool is_cert() const;
     /** @brief Returns true if signature is expired */
     bool expired(uint64_t at) const;
+    /** @brief Approximate number of bytes occupied by the signature in memory */
+    size_t memory_usage() const noexcept;
 } pgp_subsig_t;
 
 typedef std::unordered_map<pgp_sig_id_t, pgp_subsig_t> pgp_sig_map_t;
@@ -122,6 +124,8 @@ typedef struct pgp_userid_t {
     void                replace_sig(const pgp_sig_id_t &id, const pgp_sig_id_t &newsig);
     bool                del_sig(const pgp_sig_id_t &id);
     void                clear_sigs();
+    /** @brief Approximate number of bytes occupied by the userid in memory */
+    size_t memory_usage() const noexcept;
 } pgp_userid_t;
 
 #define PGP_UID_NONE ((uint32_t) -1)
@@ -138,6 +142,7 @@ struct pgp_key_t {
     pgp_sig_map_t             sigs_map_{}; /* map with subsigs stored by their id */
     std::vector<pgp_sig_id_t> sigs_{};     /* subsig ids to lookup actual sig in map */
     std::vector<pgp_sig_id_t> keysigs_{};  /* direct-key signature ids in the original order */
+    std::vector<pgp_sig_id_t> selfsigs_{}; /* ids of signatures issued by the key itself */
     std::vector<pgp_userid_t> uids_{};     /* array of user ids */
     pgp_key_pkt_t             pkt_{};      /* pubkey/seckey data packet */
     uint8_t                   flags_{};    /* key flags */
@@ -157,11 +162,15 @@ struct pgp_key_t {
     std::vector<pgp_fingerprint_t> revokers_{};
     pgp_validity_t                 validity_{};   /* key's validity */
     uint64_t                       valid_till_{}; /* date till which key is/was valid */
+    uint64_t                       revision_{};   /* updated on each change of key packets */
 
     pgp_subsig_t *latest_uid_selfcert(uint32_t uid);
     void          validate_primary(rnp::KeyStore &keyring);
     void          merge_validity(const pgp_validity_t &src);
     uint64_t      valid_till_common(bool expiry) const;
+    void          touch() noexcept;
+    void          add_selfsig(const pgp_subsig_t &sig, bool begin);
+    void          refresh_selfsigs();
     bool          write_sec_pgp(pgp_dest_t &       dst,
                                 pgp_key_pkt_t &    seckey,
                                 const std::string &password,
@@ -174,6 +183,7 @@ struct pgp_key_t {
     pgp_key_t(const pgp_key_pkt_t &pkt);
     pgp_key_t(const pgp_key_pkt_t &pkt, pgp_key_t &primary);
     pgp_key_t(const pgp_key_t &src, bool pubonly = false);
+    pgp_key_t(pgp_key_t &&src) = default;
     pgp_key_t(const pgp_transferable_key_t &src);
     pgp_key_t(const pgp_transferable_subkey_t &src, pgp_key_t *primary);
     pgp_key_t &operator=(const pgp_key_t &) = default;
@@ -191,6 +201,12 @@ struct pgp_key_t {
                                 bool                   begin = false);
     bool                del_sig(const pgp_sig_id_t &sigid);
     size_t              del_sigs(const std::vector<pgp_sig_id_t> &sigs);
+    /**
+     * @brief Drop third-party signatures over each userid, keeping only first limit ones.
+     *        Protects from certificates flooded with certifications.
+     * @return number of dropped signatures.
+     */
+    size_t              limit_certs(size_t limit);
     size_t              keysig_count() const;
     pgp_subsig_t &      get_keysig(size_t idx);
     size_t              uid_count() const;
@@ -294,6 +310,16 @@ struct pgp_key_t {
     const pgp_fingerprint_t &             get_subkey_fp(size_t idx) const;
     const std::vector<pgp_fingerprint_t> &subkey_fps() const;
 
+    /**
+     * @brief Get key's revision. It is changed each time when key's packets are updated, so
+     *        two key objects with the same revision have the same serialized contents.
+     */
+    uint64_t               revision() const noexcept;
+    /**
+     * @brief Get the latest revision, given to any of the key objects. If it didn't change
+     *        then none of the keys was updated.
+     */
+    static uint64_t        last_revision() noexcept;
     size_t                 rawpkt_count() const;
     pgp_rawpacket_t &      rawpkt();
     const pgp_rawpacket_t &rawpkt() const;
@@ -343,6 +369,12 @@ struct pgp_key_t {
      * @return void, but error may be checked via dst.werr
      */
     void write_xfer(pgp_dest_t &dst, const rnp::KeyStore *keyring = NULL) const;
+    /**
+     * @brief Add approximate memory usage of the key, its userids and signatures to usage.
+     *
+     * @param usage structure to accumulate values in.
+     */
+    void memory_usage(pgp_key_memory_t &usage) const;
     /**
      * @brief Export key with subkey as it is required by Autocrypt (5-packet sequence: key,
      * uid, sig, subkey, sig).
@@ -629,21 +661,21 @@ struct pgp_key_t {
 };
 
 namespace rnp {
+/* Locks the secret key back once it is not used anymore. Users are counted per key, so the
+ * key, used by several operations running in parallel, is locked only when the last of them
+ * is done, and if it was locked when the first one started. */
 class KeyLocker {
-    bool       lock_;
     pgp_key_t &key_;
 
   public:
-    KeyLocker(pgp_key_t &key) : lock_(key.is_locked()), key_(key)
-    {
-    }
-
-    ~KeyLocker()
-    {
-        if (lock_ && !key_.is_locked()) {
-            key_.lock();
-        }
-    }
+    KeyLocker(pgp_key_t &key, bool relock = true);
+    ~KeyLocker();
+
+    /** @brief Unlock the key, serialized with the other users of the same key. */
+    bool unlock(const pgp_password_provider_t &provider, pgp_op_t op);
+    /** @brief Validate the key material if it was not validated before, serialized with the
+     *         other users of the same key. Returns whether material is valid. */
+    bool validate(rnp::SecurityContext &ctx);
 };
 }; // namespace rnp
 
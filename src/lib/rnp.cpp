@@ -52,6 +52,8 @@
 #include <string.h>
 #include <sys/stat.h>
 #include <stdexcept>
+#include <atomic>
+#include <memory>
 #include "utils.h"
 #include "str-utils.h"
 #include "json-utils.h"
@@ -117,6 +119,8 @@ static pgp_key_t *
 ffi_key_provider(const pgp_key_request_ctx_t *ctx, void *userdata)
 {
     rnp_ffi_t ffi = (rnp_ffi_t) userdata;
+    /* may be called from the async operations, running in parallel */
+    std::lock_guard<std::recursive_mutex> lock(ffi->keys_lock);
     return find_key(ffi, ctx->search, ctx->secret, true);
 }
 
@@ -675,6 +679,8 @@ close_io_file(FILE **fp)
 
 rnp_ffi_st::~rnp_ffi_st()
 {
+    /* wait for the pending asynchronous operations */
+    pool.reset();
     close_io_file(&errs);
     delete pubring;
     delete secring;
@@ -734,6 +740,91 @@ try {
 }
 FFI_GUARD
 
+rnp_result_t
+rnp_ffi_set_async_limits(rnp_ffi_t ffi, size_t threads, size_t queue)
+try {
+    if (!ffi) {
+        return RNP_ERROR_NULL_POINTER;
+    }
+    std::lock_guard<std::mutex> lock(ffi->pool_lock);
+    if (ffi->pool && (ffi->pool->queued() || ffi->pool->active())) {
+        FFI_LOG(ffi, "There are pending operations.");
+        return RNP_ERROR_BAD_STATE;
+    }
+    /* pool will be recreated on the next use */
+    ffi->pool.reset();
+    ffi->pool_threads = threads;
+    ffi->pool_queue = queue;
+    return RNP_SUCCESS;
+}
+FFI_GUARD
+
+rnp_result_t
+rnp_ffi_get_async_stats(rnp_ffi_t ffi, size_t *queued, size_t *running, size_t *completed)
+try {
+    if (!ffi) {
+        return RNP_ERROR_NULL_POINTER;
+    }
+    std::lock_guard<std::mutex> lock(ffi->pool_lock);
+    if (queued) {
+        *queued = ffi->pool ? ffi->pool->queued() : 0;
+    }
+    if (running) {
+        *running = ffi->pool ? ffi->pool->active() : 0;
+    }
+    if (completed) {
+        *completed = ffi->pool ? ffi->pool->completed() : 0;
+    }
+    return RNP_SUCCESS;
+}
+FFI_GUARD
+
+static bool
+ffi_pool_push(rnp_ffi_t ffi, std::function<void()> task, bool exclusive = false)
+{
+    std::lock_guard<std::mutex> poollock(ffi->pool_lock);
+    if (!ffi->pool) {
+        ffi->pool.reset(new rnp::ThreadPool(ffi->pool_threads, ffi->pool_queue));
+    }
+    if (!ffi->pool->push(std::move(task), exclusive)) {
+        FFI_LOG(ffi, "Operation queue is full.");
+        return false;
+    }
+    return true;
+}
+
+static rnp_result_t
+ffi_execute_async(rnp_ffi_t                     ffi,
+                  rnp_op_async_st &             async,
+                  std::function<rnp_result_t()> exec,
+                  rnp_op_complete_t *           complete,
+                  void *                        app_ctx,
+                  bool                          exclusive = false)
+{
+    std::lock_guard<std::mutex> lock(async.lock);
+    if (async.pending) {
+        FFI_LOG(ffi, "Operation is already pending.");
+        return RNP_ERROR_BAD_STATE;
+    }
+    auto task = [&async, exec, complete, app_ctx]() {
+        rnp_result_t ret = exec();
+        {
+            /* operation may be destroyed right after this */
+            std::lock_guard<std::mutex> lock(async.lock);
+            async.pending = false;
+            async.cond.notify_all();
+        }
+        if (complete) {
+            complete(app_ctx, ret);
+        }
+    };
+    if (!ffi_pool_push(ffi, task, exclusive)) {
+        return RNP_ERROR_BAD_STATE;
+    }
+    async.pending = true;
+    return RNP_SUCCESS;
+}
+
 static const char *
 operation_description(uint8_t op)
 {
@@ -1430,16 +1521,59 @@ try {
 }
 FFI_GUARD
 
+rnp_result_t
+rnp_set_certifications_limit(rnp_ffi_t ffi, size_t limit)
+try {
+    if (!ffi) {
+        return RNP_ERROR_NULL_POINTER;
+    }
+    ffi->pubring->max_certs = limit;
+    ffi->secring->max_certs = limit;
+    return RNP_SUCCESS;
+}
+FFI_GUARD
+
+rnp_result_t
+rnp_set_key_load_threads(rnp_ffi_t ffi, size_t threads)
+try {
+    if (!ffi) {
+        return RNP_ERROR_NULL_POINTER;
+    }
+    if (!threads) {
+        FFI_LOG(ffi, "Number of threads must not be 0");
+        return RNP_ERROR_BAD_PARAMETERS;
+    }
+    ffi->pubring->g10_threads = threads;
+    ffi->secring->g10_threads = threads;
+    return RNP_SUCCESS;
+}
+FFI_GUARD
+
+rnp_result_t
+rnp_set_uid_index(rnp_ffi_t ffi, bool enable)
+try {
+    if (!ffi) {
+        return RNP_ERROR_NULL_POINTER;
+    }
+    ffi->pubring->set_uid_index(enable);
+    ffi->secring->set_uid_index(enable);
+    return RNP_SUCCESS;
+}
+FFI_GUARD
+
 static rnp_result_t
-load_keys_from_input(rnp_ffi_t ffi, rnp_input_t input, rnp::KeyStore *store)
+load_keys_from_input(rnp_ffi_t      ffi,
+                     rnp_input_t    input,
+                     rnp::KeyStore *store,
+                     bool           bypath = false)
 {
     rnp::KeyProvider        chained(rnp_key_provider_store, store);
     const rnp::KeyProvider *key_providers[] = {&chained, &ffi->key_provider, NULL};
     const rnp::KeyProvider  key_provider(rnp_key_provider_chained, key_providers);
 
-    if (!input->src_directory.empty()) {
-        // load the keys
-        store->path = input->src_directory;
+    if (!input->src_directory.empty() || bypath) {
+        // load the keys, keystore reads the file itself to remember the blobs locations
+        store->path = input->src_directory.empty() ? input->src_path : input->src_directory;
         if (!store->load(&key_provider)) {
             return RNP_ERROR_BAD_FORMAT;
         }
@@ -1474,12 +1608,88 @@ key_needs_conversion(const pgp_key_t *key, const rnp::KeyStore *store)
     return key_format != store_format;
 }
 
+static rnp_result_t
+load_keys_deferred(rnp_ffi_t ffi, rnp_input_t input)
+{
+    /* keyblocks are parsed directly to the pubring when requested, so it must be empty */
+    auto store = ffi->pubring;
+    store->defer_kbx = true;
+    rnp_result_t ret = load_keys_from_input(ffi, input, store, !input->src_path.empty());
+    store->defer_kbx = false;
+    if (ret) {
+        store->clear();
+    }
+    return ret;
+}
+
+static rnp_result_t
+load_keys_deferred_g10(rnp_ffi_t ffi, rnp_input_t input)
+{
+    /* key files are read later, so provider must outlive the load call */
+    auto store = ffi->secring;
+    store->path = input->src_directory;
+    store->defer_g10 = true;
+    bool res = store->load(&ffi->key_provider);
+    store->defer_g10 = false;
+    if (!res) {
+        store->clear();
+        return RNP_ERROR_BAD_FORMAT;
+    }
+    return RNP_SUCCESS;
+}
+
+/* Load keyring file or directory directly to the ffi's keyring of the same format. It keeps
+ * the keyring path and blob locations, so saving to the same path may update it in-place. */
+static bool
+load_keys_to_ring(rnp_ffi_t ffi, rnp_input_t input, rnp::KeyStore *ring, bool secret)
+{
+    if (input->src_path.empty() && input->src_directory.empty()) {
+        return false;
+    }
+    if (load_keys_from_input(ffi, input, ring, true)) {
+        ring->clear();
+        return false;
+    }
+    /* keyring must not get keys of the other type, otherwise fall back to the copying */
+    for (auto &key : ring->keys) {
+        if (key.is_secret() != secret) {
+            ring->clear();
+            return false;
+        }
+    }
+    return true;
+}
+
 static rnp_result_t
 do_load_keys(rnp_ffi_t              ffi,
              rnp_input_t            input,
              pgp_key_store_format_t format,
-             key_type_t             key_type)
-{
+             key_type_t             key_type,
+             bool                   deferred,
+             bool                   journal)
+{
+    if (deferred && (format == PGP_KEY_STORE_KBX) && (key_type == KEY_TYPE_PUBLIC) &&
+        (ffi->pubring->format == PGP_KEY_STORE_KBX) && input->src_directory.empty() &&
+        ffi->pubring->load_deferred() && !ffi->pubring->key_count()) {
+        return load_keys_deferred(ffi, input);
+    }
+    if (deferred && (format == PGP_KEY_STORE_G10) && (key_type == KEY_TYPE_SECRET) &&
+        (ffi->secring->format == PGP_KEY_STORE_G10) && !input->src_directory.empty() &&
+        ffi->secring->empty()) {
+        return load_keys_deferred_g10(ffi, input);
+    }
+    if ((key_type == KEY_TYPE_PUBLIC) || (key_type == KEY_TYPE_SECRET)) {
+        bool secret = key_type == KEY_TYPE_SECRET;
+        auto ring = secret ? ffi->secring : ffi->pubring;
+        if ((ring->format == format) && ring->empty()) {
+            /* journal is replayed during the load */
+            ring->journal = journal && (format == PGP_KEY_STORE_GPG);
+            if (load_keys_to_ring(ffi, input, ring, secret)) {
+                return RNP_SUCCESS;
+            }
+            ring->journal = false;
+        }
+    }
     // create a temporary key store to hold the keys
     std::unique_ptr<rnp::KeyStore> tmp_store;
     try {
@@ -1495,34 +1705,18 @@ do_load_keys(rnp_ffi_t              ffi,
     if (tmpret) {
         return tmpret;
     }
-    // go through all the loaded keys
+    // go through all the loaded keys, temporary store is discarded so keys may be moved out
     for (auto &key : tmp_store->keys) {
         // check that the key is the correct type and has not already been loaded
         // add secret key part if it is and we need it
-        if (key.is_secret() && ((key_type == KEY_TYPE_SECRET) || (key_type == KEY_TYPE_ANY))) {
-            if (key_needs_conversion(&key, ffi->secring)) {
-                FFI_LOG(ffi, "This key format conversion is not yet supported");
-                return RNP_ERROR_NOT_IMPLEMENTED;
-            }
+        bool secret = key.is_secret();
+        bool add_sec = secret && ((key_type == KEY_TYPE_SECRET) || (key_type == KEY_TYPE_ANY));
+        bool add_pub = (key.format != PGP_KEY_STORE_G10) &&
+                       ((key_type == KEY_TYPE_ANY) || (key_type == KEY_TYPE_PUBLIC));
 
-            if (!ffi->secring->add_key(key)) {
-                FFI_LOG(ffi, "Failed to add secret key");
-                return RNP_ERROR_GENERIC;
-            }
-        }
-
-        // add public key part if needed
-        if ((key.format == PGP_KEY_STORE_G10) ||
-            ((key_type != KEY_TYPE_ANY) && (key_type != KEY_TYPE_PUBLIC))) {
-            continue;
-        }
-
-        pgp_key_t keycp;
-        try {
-            keycp = pgp_key_t(key, true);
-        } catch (const std::exception &e) {
-            RNP_LOG("Failed to copy public key part: %s", e.what());
-            return RNP_ERROR_GENERIC;
+        if (add_sec && key_needs_conversion(&key, ffi->secring)) {
+            FFI_LOG(ffi, "This key format conversion is not yet supported");
+            return RNP_ERROR_NOT_IMPLEMENTED;
         }
 
         /* TODO: We could do this a few different ways. There isn't an obvious reason
@@ -1530,16 +1724,34 @@ do_load_keys(rnp_ffi_t              ffi,
          * conversion just to load and use a G10 key when using GPG keyrings, for
          * example. We could just convert when saving.
          */
-
-        if (key_needs_conversion(&key, ffi->pubring)) {
+        if (add_pub && key_needs_conversion(&key, ffi->pubring)) {
             FFI_LOG(ffi, "This key format conversion is not yet supported");
             return RNP_ERROR_NOT_IMPLEMENTED;
         }
 
-        if (!ffi->pubring->add_key(keycp)) {
+        // add public key part if needed: public key is moved, secret one is copied
+        if (add_pub && !secret && !ffi->pubring->add_key(std::move(key))) {
             FFI_LOG(ffi, "Failed to add public key");
             return RNP_ERROR_GENERIC;
         }
+        if (add_pub && secret) {
+            pgp_key_t keycp;
+            try {
+                keycp = pgp_key_t(key, true);
+            } catch (const std::exception &e) {
+                RNP_LOG("Failed to copy public key part: %s", e.what());
+                return RNP_ERROR_GENERIC;
+            }
+            if (!ffi->pubring->add_key(std::move(keycp))) {
+                FFI_LOG(ffi, "Failed to add public key");
+                return RNP_ERROR_GENERIC;
+            }
+        }
+
+        if (add_sec && !ffi->secring->add_key(std::move(key))) {
+            FFI_LOG(ffi, "Failed to add secret key");
+            return RNP_ERROR_GENERIC;
+        }
     }
     // success, even if we didn't actually load any
     return RNP_SUCCESS;
@@ -1580,13 +1792,67 @@ try {
         FFI_LOG(ffi, "invalid key store format: %s", format);
         return RNP_ERROR_BAD_PARAMETERS;
     }
+    bool deferred = extract_flag(flags, RNP_LOAD_SAVE_DEFERRED);
+    bool journal = extract_flag(flags, RNP_LOAD_SAVE_JOURNAL);
 
     // check for any unrecognized flags (not forward-compat, but maybe still a good idea)
     if (flags) {
         FFI_LOG(ffi, "unexpected flags remaining: 0x%X", flags);
         return RNP_ERROR_BAD_PARAMETERS;
     }
-    return do_load_keys(ffi, input, ks_format, type);
+    return do_load_keys(ffi, input, ks_format, type, deferred, journal);
+}
+FFI_GUARD
+
+static rnp_result_t
+copy_ring_keys(rnp_ffi_t ffi, rnp::KeyStore &src, rnp::KeyStore &dst)
+{
+    if (!src.load_deferred()) {
+        FFI_LOG(ffi, "Failed to load deferred keys");
+        return RNP_ERROR_BAD_FORMAT;
+    }
+    for (auto &key : src.keys) {
+        if (key_needs_conversion(&key, &dst)) {
+            FFI_LOG(ffi, "This key format conversion is not yet supported");
+            return RNP_ERROR_NOT_IMPLEMENTED;
+        }
+        /* copy keeps the secret key material, if key is unlocked */
+        pgp_key_t keycp(key, false);
+        if (!dst.add_key(std::move(keycp))) {
+            FFI_LOG(ffi, "Failed to add key");
+            return RNP_ERROR_GENERIC;
+        }
+    }
+    return RNP_SUCCESS;
+}
+
+rnp_result_t
+rnp_copy_keys(rnp_ffi_t ffi, rnp_ffi_t src, uint32_t flags)
+try {
+    if (!ffi || !src) {
+        return RNP_ERROR_NULL_POINTER;
+    }
+    if (ffi == src) {
+        FFI_LOG(ffi, "source and destination must be different");
+        return RNP_ERROR_BAD_PARAMETERS;
+    }
+    key_type_t type = flags_to_key_type(&flags);
+    if (!type) {
+        FFI_LOG(ffi, "invalid flags - must have public and/or secret keys");
+        return RNP_ERROR_BAD_PARAMETERS;
+    }
+    if (flags) {
+        FFI_LOG(ffi, "unexpected flags remaining: 0x%X", flags);
+        return RNP_ERROR_BAD_PARAMETERS;
+    }
+    rnp_result_t ret = RNP_SUCCESS;
+    if (type != KEY_TYPE_SECRET) {
+        ret = copy_ring_keys(ffi, *src->pubring, *ffi->pubring);
+    }
+    if (!ret && (type != KEY_TYPE_PUBLIC)) {
+        ret = copy_ring_keys(ffi, *src->secring, *ffi->secring);
+    }
+    return ret;
 }
 FFI_GUARD
 
@@ -1691,6 +1957,31 @@ add_key_status(json_object *           keys,
     return RNP_SUCCESS;
 }
 
+static rnp_result_t
+import_key_to_rings(rnp_ffi_t                ffi,
+                    pgp_key_t &              key,
+                    bool                     sec,
+                    pgp_key_import_status_t &pub_status,
+                    pgp_key_import_status_t &sec_status)
+{
+    // if we got here then we add public key itself or public part of the secret key
+    if (!ffi->pubring->import_key(key, true, &pub_status)) {
+        return RNP_ERROR_BAD_PARAMETERS;
+    }
+    // import secret key part if available and requested
+    if (sec && key.is_secret()) {
+        if (!ffi->secring->import_key(key, false, &sec_status)) {
+            return RNP_ERROR_BAD_PARAMETERS;
+        }
+        // add uids, certifications and other stuff from the public key if any
+        pgp_key_t *expub = ffi->pubring->get_key(key.fp());
+        if (expub && !ffi->secring->import_key(*expub, true)) {
+            return RNP_ERROR_BAD_PARAMETERS;
+        }
+    }
+    return RNP_SUCCESS;
+}
+
 rnp_result_t
 rnp_import_keys(rnp_ffi_t ffi, rnp_input_t input, uint32_t flags, char **results)
 try {
@@ -1762,23 +2053,12 @@ try {
         if (!pub && key.is_public()) {
             continue;
         }
-        // if we got here then we add public key itself or public part of the secret key
-        if (!ffi->pubring->import_key(key, true, &pub_status)) {
-            return RNP_ERROR_BAD_PARAMETERS;
-        }
-        // import secret key part if available and requested
-        if (sec && key.is_secret()) {
-            if (!ffi->secring->import_key(key, false, &sec_status)) {
-                return RNP_ERROR_BAD_PARAMETERS;
-            }
-            // add uids, certifications and other stuff from the public key if any
-            pgp_key_t *expub = ffi->pubring->get_key(key.fp());
-            if (expub && !ffi->secring->import_key(*expub, true)) {
-                return RNP_ERROR_BAD_PARAMETERS;
-            }
+        rnp_result_t tmpret = import_key_to_rings(ffi, key, sec, pub_status, sec_status);
+        if (tmpret) {
+            return tmpret;
         }
         // now add key fingerprint to json based on statuses
-        rnp_result_t tmpret = add_key_status(jsokeys, &key, pub_status, sec_status);
+        tmpret = add_key_status(jsokeys, &key, pub_status, sec_status);
         if (tmpret) {
             return tmpret;
         }
@@ -1791,6 +2071,74 @@ try {
 }
 FFI_GUARD
 
+rnp_result_t
+rnp_import_keys_stream(rnp_ffi_t         ffi,
+                       rnp_input_t       input,
+                       uint32_t          flags,
+                       rnp_import_key_cb cb,
+                       void *            app_ctx)
+try {
+    if (!ffi || !input) {
+        return RNP_ERROR_NULL_POINTER;
+    }
+    bool sec = extract_flag(flags, RNP_LOAD_SAVE_SECRET_KEYS);
+    bool pub = extract_flag(flags, RNP_LOAD_SAVE_PUBLIC_KEYS);
+    if (!pub && !sec) {
+        FFI_LOG(ffi, "bad flags: need to specify public and/or secret keys");
+        return RNP_ERROR_BAD_PARAMETERS;
+    }
+    bool skipbad = extract_flag(flags, RNP_LOAD_SAVE_PERMISSIVE);
+    bool base64 = extract_flag(flags, RNP_LOAD_SAVE_BASE64);
+    if (flags) {
+        FFI_LOG(ffi, "unexpected flags remaining: 0x%X", flags);
+        return RNP_ERROR_BAD_PARAMETERS;
+    }
+
+    /* check whether input is base64 */
+    if (base64 && input->src.is_base64()) {
+        rnp_result_t ret = rnp_input_dearmor_if_needed(input, true);
+        if (ret) {
+            return ret;
+        }
+    }
+
+    /* import each key as soon as it is read, so memory usage doesn't depend on input size */
+    auto handler = [&](pgp_transferable_key_t &tkey) -> rnp_result_t {
+        rnp::KeyStore tmp_store(PGP_KEY_STORE_GPG, "", ffi->context);
+        if (!tmp_store.add_ts_key(tkey)) {
+            if (!skipbad) {
+                return RNP_ERROR_BAD_STATE;
+            }
+            FFI_LOG(ffi, "Skipping key which failed to load.");
+            return RNP_SUCCESS;
+        }
+        for (auto &key : tmp_store.keys) {
+            pgp_key_import_status_t pub_status = PGP_KEY_IMPORT_STATUS_UNKNOWN;
+            pgp_key_import_status_t sec_status = PGP_KEY_IMPORT_STATUS_UNKNOWN;
+            if (!pub && key.is_public()) {
+                continue;
+            }
+            rnp_result_t ret = import_key_to_rings(ffi, key, sec, pub_status, sec_status);
+            if (ret) {
+                return ret;
+            }
+            if (!cb) {
+                continue;
+            }
+            auto fp = rnp::bin_to_hex(
+              key.fp().fingerprint, key.fp().length, rnp::HexFormat::Lowercase);
+            cb(ffi,
+               app_ctx,
+               fp.c_str(),
+               key_status_to_str(pub_status),
+               key_status_to_str(sec_status));
+        }
+        return RNP_SUCCESS;
+    };
+    return process_pgp_keys(input->src, handler, skipbad);
+}
+FFI_GUARD
+
 static const char *
 sig_status_to_str(pgp_sig_import_status_t status)
 {
@@ -1888,6 +2236,10 @@ FFI_GUARD
 static bool
 copy_store_keys(rnp_ffi_t ffi, rnp::KeyStore *dest, rnp::KeyStore *src)
 {
+    if (!src->load_deferred()) {
+        FFI_LOG(ffi, "failed to load deferred keys");
+        return false;
+    }
     for (auto &key : src->keys) {
         if (!dest->add_key(key)) {
             FFI_LOG(ffi, "failed to add key to the store");
@@ -1897,12 +2249,44 @@ copy_store_keys(rnp_ffi_t ffi, rnp::KeyStore *dest, rnp::KeyStore *src)
     return true;
 }
 
+/* Write the ffi's keyring to its own path, updating it in-place if possible. Output is not
+ * used then, so its temporary file is discarded and may not replace the keyring later on. */
+static rnp_result_t
+save_keys_from_ring(rnp_ffi_t ffi, rnp_output_t output, rnp::KeyStore *ring)
+{
+    if (!ring->load_deferred()) {
+        FFI_LOG(ffi, "failed to load deferred keys");
+        return RNP_ERROR_BAD_STATE;
+    }
+    for (auto &key : ring->keys) {
+        if (key_needs_conversion(&key, ring)) {
+            FFI_LOG(ffi, "This key format conversion is not yet supported");
+            return RNP_ERROR_NOT_IMPLEMENTED;
+        }
+    }
+    if (!ring->write()) {
+        return RNP_ERROR_WRITE;
+    }
+    if (output->dst_path) {
+        dst_close(&output->dst, true);
+        init_null_dest(&output->dst);
+    }
+    return RNP_SUCCESS;
+}
+
 static rnp_result_t
 do_save_keys(rnp_ffi_t              ffi,
              rnp_output_t           output,
              pgp_key_store_format_t format,
              key_type_t             key_type)
 {
+    if ((key_type == KEY_TYPE_PUBLIC) || (key_type == KEY_TYPE_SECRET)) {
+        auto ring = key_type == KEY_TYPE_SECRET ? ffi->secring : ffi->pubring;
+        auto path = output->dst_directory ? output->dst_directory : output->dst_path;
+        if ((ring->format == format) && path && !ring->path.empty() && (ring->path == path)) {
+            return save_keys_from_ring(ffi, output, ring);
+        }
+    }
     // create a temporary key store to hold the keys
     rnp::KeyStore *tmp_store = nullptr;
     try {
@@ -1987,6 +2371,7 @@ try {
     if (!ffi || !count) {
         return RNP_ERROR_NULL_POINTER;
     }
+    ffi->pubring->load_deferred();
     *count = ffi->pubring->key_count();
     return RNP_SUCCESS;
 }
@@ -1998,11 +2383,49 @@ try {
     if (!ffi || !count) {
         return RNP_ERROR_NULL_POINTER;
     }
+    ffi->secring->load_deferred();
     *count = ffi->secring->key_count();
     return RNP_SUCCESS;
 }
 FFI_GUARD
 
+static bool
+add_memory_usage(json_object *jso, const char *name, const pgp_key_memory_t &usage)
+{
+    json_object *jsousage = json_object_new_object();
+    if (!json_add(jso, name, jsousage)) {
+        return false; // LCOV_EXCL_LINE
+    }
+    return json_add(jsousage, "keys", (uint64_t) usage.keys) &&
+           json_add(jsousage, "signatures", (uint64_t) usage.signatures) &&
+           json_add(jsousage, "userids", (uint64_t) usage.userids) &&
+           json_add(jsousage, "key bytes", (uint64_t) usage.key_bytes) &&
+           json_add(jsousage, "signature bytes", (uint64_t) usage.sig_bytes) &&
+           json_add(jsousage, "userid bytes", (uint64_t) usage.uid_bytes) &&
+           json_add(jsousage, "total bytes", (uint64_t) usage.total);
+}
+
+rnp_result_t
+rnp_get_memory_usage(rnp_ffi_t ffi, char **result)
+try {
+    if (!ffi || !result) {
+        return RNP_ERROR_NULL_POINTER;
+    }
+    json_object *jso = json_object_new_object();
+    if (!jso) {
+        return RNP_ERROR_OUT_OF_MEMORY; // LCOV_EXCL_LINE
+    }
+    rnp::JSONObject jsowrap(jso);
+    auto            pub = ffi->pubring->memory_usage();
+    auto            sec = ffi->secring->memory_usage();
+    if (!add_memory_usage(jso, "public", pub) || !add_memory_usage(jso, "secret", sec) ||
+        !json_add(jso, "total bytes", (uint64_t)(pub.total + sec.total))) {
+        return RNP_ERROR_OUT_OF_MEMORY; // LCOV_EXCL_LINE
+    }
+    return ret_str_value(json_object_to_json_string_ext(jso, JSON_C_TO_STRING_PRETTY), result);
+}
+FFI_GUARD
+
 rnp_input_st::rnp_input_st() : reader(NULL), closer(NULL), app_ctx(NULL)
 {
     memset(&src, 0, sizeof(src));
@@ -2055,6 +2478,7 @@ try {
             delete ob;
             return ret;
         }
+        ob->src_path = path;
     }
     *input = ob;
     return RNP_SUCCESS;
@@ -2169,9 +2593,151 @@ try {
 }
 FFI_GUARD
 
-rnp_result_t
-rnp_input_destroy(rnp_input_t input)
-try {
+/* read from the pipe, waiting for the data if block is true */
+static bool
+stream_pipe_read(rnp_stream_pipe_st &pipe, void *buf, size_t len, size_t *read, bool block)
+{
+    std::unique_lock<std::mutex> lock(pipe.lock);
+    if (block && !pipe.avail() && !pipe.eof && !pipe.aborted) {
+        pipe.waiting = true;
+        if (pipe.notify) {
+            lock.unlock();
+            pipe.notify();
+            lock.lock();
+        }
+        pipe.cond.wait(lock, [&pipe]() { return pipe.avail() || pipe.eof || pipe.aborted; });
+        pipe.waiting = false;
+    }
+    if (pipe.aborted) {
+        return false;
+    }
+    *read = std::min(len, pipe.avail());
+    if (*read) {
+        memcpy(buf, pipe.data.data() + pipe.pos, *read);
+    }
+    pipe.pos += *read;
+    if (pipe.pos == pipe.data.size()) {
+        pipe.data.clear();
+        pipe.pos = 0;
+    } else if (pipe.pos > pipe.avail()) {
+        pipe.data.erase(pipe.data.begin(), pipe.data.begin() + pipe.pos);
+        pipe.pos = 0;
+    }
+    /* wake up the writer if it waits for the free space */
+    pipe.cond.notify_all();
+    return true;
+}
+
+/* write to the pipe, waiting for the free space if block is true */
+static bool
+stream_pipe_write(rnp_stream_pipe_st &pipe, const void *buf, size_t len, bool block)
+{
+    std::unique_lock<std::mutex> lock(pipe.lock);
+    if (block && pipe.max) {
+        pipe.cond.wait(lock, [&pipe]() { return (pipe.avail() < pipe.max) || pipe.aborted; });
+    }
+    if (pipe.aborted || pipe.eof) {
+        return false;
+    }
+    pipe.data.insert(pipe.data.end(), (const uint8_t *) buf, (const uint8_t *) buf + len);
+    pipe.cond.notify_all();
+    lock.unlock();
+    if (pipe.notify) {
+        pipe.notify();
+    }
+    return true;
+}
+
+static void
+stream_pipe_abort(rnp_stream_pipe_st *pipe)
+{
+    if (!pipe) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(pipe->lock);
+    pipe->aborted = true;
+    pipe->cond.notify_all();
+}
+
+static bool
+push_src_read(pgp_source_t *src, void *buf, size_t len, size_t *read)
+{
+    return stream_pipe_read(*(rnp_stream_pipe_st *) src->param, buf, len, read, true);
+}
+
+static void
+push_src_close(pgp_source_t *src)
+{
+    delete (rnp_stream_pipe_st *) src->param;
+    src->param = NULL;
+}
+
+static rnp_stream_pipe_st *
+input_push_pipe(rnp_input_t input)
+{
+    if (!input || (input->src.raw_read != push_src_read)) {
+        return NULL;
+    }
+    return (rnp_stream_pipe_st *) input->src.param;
+}
+
+rnp_result_t
+rnp_input_from_push(rnp_input_t *input)
+try {
+    if (!input) {
+        return RNP_ERROR_NULL_POINTER;
+    }
+    std::unique_ptr<rnp_input_st> obj(new rnp_input_st());
+    pgp_source_t *                src = &obj->src;
+    if (!init_src_common(src, 0)) {
+        return RNP_ERROR_OUT_OF_MEMORY; // LCOV_EXCL_LINE
+    }
+    src->param = new rnp_stream_pipe_st();
+    src->raw_read = push_src_read;
+    src->raw_close = push_src_close;
+    src->type = PGP_STREAM_PIPE;
+    *input = obj.release();
+    return RNP_SUCCESS;
+}
+FFI_GUARD
+
+rnp_result_t
+rnp_input_push(rnp_input_t input, const uint8_t *buf, size_t len)
+try {
+    if (!input || (!buf && len)) {
+        return RNP_ERROR_NULL_POINTER;
+    }
+    auto pipe = input_push_pipe(input);
+    if (!pipe) {
+        return RNP_ERROR_BAD_PARAMETERS;
+    }
+    if (!len) {
+        return RNP_SUCCESS;
+    }
+    return stream_pipe_write(*pipe, buf, len, false) ? RNP_SUCCESS : RNP_ERROR_BAD_STATE;
+}
+FFI_GUARD
+
+rnp_result_t
+rnp_input_push_finish(rnp_input_t input)
+try {
+    if (!input) {
+        return RNP_ERROR_NULL_POINTER;
+    }
+    auto pipe = input_push_pipe(input);
+    if (!pipe) {
+        return RNP_ERROR_BAD_PARAMETERS;
+    }
+    std::lock_guard<std::mutex> lock(pipe->lock);
+    pipe->eof = true;
+    pipe->cond.notify_all();
+    return RNP_SUCCESS;
+}
+FFI_GUARD
+
+rnp_result_t
+rnp_input_destroy(rnp_input_t input)
+try {
     delete input;
     return RNP_SUCCESS;
 }
@@ -2237,6 +2803,17 @@ try {
         free(res);
         return ret;
     }
+    /* target file is not touched until output is finished, so keyring may be updated */
+    if (random && overwrite) {
+        res->dst_path = strdup(path);
+        if (!res->dst_path) {
+            /* LCOV_EXCL_START */
+            dst_close(&res->dst, true);
+            free(res);
+            return RNP_ERROR_OUT_OF_MEMORY;
+            /* LCOV_EXCL_END */
+        }
+    }
     *output = res;
     return RNP_SUCCESS;
 }
@@ -2285,6 +2862,44 @@ try {
 }
 FFI_GUARD
 
+rnp_result_t
+rnp_output_to_memory_ex(rnp_output_t *output,
+                        size_t        max_alloc,
+                        size_t        size_hint,
+                        uint32_t      flags)
+try {
+    // checks
+    if (!output) {
+        return RNP_ERROR_NULL_POINTER;
+    }
+    bool segmented = extract_flag(flags, RNP_OUTPUT_MEMORY_SEGMENTED);
+    if (flags) {
+        return RNP_ERROR_BAD_PARAMETERS;
+    }
+    rnp_output_t res = (rnp_output_t) calloc(1, sizeof(*res));
+    if (!res) {
+        return RNP_ERROR_OUT_OF_MEMORY; // LCOV_EXCL_LINE
+    }
+    rnp_result_t ret = RNP_ERROR_GENERIC;
+    if (segmented) {
+        ret = init_segmented_mem_dest(&res->dst, max_alloc, size_hint);
+    } else {
+        ret = init_mem_dest(&res->dst, NULL, max_alloc);
+    }
+    if (ret) {
+        /* LCOV_EXCL_START */
+        free(res);
+        return ret;
+        /* LCOV_EXCL_END */
+    }
+    if (!segmented) {
+        mem_dest_set_size_hint(&res->dst, size_hint);
+    }
+    *output = res;
+    return RNP_SUCCESS;
+}
+FFI_GUARD
+
 rnp_result_t
 rnp_output_to_armor(rnp_output_t base, rnp_output_t *output, const char *type)
 try {
@@ -2323,19 +2938,67 @@ try {
     if (!output || !buf || !len) {
         return RNP_ERROR_NULL_POINTER;
     }
-
-    *len = output->dst.writeb;
-    *buf = (uint8_t *) mem_dest_get_memory(&output->dst);
-    if (!*buf) {
+    if (output->dst.type != PGP_STREAM_MEMORY) {
         return RNP_ERROR_BAD_PARAMETERS;
     }
+
+    *len = output->dst.writeb;
     if (do_copy) {
-        uint8_t *tmp_buf = *buf;
+        /* copy directly from the segments, so they don't need to be merged */
+        size_t count = mem_dest_segment_count(&output->dst);
+        if (!count) {
+            return RNP_ERROR_BAD_PARAMETERS;
+        }
         *buf = (uint8_t *) malloc(*len);
         if (!*buf) {
             return RNP_ERROR_OUT_OF_MEMORY; // LCOV_EXCL_LINE
         }
-        memcpy(*buf, tmp_buf, *len);
+        size_t pos = 0;
+        for (size_t idx = 0; idx < count; idx++) {
+            const uint8_t *seg = NULL;
+            size_t         seglen = 0;
+            mem_dest_get_segment(&output->dst, idx, &seg, &seglen);
+            memcpy(*buf + pos, seg, seglen);
+            pos += seglen;
+        }
+        return RNP_SUCCESS;
+    }
+    *buf = (uint8_t *) mem_dest_get_memory(&output->dst);
+    if (!*buf) {
+        return RNP_ERROR_BAD_PARAMETERS;
+    }
+    return RNP_SUCCESS;
+}
+FFI_GUARD
+
+rnp_result_t
+rnp_output_memory_get_segment_count(rnp_output_t output, size_t *count)
+try {
+    if (!output || !count) {
+        return RNP_ERROR_NULL_POINTER;
+    }
+    if (output->dst.type != PGP_STREAM_MEMORY) {
+        return RNP_ERROR_BAD_PARAMETERS;
+    }
+    *count = mem_dest_segment_count(&output->dst);
+    return RNP_SUCCESS;
+}
+FFI_GUARD
+
+rnp_result_t
+rnp_output_memory_get_segment_at(rnp_output_t    output,
+                                 size_t          idx,
+                                 const uint8_t **buf,
+                                 size_t *        len)
+try {
+    if (!output || !buf || !len) {
+        return RNP_ERROR_NULL_POINTER;
+    }
+    if (output->dst.type != PGP_STREAM_MEMORY) {
+        return RNP_ERROR_BAD_PARAMETERS;
+    }
+    if (!mem_dest_get_segment(&output->dst, idx, buf, len)) {
+        return RNP_ERROR_NOT_FOUND;
     }
     return RNP_SUCCESS;
 }
@@ -2438,6 +3101,213 @@ try {
 }
 FFI_GUARD
 
+static rnp_result_t
+pull_dst_write(pgp_dest_t *dst, const void *buf, size_t len)
+{
+    auto pipe = (rnp_stream_pipe_st *) dst->param;
+    return stream_pipe_write(*pipe, buf, len, true) ? RNP_SUCCESS : RNP_ERROR_WRITE;
+}
+
+static void
+pull_dst_close(pgp_dest_t *dst, bool discard)
+{
+    delete (rnp_stream_pipe_st *) dst->param;
+    dst->param = NULL;
+}
+
+static rnp_stream_pipe_st *
+output_pull_pipe(rnp_output_t output)
+{
+    if (!output || (output->dst.write != pull_dst_write)) {
+        return NULL;
+    }
+    return (rnp_stream_pipe_st *) output->dst.param;
+}
+
+void
+rnp_op_stream_st::stop()
+{
+    if (!state) {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(state->lock);
+    state->stopped = true;
+    if (!state->running) {
+        /* worker will skip the operation */
+        return;
+    }
+    if (!state->done) {
+        lock.unlock();
+        for (auto pipe : inputs) {
+            stream_pipe_abort(pipe);
+        }
+        stream_pipe_abort(output);
+        lock.lock();
+    }
+    state->cond.wait(lock, [this]() { return state->notified; });
+}
+
+/* queue the operation to the ffi's worker pool, exec may block on the push/pull pipes */
+static rnp_result_t
+ffi_start_stream(rnp_ffi_t                     ffi,
+                 rnp_op_stream_st &            stream,
+                 rnp_op_async_st &             async,
+                 std::vector<rnp_input_t>      inputs,
+                 rnp_output_t                  output,
+                 std::function<rnp_result_t()> exec,
+                 rnp_op_notify_t *             notify,
+                 void *                        app_ctx)
+{
+    bool pending = false;
+    {
+        std::lock_guard<std::mutex> lock(async.lock);
+        pending = async.pending;
+    }
+    if (stream.state || pending) {
+        FFI_LOG(ffi, "Operation is already started.");
+        return RNP_ERROR_BAD_STATE;
+    }
+    std::function<void()> cb;
+    if (notify) {
+        cb = [notify, app_ctx]() { notify(app_ctx); };
+    }
+    std::vector<rnp_stream_pipe_st *> pipes;
+    for (auto input : inputs) {
+        auto pipe = input_push_pipe(input);
+        if (pipe) {
+            pipe->notify = cb;
+            pipes.push_back(pipe);
+        }
+    }
+    auto outpipe = output_pull_pipe(output);
+    if (outpipe) {
+        outpipe->notify = cb;
+    }
+
+    std::shared_ptr<rnp_op_stream_st::State> state(new rnp_op_stream_st::State());
+    auto                                     task = [state, exec, cb]() {
+        {
+            std::lock_guard<std::mutex> lock(state->lock);
+            if (state->stopped) {
+                return;
+            }
+            state->running = true;
+        }
+        rnp_result_t ret = exec();
+        bool         stopped = false;
+        {
+            std::lock_guard<std::mutex> lock(state->lock);
+            state->result = ret;
+            state->done = true;
+            stopped = state->stopped;
+            state->cond.notify_all();
+        }
+        if (cb && !stopped) {
+            cb();
+        }
+        std::lock_guard<std::mutex> lock(state->lock);
+        state->notified = true;
+        state->cond.notify_all();
+    };
+    if (!ffi_pool_push(ffi, task)) {
+        return RNP_ERROR_BAD_STATE;
+    }
+    stream.state = state;
+    stream.inputs = pipes;
+    stream.output = outpipe;
+    return RNP_SUCCESS;
+}
+
+static rnp_result_t
+ffi_stream_state(rnp_ffi_t ffi, rnp_op_stream_st &stream, uint32_t *state)
+{
+    if (!stream.state) {
+        FFI_LOG(ffi, "Operation is not started.");
+        return RNP_ERROR_BAD_STATE;
+    }
+    uint32_t res = 0;
+    {
+        std::lock_guard<std::mutex> lock(stream.state->lock);
+        res = stream.state->done ? RNP_OP_STATE_DONE : 0;
+    }
+    for (auto pipe : stream.inputs) {
+        std::lock_guard<std::mutex> lock(pipe->lock);
+        if (pipe->waiting && !pipe->avail() && !pipe->eof) {
+            res |= RNP_OP_STATE_NEED_INPUT;
+        }
+    }
+    if (stream.output) {
+        std::lock_guard<std::mutex> lock(stream.output->lock);
+        if (stream.output->avail()) {
+            res |= RNP_OP_STATE_HAVE_OUTPUT;
+        }
+    }
+    *state = res;
+    return RNP_SUCCESS;
+}
+
+static rnp_result_t
+ffi_stream_finish(rnp_ffi_t ffi, rnp_op_stream_st &stream)
+{
+    if (!stream.state) {
+        FFI_LOG(ffi, "Operation is not started.");
+        return RNP_ERROR_BAD_STATE;
+    }
+    std::unique_lock<std::mutex> lock(stream.state->lock);
+    stream.state->cond.wait(lock, [&stream]() { return stream.state->done; });
+    return stream.state->result;
+}
+
+rnp_result_t
+rnp_output_to_pull(rnp_output_t *output, size_t max_buffered)
+try {
+    if (!output) {
+        return RNP_ERROR_NULL_POINTER;
+    }
+    rnp_output_t res = (rnp_output_t) calloc(1, sizeof(*res));
+    if (!res) {
+        return RNP_ERROR_OUT_OF_MEMORY; // LCOV_EXCL_LINE
+    }
+    auto pipe = new (std::nothrow) rnp_stream_pipe_st();
+    if (!pipe) {
+        /* LCOV_EXCL_START */
+        free(res);
+        return RNP_ERROR_OUT_OF_MEMORY;
+        /* LCOV_EXCL_END */
+    }
+    pipe->max = max_buffered;
+
+    pgp_dest_t *dst = &res->dst;
+    dst->write = pull_dst_write;
+    dst->close = pull_dst_close;
+    dst->param = pipe;
+    dst->type = PGP_STREAM_PIPE;
+    dst->writeb = 0;
+    dst->werr = RNP_SUCCESS;
+    /* make data available to the application as soon as it is written */
+    dst->no_cache = true;
+    *output = res;
+    return RNP_SUCCESS;
+}
+FFI_GUARD
+
+rnp_result_t
+rnp_output_pull(rnp_output_t output, uint8_t *buf, size_t len, size_t *read)
+try {
+    if (!output || !buf || !read) {
+        return RNP_ERROR_NULL_POINTER;
+    }
+    auto pipe = output_pull_pipe(output);
+    if (!pipe) {
+        return RNP_ERROR_BAD_PARAMETERS;
+    }
+    if (!stream_pipe_read(*pipe, buf, len, read, false)) {
+        return RNP_ERROR_BAD_STATE;
+    }
+    return RNP_SUCCESS;
+}
+FFI_GUARD
+
 rnp_result_t
 rnp_output_finish(rnp_output_t output)
 try {
@@ -2457,6 +3327,7 @@ try {
         }
         dst_close(&output->dst, !output->keep);
         free(output->dst_directory);
+        free(output->dst_path);
         free(output);
     }
     return RNP_SUCCESS;
@@ -2557,6 +3428,7 @@ static rnp_result_t
 rnp_op_set_flags(rnp_ffi_t ffi, rnp_ctx_t &ctx, uint32_t flags)
 {
     ctx.no_wrap = extract_flag(flags, RNP_ENCRYPT_NOWRAP);
+    ctx.zadaptive = extract_flag(flags, RNP_ENCRYPT_ADAPTIVE_COMPRESSION);
     if (flags) {
         FFI_LOG(ffi, "Unknown operation flags: %x", flags);
         return RNP_ERROR_BAD_PARAMETERS;
@@ -2856,6 +3728,30 @@ try {
 }
 FFI_GUARD
 
+rnp_result_t
+rnp_op_encrypt_get_compression(rnp_op_encrypt_t op, char **compression, int *level)
+try {
+    if (!op) {
+        return RNP_ERROR_NULL_POINTER;
+    }
+    /* input is released once operation is executed */
+    if (op->input) {
+        FFI_LOG(op->ffi, "Operation was not executed yet.");
+        return RNP_ERROR_BAD_STATE;
+    }
+    if (compression) {
+        auto ret = get_map_value(compress_alg_map, op->rnpctx.zalg_out, compression);
+        if (ret) {
+            return ret; // LCOV_EXCL_LINE
+        }
+    }
+    if (level) {
+        *level = op->rnpctx.zlevel_out;
+    }
+    return RNP_SUCCESS;
+}
+FFI_GUARD
+
 rnp_result_t
 rnp_op_encrypt_set_file_name(rnp_op_encrypt_t op, const char *filename)
 try {
@@ -2942,6 +3838,59 @@ try {
 }
 FFI_GUARD
 
+rnp_result_t
+rnp_op_encrypt_execute_async(rnp_op_encrypt_t op, rnp_op_complete_t *complete, void *app_ctx)
+try {
+    if (!op || !op->input || !op->output) {
+        return RNP_ERROR_NULL_POINTER;
+    }
+    if (op->stream.state) {
+        FFI_LOG(op->ffi, "Operation is already started.");
+        return RNP_ERROR_BAD_STATE;
+    }
+    return ffi_execute_async(
+      op->ffi, op->async, [op]() { return rnp_op_encrypt_execute(op); }, complete, app_ctx);
+}
+FFI_GUARD
+
+rnp_result_t
+rnp_op_encrypt_start(rnp_op_encrypt_t op, rnp_op_notify_t *notify, void *app_ctx)
+try {
+    if (!op || !op->input || !op->output) {
+        return RNP_ERROR_NULL_POINTER;
+    }
+    return ffi_start_stream(
+      op->ffi,
+      op->stream,
+      op->async,
+      {op->input},
+      op->output,
+      [op]() { return rnp_op_encrypt_execute(op); },
+      notify,
+      app_ctx);
+}
+FFI_GUARD
+
+rnp_result_t
+rnp_op_encrypt_get_state(rnp_op_encrypt_t op, uint32_t *state)
+try {
+    if (!op || !state) {
+        return RNP_ERROR_NULL_POINTER;
+    }
+    return ffi_stream_state(op->ffi, op->stream, state);
+}
+FFI_GUARD
+
+rnp_result_t
+rnp_op_encrypt_finish(rnp_op_encrypt_t op)
+try {
+    if (!op) {
+        return RNP_ERROR_NULL_POINTER;
+    }
+    return ffi_stream_finish(op->ffi, op->stream);
+}
+FFI_GUARD
+
 rnp_result_t
 rnp_op_encrypt_destroy(rnp_op_encrypt_t op)
 try {
@@ -3143,6 +4092,59 @@ try {
 }
 FFI_GUARD
 
+rnp_result_t
+rnp_op_sign_execute_async(rnp_op_sign_t op, rnp_op_complete_t *complete, void *app_ctx)
+try {
+    if (!op || !op->input || !op->output) {
+        return RNP_ERROR_NULL_POINTER;
+    }
+    if (op->stream.state) {
+        FFI_LOG(op->ffi, "Operation is already started.");
+        return RNP_ERROR_BAD_STATE;
+    }
+    return ffi_execute_async(
+      op->ffi, op->async, [op]() { return rnp_op_sign_execute(op); }, complete, app_ctx);
+}
+FFI_GUARD
+
+rnp_result_t
+rnp_op_sign_start(rnp_op_sign_t op, rnp_op_notify_t *notify, void *app_ctx)
+try {
+    if (!op || !op->input || !op->output) {
+        return RNP_ERROR_NULL_POINTER;
+    }
+    return ffi_start_stream(
+      op->ffi,
+      op->stream,
+      op->async,
+      {op->input},
+      op->output,
+      [op]() { return rnp_op_sign_execute(op); },
+      notify,
+      app_ctx);
+}
+FFI_GUARD
+
+rnp_result_t
+rnp_op_sign_get_state(rnp_op_sign_t op, uint32_t *state)
+try {
+    if (!op || !state) {
+        return RNP_ERROR_NULL_POINTER;
+    }
+    return ffi_stream_state(op->ffi, op->stream, state);
+}
+FFI_GUARD
+
+rnp_result_t
+rnp_op_sign_finish(rnp_op_sign_t op)
+try {
+    if (!op) {
+        return RNP_ERROR_NULL_POINTER;
+    }
+    return ffi_stream_finish(op->ffi, op->stream);
+}
+FFI_GUARD
+
 rnp_result_t
 rnp_op_sign_destroy(rnp_op_sign_t op)
 try {
@@ -3151,6 +4153,226 @@ try {
 }
 FFI_GUARD
 
+rnp_result_t
+rnp_op_sign_batch_create(rnp_op_sign_batch_t *op, rnp_ffi_t ffi)
+try {
+    if (!op || !ffi) {
+        return RNP_ERROR_NULL_POINTER;
+    }
+
+    *op = new rnp_op_sign_batch_st();
+    rnp_ctx_init_ffi((*op)->rnpctx, ffi);
+    (*op)->rnpctx.detached = true;
+    /* inputs are processed in parallel, so signatures for each input are calculated
+     * sequentially */
+    (*op)->rnpctx.threads = 1;
+    (*op)->ffi = ffi;
+    return RNP_SUCCESS;
+}
+FFI_GUARD
+
+rnp_result_t
+rnp_op_sign_batch_add_input(rnp_op_sign_batch_t op,
+                            rnp_input_t         input,
+                            rnp_output_t        signature,
+                            size_t *            idx)
+try {
+    if (!op || !input || !signature) {
+        return RNP_ERROR_NULL_POINTER;
+    }
+    if (op->executed) {
+        FFI_LOG(op->ffi, "Operation was already executed.");
+        return RNP_ERROR_BAD_STATE;
+    }
+    op->items.push_back({input, signature, RNP_ERROR_GENERIC});
+    if (idx) {
+        *idx = op->items.size() - 1;
+    }
+    return RNP_SUCCESS;
+}
+FFI_GUARD
+
+rnp_result_t
+rnp_op_sign_batch_add_signature(rnp_op_sign_batch_t      op,
+                                rnp_key_handle_t         key,
+                                rnp_op_sign_signature_t *sig)
+try {
+    if (!op) {
+        return RNP_ERROR_NULL_POINTER;
+    }
+    return rnp_op_add_signature(op->ffi, op->signatures, key, op->rnpctx, sig);
+}
+FFI_GUARD
+
+rnp_result_t
+rnp_op_sign_batch_set_armor(rnp_op_sign_batch_t op, bool armored)
+try {
+    if (!op) {
+        return RNP_ERROR_NULL_POINTER;
+    }
+    return rnp_op_set_armor(op->rnpctx, armored);
+}
+FFI_GUARD
+
+rnp_result_t
+rnp_op_sign_batch_set_hash(rnp_op_sign_batch_t op, const char *hash)
+try {
+    if (!op) {
+        return RNP_ERROR_NULL_POINTER;
+    }
+    return rnp_op_set_hash(op->ffi, op->rnpctx, hash);
+}
+FFI_GUARD
+
+rnp_result_t
+rnp_op_sign_batch_set_creation_time(rnp_op_sign_batch_t op, uint32_t create)
+try {
+    if (!op) {
+        return RNP_ERROR_NULL_POINTER;
+    }
+    return rnp_op_set_creation_time(op->rnpctx, create);
+}
+FFI_GUARD
+
+rnp_result_t
+rnp_op_sign_batch_set_expiration_time(rnp_op_sign_batch_t op, uint32_t expire)
+try {
+    if (!op) {
+        return RNP_ERROR_NULL_POINTER;
+    }
+    return rnp_op_set_expiration_time(op->rnpctx, expire);
+}
+FFI_GUARD
+
+rnp_result_t
+rnp_op_sign_batch_set_threads(rnp_op_sign_batch_t op, size_t threads)
+try {
+    if (!op) {
+        return RNP_ERROR_NULL_POINTER;
+    }
+    op->threads = threads;
+    return RNP_SUCCESS;
+}
+FFI_GUARD
+
+rnp_op_sign_batch_worker_t::rnp_op_sign_batch_worker_t(rnp_op_sign_batch_t op)
+{
+    auto &src = op->rnpctx;
+    secctx.profile = src.ctx->profile;
+    /* all of the signatures in batch would have the same creation time */
+    secctx.set_time(src.ctx->time());
+    rnpctx.ctx = &secctx;
+    rnpctx.sigcreate = src.sigcreate;
+    rnpctx.sigexpire = src.sigexpire;
+    rnpctx.detached = src.detached;
+    rnpctx.halg = src.halg;
+    rnpctx.armor = src.armor;
+    rnpctx.threads = src.threads;
+    rnpctx.signers = src.signers;
+}
+
+/* unlock and validate signing keys once, before the inputs are processed in parallel */
+static rnp_result_t
+rnp_op_sign_batch_prepare(rnp_op_sign_batch_t                           op,
+                          std::vector<std::unique_ptr<rnp::KeyLocker>> &lockers)
+{
+    for (auto &signer : op->rnpctx.signers) {
+        auto key = signer.key;
+        if (!key->material() || !key->is_secret()) {
+            FFI_LOG(op->ffi, "Secret key required for signing.");
+            return RNP_ERROR_BAD_PARAMETERS;
+        }
+        lockers.emplace_back(new rnp::KeyLocker(*key));
+        if (key->encrypted() && !lockers.back()->unlock(op->ffi->pass_provider, PGP_OP_SIGN)) {
+            FFI_LOG(op->ffi, "Failed to unlock signing key.");
+            return RNP_ERROR_BAD_PASSWORD;
+        }
+        /* validation result is cached, so workers will not modify the key material */
+        lockers.back()->validate(op->ffi->context);
+    }
+    return RNP_SUCCESS;
+}
+
+rnp_result_t
+rnp_op_sign_batch_execute(rnp_op_sign_batch_t op)
+try {
+    if (!op) {
+        return RNP_ERROR_NULL_POINTER;
+    }
+    if (op->executed || op->items.empty() || op->signatures.empty()) {
+        FFI_LOG(op->ffi, "No inputs or signers, or operation was already executed.");
+        return RNP_ERROR_BAD_STATE;
+    }
+    op->executed = true;
+
+    // set the default hash alg if none was specified
+    if (!op->rnpctx.halg) {
+        op->rnpctx.halg = DEFAULT_PGP_HASH_ALG;
+    }
+    rnp_result_t ret;
+    if ((ret = rnp_op_add_signatures(op->signatures, op->rnpctx))) {
+        return ret;
+    }
+    std::vector<std::unique_ptr<rnp::KeyLocker>> lockers;
+    if ((ret = rnp_op_sign_batch_prepare(op, lockers))) {
+        return ret;
+    }
+
+    auto & pool = rnp::ThreadPool::shared();
+    size_t count = op->threads ? op->threads : pool.max_threads();
+    count = std::max<size_t>(std::min(count, op->items.size()), 1);
+    /* workers do not share the ffi context and providers */
+    std::vector<std::unique_ptr<rnp_op_sign_batch_worker_t>> workers;
+    for (size_t i = 0; i < count; i++) {
+        workers.emplace_back(new rnp_op_sign_batch_worker_t(op));
+    }
+    std::atomic<size_t> next(0);
+    std::atomic<size_t> slot(0);
+    auto                worker = [&]() {
+        auto &              wrk = *workers[slot++];
+        pgp_write_handler_t handler =
+          pgp_write_handler(&wrk.pass_provider, &wrk.rnpctx, NULL, &wrk.key_provider);
+        size_t idx;
+        while ((idx = next++) < op->items.size()) {
+            auto &item = op->items[idx];
+            item.result = rnp_sign_src(&handler, &item.input->src, &item.output->dst);
+            dst_flush(&item.output->dst);
+            item.output->keep = item.result == RNP_SUCCESS;
+        }
+    };
+    pool.run_parallel(count, worker);
+
+    for (auto &item : op->items) {
+        if (item.result) {
+            return item.result;
+        }
+    }
+    return RNP_SUCCESS;
+}
+FFI_GUARD
+
+rnp_result_t
+rnp_op_sign_batch_get_result(rnp_op_sign_batch_t op, size_t idx, rnp_result_t *result)
+try {
+    if (!op || !result) {
+        return RNP_ERROR_NULL_POINTER;
+    }
+    if (!op->executed || (idx >= op->items.size())) {
+        return RNP_ERROR_BAD_PARAMETERS;
+    }
+    *result = op->items[idx].result;
+    return RNP_SUCCESS;
+}
+FFI_GUARD
+
+rnp_result_t
+rnp_op_sign_batch_destroy(rnp_op_sign_batch_t op)
+try {
+    delete op;
+    return RNP_SUCCESS;
+}
+FFI_GUARD
+
 static void
 rnp_op_verify_on_signatures(const std::vector<pgp_signature_info_t> &sigs, void *param)
 {
@@ -3301,13 +4523,23 @@ rnp_verify_on_decryption_info(bool mdc, pgp_aead_alg_t aead, pgp_symm_alg_t salg
 }
 
 static void
-rnp_verify_on_decryption_done(bool validated, void *param)
+rnp_verify_on_decryption_done(bool validated, void *param)
+{
+    rnp_op_verify_t op = (rnp_op_verify_t) param;
+    if (op->encrypted_layers > 1) {
+        return;
+    }
+    op->validated = validated;
+}
+
+static void
+rnp_verify_on_decryption_key(const uint8_t *key, size_t len, void *param)
 {
     rnp_op_verify_t op = (rnp_op_verify_t) param;
     if (op->encrypted_layers > 1) {
         return;
     }
-    op->validated = validated;
+    op->sesskey.assign(key, key + len);
 }
 
 rnp_result_t
@@ -3376,6 +4608,7 @@ ffi_decrypt_key_provider(const pgp_key_request_ctx_t *ctx, void *userdata)
         call_key_callback(ffi, ctx->search, ctx->secret);
     }
     kparam->has_hidden = true;
+    std::lock_guard<std::recursive_mutex> lock(ffi->keys_lock);
     kparam->last = find_key(ffi, ctx->search, true, true, kparam->last);
     return kparam->last;
 }
@@ -3392,6 +4625,10 @@ try {
     op->require_all_sigs = extract_flag(flags, RNP_VERIFY_REQUIRE_ALL_SIGS);
     /* Allow hidden recipients if any */
     op->allow_hidden = extract_flag(flags, RNP_VERIFY_ALLOW_HIDDEN_RECIPIENT);
+    /* Keep the session key so it may be retrieved later */
+    op->keep_sesskey = extract_flag(flags, RNP_VERIFY_KEEP_SESSION_KEY);
+    /* Keep decryption key unlocked for the subsequent operations */
+    op->rnpctx.keep_unlocked = extract_flag(flags, RNP_VERIFY_KEEP_KEYS_UNLOCKED);
 
     if (flags) {
         FFI_LOG(op->ffi, "Unknown operation flags: %x", flags);
@@ -3423,6 +4660,7 @@ try {
     handler.on_decryption_start = rnp_verify_on_decryption_start;
     handler.on_decryption_info = rnp_verify_on_decryption_info;
     handler.on_decryption_done = rnp_verify_on_decryption_done;
+    handler.on_decryption_key = op->keep_sesskey ? rnp_verify_on_decryption_key : NULL;
     handler.param = op;
     handler.ctx = &op->rnpctx;
 
@@ -3448,6 +4686,59 @@ try {
 }
 FFI_GUARD
 
+rnp_result_t
+rnp_op_verify_start(rnp_op_verify_t op, rnp_op_notify_t *notify, void *app_ctx)
+try {
+    if (!op) {
+        return RNP_ERROR_NULL_POINTER;
+    }
+    return ffi_start_stream(
+      op->ffi,
+      op->stream,
+      op->async,
+      {op->input, op->detached_input},
+      op->output,
+      [op]() { return rnp_op_verify_execute(op); },
+      notify,
+      app_ctx);
+}
+FFI_GUARD
+
+rnp_result_t
+rnp_op_verify_get_state(rnp_op_verify_t op, uint32_t *state)
+try {
+    if (!op || !state) {
+        return RNP_ERROR_NULL_POINTER;
+    }
+    return ffi_stream_state(op->ffi, op->stream, state);
+}
+FFI_GUARD
+
+rnp_result_t
+rnp_op_verify_finish(rnp_op_verify_t op)
+try {
+    if (!op) {
+        return RNP_ERROR_NULL_POINTER;
+    }
+    return ffi_stream_finish(op->ffi, op->stream);
+}
+FFI_GUARD
+
+rnp_result_t
+rnp_op_verify_execute_async(rnp_op_verify_t op, rnp_op_complete_t *complete, void *app_ctx)
+try {
+    if (!op) {
+        return RNP_ERROR_NULL_POINTER;
+    }
+    if (op->stream.state) {
+        FFI_LOG(op->ffi, "Operation is already started.");
+        return RNP_ERROR_BAD_STATE;
+    }
+    return ffi_execute_async(
+      op->ffi, op->async, [op]() { return rnp_op_verify_execute(op); }, complete, app_ctx);
+}
+FFI_GUARD
+
 rnp_result_t
 rnp_op_verify_get_signature_count(rnp_op_verify_t op, size_t *count)
 try {
@@ -3582,6 +4873,29 @@ try {
 }
 FFI_GUARD
 
+rnp_result_t
+rnp_op_verify_get_session_key(rnp_op_verify_t op, uint8_t **key, size_t *key_len)
+try {
+    if (!op || !key || !key_len) {
+        return RNP_ERROR_NULL_POINTER;
+    }
+    if (!op->keep_sesskey) {
+        FFI_LOG(op->ffi, "Session key was not requested to be kept.");
+        return RNP_ERROR_BAD_STATE;
+    }
+    if (op->sesskey.empty()) {
+        return RNP_ERROR_NOT_FOUND;
+    }
+    *key = (uint8_t *) malloc(op->sesskey.size());
+    if (!*key) {
+        return RNP_ERROR_OUT_OF_MEMORY; // LCOV_EXCL_LINE
+    }
+    memcpy(*key, op->sesskey.data(), op->sesskey.size());
+    *key_len = op->sesskey.size();
+    return RNP_SUCCESS;
+}
+FFI_GUARD
+
 rnp_result_t
 rnp_op_verify_get_recipient_at(rnp_op_verify_t         op,
                                size_t                  idx,
@@ -3715,6 +5029,9 @@ FFI_GUARD
 
 rnp_op_verify_st::~rnp_op_verify_st()
 {
+    async.wait();
+    /* stop the operation, running in background */
+    stream.stop();
     delete used_recipient;
     delete used_symenc;
 }
@@ -3821,6 +5138,81 @@ try {
 }
 FFI_GUARD
 
+rnp_result_t
+rnp_op_decrypt_range_create(rnp_op_decrypt_range_t *op,
+                            rnp_ffi_t               ffi,
+                            rnp_input_t             input,
+                            const uint8_t *         key,
+                            size_t                  key_len)
+try {
+    if (!op || !ffi || !input || !key) {
+        return RNP_ERROR_NULL_POINTER;
+    }
+    if (!input->src_directory.empty()) {
+        FFI_LOG(ffi, "Directory input is not supported.");
+        return RNP_ERROR_BAD_PARAMETERS;
+    }
+
+    std::unique_ptr<rnp_op_decrypt_range_st> ob(new rnp_op_decrypt_range_st());
+    rnp_result_t ret = init_aead_range_src(&ob->src, &input->src, key, key_len);
+    if (ret) {
+        FFI_LOG(ffi, "Failed to initialize range decryption: 0x%x", ret);
+        return ret;
+    }
+    ob->ffi = ffi;
+    ob->input = input;
+    *op = ob.release();
+    return RNP_SUCCESS;
+}
+FFI_GUARD
+
+rnp_result_t
+rnp_op_decrypt_range_execute(rnp_op_decrypt_range_t op,
+                             uint64_t               offset,
+                             uint64_t               length,
+                             rnp_output_t           output)
+try {
+    if (!op || !output) {
+        return RNP_ERROR_NULL_POINTER;
+    }
+    if (!op->src.seek(offset)) {
+        return RNP_ERROR_READ; // LCOV_EXCL_LINE
+    }
+    std::vector<uint8_t> buf(PGP_INPUT_CACHE_SIZE);
+    while (length && !op->src.eof_) {
+        size_t read = 0;
+        if (!op->src.read(buf.data(), std::min<uint64_t>(length, buf.size()), &read)) {
+            FFI_LOG(op->ffi, "Failed to read or decrypt data.");
+            return RNP_ERROR_READ;
+        }
+        if (!read) {
+            break;
+        }
+        dst_write(&output->dst, buf.data(), read);
+        if (output->dst.werr) {
+            return RNP_ERROR_WRITE;
+        }
+        length -= read;
+    }
+    dst_flush(&output->dst);
+    output->keep = !output->dst.werr;
+    return output->dst.werr;
+}
+FFI_GUARD
+
+rnp_op_decrypt_range_st::~rnp_op_decrypt_range_st()
+{
+    src.close();
+}
+
+rnp_result_t
+rnp_op_decrypt_range_destroy(rnp_op_decrypt_range_t op)
+try {
+    delete op;
+    return RNP_SUCCESS;
+}
+FFI_GUARD
+
 static rnp_result_t
 rnp_locate_key_int(rnp_ffi_t             ffi,
                    const rnp::KeySearch &locator,
@@ -3865,6 +5257,147 @@ try {
 }
 FFI_GUARD
 
+typedef std::vector<std::pair<pgp_key_t *, pgp_key_t *>> key_pairs_t;
+
+static bool
+locate_keys_add(key_pairs_t &keys, pgp_key_t *pub, pgp_key_t *sec, bool secret, uint8_t usage)
+{
+    if (secret && !sec) {
+        return false;
+    }
+    uint8_t keyflags = (pub ? pub : sec)->flags();
+    /* encryption usage is satisfied by any of the encryption flags */
+    if (keyflags & PGP_KF_ENCRYPT) {
+        keyflags |= PGP_KF_ENCRYPT;
+    }
+    if ((keyflags & usage) != usage) {
+        return false;
+    }
+    keys.emplace_back(pub, sec);
+    return true;
+}
+
+static bool
+locate_keys_has_primary(rnp_ffi_t ffi, const pgp_key_t &subkey)
+{
+    if (!subkey.has_primary_fp()) {
+        return false;
+    }
+    auto &fp = subkey.primary_fp();
+    return ffi->pubring->get_key(fp) || ffi->secring->get_key(fp);
+}
+
+static rnp_result_t
+locate_keys(rnp_ffi_t ffi, const char *query, uint32_t flags, key_pairs_t &res)
+{
+    bool    secret = extract_flag(flags, RNP_LOCATE_SECRET);
+    bool    subkeys = extract_flag(flags, RNP_LOCATE_SUBKEYS);
+    bool    subkeys_after = extract_flag(flags, RNP_LOCATE_SUBKEYS_AFTER);
+    bool    first_only = extract_flag(flags, RNP_LOCATE_FIRST_ONLY);
+    uint8_t usage = 0;
+    if (extract_flag(flags, RNP_LOCATE_USAGE_CERTIFY)) {
+        usage |= PGP_KF_CERTIFY;
+    }
+    if (extract_flag(flags, RNP_LOCATE_USAGE_SIGN)) {
+        usage |= PGP_KF_SIGN;
+    }
+    if (extract_flag(flags, RNP_LOCATE_USAGE_ENCRYPT)) {
+        usage |= PGP_KF_ENCRYPT;
+    }
+    if (extract_flag(flags, RNP_LOCATE_USAGE_AUTH)) {
+        usage |= PGP_KF_AUTH;
+    }
+    if (flags) {
+        FFI_LOG(ffi, "Unknown flags: %" PRIu32, flags);
+        return RNP_ERROR_BAD_PARAMETERS;
+    }
+    subkeys = subkeys || subkeys_after;
+    /* query is compiled once and throws on invalid regular expression */
+    rnp::KeyQuerySearch search(query);
+
+    for (auto ring : {ffi->pubring, ffi->secring}) {
+        bool secring = ring == ffi->secring;
+        for (auto keyp : ring->search_all(search)) {
+            auto &key = *keyp;
+            /* keys, available in both keyrings, are checked only once */
+            if (secring && ffi->pubring->get_key(key.fp())) {
+                continue;
+            }
+            if (key.is_subkey() &&
+                (!subkeys || (subkeys_after && locate_keys_has_primary(ffi, key)))) {
+                continue;
+            }
+            auto pub = secring ? nullptr : &key;
+            auto sec = secring ? &key : ffi->secring->get_key(key.fp());
+            bool added = locate_keys_add(res, pub, sec, secret, usage);
+            /* subkeys of the matching primary key must pass the same filters */
+            for (size_t idx = 0; subkeys_after && (idx < key.subkey_count()); idx++) {
+                auto &fp = key.get_subkey_fp(idx);
+                auto  subpub = ffi->pubring->get_key(fp);
+                auto  subsec = ffi->secring->get_key(fp);
+                if ((subpub || subsec) && locate_keys_add(res, subpub, subsec, secret, usage)) {
+                    added = true;
+                }
+            }
+            if (added && first_only) {
+                return RNP_SUCCESS;
+            }
+        }
+    }
+    return RNP_SUCCESS;
+}
+
+rnp_result_t
+rnp_locate_keys(rnp_ffi_t ffi, const char *query, uint32_t flags, rnp_key_iterator_t *it)
+try {
+    if (!ffi || !query || !it) {
+        return RNP_ERROR_NULL_POINTER;
+    }
+    std::unique_ptr<rnp_key_iterator_st> res(new rnp_key_iterator_st(ffi));
+    rnp_result_t                         ret = locate_keys(ffi, query, flags, res->keys);
+    if (ret) {
+        return ret;
+    }
+    *it = res.release();
+    return RNP_SUCCESS;
+}
+FFI_GUARD
+
+rnp_result_t
+rnp_key_iterator_get_count(rnp_key_iterator_t it, size_t *count)
+try {
+    if (!it || !count) {
+        return RNP_ERROR_NULL_POINTER;
+    }
+    *count = it->keys.size();
+    return RNP_SUCCESS;
+}
+FFI_GUARD
+
+rnp_result_t
+rnp_key_iterator_next(rnp_key_iterator_t it, rnp_key_handle_t *key)
+try {
+    if (!it || !key) {
+        return RNP_ERROR_NULL_POINTER;
+    }
+    if (it->idx >= it->keys.size()) {
+        *key = NULL;
+        return RNP_SUCCESS;
+    }
+    auto &keys = it->keys[it->idx++];
+    *key = new rnp_key_handle_st(it->ffi, keys.first, keys.second);
+    return RNP_SUCCESS;
+}
+FFI_GUARD
+
+rnp_result_t
+rnp_key_iterator_destroy(rnp_key_iterator_t it)
+try {
+    delete it;
+    return RNP_SUCCESS;
+}
+FFI_GUARD
+
 rnp_result_t
 rnp_key_export(rnp_key_handle_t handle, rnp_output_t output, uint32_t flags)
 try {
@@ -5609,6 +7142,25 @@ done:
 }
 FFI_GUARD
 
+rnp_result_t
+rnp_op_generate_execute_async(rnp_op_generate_t  op,
+                              rnp_op_complete_t *complete,
+                              void *             app_ctx)
+try {
+    if (!op) {
+        return RNP_ERROR_NULL_POINTER;
+    }
+    /* generated keys are added to the keyrings, so nothing else may run in parallel */
+    return ffi_execute_async(
+      op->ffi,
+      op->async,
+      [op]() { return rnp_op_generate_execute(op); },
+      complete,
+      app_ctx,
+      true);
+}
+FFI_GUARD
+
 rnp_result_t
 rnp_op_generate_get_key(rnp_op_generate_t op, rnp_key_handle_t *handle)
 try {
@@ -5756,6 +7308,10 @@ try {
     }
     /* add and certify userid */
     secret_key->add_uid_cert(info, hash_alg, handle->ffi->context, public_key);
+    handle->ffi->secring->update_uid_index(*secret_key);
+    if (public_key) {
+        handle->ffi->pubring->update_uid_index(*public_key);
+    }
     return RNP_SUCCESS;
 }
 FFI_GUARD
@@ -6555,7 +8111,7 @@ try {
     if (!handle || !count) {
         return RNP_ERROR_NULL_POINTER;
     }
-    *count = handle->sig->sig.subpkts.size();
+    *count = handle->sig->sig.subpkts().size();
     return RNP_SUCCESS;
 }
 FFI_GUARD
@@ -6568,10 +8124,10 @@ try {
     if (!handle || !subpkt) {
         return RNP_ERROR_NULL_POINTER;
     }
-    if (idx >= handle->sig->sig.subpkts.size()) {
+    if (idx >= handle->sig->sig.subpkts().size()) {
         return RNP_ERROR_NOT_FOUND;
     }
-    *subpkt = new rnp_sig_subpacket_st(*handle->sig->sig.subpkts[idx]);
+    *subpkt = new rnp_sig_subpacket_st(*handle->sig->sig.subpkts()[idx]);
     return RNP_SUCCESS;
 }
 FFI_GUARD
@@ -7110,11 +8666,13 @@ try {
     bool ok = false;
     if (pkey && (pkey->uid_count() > uid->idx)) {
         pkey->del_uid(uid->idx);
+        key->ffi->pubring->update_uid_index(*pkey);
         pkey->revalidate(*key->ffi->pubring);
         ok = true;
     }
     if (skey && (skey->uid_count() > uid->idx)) {
         skey->del_uid(uid->idx);
+        key->ffi->secring->update_uid_index(*skey);
         skey->revalidate(*key->ffi->secring);
         ok = true;
     }
@@ -8638,6 +10196,213 @@ try {
 }
 FFI_GUARD
 
+/* Bulk listing writes JSON directly, skipping json-c objects and handles for each key */
+static void
+list_add_name(std::string &line, const char *name)
+{
+    if (line.back() != '{') {
+        line.push_back(',');
+    }
+    line.push_back('"');
+    line.append(name);
+    line.append("\":");
+}
+
+static void
+list_add_str(std::string &line, const std::string &str)
+{
+    static const char hex[] = "0123456789abcdef";
+    line.push_back('"');
+    for (char ch : str) {
+        switch (ch) {
+        case '"':
+            line.append("\\\"");
+            break;
+        case '\\':
+            line.append("\\\\");
+            break;
+        case '\n':
+            line.append("\\n");
+            break;
+        case '\r':
+            line.append("\\r");
+            break;
+        case '\t':
+            line.append("\\t");
+            break;
+        default:
+            if ((uint8_t) ch < 0x20) {
+                line.append("\\u00");
+                line.push_back(hex[(uint8_t) ch >> 4]);
+                line.push_back(hex[ch & 0xf]);
+            } else {
+                line.push_back(ch);
+            }
+        }
+    }
+    line.push_back('"');
+}
+
+static void
+list_add_str(std::string &line, const char *name, const std::string &str)
+{
+    list_add_name(line, name);
+    list_add_str(line, str);
+}
+
+static void
+list_add_num(std::string &line, const char *name, uint64_t num)
+{
+    list_add_name(line, name);
+    line.append(std::to_string(num));
+}
+
+static void
+list_add_bool(std::string &line, const char *name, bool value)
+{
+    list_add_name(line, name);
+    line.append(value ? "true" : "false");
+}
+
+static void
+list_add_hex(std::string &line, const char *name, const uint8_t *data, size_t len)
+{
+    list_add_name(line, name);
+    line.push_back('"');
+    line.append(rnp::bin_to_hex(data, len).c_str());
+    line.push_back('"');
+}
+
+static void
+list_add_key(std::string &line, pgp_key_t *pub, pgp_key_t *sec, uint32_t fields)
+{
+    auto &key = pub ? *pub : *sec;
+    line.push_back('{');
+    if (fields & RNP_LIST_KEYID) {
+        list_add_hex(line, "keyid", key.keyid().data(), key.keyid().size());
+    }
+    if (fields & RNP_LIST_FPRINT) {
+        list_add_hex(line, "fingerprint", key.fp().fingerprint, key.fp().length);
+    }
+    if (fields & RNP_LIST_GRIP) {
+        list_add_hex(line, "grip", key.grip().data(), key.grip().size());
+    }
+    if (fields & RNP_LIST_ALG) {
+        list_add_str(line, "type", id_str_pair::lookup(pubkey_alg_map, key.alg(), "unknown"));
+        auto        km = key.material();
+        const char *curve = NULL;
+        list_add_num(line, "length", km ? km->bits() : 0);
+        if (km && curve_type_to_str(km->curve(), &curve)) {
+            list_add_str(line, "curve", curve);
+        }
+#if defined(ENABLE_PQC)
+        auto slhdsa = dynamic_cast<const pgp::SlhdsaKeyMaterial *>(km);
+        if (slhdsa) {
+            list_add_str(
+              line,
+              "sphincsplus param",
+              id_str_pair::lookup(sphincsplus_params_map, slhdsa->pub().param(), "unknown"));
+        }
+#endif
+    }
+    if (fields & RNP_LIST_TIMES) {
+        list_add_num(line, "creation time", key.creation());
+        list_add_num(line, "expiration", key.expiration());
+    }
+    if (fields & RNP_LIST_VALIDITY) {
+        list_add_bool(line, "valid", key.valid());
+        list_add_bool(line, "expired", key.expired());
+        list_add_bool(line, "revoked", key.revoked());
+    }
+    if (fields & RNP_LIST_USAGE) {
+        list_add_name(line, "usage");
+        line.push_back('[');
+        for (size_t i = 0; i < ARRAY_SIZE(key_usage_map); i++) {
+            if (!(key_usage_map[i].id & key.flags())) {
+                continue;
+            }
+            if (line.back() != '[') {
+                line.push_back(',');
+            }
+            list_add_str(line, key_usage_map[i].str);
+        }
+        line.push_back(']');
+    }
+    if ((fields & RNP_LIST_USERIDS) && key.is_primary()) {
+        list_add_name(line, "userids");
+        line.push_back('[');
+        for (size_t i = 0; i < key.uid_count(); i++) {
+            if (i) {
+                line.push_back(',');
+            }
+            list_add_str(line, key.get_uid(i).str);
+        }
+        line.push_back(']');
+    }
+    if ((fields & RNP_LIST_USERIDS_VALIDITY) && key.is_primary()) {
+        list_add_name(line, "userids validity");
+        line.push_back('[');
+        for (size_t i = 0; i < key.uid_count(); i++) {
+            if (i) {
+                line.push_back(',');
+            }
+            auto &uid = key.get_uid(i);
+            line.push_back('{');
+            list_add_bool(line, "valid", uid.valid);
+            list_add_bool(line, "revoked", uid.revoked);
+            line.push_back('}');
+        }
+        line.push_back(']');
+    }
+    if (fields & RNP_LIST_SECRET) {
+        list_add_bool(line, "public", pub != nullptr);
+        list_add_bool(line, "secret", sec != nullptr);
+    }
+    if (fields & RNP_LIST_PRIMARY) {
+        list_add_bool(line, "primary", key.is_primary());
+        if (key.is_subkey() && key.has_primary_fp()) {
+            auto &pfp = key.primary_fp();
+            list_add_hex(line, "primary fingerprint", pfp.fingerprint, pfp.length);
+        }
+    }
+    line.append("}\n");
+}
+
+rnp_result_t
+rnp_list_keys(
+  rnp_ffi_t ffi, const char *query, uint32_t flags, uint32_t fields, rnp_output_t output)
+try {
+    if (!ffi || !output) {
+        return RNP_ERROR_NULL_POINTER;
+    }
+    if (!fields || (fields & ~RNP_LIST_ALL)) {
+        FFI_LOG(ffi, "Invalid fields: %" PRIu32, fields);
+        return RNP_ERROR_BAD_PARAMETERS;
+    }
+    key_pairs_t  keys;
+    rnp_result_t ret = locate_keys(ffi, query ? query : "", flags, keys);
+    if (ret) {
+        return ret;
+    }
+    std::string line;
+    for (auto &key : keys) {
+        list_add_key(line, key.first, key.second, fields);
+        if (line.size() < PGP_OUTPUT_CACHE_SIZE) {
+            continue;
+        }
+        dst_write(&output->dst, line.data(), line.size());
+        line.clear();
+        if (output->dst.werr) {
+            return output->dst.werr;
+        }
+    }
+    dst_write(&output->dst, line.data(), line.size());
+    dst_flush(&output->dst);
+    output->keep = (output->dst.werr == RNP_SUCCESS);
+    return output->dst.werr;
+}
+FFI_GUARD
+
 static rnp_result_t
 rnp_dump_src_to_json(pgp_source_t *src, uint32_t flags, char **result)
 {
@@ -8835,6 +10600,9 @@ try {
     if (type == rnp::KeySearch::Type::Unknown) {
         return RNP_ERROR_BAD_PARAMETERS;
     }
+    // iterator walks over the keys list, so deferred keys must be parsed
+    ffi->pubring->load_deferred();
+    ffi->secring->load_deferred();
     *it = new rnp_identifier_iterator_st(ffi, type);
     // move to first item (if any)
     key_iter_first_item(*it);
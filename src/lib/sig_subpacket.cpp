@@ -38,6 +38,13 @@ namespace pkt {
 
 namespace sigsub {
 
+/* std::string keeps short values inline */
+static size_t
+string_heap_size(const std::string &str) noexcept
+{
+    return str.capacity() >= sizeof(str) ? str.capacity() + 1 : 0;
+}
+
 /* Raw unparsed subpacket */
 Raw::Raw(uint8_t rawtype, bool hashed, bool critical)
     : hashed_(hashed), raw_type_(rawtype), critical_(critical), type_(Type::Unknown)
@@ -208,12 +215,94 @@ Raw::create(const uint8_t *data, size_t size, bool hashed)
     return sub;
 }
 
+bool
+Raw::check(const uint8_t *data, size_t size)
+{
+    if (!size) {
+        RNP_LOG("got subpacket with 0 length");
+        return false;
+    }
+    bool    critical = data[0] & 0x80;
+    uint8_t type = data[0] & 0x7f;
+    auto    check_len = [type, size](const Raw &sub) {
+        if (!sub.check_size(size - 1)) {
+            RNP_LOG("wrong len %zu of subpacket type %" PRIu8, size - 1, type);
+            return false;
+        }
+        return true;
+    };
+
+    switch (type) {
+    case (uint8_t) Type::CreationTime:
+        return check_len(CreationTime());
+    case (uint8_t) Type::ExpirationTime:
+        return check_len(ExpirationTime());
+    case (uint8_t) Type::ExportableCert:
+        return check_len(ExportableCert());
+    case (uint8_t) Type::Trust:
+        return check_len(Trust());
+    case (uint8_t) Type::RegExp:
+        return check_len(RegExp());
+    case (uint8_t) Type::Revocable:
+        return check_len(Revocable());
+    case (uint8_t) Type::KeyExpirationTime:
+        return check_len(KeyExpirationTime());
+    case (uint8_t) Type::PreferredSymmetric:
+        return check_len(PreferredSymmetric());
+    case (uint8_t) Type::RevocationKey:
+        return check_len(RevocationKey());
+    case (uint8_t) Type::IssuerKeyID:
+        return check_len(IssuerKeyID());
+    case (uint8_t) Type::PreferredHash:
+        return check_len(PreferredHash());
+    case (uint8_t) Type::PreferredCompress:
+        return check_len(PreferredCompress());
+    case (uint8_t) Type::KeyserverPrefs:
+        return check_len(KeyserverPrefs());
+    case (uint8_t) Type::PreferredKeyserver:
+        return check_len(PreferredKeyserver());
+    case (uint8_t) Type::PrimaryUserID:
+        return check_len(PrimaryUserID());
+    case (uint8_t) Type::PolicyURI:
+        return check_len(PolicyURI());
+    case (uint8_t) Type::KeyFlags:
+        return check_len(KeyFlags());
+    case (uint8_t) Type::SignersUserID:
+        return check_len(SignersUserID());
+    case (uint8_t) Type::RevocationReason:
+        return check_len(RevocationReason());
+    case (uint8_t) Type::Features:
+        return check_len(Features());
+    case (uint8_t) Type::IssuerFingerprint:
+        return check_len(IssuerFingerprint());
+    case (uint8_t) Type::PreferredAEAD:
+        return check_len(PreferredAEAD());
+#if defined(ENABLE_CRYPTO_REFRESH)
+    case (uint8_t) Type::PreferredAEADv6:
+        return check_len(PreferredAEADv6());
+#endif
+    case (uint8_t) Type::NotationData:
+    case (uint8_t) Type::EmbeddedSignature:
+        /* contents of these must be parsed to be checked */
+        return create(data, size, false) != nullptr;
+    default:
+        report_unknown(type, critical);
+        return !critical;
+    }
+}
+
 RawPtr
 Raw::clone() const
 {
     return RawPtr(new Raw(*this));
 }
 
+size_t
+Raw::memory_usage() const noexcept
+{
+    return sizeof(*this) + data_.capacity();
+}
+
 /* Timestamp-based subpackets abstract parent */
 void
 Time::write_data()
@@ -235,6 +324,12 @@ Time::parse_data(const uint8_t *data, size_t size)
     return true;
 }
 
+size_t
+Time::memory_usage() const noexcept
+{
+    return sizeof(*this) + data_.capacity();
+}
+
 /* Creation time signature subpacket */
 RawPtr
 CreationTime::clone() const
@@ -277,6 +372,12 @@ Bool::parse_data(const uint8_t *data, size_t size)
     return true;
 }
 
+size_t
+Bool::memory_usage() const noexcept
+{
+    return sizeof(*this) + data_.capacity();
+}
+
 /* Exportable certification signature subpacket */
 RawPtr
 ExportableCert::clone() const
@@ -313,6 +414,12 @@ Trust::clone() const
     return RawPtr(new Trust(*this));
 }
 
+size_t
+Trust::memory_usage() const noexcept
+{
+    return sizeof(*this) + data_.capacity();
+}
+
 /* Base class for single string value subpackets */
 void
 String::write_data()
@@ -327,6 +434,12 @@ String::parse_data(const uint8_t *data, size_t size)
     return true;
 }
 
+size_t
+String::memory_usage() const noexcept
+{
+    return sizeof(*this) + data_.capacity() + string_heap_size(value_);
+}
+
 /* Regular expression signature subpacket */
 RawPtr
 RegExp::clone() const
@@ -362,6 +475,12 @@ Preferred::parse_data(const uint8_t *data, size_t size)
     return true;
 }
 
+size_t
+Preferred::memory_usage() const noexcept
+{
+    return sizeof(*this) + data_.capacity() + algs_.capacity();
+}
+
 /* Preferred symmetric algorithms */
 RawPtr
 PreferredSymmetric::clone() const
@@ -441,6 +560,12 @@ RevocationKey::clone() const
     return RawPtr(new RevocationKey(*this));
 }
 
+size_t
+RevocationKey::memory_usage() const noexcept
+{
+    return sizeof(*this) + data_.capacity();
+}
+
 /* Issuer Key ID signature subpacet */
 void
 IssuerKeyID::write_data()
@@ -467,6 +592,12 @@ IssuerKeyID::clone() const
     return RawPtr(new IssuerKeyID(*this));
 }
 
+size_t
+IssuerKeyID::memory_usage() const noexcept
+{
+    return sizeof(*this) + data_.capacity();
+}
+
 /* Notation data signature subpacket */
 void
 NotationData::write_data()
@@ -539,6 +670,13 @@ NotationData::clone() const
     return RawPtr(new NotationData(*this));
 }
 
+size_t
+NotationData::memory_usage() const noexcept
+{
+    return sizeof(*this) + data_.capacity() + string_heap_size(name_) +
+           value_.capacity();
+}
+
 /* Base class for bit flags subpackets */
 void
 Flags::write_data()
@@ -560,6 +698,12 @@ Flags::parse_data(const uint8_t *data, size_t size)
     return true;
 }
 
+size_t
+Flags::memory_usage() const noexcept
+{
+    return sizeof(*this) + data_.capacity();
+}
+
 /* Key server preferences signature subpacket */
 RawPtr
 KeyserverPrefs::clone() const
@@ -631,6 +775,12 @@ RevocationReason::clone() const
     return RawPtr(new RevocationReason(*this));
 }
 
+size_t
+RevocationReason::memory_usage() const noexcept
+{
+    return sizeof(*this) + data_.capacity() + string_heap_size(reason_);
+}
+
 /* Features signature subpacket */
 RawPtr
 Features::clone() const
@@ -705,6 +855,13 @@ EmbeddedSignature::clone() const
     return RawPtr(new EmbeddedSignature(*this));
 }
 
+size_t
+EmbeddedSignature::memory_usage() const noexcept
+{
+    size_t res = sizeof(*this) + data_.capacity();
+    return signature_ ? res + signature_->memory_usage() : res;
+}
+
 /* Issuer fingerprint signature subpacket */
 void
 IssuerFingerprint::write_data()
@@ -736,6 +893,12 @@ IssuerFingerprint::clone() const
     return RawPtr(new IssuerFingerprint(*this));
 }
 
+size_t
+IssuerFingerprint::memory_usage() const noexcept
+{
+    return sizeof(*this) + data_.capacity();
+}
+
 List::List(const List &src)
 {
     items.reserve(src.items.size());
@@ -165,7 +165,16 @@ class Raw {
 
     static RawPtr create(const uint8_t *data, size_t size, bool hashed);
 
+    /**
+     * @brief Check whether subpacket (including the type byte) may be parsed, without
+     *        creating the subpacket object for the commonly used subpacket types.
+     */
+    static bool check(const uint8_t *data, size_t size);
+
     virtual RawPtr clone() const;
+
+    /** @brief Approximate number of bytes occupied by the subpacket in memory */
+    virtual size_t memory_usage() const noexcept;
 };
 
 /* Base class for timestamp-based subpackets */
@@ -197,6 +206,7 @@ class Time : public Raw {
     }
 
     RawPtr clone() const override = 0;
+    size_t memory_usage() const noexcept override;
 };
 
 /* Creation time signature subpacket */
@@ -247,6 +257,7 @@ class Bool : public Raw {
     }
 
     RawPtr clone() const override = 0;
+    size_t memory_usage() const noexcept override;
 };
 
 /* Exportable certification signature subpacket */
@@ -318,6 +329,7 @@ class Trust : public Raw {
     }
 
     RawPtr clone() const override;
+    size_t memory_usage() const noexcept override;
 };
 
 /* Base class for single string value subpackets */
@@ -335,6 +347,7 @@ class String : public Raw {
     }
 
     RawPtr clone() const override = 0;
+    size_t memory_usage() const noexcept override;
 };
 
 /* Regular expression signature subpacket */
@@ -405,6 +418,7 @@ class Preferred : public Raw {
     }
 
     RawPtr clone() const override = 0;
+    size_t memory_usage() const noexcept override;
 };
 
 /* Preferred symmetric algorithms */
@@ -514,6 +528,7 @@ class RevocationKey : public Raw {
     }
 
     RawPtr clone() const override;
+    size_t memory_usage() const noexcept override;
 };
 
 /* Issuer Key ID signature subpacet */
@@ -546,6 +561,7 @@ class IssuerKeyID : public Raw {
     }
 
     RawPtr clone() const override;
+    size_t memory_usage() const noexcept override;
 };
 
 /* Notation data signature subpacket */
@@ -591,6 +607,7 @@ class NotationData : public Raw {
     void set_value(const std::vector<uint8_t> &value);
 
     RawPtr clone() const override;
+    size_t memory_usage() const noexcept override;
 };
 
 /* Base class for bit flags subpackets */
@@ -609,6 +626,7 @@ class Flags : public Raw {
     }
 
     RawPtr clone() const override = 0;
+    size_t memory_usage() const noexcept override;
 };
 
 /* Key server preferences signature subpacket */
@@ -805,6 +823,7 @@ class RevocationReason : public Raw {
     }
 
     RawPtr clone() const override;
+    size_t memory_usage() const noexcept override;
 };
 
 /* Features signature subpacket */
@@ -852,6 +871,7 @@ class EmbeddedSignature : public Raw {
     void set_signature(const pgp_signature_t &sig);
 
     RawPtr clone() const override;
+    size_t memory_usage() const noexcept override;
 };
 
 /* Issuer fingerprint signature subpacket */
@@ -898,6 +918,7 @@ class IssuerFingerprint : public Raw {
     }
 
     RawPtr clone() const override;
+    size_t memory_usage() const noexcept override;
 };
 
 class List {
@@ -908,7 +929,9 @@ class List {
     {
     }
     List(const List &src);
+    List(List &&src) = default;
     List &operator=(const List &src);
+    List &operator=(List &&src) = default;
 
     std::vector<RawPtr>::iterator
     begin()
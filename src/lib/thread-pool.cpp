@@ -0,0 +1,204 @@
+/*
+ * Copyright (c) 2025 [Ribose Inc](https://www.ribose.com).
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1.  Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ * 2.  Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "thread-pool.hpp"
+#include "logging.h"
+#include <algorithm>
+#include <memory>
+
+namespace rnp {
+
+ThreadPool::ThreadPool(size_t threads, size_t max_queue)
+    : max_threads_(threads), max_queue_(max_queue)
+{
+    if (!max_threads_) {
+        max_threads_ = std::max(std::thread::hardware_concurrency(), 1U);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        stop_ = true;
+        cond_.notify_all();
+    }
+    for (auto &thread : threads_) {
+        thread.join();
+    }
+}
+
+void
+ThreadPool::worker()
+{
+    std::unique_lock<std::mutex> lock(lock_);
+    while (true) {
+        /* front task may be started only if it doesn't conflict with the running ones */
+        cond_.wait(lock, [this]() {
+            if (tasks_.empty()) {
+                return stop_;
+            }
+            return !exclusive_ && (!tasks_.front().exclusive || !active_);
+        });
+        if (tasks_.empty()) {
+            return;
+        }
+        Task task = std::move(tasks_.front());
+        tasks_.pop_front();
+        active_++;
+        exclusive_ = task.exclusive;
+        lock.unlock();
+        try {
+            task.func();
+        } catch (const std::exception &e) {
+            RNP_LOG("Task failed: %s", e.what()); // LCOV_EXCL_LINE
+        }
+        lock.lock();
+        active_--;
+        exclusive_ = false;
+        completed_++;
+        cond_.notify_all();
+    }
+}
+
+bool
+ThreadPool::push(std::function<void()> func, bool exclusive)
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    if (stop_ || (max_queue_ && (tasks_.size() >= max_queue_))) {
+        return false;
+    }
+    tasks_.push_back({std::move(func), exclusive});
+    /* start one more thread if all of the existing are busy */
+    if ((threads_.size() < max_threads_) && (threads_.size() < active_ + tasks_.size())) {
+        try {
+            threads_.emplace_back(&ThreadPool::worker, this);
+        } catch (const std::exception &e) {
+            /* LCOV_EXCL_START */
+            RNP_LOG("Failed to start thread: %s", e.what());
+            if (threads_.empty()) {
+                tasks_.pop_back();
+                return false;
+            }
+            /* LCOV_EXCL_END */
+        }
+    }
+    cond_.notify_one();
+    return true;
+}
+
+void
+ThreadPool::run_parallel(size_t threads, const std::function<void()> &func)
+{
+    struct State {
+        std::mutex              lock;
+        std::condition_variable cond;
+        size_t                  running{};
+        bool                    closed{};
+    };
+    auto state = std::make_shared<State>();
+    /* helper doesn't touch func once state is closed, so reference capture is safe */
+    auto helper = [state, &func]() {
+        {
+            std::lock_guard<std::mutex> lock(state->lock);
+            if (state->closed) {
+                return;
+            }
+            state->running++;
+        }
+        try {
+            func();
+        } catch (const std::exception &e) {
+            RNP_LOG("Parallel task failed: %s", e.what()); // LCOV_EXCL_LINE
+        }
+        std::lock_guard<std::mutex> lock(state->lock);
+        state->running--;
+        state->cond.notify_all();
+    };
+    if (!threads) {
+        threads = max_threads_;
+    }
+    for (size_t i = 1; i < threads; i++) {
+        if (!push(helper)) {
+            break;
+        }
+    }
+    auto wait = [&state]() {
+        std::unique_lock<std::mutex> lock(state->lock);
+        state->closed = true;
+        state->cond.wait(lock, [&state]() { return !state->running; });
+    };
+    try {
+        func();
+    } catch (...) {
+        wait();
+        throw;
+    }
+    wait();
+}
+
+ThreadPool &
+ThreadPool::shared()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+size_t
+ThreadPool::max_threads() const noexcept
+{
+    return max_threads_;
+}
+
+size_t
+ThreadPool::max_queue() const noexcept
+{
+    return max_queue_;
+}
+
+size_t
+ThreadPool::queued()
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    return tasks_.size();
+}
+
+size_t
+ThreadPool::active()
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    return active_;
+}
+
+size_t
+ThreadPool::completed()
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    return completed_;
+}
+
+} // namespace rnp
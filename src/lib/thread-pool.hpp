@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2025 [Ribose Inc](https://www.ribose.com).
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1.  Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ * 2.  Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef RNP_THREAD_POOL_HPP_
+#define RNP_THREAD_POOL_HPP_
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace rnp {
+
+/* Pool of worker threads, executing the queued tasks in FIFO order. Threads are started
+ * lazily, up to the limit. Exclusive task is executed only when no other tasks are running,
+ * and blocks others until it is done. */
+class ThreadPool {
+  private:
+    struct Task {
+        std::function<void()> func;
+        bool                  exclusive;
+    };
+
+    std::mutex               lock_;
+    std::condition_variable  cond_;
+    std::deque<Task>         tasks_;
+    std::vector<std::thread> threads_;
+    size_t                   max_threads_;
+    size_t                   max_queue_;
+    size_t                   active_{};
+    size_t                   completed_{};
+    bool                     exclusive_{};
+    bool                     stop_{};
+
+    void worker();
+
+  public:
+    /* threads: maximum number of worker threads, 0 to use the number of CPUs.
+     * max_queue: maximum number of queued tasks, 0 for unlimited. */
+    ThreadPool(size_t threads = 0, size_t max_queue = 0);
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool(ThreadPool &&) = delete;
+    /* waits for all of the queued tasks to finish */
+    ~ThreadPool();
+
+    /* queue the task, returns false if queue is full */
+    bool push(std::function<void()> func, bool exclusive = false);
+
+    /* Run func on the calling thread and on up to (threads - 1) pool threads at once, and
+     * wait for the started calls. Calls not started by the time the calling thread's one
+     * returns are dropped, so func should take the work items from a shared counter. This
+     * also makes the nested use of the same pool safe. 0 threads means the pool's limit. */
+    void run_parallel(size_t threads, const std::function<void()> &func);
+
+    /* process-wide pool for the CPU-bound library work, with thread per CPU */
+    static ThreadPool &shared();
+
+    size_t max_threads() const noexcept;
+    size_t max_queue() const noexcept;
+    /* number of tasks, waiting for execution */
+    size_t queued();
+    /* number of tasks, being executed at the moment */
+    size_t active();
+    /* number of executed tasks since the pool creation */
+    size_t completed();
+};
+
+} // namespace rnp
+
+#endif
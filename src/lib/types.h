@@ -165,6 +165,17 @@ typedef struct pgp_validity_t {
     void reset();
 } pgp_validity_t;
 
+/** Approximate memory usage of the keys, accumulated by pgp_key_t::memory_usage() */
+typedef struct pgp_key_memory_t {
+    size_t keys{};       /* number of keys */
+    size_t signatures{}; /* number of signatures */
+    size_t userids{};    /* number of userids */
+    size_t key_bytes{};  /* key packets, including key material and raw packets */
+    size_t sig_bytes{};  /* signatures, including raw packets */
+    size_t uid_bytes{};  /* userids, including raw packets */
+    size_t total{};      /* all of the above plus containers overhead */
+} pgp_key_memory_t;
+
 /**
  * Type to keep signature without any openpgp-dependent data.
  */
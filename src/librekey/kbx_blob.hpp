@@ -148,11 +148,21 @@ class kbx_pgp_blob_t : public kbx_blob_t {
     {
         return keys_.size();
     }
+    const std::vector<kbx_pgp_key_t> &
+    keys() const
+    {
+        return keys_;
+    }
     size_t
     nuids()
     {
         return uids_.size();
     }
+    const std::vector<kbx_pgp_uid_t> &
+    uids() const
+    {
+        return uids_;
+    }
     size_t
     nsigs()
     {
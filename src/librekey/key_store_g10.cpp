@@ -30,6 +30,9 @@
 #include <stdlib.h>
 #include <limits.h>
 #include <time.h>
+#include <errno.h>
+#include <atomic>
+#include <algorithm>
 #include "config.h"
 
 #include <librepgp/stream-packet.h>
@@ -40,6 +43,8 @@
 #include "crypto/cipher.hpp"
 #include "pgp-key.h"
 #include "time-utils.h"
+#include "file-utils.h"
+#include "thread-pool.hpp"
 
 #include "g23_sexp.hpp"
 using namespace ext_key_format;
@@ -53,6 +58,9 @@ using namespace sexp;
 
 #define G10_PROTECTED_AT_SIZE 15
 
+/* number of key files per loading thread, read to the memory at once */
+#define G10_LOAD_BATCH 16
+
 typedef struct format_info {
     pgp_symm_alg_t    cipher;
     pgp_cipher_mode_t cipher_mode;
@@ -928,6 +936,39 @@ copy_secret_fields(pgp_key_pkt_t &dst, const pgp_key_pkt_t &src)
 }
 
 namespace rnp {
+bool
+KeyStore::add_g10_key(pgp_key_pkt_t &    seckey,
+                      const uint8_t *    data,
+                      size_t             size,
+                      const KeyProvider *key_provider)
+{
+    /* copy public key fields if any */
+    pgp_key_t key;
+    if (key_provider) {
+        pgp_key_grip_t grip = seckey.material->grip();
+        auto           pubkey =
+          key_provider->request_key(*rnp::KeySearch::create(grip), PGP_OP_MERGE_INFO);
+        if (!pubkey) {
+            return false;
+        }
+
+        /* public key packet has some more info then the secret part */
+        key = pgp_key_t(*pubkey, true);
+        if (!copy_secret_fields(key.pkt(), seckey)) {
+            return false;
+        }
+    } else {
+        key.set_pkt(std::move(seckey));
+    }
+    /* set rawpkt */
+    key.set_rawpkt(pgp_rawpacket_t(data, size, PGP_PKT_RESERVED));
+    key.format = PGP_KEY_STORE_G10;
+    if (!add_key(std::move(key))) {
+        return false;
+    }
+    return true;
+}
+
 bool
 KeyStore::load_g10(pgp_source_t &src, const KeyProvider *key_provider)
 {
@@ -939,39 +980,197 @@ KeyStore::load_g10(pgp_source_t &src, const KeyProvider *key_provider)
         if (!g23_parse_seckey(seckey, (uint8_t *) memsrc.memory(), memsrc.size(), NULL)) {
             return false;
         }
-        /* copy public key fields if any */
-        pgp_key_t key;
-        if (key_provider) {
-            pgp_key_grip_t grip = seckey.material->grip();
-            auto           pubkey =
-              key_provider->request_key(*rnp::KeySearch::create(grip), PGP_OP_MERGE_INFO);
-            if (!pubkey) {
-                return false;
-            }
+        return add_g10_key(seckey, (uint8_t *) memsrc.memory(), memsrc.size(), key_provider);
+    } catch (const std::exception &e) {
+        /* LCOV_EXCL_START */
+        RNP_LOG("%s", e.what());
+        return false;
+        /* LCOV_EXCL_END */
+    }
+}
 
-            /* public key packet has some more info then the secret part */
-            key = pgp_key_t(*pubkey, true);
-            if (!copy_secret_fields(key.pkt(), seckey)) {
-                return false;
-            }
-        } else {
-            key.set_pkt(std::move(seckey));
+namespace {
+struct g10_file_t {
+    std::unique_ptr<MemorySource> data;
+    pgp_key_pkt_t                 seckey;
+    bool                          parsed{};
+};
+
+void
+g10_parse_file(const std::string &path, g10_file_t &file)
+{
+    try {
+        pgp_source_t src = {};
+        if (init_file_src(&src, path.c_str())) {
+            RNP_LOG("failed to read file %s", path.c_str());
+            return;
         }
-        /* set rawpkt */
-        key.set_rawpkt(
-          pgp_rawpacket_t((uint8_t *) memsrc.memory(), memsrc.size(), PGP_PKT_RESERVED));
-        key.format = PGP_KEY_STORE_G10;
-        if (!add_key(key)) {
-            return false;
+        try {
+            file.data.reset(new MemorySource(src));
+        } catch (...) {
+            /* LCOV_EXCL_START */
+            src.close();
+            throw;
+            /* LCOV_EXCL_END */
         }
-        return true;
+        src.close();
+        file.parsed = g23_parse_seckey(
+          file.seckey, (uint8_t *) file.data->memory(), file.data->size(), NULL);
     } catch (const std::exception &e) {
         /* LCOV_EXCL_START */
         RNP_LOG("%s", e.what());
-        return false;
+        file.parsed = false;
         /* LCOV_EXCL_END */
     }
 }
+
+/* GnuPG stores secret keys in files named <keygrip>.key */
+bool
+g10_name_to_grip(const std::string &name, pgp_key_grip_t &grip)
+{
+    static const std::string ext = ".key";
+    size_t                   hexlen = grip.size() * 2;
+    if ((name.size() != hexlen + ext.size()) || name.compare(hexlen, ext.size(), ext)) {
+        return false;
+    }
+    std::string hex = name.substr(0, hexlen);
+    return rnp::hex_decode(hex.c_str(), grip.data(), grip.size()) == grip.size();
+}
+} // namespace
+
+const KeyProvider *
+KeyStore::g10_provider() const
+{
+    return g10_provider_.callback ? &g10_provider_ : nullptr;
+}
+
+bool
+KeyStore::load_g10_files(const std::vector<std::string> &paths,
+                         const KeyProvider *             key_provider)
+{
+    bool loading = g10_loading_;
+    g10_loading_ = true;
+    bool res = true;
+    /* files are read in batches, so only a few of them are kept in memory at once */
+    size_t batch = std::max<size_t>(g10_threads, 1) * G10_LOAD_BATCH;
+    for (size_t start = 0; start < paths.size(); start += batch) {
+        /* key files are independent, so may be read and parsed in parallel */
+        std::vector<g10_file_t> files(std::min(batch, paths.size() - start));
+        std::atomic<size_t>     next(0);
+        auto                    worker = [&]() {
+            size_t idx;
+            while ((idx = next++) < files.size()) {
+                g10_parse_file(paths[start + idx], files[idx]);
+            }
+        };
+        rnp::ThreadPool::shared().run_parallel(std::min(g10_threads, files.size()), worker);
+
+        /* adding keys to the store must be done sequentially and in the directory order */
+        for (size_t idx = 0; idx < files.size(); idx++) {
+            auto &file = files[idx];
+            // G10 may fail to read one file, so ignore it!
+            try {
+                if (file.parsed &&
+                    add_g10_key(file.seckey,
+                                (uint8_t *) file.data->memory(),
+                                file.data->size(),
+                                key_provider)) {
+                    continue;
+                }
+            } catch (const std::exception &e) {
+                /* LCOV_EXCL_START */
+                RNP_LOG("%s", e.what());
+                /* LCOV_EXCL_END */
+            }
+            RNP_LOG("Can't parse file: %s", paths[start + idx].c_str()); // TODO: %S ?
+            res = false;
+        }
+    }
+    g10_loading_ = loading;
+    return res;
+}
+
+bool
+KeyStore::load_g10_dir(const KeyProvider *key_provider)
+{
+    auto dir = rnp_opendir(path.c_str());
+    if (!dir) {
+        RNP_LOG("Can't open G10 directory %s: %s", path.c_str(), strerror(errno));
+        return false;
+    }
+
+    std::vector<std::string> paths;
+    std::string              dirname;
+    while (!((dirname = rnp_readdir_name(dir)).empty())) {
+        std::string    apath = rnp::path::append(path, dirname);
+        pgp_key_grip_t grip = {};
+        if (defer_g10 && g10_name_to_grip(dirname, grip)) {
+            g10_deferred_[grip] = apath;
+            continue;
+        }
+        paths.push_back(apath);
+    }
+    rnp_closedir(dir);
+    if (!g10_deferred_.empty()) {
+        g10_provider_ = key_provider ? *key_provider : KeyProvider();
+    }
+    load_g10_files(paths, key_provider);
+    return true;
+}
+
+bool
+KeyStore::g10_load_deferred(const pgp_key_grip_t &grip)
+{
+    if (g10_loading_) {
+        return false;
+    }
+    auto it = g10_deferred_.find(grip);
+    if (it == g10_deferred_.end()) {
+        return false;
+    }
+    std::vector<std::string> paths = {it->second};
+    g10_deferred_.erase(it);
+    return load_g10_files(paths, g10_provider());
+}
+
+bool
+KeyStore::g10_load_deferred(const KeySearch &search)
+{
+    if (g10_deferred_.empty() || g10_loading_) {
+        return false;
+    }
+    if (search.type() == KeySearch::Type::Grip) {
+        return g10_load_deferred(dynamic_cast<const KeyGripSearch &>(search).get_grip());
+    }
+    if (!g10_provider_.callback) {
+        /* there is no way to get keygrip without the public key */
+        return load_deferred();
+    }
+    /* provider may search this key store as well */
+    g10_loading_ = true;
+    pgp_key_t *pubkey = g10_provider_.request_key(search, PGP_OP_MERGE_INFO);
+    g10_loading_ = false;
+    if (!pubkey) {
+        return false;
+    }
+    return g10_load_deferred(pubkey->grip());
+}
+
+bool
+KeyStore::g10_load_all_deferred()
+{
+    if (g10_deferred_.empty()) {
+        return true;
+    }
+    std::vector<std::string> paths;
+    for (auto &it : g10_deferred_) {
+        paths.push_back(it.second);
+    }
+    g10_deferred_.clear();
+    // G10 may fail to read one file, so ignore it!
+    load_g10_files(paths, g10_provider());
+    return true;
+}
 } // namespace rnp
 
 /*
@@ -34,9 +34,13 @@
 #include <stdint.h>
 #include <time.h>
 #include <inttypes.h>
+#include <errno.h>
+#include <sys/stat.h>
 #include <cassert>
 
 #include "pgp-key.h"
+#include "file-utils.h"
+#include "fingerprint.h"
 #include <librepgp/stream-sig.h>
 
 /* same limit with GnuPG 2.1 */
@@ -50,6 +54,8 @@
 #define BLOB_UID_SIZE 0x0C
 #define BLOB_SIG_SIZE 0x04
 #define BLOB_VALIDITY_SIZE 0x10
+/* Rewrite the whole KBX file once empty blobs take more than this percent of it */
+#define KBX_COMPACT_RATIO 50
 
 uint8_t
 kbx_blob_t::ru8(size_t idx)
@@ -381,6 +387,25 @@ kbx_parse_blob(const uint8_t *image, size_t image_len)
 }
 } // namespace
 
+pgp_key_t *
+KeyStore::kbx_blob_primary(kbx_pgp_blob_t &blob, pgp_fingerprint_t &fp)
+{
+    memcpy(fp.fingerprint, blob.keys()[0].fp, PGP_FINGERPRINT_V4_SIZE);
+    fp.length = PGP_FINGERPRINT_V4_SIZE;
+    auto key = get_key(fp);
+    if (key) {
+        return key;
+    }
+    /* blob keeps only 20 bytes of the v5/v6 fingerprint, so calculate it from the keyblock */
+    auto          data = blob.image().data() + blob.keyblock_offset();
+    MemorySource  src(data, blob.keyblock_length(), false);
+    pgp_key_pkt_t pkt;
+    if (pkt.parse(src.src()) || pgp_fingerprint(fp, pkt)) {
+        return nullptr;
+    }
+    return get_key(fp);
+}
+
 bool
 KeyStore::load_kbx(pgp_source_t &src, const KeyProvider *key_provider)
 {
@@ -388,6 +413,9 @@ KeyStore::load_kbx(pgp_source_t &src, const KeyProvider *key_provider)
         MemorySource mem(src);
         size_t       has_bytes = mem.size();
         uint8_t *    buf = (uint8_t *) mem.memory();
+        /* blob locations are tracked only when whole keystore is loaded from the KBX */
+        bool refs = keys.empty() && !defer_kbx;
+        kbx_reset_refs();
 
         if (has_bytes < BLOB_FIRST_SIZE) {
             RNP_LOG("Too few bytes for valid KBX");
@@ -418,6 +446,9 @@ KeyStore::load_kbx(pgp_source_t &src, const KeyProvider *key_provider)
             }
             kbx_blob_t *pblob = blob.get();
             blobs.push_back(std::move(blob));
+            if (refs && (pblob->type() == KBX_EMPTY_BLOB)) {
+                kbx_wasted_ += blob_length;
+            }
 
             if (pblob->type() == KBX_PGP_BLOB) {
                 // parse keyblock if it existed
@@ -426,6 +457,12 @@ KeyStore::load_kbx(pgp_source_t &src, const KeyProvider *key_provider)
                     RNP_LOG("PGP blob have zero size");
                     return false;
                 }
+                if (defer_kbx) {
+                    kbx_defer_blob(blobs.size() - 1, buf - (uint8_t *) mem.memory());
+                    has_bytes -= blob_length;
+                    buf += blob_length;
+                    continue;
+                }
 
                 MemorySource blsrc(pgp_blob.image().data() + pgp_blob.keyblock_offset(),
                                    pgp_blob.keyblock_length(),
@@ -433,6 +470,22 @@ KeyStore::load_kbx(pgp_source_t &src, const KeyProvider *key_provider)
                 if (load_pgp(blsrc.src())) {
                     return false;
                 }
+                /* remember where primary key and its subkeys are stored */
+                pgp_fingerprint_t fp = {};
+                pgp_key_t *       key = refs ? kbx_blob_primary(pgp_blob, fp) : nullptr;
+                if (refs && key && key->is_primary()) {
+                    size_t offset = buf - (uint8_t *) mem.memory();
+                    auto   ref = key_ref(*key, offset, blob_length);
+                    auto   it = kbx_refs_.find(fp);
+                    if (it != kbx_refs_.end()) {
+                        /* key is split between blobs: leave just one with merged key */
+                        kbx_orphans_.push_back(std::move(it->second));
+                        ref.revisions[0] = 0;
+                        it->second = std::move(ref);
+                    } else {
+                        kbx_refs_.emplace(fp, std::move(ref));
+                    }
+                }
             }
 
             has_bytes -= blob_length;
@@ -441,6 +494,9 @@ KeyStore::load_kbx(pgp_source_t &src, const KeyProvider *key_provider)
         if (has_bytes) {
             RNP_LOG("KBX source has excess trailing bytes");
         }
+        if (refs) {
+            kbx_size_ = mem.size();
+        }
         return true;
     } catch (const std::exception &e) {
         /* LCOV_EXCL_START */
@@ -450,6 +506,148 @@ KeyStore::load_kbx(pgp_source_t &src, const KeyProvider *key_provider)
     }
 }
 
+void
+KeyStore::kbx_defer_blob(size_t idx, size_t offset)
+{
+    auto &blob = dynamic_cast<kbx_pgp_blob_t &>(*blobs[idx]);
+    if (kbx_deferred_.size() <= idx) {
+        kbx_deferred_.resize(idx + 1);
+    }
+    kbx_deferred_[idx] = true;
+
+    for (auto &bkey : blob.keys()) {
+        pgp_fingerprint_t fp = {};
+        memcpy(fp.fingerprint, bkey.fp, PGP_FINGERPRINT_V4_SIZE);
+        fp.length = PGP_FINGERPRINT_V4_SIZE;
+        kbx_deferred_fps_.emplace(fp, idx);
+        /* key version is not known here, so index both V4 and V5/V6 keyids */
+        pgp_key_id_t keyid = {};
+        size_t       idpos = PGP_FINGERPRINT_V4_SIZE - keyid.size();
+        memcpy(keyid.data(), fp.fingerprint + idpos, keyid.size());
+        kbx_deferred_ids_.emplace(keyid, idx);
+        memcpy(keyid.data(), fp.fingerprint, keyid.size());
+        kbx_deferred_ids_.emplace(keyid, idx);
+    }
+
+    /* GnuPG stores uid offset relative to the blob, while RNP uses offset in the file */
+    auto &image = blob.image();
+    for (auto &uid : blob.uids()) {
+        size_t offsets[2] = {uid.offset, uid.offset - offset};
+        for (size_t i = 0; i < 2; i++) {
+            if ((i && (uid.offset < offset)) || (offsets[i] > image.size()) ||
+                (uid.length > image.size() - offsets[i])) {
+                continue;
+            }
+            kbx_deferred_uids_.emplace(
+              std::string((const char *) image.data() + offsets[i], uid.length), idx);
+        }
+    }
+}
+
+bool
+KeyStore::kbx_load_deferred(size_t idx)
+{
+    if ((idx >= kbx_deferred_.size()) || !kbx_deferred_[idx]) {
+        return false;
+    }
+    kbx_deferred_[idx] = false;
+
+    auto &       blob = dynamic_cast<kbx_pgp_blob_t &>(*blobs[idx]);
+    MemorySource blsrc(
+      blob.image().data() + blob.keyblock_offset(), blob.keyblock_length(), false);
+    if (load_pgp(blsrc.src())) {
+        RNP_LOG("Failed to load deferred KBX keyblock");
+        return false;
+    }
+    return true;
+}
+
+bool
+KeyStore::kbx_load_deferred(const pgp_fingerprint_t &fp)
+{
+    if (kbx_deferred_fps_.empty()) {
+        return false;
+    }
+    if (fp.length != PGP_FINGERPRINT_V4_SIZE) {
+        /* only first 20 bytes of the longer fingerprint are stored in the blob */
+        return load_deferred() && get_key(fp);
+    }
+    /* key may be split between the blobs */
+    std::vector<size_t> idxs;
+    auto                range = kbx_deferred_fps_.equal_range(fp);
+    for (auto it = range.first; it != range.second; it++) {
+        idxs.push_back(it->second);
+    }
+    bool loaded = false;
+    for (auto idx : idxs) {
+        loaded = kbx_load_deferred(idx) || loaded;
+    }
+    return loaded;
+}
+
+bool
+KeyStore::kbx_load_deferred(const KeySearch &search)
+{
+    if (kbx_deferred_fps_.empty()) {
+        return false;
+    }
+    std::vector<size_t> idxs;
+    switch (search.type()) {
+    case KeySearch::Type::Fingerprint:
+        return kbx_load_deferred(
+          dynamic_cast<const KeyFingerprintSearch &>(search).get_fp());
+    case KeySearch::Type::KeyID: {
+        auto &idsearch = dynamic_cast<const KeyIDSearch &>(search);
+        if (idsearch.hidden()) {
+            return load_deferred();
+        }
+        auto range = kbx_deferred_ids_.equal_range(idsearch.get_keyid());
+        for (auto it = range.first; it != range.second; it++) {
+            idxs.push_back(it->second);
+        }
+        break;
+    }
+    case KeySearch::Type::UserID: {
+        auto range = kbx_deferred_uids_.equal_range(search.value());
+        for (auto it = range.first; it != range.second; it++) {
+            idxs.push_back(it->second);
+        }
+        break;
+    }
+    default:
+        /* keygrip is not stored in the blob */
+        return load_deferred();
+    }
+    /* loading of keyblock may modify index, so do not iterate over it */
+    bool loaded = false;
+    for (auto idx : idxs) {
+        loaded = kbx_load_deferred(idx) || loaded;
+    }
+    return loaded;
+}
+
+void
+KeyStore::kbx_reset_deferred()
+{
+    kbx_deferred_fps_.clear();
+    kbx_deferred_ids_.clear();
+    kbx_deferred_uids_.clear();
+    kbx_deferred_.clear();
+}
+
+bool
+KeyStore::load_deferred()
+{
+    bool res = true;
+    for (size_t idx = 0; idx < kbx_deferred_.size(); idx++) {
+        if (kbx_deferred_[idx] && !kbx_load_deferred(idx)) {
+            res = false;
+        }
+    }
+    kbx_reset_deferred();
+    return g10_load_all_deferred() && res;
+}
+
 namespace {
 bool
 pbuf(pgp_dest_t &dst, const void *buf, size_t len)
@@ -500,11 +698,10 @@ kbx_write_header(const KeyStore &key_store, pgp_dest_t &dst)
              !pu32(dst, 0)); // RFU
 }
 
+/* Build PGP blob for the key, assuming that it will be placed at the offset in the file. */
 bool
-kbx_write_pgp(const KeyStore &key_store, const pgp_key_t &key, pgp_dest_t &dst)
+kbx_build_pgp(const KeyStore &key_store, const pgp_key_t &key, size_t offset, MemoryDest &mem)
 {
-    MemoryDest mem(NULL, BLOB_SIZE_LIMIT);
-
     if (!pu32(mem.dst(), 0)) { // length, we don't know length of blob yet, so it's 0
         return false;
     }
@@ -617,7 +814,7 @@ kbx_write_pgp(const KeyStore &key_store, const pgp_key_t &key, pgp_dest_t &dst)
         const pgp_userid_t &uid = key.get_uid(i);
         uint8_t *           p = (uint8_t *) mem.memory() + uid_start + (12 * i);
         /* store absolute uid offset in the output stream */
-        uint32_t pt = mem.writeb() + dst.writeb;
+        uint32_t pt = mem.writeb() + offset;
         write_uint32(p, pt);
         /* and uid length */
         pt = uid.str.size();
@@ -667,10 +864,17 @@ kbx_write_pgp(const KeyStore &key_store, const pgp_key_t &key, pgp_dest_t &dst)
     assert(hash->size() == sizeof(checksum));
     hash->finish(checksum);
 
-    if (!(pbuf(mem.dst(), checksum, PGP_SHA1_HASH_SIZE))) {
+    return pbuf(mem.dst(), checksum, PGP_SHA1_HASH_SIZE);
+}
+
+bool
+kbx_write_pgp(const KeyStore &key_store, const pgp_key_t &key, pgp_dest_t &dst)
+{
+    MemoryDest mem(NULL, BLOB_SIZE_LIMIT);
+    /* cached bytes are not counted in writeb */
+    if (!kbx_build_pgp(key_store, key, dst.writeb + dst.clen, mem)) {
         return false;
     }
-
     /* finally write to the output */
     dst_write(&dst, mem.memory(), mem.writeb());
     return !dst.werr;
@@ -693,8 +897,17 @@ kbx_write_x509(const KeyStore &key_store, pgp_dest_t &dst)
 
 bool
 KeyStore::write_kbx(pgp_dest_t &dst)
+{
+    return write_kbx(dst, false);
+}
+
+bool
+KeyStore::write_kbx(pgp_dest_t &dst, bool refs)
 {
     try {
+        if (refs) {
+            kbx_reset_refs();
+        }
         if (!kbx_write_header(*this, dst)) {
             RNP_LOG("Can't write KBX header");
             return false;
@@ -704,16 +917,24 @@ KeyStore::write_kbx(pgp_dest_t &dst)
             if (!key.is_primary()) {
                 continue;
             }
+            size_t offset = dst.writeb + dst.clen;
             if (!kbx_write_pgp(*this, key, dst)) {
                 RNP_LOG("Can't write PGP blobs for key %p", &key);
                 return false;
             }
+            if (refs) {
+                size_t length = dst.writeb + dst.clen - offset;
+                kbx_refs_.emplace(key.fp(), key_ref(key, offset, length));
+            }
         }
 
         if (!kbx_write_x509(*this, dst)) {
             RNP_LOG("Can't write X509 blobs");
             return false;
         }
+        if (refs) {
+            kbx_size_ = dst.writeb + dst.clen;
+        }
         return true;
     } catch (const std::exception &e) {
         /* LCOV_EXCL_START */
@@ -722,4 +943,144 @@ KeyStore::write_kbx(pgp_dest_t &dst)
         /* LCOV_EXCL_END */
     }
 }
+
+void
+KeyStore::kbx_reset_refs()
+{
+    kbx_refs_.clear();
+    kbx_orphans_.clear();
+    kbx_path_.clear();
+    kbx_size_ = 0;
+    kbx_wasted_ = 0;
+}
+
+namespace {
+bool
+kbx_file_write(FILE *fp, size_t offset, const void *buf, size_t len)
+{
+#ifdef _WIN32
+    int res = _fseeki64(fp, offset, SEEK_SET);
+#else
+    int res = fseeko(fp, offset, SEEK_SET);
+#endif
+    if (res) {
+        RNP_LOG("Failed to seek KBX file to %zu: %s", offset, strerror(errno));
+        return false;
+    }
+    if (fwrite(buf, 1, len, fp) != len) {
+        RNP_LOG("Failed to write %zu bytes to KBX file: %s", len, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+bool
+kbx_file_free(FILE *fp, size_t offset)
+{
+    /* GnuPG skips empty blobs as well, so this works as a deletion */
+    uint8_t type = KBX_EMPTY_BLOB;
+    return kbx_file_write(fp, offset + 4, &type, 1);
+}
+} // namespace
+
+bool
+KeyStore::update_kbx()
+{
+    if (kbx_path_.empty() || (kbx_path_ != path)) {
+        return false;
+    }
+    /* make sure that file was not changed by someone else */
+    struct stat st = {};
+    if (rnp_stat(path.c_str(), &st) || ((size_t) st.st_size != kbx_size_)) {
+        RNP_LOG("KBX file %s was changed, rewriting it.", path.c_str());
+        return false;
+    }
+    FILE *fp = rnp_fopen(path.c_str(), "r+b");
+    if (!fp) {
+        RNP_LOG("Failed to open %s: %s", path.c_str(), strerror(errno));
+        return false;
+    }
+
+    /* Existing blobs are never overwritten: new versions are appended and synced first, and
+     * only then old ones are marked as empty via the single byte write. So crash may leave
+     * both versions of the key, which are merged on load, but not a half-written blob in the
+     * middle of the file. */
+    bool                    res = false;
+    std::vector<KeyBlobRef> freed;
+    try {
+        for (auto &key : keys) {
+            if (!key.is_primary()) {
+                continue;
+            }
+            auto it = kbx_refs_.find(key.fp());
+            if ((it != kbx_refs_.end()) && !key_ref_changed(key, it->second)) {
+                continue;
+            }
+            MemoryDest mem(NULL, BLOB_SIZE_LIMIT);
+            if (!kbx_build_pgp(*this, key, kbx_size_, mem) ||
+                !kbx_file_write(fp, kbx_size_, mem.memory(), mem.writeb())) {
+                RNP_LOG_KEY("Can't append PGP blob for key %s", &key);
+                goto done;
+            }
+            if (it != kbx_refs_.end()) {
+                freed.push_back(std::move(it->second));
+            }
+            kbx_refs_[key.fp()] = key_ref(key, kbx_size_, mem.writeb());
+            kbx_size_ += mem.writeb();
+        }
+        /* blobs of the removed keys */
+        for (auto it = kbx_refs_.begin(); it != kbx_refs_.end();) {
+            auto key = get_key(it->first);
+            if (key && key->is_primary()) {
+                it++;
+                continue;
+            }
+            freed.push_back(std::move(it->second));
+            it = kbx_refs_.erase(it);
+        }
+        for (auto &orphan : kbx_orphans_) {
+            freed.push_back(std::move(orphan));
+        }
+        kbx_orphans_.clear();
+
+        if (rnp_fsync(fp)) {
+            RNP_LOG("Failed to sync %s: %s", path.c_str(), strerror(errno));
+            goto done;
+        }
+        for (auto &ref : freed) {
+            if (!kbx_file_free(fp, ref.offset)) {
+                goto done;
+            }
+            kbx_wasted_ += ref.length;
+        }
+        if (!freed.empty() && rnp_fsync(fp)) {
+            RNP_LOG("Failed to sync %s: %s", path.c_str(), strerror(errno));
+            goto done;
+        }
+        res = true;
+    } catch (const std::exception &e) {
+        /* LCOV_EXCL_START */
+        RNP_LOG("Failed to update KBX store: %s", e.what());
+        /* LCOV_EXCL_END */
+    }
+done:
+    if (fclose(fp)) {
+        RNP_LOG("Failed to close %s: %s", path.c_str(), strerror(errno));
+        res = false;
+    }
+    if (!res) {
+        /* file contents are unknown now, so full rewrite is needed */
+        kbx_reset_refs();
+        return false;
+    }
+    /* full rewrite drops the empty blobs, so do it once they take too much space */
+    if (kbx_wasted_ * 100 > kbx_size_ * KBX_COMPACT_RATIO) {
+        RNP_LOG("KBX file %s has %zu bytes of empty blobs, rewriting it.",
+                path.c_str(),
+                kbx_wasted_);
+        kbx_reset_refs();
+        return false;
+    }
+    return true;
+}
 } // namespace rnp
@@ -26,14 +26,19 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
 
 #include <librepgp/stream-common.h>
 #include <librepgp/stream-sig.h>
 #include <librepgp/stream-packet.h>
 #include <librepgp/stream-key.h>
 #include "crypto/mem.h"
+#include "crypto/hash.hpp"
 
 #include "types.h"
+#include "utils.h"
+#include "file-utils.h"
 #include "pgp-key.h"
 
 namespace rnp {
@@ -44,7 +49,7 @@ KeyStore::add_ts_subkey(const pgp_transferable_subkey_t &tskey, pgp_key_t *pkey)
         /* create subkey */
         pgp_key_t skey(tskey, pkey);
         /* add it to the storage */
-        return add_key(skey);
+        return add_key(std::move(skey));
     } catch (const std::exception &e) {
         /* LCOV_EXCL_START */
         RNP_LOG("%s", e.what());
@@ -66,7 +71,7 @@ KeyStore::add_ts_key(pgp_transferable_key_t &tkey)
         /* temporary disable key validation */
         disable_validation = true;
         /* add key to the storage before subkeys */
-        addkey = add_key(key);
+        addkey = add_key(std::move(key));
     } catch (const std::exception &e) {
         disable_validation = false;
         RNP_LOG_KEY_PKT("failed to add key %s", tkey.key);
@@ -155,6 +160,31 @@ KeyStore::load_pgp(pgp_source_t &src, bool skiperrors)
 } // namespace rnp
 
 namespace {
+bool
+do_write_key(rnp::KeyStore &key_store, pgp_key_t &key, pgp_dest_t &dst)
+{
+    if (key.format != PGP_KEY_STORE_GPG) {
+        RNP_LOG("incorrect format (conversions not supported): %d", key.format);
+        return false;
+    }
+    key.write(dst);
+    if (dst.werr) {
+        return false;
+    }
+    for (auto &sfp : key.subkey_fps()) {
+        pgp_key_t *subkey = key_store.get_key(sfp);
+        if (!subkey) {
+            RNP_LOG("Missing subkey");
+            continue;
+        }
+        subkey->write(dst);
+        if (dst.werr) {
+            return false;
+        }
+    }
+    return true;
+}
+
 bool
 do_write(rnp::KeyStore &key_store, pgp_dest_t &dst, bool secret)
 {
@@ -166,36 +196,434 @@ do_write(rnp::KeyStore &key_store, pgp_dest_t &dst, bool secret)
         if (!key.is_primary()) {
             continue;
         }
+        if (!do_write_key(key_store, key, dst)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Journal is a sequence of records: type (1 byte), length of data (4 bytes), data and CRC24
+ * of all the previous fields. First record is a header, which binds journal to the size and
+ * SHA-256 hash of the keyring file, so stale journal would not be applied if process crashed
+ * during the compaction. */
+#define JOURNAL_MAGIC "RNPJ"
+#define JOURNAL_VERSION 2
+#define JOURNAL_HASH_SIZE 32
+#define JOURNAL_HEADER_SIZE (13 + JOURNAL_HASH_SIZE)
+#define JOURNAL_RECORD_HDR_SIZE 5
+#define JOURNAL_RECORD_CRC_SIZE 3
+
+typedef enum : uint8_t {
+    JOURNAL_RECORD_HEADER = 'H',
+    JOURNAL_RECORD_KEY = 'K',
+    JOURNAL_RECORD_DELETE = 'D'
+} journal_record_type_t;
+
+void
+journal_add_record(pgp_dest_t &dst, journal_record_type_t type, const void *data, size_t len)
+{
+    uint8_t hdr[JOURNAL_RECORD_HDR_SIZE];
+    hdr[0] = type;
+    write_uint32(hdr + 1, len);
+    auto crc = rnp::CRC24::create();
+    crc->add(hdr, sizeof(hdr));
+    crc->add(data, len);
+    auto sum = crc->finish();
+    dst_write(&dst, hdr, sizeof(hdr));
+    dst_write(&dst, data, len);
+    dst_write(&dst, sum.data(), sum.size());
+}
+
+bool
+journal_base_hash(const std::string &path, uint64_t &size, uint8_t *digest)
+{
+    pgp_source_t src = {};
+    if (init_file_src(&src, path.c_str())) {
+        RNP_LOG("failed to read keyring %s", path.c_str());
+        return false;
+    }
+    bool res = false;
+    try {
+        auto                 hash = rnp::Hash::create(PGP_HASH_SHA256);
+        std::vector<uint8_t> buf(PGP_INPUT_CACHE_SIZE);
+        size = 0;
+        size_t read = 0;
+        while (src.read(buf.data(), buf.size(), &read) && read) {
+            hash->add(buf.data(), read);
+            size += read;
+        }
+        res = !src.error() && (hash->finish(digest) == JOURNAL_HASH_SIZE);
+    } catch (const std::exception &e) {
+        /* LCOV_EXCL_START */
+        RNP_LOG("%s", e.what());
+        /* LCOV_EXCL_END */
+    }
+    src.close();
+    return res;
+}
 
-        if (key.format != PGP_KEY_STORE_GPG) {
-            RNP_LOG("incorrect format (conversions not supported): %d", key.format);
+bool
+journal_add_header(pgp_dest_t &dst, const std::string &path)
+{
+    uint8_t  hdr[JOURNAL_HEADER_SIZE];
+    uint64_t size = 0;
+    if (!journal_base_hash(path, size, hdr + 13)) {
+        return false;
+    }
+    memcpy(hdr, JOURNAL_MAGIC, 4);
+    hdr[4] = JOURNAL_VERSION;
+    write_uint32(hdr + 5, size >> 32);
+    write_uint32(hdr + 9, size & 0xffffffff);
+    journal_add_record(dst, JOURNAL_RECORD_HEADER, hdr, sizeof(hdr));
+    return true;
+}
+
+bool
+journal_check_header(const uint8_t *data, size_t len, const std::string &path)
+{
+    if ((len != JOURNAL_HEADER_SIZE) || memcmp(data, JOURNAL_MAGIC, 4) ||
+        (data[4] != JOURNAL_VERSION)) {
+        RNP_LOG("Invalid journal header");
+        return false;
+    }
+    uint64_t size = 0;
+    uint8_t  digest[PGP_MAX_HASH_SIZE];
+    if (!journal_base_hash(path, size, digest)) {
+        return false;
+    }
+    uint64_t jsize = ((uint64_t) read_uint32(data + 5) << 32) | read_uint32(data + 9);
+    if ((jsize != size) || memcmp(data + 13, digest, JOURNAL_HASH_SIZE)) {
+        RNP_LOG("Journal does not belong to the current keyring, ignoring it");
+        return false;
+    }
+    return true;
+}
+
+void
+journal_add_delete(pgp_dest_t &dst, const std::vector<pgp_fingerprint_t> &fps)
+{
+    for (auto &fp : fps) {
+        journal_add_record(dst, JOURNAL_RECORD_DELETE, fp.fingerprint, fp.length);
+    }
+}
+
+bool
+journal_add_key(rnp::KeyStore &key_store, pgp_key_t &key, pgp_dest_t &dst)
+{
+    rnp::MemoryDest mem;
+    if (!do_write_key(key_store, key, mem.dst())) {
+        return false;
+    }
+    journal_add_record(dst, JOURNAL_RECORD_KEY, mem.memory(), mem.writeb());
+    return true;
+}
+
+/* Keyring is always rewritten via the temporary file, getting the new inode, while ctime
+ * catches in-place changes. Both are much cheaper to check than the hash. */
+bool
+journal_base_stat(const std::string &path, uint64_t &size, uint64_t &inode, int64_t &ctime)
+{
+    struct stat st;
+    if (rnp_stat(path.c_str(), &st)) {
+        RNP_LOG("stat(%s): %s", path.c_str(), strerror(errno));
+        return false;
+    }
+    size = st.st_size;
+    inode = st.st_ino;
+#if defined(__APPLE__)
+    long nsec = st.st_ctimespec.tv_nsec;
+#elif defined(_WIN32)
+    long nsec = 0;
+#else
+    long nsec = st.st_ctim.tv_nsec;
+#endif
+    ctime = (int64_t) st.st_ctime * 1000000000 + nsec;
+    return true;
+}
+} // namespace
+
+namespace rnp {
+bool
+KeyStore::write_pgp(pgp_dest_t &dst)
+{
+    // two separate passes (public keys, then secret keys)
+    return do_write(*this, dst, false) && do_write(*this, dst, true);
+}
+} // namespace rnp
+
+namespace rnp {
+std::string
+KeyStore::journal_file() const
+{
+    return path + ".journal";
+}
+
+void
+KeyStore::journal_reset_refs()
+{
+    journal_refs_.clear();
+    journal_dirty_.clear();
+    journal_path_.clear();
+    journal_size_ = 0;
+    journal_revision_ = 0;
+    journal_base_size_ = 0;
+    journal_base_inode_ = 0;
+    journal_base_ctime_ = 0;
+}
+
+void
+KeyStore::journal_touch(const pgp_key_t &key)
+{
+    if (journal_path_.empty()) {
+        return;
+    }
+    if (key.is_primary()) {
+        journal_dirty_.insert(key.fp());
+    } else if (key.has_primary_fp()) {
+        journal_dirty_.insert(key.primary_fp());
+    }
+}
+
+bool
+KeyStore::journal_replay(bool refs)
+{
+    journal_reset_refs();
+    uint64_t base_size = 0;
+    uint64_t base_inode = 0;
+    int64_t  base_ctime = 0;
+    if (!journal_base_stat(path, base_size, base_inode, base_ctime)) {
+        return false;
+    }
+
+    std::string jpath = journal_file();
+    size_t      left = 0;
+    size_t      valid = 0;
+    if (rnp_file_exists(jpath.c_str())) {
+        pgp_source_t src = {};
+        if (init_file_src(&src, jpath.c_str())) {
+            RNP_LOG("failed to read journal %s", jpath.c_str());
             return false;
         }
-        key.write(dst);
-        if (dst.werr) {
+        try {
+            MemorySource   mem(src);
+            const uint8_t *buf = (const uint8_t *) mem.memory();
+            left = mem.size();
+            while (left >= JOURNAL_RECORD_HDR_SIZE + JOURNAL_RECORD_CRC_SIZE) {
+                size_t len = read_uint32(buf + 1);
+                if (len > left - JOURNAL_RECORD_HDR_SIZE - JOURNAL_RECORD_CRC_SIZE) {
+                    break;
+                }
+                const uint8_t *data = buf + JOURNAL_RECORD_HDR_SIZE;
+                auto           crc = CRC24::create();
+                crc->add(buf, JOURNAL_RECORD_HDR_SIZE + len);
+                if (memcmp(crc->finish().data(), data + len, JOURNAL_RECORD_CRC_SIZE)) {
+                    break;
+                }
+                if (!valid) {
+                    if ((buf[0] != JOURNAL_RECORD_HEADER) ||
+                        !journal_check_header(data, len, path)) {
+                        break;
+                    }
+                } else if (buf[0] == JOURNAL_RECORD_KEY) {
+                    MemorySource keysrc(data, len, false);
+                    if (load_pgp(keysrc.src())) {
+                        RNP_LOG("failed to replay journaled key");
+                        src.close();
+                        return false;
+                    }
+                } else if ((buf[0] == JOURNAL_RECORD_DELETE) &&
+                           (len <= PGP_MAX_FINGERPRINT_SIZE)) {
+                    pgp_fingerprint_t fp = {};
+                    memcpy(fp.fingerprint, data, len);
+                    fp.length = len;
+                    auto key = get_key(fp);
+                    if (key) {
+                        remove_key(*key);
+                    }
+                } else {
+                    RNP_LOG("invalid journal record: %d", (int) buf[0]);
+                    break;
+                }
+                size_t rlen = JOURNAL_RECORD_HDR_SIZE + len + JOURNAL_RECORD_CRC_SIZE;
+                buf += rlen;
+                left -= rlen;
+                valid += rlen;
+            }
+        } catch (const std::exception &e) {
+            /* LCOV_EXCL_START */
+            RNP_LOG("%s", e.what());
+            src.close();
+            return false;
+            /* LCOV_EXCL_END */
+        }
+        src.close();
+    }
+    /* partially written or stale journal would be dropped on the next write */
+    if (left) {
+        RNP_LOG("journal %s has %zu bytes of invalid data", jpath.c_str(), left);
+        return true;
+    }
+    if (!refs) {
+        return true;
+    }
+    for (auto &key : keys) {
+        if (key.is_primary()) {
+            journal_refs_.emplace(key.fp(), key_ref(key, 0, 0));
+        }
+    }
+    journal_path_ = path;
+    journal_size_ = valid;
+    journal_revision_ = pgp_key_t::last_revision();
+    journal_base_size_ = base_size;
+    journal_base_inode_ = base_inode;
+    journal_base_ctime_ = base_ctime;
+    return true;
+}
+
+bool
+KeyStore::journal_update()
+{
+    if (journal_path_.empty() || (journal_path_ != path)) {
+        return false;
+    }
+    /* make sure that keyring and journal were not modified by someone else */
+    uint64_t base_size = 0;
+    uint64_t base_inode = 0;
+    int64_t  base_ctime = 0;
+    if (!journal_base_stat(path, base_size, base_inode, base_ctime) ||
+        (base_size != journal_base_size_) || (base_inode != journal_base_inode_) ||
+        (base_ctime != journal_base_ctime_)) {
+        return false;
+    }
+    std::string jpath = journal_file();
+    struct stat st;
+    size_t      jsize = rnp_stat(jpath.c_str(), &st) ? 0 : st.st_size;
+    if (jsize != journal_size_) {
+        return false;
+    }
+    /* keys were neither changed, nor added or removed */
+    uint64_t revision = pgp_key_t::last_revision();
+    if (journal_dirty_.empty() && (revision == journal_revision_)) {
+        return true;
+    }
+
+    try {
+        /* Added and removed keys are tracked by the keystore, while keys which were changed
+         * directly are found by the revision, without serializing or looking them up. */
+        std::unordered_set<pgp_fingerprint_t> dirty(journal_dirty_);
+        for (auto &key : keys) {
+            if ((revision == journal_revision_) || (key.revision() <= journal_revision_)) {
+                continue;
+            }
+            if (key.is_primary()) {
+                dirty.insert(key.fp());
+            } else if (key.has_primary_fp()) {
+                dirty.insert(key.primary_fp());
+            }
+        }
+
+        MemoryDest                                        mem;
+        std::unordered_map<pgp_fingerprint_t, KeyBlobRef> updated;
+        std::vector<pgp_fingerprint_t>                    removed;
+        if (!journal_size_ && !journal_add_header(mem.dst(), path)) {
             return false;
         }
-        for (auto &sfp : key.subkey_fps()) {
-            pgp_key_t *subkey = key_store.get_key(sfp);
-            if (!subkey) {
-                RNP_LOG("Missing subkey");
+        /* changed key is stored as removal of the old version and addition of the new one */
+        for (auto &fp : dirty) {
+            auto it = journal_refs_.find(fp);
+            auto key = get_key(fp);
+            if (!key || !key->is_primary()) {
+                if (it != journal_refs_.end()) {
+                    journal_add_delete(mem.dst(), it->second.fps);
+                    removed.push_back(fp);
+                }
                 continue;
             }
-            subkey->write(dst);
-            if (dst.werr) {
+            if ((it != journal_refs_.end()) && !key_ref_changed(*key, it->second)) {
+                continue;
+            }
+            if (it != journal_refs_.end()) {
+                journal_add_delete(mem.dst(), it->second.fps);
+            }
+            if (!journal_add_key(*this, *key, mem.dst())) {
                 return false;
             }
+            updated.emplace(fp, key_ref(*key, 0, 0));
+        }
+        if (updated.empty() && removed.empty()) {
+            journal_dirty_.clear();
+            journal_revision_ = revision;
+            return true;
+        }
+        /* compact the keyring once journal becomes larger than it */
+        if (journal_size_ + mem.writeb() > journal_base_size_) {
+            return false;
         }
+
+        FILE *fp = rnp_fopen(jpath.c_str(), "ab");
+        if (!fp) {
+            RNP_LOG("failed to open journal %s: %s", jpath.c_str(), strerror(errno));
+            return false;
+        }
+        bool res = (fwrite(mem.memory(), 1, mem.writeb(), fp) == mem.writeb()) &&
+                   !rnp_fsync(fp);
+        res = !fclose(fp) && res;
+        if (!res) {
+            RNP_LOG("failed to write journal %s", jpath.c_str());
+            return false;
+        }
+
+        journal_size_ += mem.writeb();
+        journal_dirty_.clear();
+        journal_revision_ = revision;
+        for (auto &rfp : removed) {
+            journal_refs_.erase(rfp);
+        }
+        for (auto &upd : updated) {
+            journal_refs_[upd.first] = std::move(upd.second);
+        }
+        return true;
+    } catch (const std::exception &e) {
+        /* LCOV_EXCL_START */
+        RNP_LOG("%s", e.what());
+        return false;
+        /* LCOV_EXCL_END */
     }
-    return true;
 }
-} // namespace
 
-namespace rnp {
 bool
-KeyStore::write_pgp(pgp_dest_t &dst)
+KeyStore::journal_rebase()
 {
-    // two separate passes (public keys, then secret keys)
-    return do_write(*this, dst, false) && do_write(*this, dst, true);
+    journal_reset_refs();
+    /* make sure keyring is on disk before dropping the journal */
+    FILE *fp = rnp_fopen(path.c_str(), "r+b");
+    if (!fp) {
+        RNP_LOG("failed to open keyring %s: %s", path.c_str(), strerror(errno));
+        return false;
+    }
+    bool synced = !rnp_fsync(fp);
+    fclose(fp);
+    if (!synced) {
+        RNP_LOG("failed to sync keyring %s", path.c_str());
+        return false;
+    }
+    std::string jpath = journal_file();
+    if (rnp_unlink(jpath.c_str()) && (errno != ENOENT)) {
+        RNP_LOG("failed to remove journal %s: %s", jpath.c_str(), strerror(errno));
+        return false;
+    }
+    if (!journal_base_stat(
+          path, journal_base_size_, journal_base_inode_, journal_base_ctime_)) {
+        return false;
+    }
+    for (auto &key : keys) {
+        if (key.is_primary()) {
+            journal_refs_.emplace(key.fp(), key_ref(key, 0, 0));
+        }
+    }
+    journal_path_ = path;
+    journal_revision_ = pgp_key_t::last_revision();
+    return true;
 }
 } // namespace rnp
@@ -63,30 +63,10 @@ bool
 KeyStore::load(const KeyProvider *key_provider)
 {
     pgp_source_t src = {};
+    bool         empty = keys.empty();
 
     if (format == PGP_KEY_STORE_G10) {
-        auto dir = rnp_opendir(path.c_str());
-        if (!dir) {
-            RNP_LOG("Can't open G10 directory %s: %s", path.c_str(), strerror(errno));
-            return false;
-        }
-
-        std::string dirname;
-        while (!((dirname = rnp_readdir_name(dir)).empty())) {
-            std::string apath = rnp::path::append(path, dirname);
-
-            if (init_file_src(&src, apath.c_str())) {
-                RNP_LOG("failed to read file %s", apath.c_str());
-                continue;
-            }
-            // G10 may fail to read one file, so ignore it!
-            if (!load_g10(src, key_provider)) {
-                RNP_LOG("Can't parse file: %s", apath.c_str()); // TODO: %S ?
-            }
-            src.close();
-        }
-        rnp_closedir(dir);
-        return true;
+        return load_g10_dir(key_provider);
     }
 
     /* init file source and load from it */
@@ -97,6 +77,14 @@ KeyStore::load(const KeyProvider *key_provider)
 
     bool rc = load(src, key_provider);
     src.close();
+    /* KBX file may be updated in-place later on */
+    if (rc && (format == PGP_KEY_STORE_KBX) && kbx_size_) {
+        kbx_path_ = path;
+    }
+    /* apply changes, stored in the journal */
+    if (rc && (format == PGP_KEY_STORE_GPG) && journal) {
+        rc = journal_replay(empty);
+    }
     return rc;
 }
 
@@ -123,6 +111,10 @@ KeyStore::write()
     bool       rc;
     pgp_dest_t keydst = {};
 
+    if (!load_deferred()) {
+        return false;
+    }
+
     /* write g10 key store to the directory */
     if (format == PGP_KEY_STORE_G10) {
         char chpath[MAXPATHLEN];
@@ -170,13 +162,24 @@ KeyStore::write()
         return true;
     }
 
+    /* update kbx store in-place if possible, falling back to the full rewrite */
+    if ((format == PGP_KEY_STORE_KBX) && update_kbx()) {
+        return true;
+    }
+    /* append changes to the journal if possible, otherwise compact it into the keyring */
+    bool jrnl = journal && (format == PGP_KEY_STORE_GPG);
+    if (jrnl && journal_update()) {
+        return true;
+    }
+
     /* write kbx/gpg store to the single file */
     if (init_tmpfile_dest(&keydst, path.c_str(), true)) {
         RNP_LOG("failed to create keystore file");
         return false;
     }
 
-    if (!write(keydst)) {
+    bool kbx = format == PGP_KEY_STORE_KBX;
+    if (!(kbx ? write_kbx(keydst, true) : write(keydst))) {
         RNP_LOG("failed to write keys to file");
         dst_close(&keydst, true);
         return false;
@@ -184,12 +187,34 @@ KeyStore::write()
 
     rc = dst_finish(&keydst) == RNP_SUCCESS;
     dst_close(&keydst, !rc);
+    if (kbx) {
+        if (rc) {
+            kbx_path_ = path;
+        } else {
+            kbx_reset_refs();
+        }
+    }
+    if (jrnl) {
+        rc = rc && journal_rebase();
+    }
     return rc;
 }
 
+bool
+KeyStore::compact()
+{
+    /* this would disable in-place and journal updates */
+    kbx_reset_refs();
+    journal_reset_refs();
+    return write();
+}
+
 bool
 KeyStore::write(pgp_dest_t &dst)
 {
+    if (!load_deferred()) {
+        return false;
+    }
     switch (format) {
     case PGP_KEY_STORE_GPG:
         return write_pgp(dst);
@@ -208,6 +233,18 @@ KeyStore::clear()
     keybyfp.clear();
     keys.clear();
     blobs.clear();
+    kbx_reset_refs();
+    kbx_reset_deferred();
+    g10_deferred_.clear();
+    g10_provider_ = KeyProvider();
+    journal_reset_refs();
+    uid_index_reset();
+}
+
+bool
+KeyStore::empty() const
+{
+    return keys.empty() && blobs.empty() && g10_deferred_.empty();
 }
 
 size_t
@@ -216,6 +253,178 @@ KeyStore::key_count() const
     return keys.size();
 }
 
+pgp_key_memory_t
+KeyStore::memory_usage() const
+{
+    pgp_key_memory_t usage;
+    for (auto &key : keys) {
+        key.memory_usage(usage);
+        /* std::list node keeps pointers to the previous and next ones */
+        usage.total += 2 * sizeof(void *);
+    }
+    usage.total += keybyfp.bucket_count() * sizeof(void *);
+    usage.total += keybyfp.size() * (sizeof(pgp_key_fp_map_t::value_type) + sizeof(void *));
+    for (auto &blob : blobs) {
+        usage.total += sizeof(*blob) + blob->image().capacity();
+    }
+    for (auto &tri : uid_trigrams_) {
+        usage.total += sizeof(tri) + tri.second.size() * (sizeof(uint64_t) + sizeof(void *));
+    }
+    for (auto &entry : uid_indexed_) {
+        usage.total += sizeof(entry) + entry.second.trigrams.capacity() * sizeof(uint32_t);
+    }
+    /* std::map node keeps pointers to the parent and children */
+    for (auto &seq : uid_seqs_) {
+        usage.total += sizeof(seq) + 4 * sizeof(void *);
+    }
+    return usage;
+}
+
+namespace {
+/* Append trigrams of the string, with ASCII letters lowercased, each packed to uint32_t */
+void
+uid_trigrams(const std::string &str, std::vector<uint32_t> &res)
+{
+    auto lower = [](char ch) -> uint32_t {
+        return ((ch >= 'A') && (ch <= 'Z')) ? ch - 'A' + 'a' : (uint8_t) ch;
+    };
+    for (size_t idx = 0; idx + 3 <= str.size(); idx++) {
+        res.push_back((lower(str[idx]) << 16) | (lower(str[idx + 1]) << 8) |
+                      lower(str[idx + 2]));
+    }
+}
+} // namespace
+
+void
+KeyStore::uid_index_put(const pgp_key_t &key)
+{
+    /* reindexed key keeps its position, keys without userids are indexed as well */
+    auto          it = uid_indexed_.find(key.fp());
+    UidIndexEntry entry{it != uid_indexed_.end() ? it->second.seq : ++uid_seq_, {}};
+    for (size_t idx = 0; idx < key.uid_count(); idx++) {
+        uid_trigrams(key.get_uid(idx).str, entry.trigrams);
+    }
+    std::sort(entry.trigrams.begin(), entry.trigrams.end());
+    entry.trigrams.erase(std::unique(entry.trigrams.begin(), entry.trigrams.end()),
+                         entry.trigrams.end());
+    uid_index_remove(key);
+    uid_seqs_.emplace(entry.seq, key.fp());
+    for (auto tri : entry.trigrams) {
+        uid_trigrams_[tri].insert(entry.seq);
+    }
+    uid_indexed_.emplace(key.fp(), std::move(entry));
+}
+
+void
+KeyStore::uid_index_remove(const pgp_key_t &key)
+{
+    auto it = uid_indexed_.find(key.fp());
+    if (it == uid_indexed_.end()) {
+        return;
+    }
+    for (auto tri : it->second.trigrams) {
+        auto &set = uid_trigrams_[tri];
+        set.erase(it->second.seq);
+        if (set.empty()) {
+            uid_trigrams_.erase(tri);
+        }
+    }
+    uid_seqs_.erase(it->second.seq);
+    uid_indexed_.erase(it);
+}
+
+void
+KeyStore::uid_index_reset()
+{
+    uid_trigrams_.clear();
+    uid_indexed_.clear();
+    uid_seqs_.clear();
+    uid_seq_ = 0;
+}
+
+void
+KeyStore::set_uid_index(bool enable)
+{
+    if (enable == uid_index_) {
+        return;
+    }
+    uid_index_reset();
+    uid_index_ = enable;
+    if (!enable) {
+        return;
+    }
+    for (auto &key : keys) {
+        uid_index_put(key);
+    }
+}
+
+bool
+KeyStore::uid_index_search(const KeySearch &search, std::vector<pgp_key_t *> &res)
+{
+    if (!uid_index_) {
+        return false;
+    }
+    switch (search.type()) {
+    case KeySearch::Type::UserID:
+        break;
+    case KeySearch::Type::Query:
+        if (!dynamic_cast<const KeyQuerySearch &>(search).literal()) {
+            return false;
+        }
+        break;
+    default:
+        return false;
+    }
+    std::vector<uint32_t> trigrams;
+    uid_trigrams(search.value(), trigrams);
+    if (trigrams.empty()) {
+        return false;
+    }
+
+    /* each trigram must be present, so start from the rarest one */
+    res.clear();
+    std::vector<const std::unordered_set<uint64_t> *> sets;
+    for (auto tri : trigrams) {
+        auto it = uid_trigrams_.find(tri);
+        if (it == uid_trigrams_.end()) {
+            return true;
+        }
+        sets.push_back(&it->second);
+    }
+    std::sort(sets.begin(), sets.end(), [](const auto *a, const auto *b) {
+        return a->size() < b->size();
+    });
+    std::vector<uint64_t> seqs;
+    for (auto seq : *sets.front()) {
+        bool all = std::all_of(sets.begin() + 1, sets.end(), [seq](const auto *set) {
+            return set->count(seq);
+        });
+        if (all) {
+            seqs.push_back(seq);
+        }
+    }
+    std::sort(seqs.begin(), seqs.end());
+    /* candidates are resolved via keybyfp and checked with the search itself, so results
+     * are exact and never refer to the removed keys */
+    for (auto seq : seqs) {
+        auto it = keybyfp.find(uid_seqs_.at(seq));
+        if ((it != keybyfp.end()) && search.matches(*it->second)) {
+            res.push_back(&*it->second);
+        }
+    }
+    return true;
+}
+
+void
+KeyStore::update_uid_index(const pgp_key_t &key)
+{
+    auto it = keybyfp.find(key.fp());
+    if (!uid_index_ || (it == keybyfp.end()) || (&*it->second != &key)) {
+        return;
+    }
+    uid_index_put(*it->second);
+}
+
 bool
 KeyStore::refresh_subkey_grips(pgp_key_t &key)
 {
@@ -264,7 +473,7 @@ KeyStore::refresh_subkey_grips(pgp_key_t &key)
 }
 
 pgp_key_t *
-KeyStore::add_subkey(pgp_key_t &srckey, pgp_key_t *oldkey)
+KeyStore::add_subkey(pgp_key_t &srckey, pgp_key_t *oldkey, bool move)
 {
     pgp_key_t *primary = NULL;
     if (oldkey) {
@@ -295,7 +504,11 @@ KeyStore::add_subkey(pgp_key_t &srckey, pgp_key_t *oldkey)
             keys.emplace_back();
             oldkey = &keys.back();
             keybyfp[srckey.fp()] = std::prev(keys.end());
-            *oldkey = pgp_key_t(srckey);
+            if (move) {
+                *oldkey = std::move(srckey);
+            } else {
+                *oldkey = pgp_key_t(srckey);
+            }
             if (primary) {
                 primary->link_subkey_fp(*oldkey);
             }
@@ -318,15 +531,32 @@ KeyStore::add_subkey(pgp_key_t &srckey, pgp_key_t *oldkey)
         oldkey->validate_subkey(primary, secctx);
     }
     if (!oldkey->refresh_data(primary, secctx)) {
-        RNP_LOG_KEY("Failed to refresh subkey %s data", &srckey);
+        RNP_LOG_KEY("Failed to refresh subkey %s data", oldkey);
         RNP_LOG_KEY("primary key is %s", primary);
     }
+    /* subkeys are indexed too, so search() may continue after any of the keys */
+    if (uid_index_) {
+        uid_index_put(*oldkey);
+    }
+    journal_touch(*oldkey);
     return oldkey;
 }
 
 /* add a key to keyring */
 pgp_key_t *
 KeyStore::add_key(pgp_key_t &srckey)
+{
+    return add_key(srckey, false);
+}
+
+pgp_key_t *
+KeyStore::add_key(pgp_key_t &&srckey)
+{
+    return add_key(srckey, true);
+}
+
+pgp_key_t *
+KeyStore::add_key(pgp_key_t &srckey, bool move)
 {
     assert(srckey.type() && srckey.version());
     pgp_key_t *added_key = get_key(srckey.fp());
@@ -336,7 +566,7 @@ KeyStore::add_key(pgp_key_t &srckey)
     }
     /* different processing for subkeys */
     if (srckey.is_subkey()) {
-        return add_subkey(srckey, added_key);
+        return add_subkey(srckey, added_key, move);
     }
 
     if (added_key) {
@@ -349,7 +579,12 @@ KeyStore::add_key(pgp_key_t &srckey)
             keys.emplace_back();
             added_key = &keys.back();
             keybyfp[srckey.fp()] = std::prev(keys.end());
-            *added_key = pgp_key_t(srckey);
+            /* moving avoids deep copy of the packets, signatures and key material */
+            if (move) {
+                *added_key = std::move(srckey);
+            } else {
+                *added_key = pgp_key_t(srckey);
+            }
             /* primary key may be added after subkeys, so let's handle this case correctly */
             if (!refresh_subkey_grips(*added_key)) {
                 RNP_LOG_KEY("failed to refresh subkey grips for %s", added_key);
@@ -366,12 +601,22 @@ KeyStore::add_key(pgp_key_t &srckey)
             /* LCOV_EXCL_END */
         }
     }
+    /* do not let flooded certificates to grow unbounded */
+    if (added_key->limit_certs(max_certs)) {
+        RNP_LOG_KEY("Too many certifications on the key %s, dropping extra.", added_key);
+    }
+
+    /* merged key may get new userids */
+    if (uid_index_) {
+        uid_index_put(*added_key);
+    }
+    journal_touch(*added_key);
 
     /* validate all added keys if not disabled or already validated */
     if (!disable_validation && !added_key->validated()) {
         added_key->revalidate(*this);
     } else if (!added_key->refresh_data(secctx)) {
-        RNP_LOG_KEY("Failed to refresh key %s data", &srckey);
+        RNP_LOG_KEY("Failed to refresh key %s data", added_key);
     }
     /* Revalidate non-self revocations for all keys in keyring, as added_key key could be a
      * revoker. Should not be time-consuming as `validate_desig_revokes()` has early exit. */
@@ -439,7 +684,7 @@ KeyStore::import_key(pgp_key_t &srckey, bool pubkey, pgp_key_import_status_t *st
     try {
         pgp_key_t keycp(srckey, pubkey);
         disable_validation = true;
-        exkey = add_key(keycp);
+        exkey = add_key(std::move(keycp));
         disable_validation = false;
         if (!exkey) {
             RNP_LOG("failed to add key to the keyring");
@@ -570,6 +815,7 @@ KeyStore::remove_key(const pgp_key_t &key, bool subkeys)
     if (it == keybyfp.end()) {
         return false;
     }
+    journal_touch(key);
 
     /* cleanup primary_grip (or subkey)/subkey_grips */
     if (key.is_primary() && key.subkey_count()) {
@@ -580,6 +826,7 @@ KeyStore::remove_key(const pgp_key_t &key, bool subkeys)
             }
             /* if subkeys are deleted then no need to update grips */
             if (subkeys) {
+                uid_index_remove(*its->second);
                 keys.erase(its->second);
                 keybyfp.erase(its);
                 continue;
@@ -594,6 +841,7 @@ KeyStore::remove_key(const pgp_key_t &key, bool subkeys)
         }
     }
 
+    uid_index_remove(key);
     keys.erase(it->second);
     keybyfp.erase(it);
     return true;
@@ -613,6 +861,11 @@ pgp_key_t *
 KeyStore::get_key(const pgp_fingerprint_t &fpr)
 {
     auto it = keybyfp.find(fpr);
+    if ((it == keybyfp.end()) &&
+        (kbx_load_deferred(fpr) ||
+         (!g10_deferred_.empty() && g10_load_deferred(*KeySearch::create(fpr))))) {
+        it = keybyfp.find(fpr);
+    }
     if (it == keybyfp.end()) {
         return nullptr;
     }
@@ -654,6 +907,35 @@ KeyStore::primary_key(const pgp_key_t &subkey)
     return nullptr;
 }
 
+KeyStore::KeyBlobRef
+KeyStore::key_ref(const pgp_key_t &key, size_t offset, uint32_t length) const
+{
+    KeyBlobRef ref{offset, length, {key.fp()}, {key.revision()}};
+    for (auto &sfp : key.subkey_fps()) {
+        auto subkey = get_key(sfp);
+        ref.fps.push_back(sfp);
+        ref.revisions.push_back(subkey ? subkey->revision() : 0);
+    }
+    return ref;
+}
+
+bool
+KeyStore::key_ref_changed(const pgp_key_t &key, const KeyBlobRef &ref) const
+{
+    if ((ref.fps.size() != key.subkey_count() + 1) || (ref.revisions[0] != key.revision())) {
+        return true;
+    }
+    for (size_t idx = 0; idx < key.subkey_count(); idx++) {
+        auto &sfp = key.get_subkey_fp(idx);
+        auto  subkey = get_key(sfp);
+        if (!subkey || (ref.fps[idx + 1] != sfp) ||
+            (ref.revisions[idx + 1] != subkey->revision())) {
+            return true;
+        }
+    }
+    return false;
+}
+
 pgp_key_t *
 KeyStore::search(const KeySearch &search, pgp_key_t *after)
 {
@@ -670,6 +952,27 @@ KeyStore::search(const KeySearch &search, pgp_key_t *after)
         return after ? nullptr : key;
     }
 
+    // parse deferred KBX blobs which may contain the key
+    kbx_load_deferred(search);
+    // read deferred G10 key file if it matches the search
+    g10_load_deferred(search);
+
+    // userid index returns all matching keys, in the keys list order
+    std::vector<pgp_key_t *> found;
+    if (uid_index_search(search, found)) {
+        auto afterfp = after ? keybyfp.find(after->fp()) : keybyfp.end();
+        auto afterit = uid_indexed_.end();
+        if (after && (afterfp != keybyfp.end()) && (&*afterfp->second == after)) {
+            afterit = uid_indexed_.find(after->fp());
+        }
+        if (!after || (afterit != uid_indexed_.end())) {
+            auto nextit = std::find_if(found.begin(), found.end(), [&](pgp_key_t *key) {
+                return !after || (uid_indexed_.at(key->fp()).seq > afterit->second.seq);
+            });
+            return (nextit == found.end()) ? nullptr : *nextit;
+        }
+    }
+
     // if after is provided, make sure it is a member of the appropriate list
     auto it = std::find_if(keys.begin(), keys.end(), [after](const pgp_key_t &key) {
         return !after || (after == &key);
@@ -686,6 +989,24 @@ KeyStore::search(const KeySearch &search, pgp_key_t *after)
     return (it == keys.end()) ? nullptr : &(*it);
 }
 
+std::vector<pgp_key_t *>
+KeyStore::search_all(const KeySearch &search)
+{
+    // all matching keys are needed, so everything deferred is parsed
+    load_deferred();
+
+    std::vector<pgp_key_t *> res;
+    if (uid_index_search(search, res)) {
+        return res;
+    }
+    for (auto &key : keys) {
+        if (search.matches(key)) {
+            res.push_back(&key);
+        }
+    }
+    return res;
+}
+
 pgp_key_t *
 KeyStore::get_signer(const pgp_signature_t &sig, const KeyProvider *prov)
 {
@@ -26,6 +26,7 @@
 
 #include "config.h"
 #include <stdlib.h>
+#include <stddef.h>
 #include <stdio.h>
 #ifdef HAVE_UNISTD_H
 #include <unistd.h>
@@ -48,9 +49,48 @@
 #include "types.h"
 #include "file-utils.h"
 #include "crypto/mem.h"
+#include "object-pool.hpp"
 #include <algorithm>
+#include <limits>
 #include <memory>
 
+namespace {
+struct source_cache_release {
+    void
+    operator()(pgp_source_cache_t *cache)
+    {
+        free(cache);
+    }
+};
+
+typedef rnp::ObjectPool<pgp_source_cache_t *, source_cache_release> source_cache_pool_t;
+
+/* Each layer of the processing chain needs its own cache, so keep a few per thread */
+source_cache_pool_t &
+source_cache_pool()
+{
+    static thread_local source_cache_pool_t pool(8);
+    return pool;
+}
+
+pgp_source_cache_t *
+source_cache_get()
+{
+    pgp_source_cache_t *cache = NULL;
+    if (!source_cache_pool().get(cache)) {
+        /* buffer contents are not used beyond cache->len, so there is no need to zero it */
+        cache = (pgp_source_cache_t *) malloc(sizeof(*cache));
+        if (!cache) {
+            return NULL;
+        }
+    }
+    cache->pos = 0;
+    cache->len = 0;
+    cache->readahead = true;
+    return cache;
+}
+} // namespace
+
 bool
 pgp_source_t::read(void *buf, size_t len, size_t *readres)
 {
@@ -248,6 +288,32 @@ pgp_source_t::skip(size_t len)
     free(buf);
 }
 
+bool
+pgp_source_t::seek(uint64_t pos)
+{
+    if (!raw_seek || (knownsize && (pos > size))) {
+        return false;
+    }
+    if (!raw_seek(this, pos)) {
+        error_ = true;
+        return false;
+    }
+    if (cache) {
+        cache->pos = 0;
+        cache->len = 0;
+    }
+    readb = pos;
+    error_ = false;
+    eof_ = knownsize && (pos == size);
+    return true;
+}
+
+bool
+pgp_source_t::seekable() const
+{
+    return raw_seek;
+}
+
 rnp_result_t
 pgp_source_t::finish()
 {
@@ -283,7 +349,7 @@ pgp_source_t::close()
     }
 
     if (cache) {
-        free(cache);
+        source_cache_pool().put(std::move(cache));
         cache = NULL;
     }
 }
@@ -347,19 +413,18 @@ bool
 init_src_common(pgp_source_t *src, size_t paramsize)
 {
     memset(src, 0, sizeof(*src));
-    src->cache = (pgp_source_cache_t *) calloc(1, sizeof(*src->cache));
+    src->cache = source_cache_get();
     if (!src->cache) {
         RNP_LOG("cache allocation failed");
         return false;
     }
-    src->cache->readahead = true;
     if (!paramsize) {
         return true;
     }
     src->param = calloc(1, paramsize);
     if (!src->param) {
         RNP_LOG("param allocation failed");
-        free(src->cache);
+        source_cache_pool().put(std::move(src->cache));
         src->cache = NULL;
         return false;
     }
@@ -386,6 +451,23 @@ file_src_read(pgp_source_t *src, void *buf, size_t len, size_t *readres)
     return true;
 }
 
+static bool
+file_src_seek(pgp_source_t *src, uint64_t pos)
+{
+    pgp_source_file_param_t *param = (pgp_source_file_param_t *) src->param;
+    if (!param) {
+        return false;
+    }
+#ifdef _WIN32
+    return _lseeki64(param->fd, pos, SEEK_SET) >= 0;
+#else
+    if (pos > (uint64_t) std::numeric_limits<off_t>::max()) {
+        return false;
+    }
+    return lseek(param->fd, (off_t) pos, SEEK_SET) >= 0;
+#endif
+}
+
 static void
 file_src_close(pgp_source_t *src)
 {
@@ -410,6 +492,7 @@ init_fd_src(pgp_source_t *src, int fd, uint64_t *size)
     param->fd = fd;
     src->raw_read = file_src_read;
     src->raw_close = file_src_close;
+    src->raw_seek = file_src_seek;
     src->type = PGP_STREAM_FILE;
     src->size = size ? *size : 0;
     src->knownsize = !!size;
@@ -481,15 +564,31 @@ typedef struct pgp_source_mem_param_t {
     size_t      pos;
 } pgp_source_mem_param_t;
 
+typedef struct pgp_dest_mem_segment_t {
+    uint8_t *data; /* segment's memory */
+    size_t   len;  /* number of bytes written to the segment */
+    size_t   size; /* number of bytes allocated for the segment */
+} pgp_dest_mem_segment_t;
+
 typedef struct pgp_dest_mem_param_t {
-    unsigned maxalloc;
-    unsigned allocated;
-    void *   memory;
-    bool     free;
-    bool     discard_overflow;
-    bool     secure;
+    size_t maxalloc;
+    size_t allocated;
+    void * memory;
+    bool   free;
+    bool   discard_overflow;
+    bool   secure;
+    size_t hint; /* expected size of the output, used for the first allocation */
+    /* segmented dest keeps data in a list of segments instead of a single buffer */
+    bool                    segmented;
+    pgp_dest_mem_segment_t *segs;
+    size_t                  segcount;
+    size_t                  segalloc;
 } pgp_dest_mem_param_t;
 
+/* segments are allocated with the size of already written data, within these bounds */
+#define MEM_SEGMENT_MIN (64 * 1024)
+#define MEM_SEGMENT_MAX (64 * 1024 * 1024)
+
 static bool
 mem_src_read(pgp_source_t *src, void *buf, size_t len, size_t *read)
 {
@@ -507,6 +606,17 @@ mem_src_read(pgp_source_t *src, void *buf, size_t len, size_t *read)
     return true;
 }
 
+static bool
+mem_src_seek(pgp_source_t *src, uint64_t pos)
+{
+    pgp_source_mem_param_t *param = (pgp_source_mem_param_t *) src->param;
+    if (!param || (pos > param->len)) {
+        return false;
+    }
+    param->pos = pos;
+    return true;
+}
+
 static void
 mem_src_close(pgp_source_t *src)
 {
@@ -538,6 +648,7 @@ init_mem_src(pgp_source_t *src, const void *mem, size_t len, bool free)
     param->free = free;
     src->raw_read = mem_src_read;
     src->raw_close = mem_src_close;
+    src->raw_seek = mem_src_seek;
     src->raw_finish = NULL;
     src->size = len;
     src->knownsize = 1;
@@ -606,7 +717,10 @@ mem_src_get_memory(pgp_source_t *src, bool own)
 bool
 init_dst_common(pgp_dest_t *dst, size_t paramsize)
 {
-    memset(dst, 0, sizeof(*dst));
+    /* write cache is large and is never read beyond clen, so skip it */
+    memset(dst, 0, offsetof(pgp_dest_t, cache));
+    dst->clen = 0;
+    dst->finished = false;
     dst->werr = RNP_SUCCESS;
     if (!paramsize) {
         return true;
@@ -940,6 +1054,96 @@ init_stdout_dest(pgp_dest_t *dst)
     return RNP_SUCCESS;
 }
 
+static rnp_result_t
+mem_dst_write_segment(pgp_dest_t *          dst,
+                      pgp_dest_mem_param_t *param,
+                      const uint8_t *       buf,
+                      size_t                len)
+{
+    if ((param->maxalloc > 0) && (dst->writeb + len > param->maxalloc)) {
+        RNP_LOG("attempt to alloc more then allowed");
+        return RNP_ERROR_OUT_OF_MEMORY;
+    }
+
+    /* fill the free space of the last segment */
+    if (param->segcount) {
+        pgp_dest_mem_segment_t &last = param->segs[param->segcount - 1];
+        size_t                  cplen = std::min(len, last.size - last.len);
+        memcpy(last.data + last.len, buf, cplen);
+        last.len += cplen;
+        buf += cplen;
+        len -= cplen;
+    }
+    if (!len) {
+        return RNP_SUCCESS;
+    }
+
+    /* previous segments are never moved, so growth doesn't need copying */
+    if (param->segcount == param->segalloc) {
+        size_t newalloc = param->segalloc ? param->segalloc * 2 : 16;
+        void * newsegs = realloc(param->segs, newalloc * sizeof(*param->segs));
+        if (!newsegs) {
+            return RNP_ERROR_OUT_OF_MEMORY; // LCOV_EXCL_LINE
+        }
+        param->segs = (pgp_dest_mem_segment_t *) newsegs;
+        param->segalloc = newalloc;
+    }
+
+    size_t size = std::max(dst->writeb, (size_t) MEM_SEGMENT_MIN);
+    size = std::min(size, (size_t) MEM_SEGMENT_MAX);
+    if (!param->segcount && param->hint) {
+        size = param->hint;
+    }
+    size = std::max(size, len);
+    if ((param->maxalloc > 0) && (size > param->maxalloc - param->allocated)) {
+        size = param->maxalloc - param->allocated;
+    }
+    uint8_t *data = (uint8_t *) malloc(size);
+    if (!data) {
+        return RNP_ERROR_OUT_OF_MEMORY; // LCOV_EXCL_LINE
+    }
+    memcpy(data, buf, len);
+    param->segs[param->segcount++] = {data, len, size};
+    param->allocated += size;
+    return RNP_SUCCESS;
+}
+
+static void
+mem_dst_free_segments(pgp_dest_mem_param_t *param)
+{
+    for (size_t idx = 0; idx < param->segcount; idx++) {
+        if (param->secure) {
+            secure_clear(param->segs[idx].data, param->segs[idx].len);
+        }
+        free(param->segs[idx].data);
+    }
+    param->segcount = 0;
+    param->allocated = 0;
+}
+
+/* merge segments into a single one, so data may be accessed as a contiguous buffer */
+static bool
+mem_dst_merge_segments(pgp_dest_t *dst, pgp_dest_mem_param_t *param)
+{
+    if (param->segcount < 2) {
+        return true;
+    }
+    uint8_t *data = (uint8_t *) malloc(dst->writeb);
+    if (!data) {
+        return false; // LCOV_EXCL_LINE
+    }
+    size_t len = 0;
+    for (size_t idx = 0; idx < param->segcount; idx++) {
+        memcpy(data + len, param->segs[idx].data, param->segs[idx].len);
+        len += param->segs[idx].len;
+    }
+    mem_dst_free_segments(param);
+    param->segs[0] = {data, len, len};
+    param->segcount = 1;
+    param->allocated = len;
+    return true;
+}
+
 static rnp_result_t
 mem_dst_write(pgp_dest_t *dst, const void *buf, size_t len)
 {
@@ -956,6 +1160,10 @@ mem_dst_write(pgp_dest_t *dst, const void *buf, size_t len)
         len = param->allocated - dst->writeb;
     }
 
+    if (param->segmented) {
+        return mem_dst_write_segment(dst, param, (const uint8_t *) buf, len);
+    }
+
     if (dst->writeb + len > param->allocated) {
         if ((param->maxalloc > 0) && (dst->writeb + len > param->maxalloc)) {
             RNP_LOG("attempt to alloc more then allowed");
@@ -964,6 +1172,9 @@ mem_dst_write(pgp_dest_t *dst, const void *buf, size_t len)
 
         /* round up to the page boundary and do it exponentially */
         size_t alloc = ((dst->writeb + len) * 2 + 4095) / 4096 * 4096;
+        if (!param->allocated && (param->hint >= dst->writeb + len)) {
+            alloc = param->hint;
+        }
         if ((param->maxalloc > 0) && (alloc > param->maxalloc)) {
             alloc = param->maxalloc;
         }
@@ -998,7 +1209,9 @@ mem_dst_close(pgp_dest_t *dst, bool discard)
             secure_clear(param->memory, param->allocated);
         }
         free(param->memory);
+        mem_dst_free_segments(param);
     }
+    free(param->segs);
     free(param);
     dst->param = NULL;
 }
@@ -1029,6 +1242,70 @@ init_mem_dest(pgp_dest_t *dst, void *mem, unsigned len)
     return RNP_SUCCESS;
 }
 
+rnp_result_t
+init_segmented_mem_dest(pgp_dest_t *dst, size_t maxalloc, size_t hint)
+{
+    rnp_result_t ret = init_mem_dest(dst, NULL, 0);
+    if (ret) {
+        return ret;
+    }
+    pgp_dest_mem_param_t *param = (pgp_dest_mem_param_t *) dst->param;
+    param->maxalloc = maxalloc;
+    param->hint = (maxalloc && (hint > maxalloc)) ? maxalloc : hint;
+    param->segmented = true;
+    return RNP_SUCCESS;
+}
+
+void
+mem_dest_set_size_hint(pgp_dest_t *dst, size_t hint)
+{
+    if (dst->type != PGP_STREAM_MEMORY) {
+        RNP_LOG("wrong function call");
+        return;
+    }
+
+    pgp_dest_mem_param_t *param = (pgp_dest_mem_param_t *) dst->param;
+    if (param) {
+        param->hint = hint;
+    }
+}
+
+size_t
+mem_dest_segment_count(pgp_dest_t *dst)
+{
+    if (dst->type != PGP_STREAM_MEMORY) {
+        RNP_LOG("wrong function call");
+        return 0;
+    }
+
+    pgp_dest_mem_param_t *param = (pgp_dest_mem_param_t *) dst->param;
+    if (!param) {
+        return 0;
+    }
+    if (param->segmented) {
+        return param->segcount;
+    }
+    return param->memory && dst->writeb ? 1 : 0;
+}
+
+bool
+mem_dest_get_segment(pgp_dest_t *dst, size_t idx, const uint8_t **buf, size_t *len)
+{
+    if (idx >= mem_dest_segment_count(dst)) {
+        return false;
+    }
+
+    pgp_dest_mem_param_t *param = (pgp_dest_mem_param_t *) dst->param;
+    if (!param->segmented) {
+        *buf = (const uint8_t *) param->memory;
+        *len = dst->writeb;
+        return true;
+    }
+    *buf = param->segs[idx].data;
+    *len = param->segs[idx].len;
+    return true;
+}
+
 void
 mem_dest_discard_overflow(pgp_dest_t *dst, bool discard)
 {
@@ -1052,12 +1329,17 @@ mem_dest_get_memory(pgp_dest_t *dst)
     }
 
     pgp_dest_mem_param_t *param = (pgp_dest_mem_param_t *) dst->param;
-
-    if (param) {
+    if (!param) {
+        return NULL;
+    }
+    if (!param->segmented) {
         return param->memory;
     }
-
-    return NULL;
+    if (!mem_dst_merge_segments(dst, param)) {
+        RNP_LOG("failed to merge segments"); // LCOV_EXCL_LINE
+        return NULL;                          // LCOV_EXCL_LINE
+    }
+    return param->segcount ? param->segs[0].data : NULL;
 }
 
 void *
@@ -1077,6 +1359,21 @@ mem_dest_own_memory(pgp_dest_t *dst)
 
     dst_finish(dst);
 
+    if (param->segmented) {
+        /* segments are merged into a single one, which is passed to the caller */
+        void *res = mem_dest_get_memory(dst);
+        if (res && !param->free) {
+            /* ownership was already passed, so copy the memory */
+            void *cp = malloc(dst->writeb);
+            if (cp) {
+                memcpy(cp, res, dst->writeb);
+            }
+            return cp;
+        }
+        param->free = false;
+        return res;
+    }
+
     if (param->free) {
         if (!dst->writeb) {
             free(param->memory);
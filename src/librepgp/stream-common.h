@@ -43,6 +43,7 @@ typedef enum {
     PGP_STREAM_MEMORY,
     PGP_STREAM_STDIN,
     PGP_STREAM_STDOUT,
+    PGP_STREAM_PIPE,
     PGP_STREAM_PACKET,
     PGP_STREAM_PARLEN_PACKET,
     PGP_STREAM_LITERAL,
@@ -59,6 +60,7 @@ typedef struct pgp_dest_t   pgp_dest_t;
 typedef bool pgp_source_read_func_t(pgp_source_t *src, void *buf, size_t len, size_t *read);
 typedef rnp_result_t pgp_source_finish_func_t(pgp_source_t *src);
 typedef void         pgp_source_close_func_t(pgp_source_t *src);
+typedef bool         pgp_source_seek_func_t(pgp_source_t *src, uint64_t pos);
 
 typedef rnp_result_t pgp_dest_write_func_t(pgp_dest_t *dst, const void *buf, size_t len);
 typedef rnp_result_t pgp_dest_finish_func_t(pgp_dest_t *src);
@@ -77,6 +79,7 @@ typedef struct pgp_source_t {
                                          to virtual rnp::Source::raw_read()/finish()/close() */
     pgp_source_finish_func_t *raw_finish;
     pgp_source_close_func_t * raw_close;
+    pgp_source_seek_func_t *  raw_seek; /* optional, set only for the seekable sources */
     pgp_stream_type_t         type;
 
     uint64_t size;  /* size of the data if available, see knownsize */
@@ -130,6 +133,16 @@ typedef struct pgp_source_t {
      */
     void skip(size_t len);
 
+    /** @brief set the read position of the seekable source, dropping the cached data.
+     *  @param pos position from the beginning of the source
+     *  @return true on success or false if source is not seekable or seek failed
+     */
+    bool seek(uint64_t pos);
+
+    /** @brief check whether source supports seek()
+     */
+    bool seekable() const;
+
     /** @brief notify source that all reading is done, so final data processing may be started,
      *         i.e. signature reading and verification and so on. Do not misuse with close().
      *  @return RNP_SUCCESS or error code. If source doesn't have finish handler then also
@@ -186,7 +199,8 @@ typedef struct pgp_source_t {
 } pgp_source_t;
 
 /** @brief helper function to allocate memory for source's cache and param
- *         Also fills src and param with zeroes
+ *         Also fills src and param with zeroes. Cache is taken from the per-thread pool
+ *         and returned there by src->close().
  *  @param src pointer to the source structure
  *  @param paramsize number of bytes required for src->param
  *  @return true on success or false if memory allocation failed.
@@ -251,7 +265,7 @@ typedef struct pgp_dest_t {
 } pgp_dest_t;
 
 /** @brief helper function to allocate memory for dest's param.
- *         Initializes dst and param with zeroes as well.
+ *         Initializes dst (except the write cache contents) and param with zeroes.
  *  @param dst dest structure
  *  @param paramsize number of bytes required for dst->param
  *  @return true on success, or false if memory allocation failed
@@ -332,13 +346,50 @@ rnp_result_t init_stdout_dest(pgp_dest_t *dst);
  **/
 rnp_result_t init_mem_dest(pgp_dest_t *dst, void *mem, unsigned len);
 
+/** @brief init segmented memory destination. Data is stored in a list of separately allocated
+ *         segments, so growth doesn't require reallocation and copying of already written
+ *         data. Segments are merged into a single buffer only when mem_dest_get_memory() or
+ *         mem_dest_own_memory() is called.
+ *  @param dst pre-allocated dest structure
+ *  @param maxalloc maximum amount of memory to allocate, or zero for no limit.
+ *  @param hint expected size of the output, or zero if unknown. The first segment is allocated
+ *         with this size.
+ *  @return RNP_SUCCESS or error code
+ **/
+rnp_result_t init_segmented_mem_dest(pgp_dest_t *dst, size_t maxalloc, size_t hint);
+
+/** @brief set the expected size of the memory dest's output, so memory may be allocated at
+ *         once. Must be called before writing any data.
+ *  @param dst pre-allocated and initialized memory dest
+ *  @param hint expected number of bytes
+ **/
+void mem_dest_set_size_hint(pgp_dest_t *dst, size_t hint);
+
+/** @brief get the number of memory segments, holding the dest's data. Non-segmented memory
+ *         dest with data has exactly one segment.
+ *  @param dst pre-allocated and initialized memory dest
+ *  @return number of segments
+ **/
+size_t mem_dest_segment_count(pgp_dest_t *dst);
+
+/** @brief get the memory segment. Do not retain the result, it may change after subsequent
+ *         writes or mem_dest_get_memory() call.
+ *  @param dst pre-allocated and initialized memory dest
+ *  @param idx index of the segment
+ *  @param buf pointer to the segment's data will be stored here
+ *  @param len number of bytes in the segment will be stored here
+ *  @return true on success or false if idx is out of range
+ **/
+bool mem_dest_get_segment(pgp_dest_t *dst, size_t idx, const uint8_t **buf, size_t *len);
+
 /** @brief set whether to silently discard bytes which overflow memory of the dst.
  *  @param dst pre-allocated and initialized memory dest
  *  @param discard true to discard or false to return an error on overflow.
  **/
 void mem_dest_discard_overflow(pgp_dest_t *dst, bool discard);
 
-/** @brief get the pointer to the memory where data is written.
+/** @brief get the pointer to the memory where data is written. Segments of the segmented
+ *  dest are merged into a single buffer.
  *  Do not retain the result, it may change between calls due to realloc
  *  @param dst pre-allocated and initialized memory dest
  *  @return pointer to the memory area or NULL if memory was not allocated
@@ -65,6 +65,9 @@ typedef struct rnp_symmetric_pass_info_t {
  *  For operations with OpenPGP embedded data (i.e. encrypted data and attached signatures):
  *  - filename, filemtime : to specify information about the contents of literal data packet
  *  - zalg, zlevel : compression algorithm and level, zlevel = 0 to disable compression
+ *  - zadaptive : compress the data sample first, and depending on the gain store data
+ *    uncompressed or use the fastest compression level
+ *  - zalg_out, zlevel_out : compression actually applied, set during the processing
  *
  *  For encryption operation (including encrypt-and-sign):
  *  - halg : hash algorithm used during key derivation for password-based encryption
@@ -85,6 +88,7 @@ typedef struct rnp_symmetric_pass_info_t {
  *  - halg : hash algorithm used to calculate signature(s)
  *  - signers : list of rnp_signer_info_t structures describing signing key and parameters
  *  - sigcreate, sigexpire : default signature(s) creation and expiration times
+ *  - threads : maximum number of threads used to calculate signatures of multiple signers
  *  - filename, filemtime, zalg, zlevel : only for attached signatures, see previous
  *
  *  For data decryption and/or verification there is not much of fields:
@@ -103,11 +107,21 @@ typedef struct rnp_ctx_t {
     pgp_symm_alg_t ealg{};      /* encryption algorithm */
     int            zalg{};      /* compression algorithm used */
     int            zlevel{};    /* compression level */
+    bool           zadaptive{}; /* skip or lower compression for incompressible data */
     pgp_aead_alg_t aalg{};      /* non-zero to use AEAD */
     int            abits{};     /* AEAD chunk bits */
     bool           overwrite{}; /* allow to overwrite output file if exists */
     bool           armor{};     /* whether to use ASCII armor on output */
     bool           no_wrap{};   /* do not wrap source in literal data packet */
+    size_t         threads{};   /* max threads used for signing, 0 to use CPU count */
+
+    /* compression, actually applied to the data */
+    int zalg_out{};
+    int zlevel_out{};
+
+    /* do not lock back keys, unlocked for the decryption */
+    bool keep_unlocked{};
+
 #if defined(ENABLE_CRYPTO_REFRESH)
     bool enable_pkesk_v6{}; /* allows pkesk v6 if list of recipients is suitable */
 #endif
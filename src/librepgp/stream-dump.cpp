@@ -764,7 +764,7 @@ signature_dump_subpackets(rnp_dump_ctx_t * ctx,
 {
     bool empty = true;
 
-    for (auto &subpkt : sig->subpkts) {
+    for (auto &subpkt : sig->subpkts()) {
         if (subpkt->hashed() != hashed) {
             continue;
         }
@@ -1947,7 +1947,7 @@ signature_dump_subpackets_json(rnp_dump_ctx_t *ctx, const pgp_signature_t *sig)
     }
     rnp::JSONObject reswrap(res);
 
-    for (auto &subpkt : sig->subpkts) {
+    for (auto &subpkt : sig->subpkts()) {
         json_object *jso_subpkt = json_object_new_object();
         if (json_object_array_add(res, jso_subpkt)) {
             json_object_put(jso_subpkt);
@@ -214,11 +214,27 @@ process_pgp_key_auto(pgp_source_t &          src,
 
 rnp_result_t
 process_pgp_keys(pgp_source_t &src, pgp_key_sequence_t &keys, bool skiperrors)
+{
+    keys.keys.clear();
+    rnp_result_t ret = process_pgp_keys(
+      src,
+      [&keys](pgp_transferable_key_t &key) {
+          keys.keys.emplace_back(std::move(key));
+          return RNP_SUCCESS;
+      },
+      skiperrors);
+    if (ret) {
+        keys.keys.clear();
+    }
+    return ret;
+}
+
+rnp_result_t
+process_pgp_keys(pgp_source_t &src, const pgp_key_handler_t &handler, bool skiperrors)
 {
     bool has_secret = false;
     bool has_public = false;
 
-    keys.keys.clear();
     /* create maybe-armored stream */
     rnp::ArmoredSource armor(
       src, rnp::ArmoredSource::AllowBinary | rnp::ArmoredSource::AllowMultiple);
@@ -236,7 +252,6 @@ process_pgp_keys(pgp_source_t &src, pgp_key_sequence_t &keys, bool skiperrors)
         pgp_transferable_key_t curkey;
         rnp_result_t ret = process_pgp_key_auto(armor.src(), curkey, false, skiperrors);
         if (ret && (!skiperrors || (ret != RNP_ERROR_BAD_FORMAT))) {
-            keys.keys.clear();
             return ret;
         }
         /* check whether we actually read any key or just skipped erroneous packets */
@@ -246,7 +261,10 @@ process_pgp_keys(pgp_source_t &src, pgp_key_sequence_t &keys, bool skiperrors)
         has_secret |= (curkey.key.tag == PGP_PKT_SECRET_KEY);
         has_public |= (curkey.key.tag == PGP_PKT_PUBLIC_KEY);
 
-        keys.keys.emplace_back(std::move(curkey));
+        ret = handler(curkey);
+        if (ret) {
+            return ret;
+        }
     }
 
     if (has_secret && has_public) {
@@ -254,7 +272,6 @@ process_pgp_keys(pgp_source_t &src, pgp_key_sequence_t &keys, bool skiperrors)
     }
 
     if (armor.error()) {
-        keys.keys.clear();
         return RNP_ERROR_READ;
     }
     return RNP_SUCCESS;
@@ -846,6 +863,12 @@ pgp_key_pkt_t::~pgp_key_pkt_t()
     free(sec_data);
 }
 
+size_t
+pgp_key_pkt_t::memory_usage() const noexcept
+{
+    return sizeof(*this) + hashed_len + sec_len + (material ? material->memory_usage() : 0);
+}
+
 #if defined(ENABLE_CRYPTO_REFRESH)
 uint8_t
 pgp_key_pkt_t::s2k_specifier_len(pgp_s2k_specifier_t specifier)
@@ -30,6 +30,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <sys/types.h>
+#include <functional>
 #include "rnp.h"
 #include "stream-common.h"
 #include "stream-sig.h"
@@ -72,6 +73,9 @@ typedef struct pgp_key_pkt_t {
     /** @brief Fills the hashed (signed) data part of the key packet. Must be called before
      *         pgp_key_pkt_t::write() on the newly generated key */
     void fill_hashed_data();
+    /** @brief Approximate number of bytes occupied by the key packet in memory, including
+     *         the key material. */
+    size_t memory_usage() const noexcept;
 
   private:
     /* create the contents of the algorithm specific public key fields in a separate packet */
@@ -127,6 +131,16 @@ rnp_result_t process_pgp_key_auto(pgp_source_t &          src,
 
 rnp_result_t process_pgp_keys(pgp_source_t &src, pgp_key_sequence_t &keys, bool skiperrors);
 
+/* Handler which is called for each key read by the process_pgp_keys(). Non-zero return value
+   stops the processing. */
+typedef std::function<rnp_result_t(pgp_transferable_key_t &)> pgp_key_handler_t;
+
+/* Process sequence of the transferable keys, passing each of them to the handler as soon as it
+   is read, so only single key is kept in memory at a time. */
+rnp_result_t process_pgp_keys(pgp_source_t &           src,
+                              const pgp_key_handler_t &handler,
+                              bool                     skiperrors);
+
 rnp_result_t process_pgp_key(pgp_source_t &src, pgp_transferable_key_t &key, bool skiperrors);
 
 rnp_result_t process_pgp_subkey(pgp_source_t &             src,
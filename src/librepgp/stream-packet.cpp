@@ -769,7 +769,7 @@ pgp_packet_body_t::add_subpackets(const pgp_signature_t &sig, bool hashed)
 {
     pgp_packet_body_t spbody(PGP_PKT_RESERVED);
 
-    for (auto &subpkt : sig.subpkts) {
+    for (auto &subpkt : sig.subpkts()) {
         if (subpkt->hashed() != hashed) {
             continue;
         }
@@ -780,25 +780,30 @@ pgp_packet_body_t::add_subpackets(const pgp_signature_t &sig, bool hashed)
         spbody.add_byte(subpkt->raw_type() | (subpkt->critical() << 7));
         spbody.add(subpkt->data().data(), subpkt->data().size());
     }
+    add_subpackets(spbody.data_, sig.version);
+}
 
-    if (spbody.data_.size() > 0xffff) {
+void
+pgp_packet_body_t::add_subpackets(const std::vector<uint8_t> &raw, pgp_version_t version)
+{
+    if (raw.size() > 0xffff) {
         throw rnp::rnp_exception(RNP_ERROR_BAD_PARAMETERS);
     }
-    switch (sig.version) {
+    switch (version) {
     case PGP_V4:
     case PGP_V5:
-        add_uint16(spbody.data_.size());
+        add_uint16(raw.size());
         break;
 #if defined(ENABLE_CRYPTO_REFRESH)
     case PGP_V6:
-        add_uint32(spbody.data_.size());
+        add_uint32(raw.size());
         break;
 #endif
     default:
         RNP_LOG("should not reach this code");
         throw rnp::rnp_exception(RNP_ERROR_BAD_STATE);
     }
-    add(spbody.data_.data(), spbody.data_.size());
+    add(raw.data(), raw.size());
 }
 
 void
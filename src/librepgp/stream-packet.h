@@ -149,6 +149,12 @@ typedef struct pgp_packet_body_t {
      * @param hashed whether write hashed or not hashed subpackets
      */
     void add_subpackets(const pgp_signature_t &sig, bool hashed);
+    /**
+     * @brief add raw signature subpackets area (including its length) to the packet body
+     * @param raw encoded subpackets
+     * @param version signature version, which defines the length field size
+     */
+    void add_subpackets(const std::vector<uint8_t> &raw, pgp_version_t version);
     /** @brief add ec curve description to the packet body */
     void add(const pgp_curve_t curve);
     /** @brief add s2k description to the packet body */
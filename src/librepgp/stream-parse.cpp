@@ -31,6 +31,7 @@
 #include <string.h>
 #include <string>
 #include <vector>
+#include <algorithm>
 #include <time.h>
 #include <cinttypes>
 #include <cassert>
@@ -1379,25 +1380,28 @@ cleartext_src_read(pgp_source_t *src, void *buf, size_t len, size_t *readres)
             break;
         }
 
-        /* processing data line by line, eol could be \n or \r\n */
-        for (cur = srcb, bg = srcb, en = cur + read; cur < en; cur++) {
-            if ((*cur == CH_LF) ||
-                ((*cur == CH_CR) && (cur + 1 < en) && (*(cur + 1) == CH_LF))) {
-                cleartext_process_line(src, bg, cur - bg, true);
-                /* processing eol */
-                if (param->clr_eod) {
-                    break;
-                }
+        /* processing data line by line, eol could be \n or \r\n. memchr() is vectorized by
+         * libc so locating line ends this way is much faster than checking each byte. */
+        bg = srcb;
+        en = srcb + read;
+        while ((bg < en) && (cur = (uint8_t *) memchr(bg, CH_LF, en - bg))) {
+            if ((cur > bg) && (*(cur - 1) == CH_CR)) {
+                cur--;
+            }
+            cleartext_process_line(src, bg, cur - bg, true);
+            /* processing eol */
+            if (param->clr_eod) {
+                break;
+            }
 
-                /* processing eol */
-                param->clr_fline = false;
-                param->clr_mline = false;
-                if (*cur == CH_CR) {
-                    param->out[param->outlen++] = *cur++;
-                }
-                param->out[param->outlen++] = *cur;
-                bg = cur + 1;
+            /* processing eol */
+            param->clr_fline = false;
+            param->clr_mline = false;
+            if (*cur == CH_CR) {
+                param->out[param->outlen++] = *cur++;
             }
+            param->out[param->outlen++] = *cur;
+            bg = cur + 1;
         }
 
         /* if line is larger then 4k then just dump it out */
@@ -1434,6 +1438,16 @@ cleartext_src_read(pgp_source_t *src, void *buf, size_t len, size_t *readres)
     return true;
 }
 
+static void
+encrypted_report_key(pgp_source_encrypted_param_t *param,
+                     pgp_symm_alg_t                alg,
+                     const uint8_t *               key)
+{
+    if (param->handler && param->handler->on_decryption_key) {
+        param->handler->on_decryption_key(key, pgp_key_size(alg), param->handler->param);
+    }
+}
+
 static bool
 encrypted_decrypt_cfb_header(pgp_source_encrypted_param_t *param,
                              pgp_symm_alg_t                alg,
@@ -1469,6 +1483,7 @@ encrypted_decrypt_cfb_header(pgp_source_encrypted_param_t *param,
 
     param->pkt.readsrc->skip(blsize + 2);
     param->decrypt = crypt;
+    encrypted_report_key(param, alg, key);
 
     /* init mdc if it is here */
     /* RFC 4880, 5.13: Unlike the Symmetrically Encrypted Data Packet, no special CFB
@@ -1479,7 +1494,7 @@ encrypted_decrypt_cfb_header(pgp_source_encrypted_param_t *param,
     }
 
     try {
-        param->mdc = rnp::Hash::create(PGP_HASH_SHA1);
+        param->mdc = rnp::Hash::create_fast(PGP_HASH_SHA1);
         param->mdc->add(dechdr, blsize + 2);
     } catch (const std::exception &e) {
         /* LCOV_EXCL_START */
@@ -1500,7 +1515,8 @@ encrypted_start_aead(pgp_source_encrypted_param_t *param, pgp_symm_alg_t alg, ui
     RNP_LOG("AEAD is not enabled.");
     return false;
 #else
-    size_t gran;
+    size_t         gran;
+    const uint8_t *sesskey = key;
 
     if (alg != param->aead_hdr.ealg) {
         return false;
@@ -1533,7 +1549,11 @@ encrypted_start_aead(pgp_source_encrypted_param_t *param, pgp_symm_alg_t alg, ui
         return false;
     }
 
-    return encrypted_start_aead_chunk(param, 0, false);
+    if (!encrypted_start_aead_chunk(param, 0, false)) {
+        return false;
+    }
+    encrypted_report_key(param, alg, sesskey);
+    return true;
 #endif
 }
 
@@ -1571,6 +1591,7 @@ static bool
 encrypted_try_key(pgp_source_encrypted_param_t *param,
                   pgp_pk_sesskey_t &            sesskey,
                   pgp_key_t &                   seckey,
+                  rnp::KeyLocker &              seclock,
                   rnp::SecurityContext &        ctx)
 {
     pgp_encrypted_material_t encmaterial;
@@ -1578,8 +1599,8 @@ encrypted_try_key(pgp_source_encrypted_param_t *param,
         if (!sesskey.parse_material(encmaterial) || !seckey.material()) {
             return false;
         }
-        seckey.material()->validate(ctx, false);
-        if (!seckey.material()->valid()) {
+        /* key may be used by the other operations at the same time */
+        if (!seclock.validate(ctx)) {
             RNP_LOG("Attempt to decrypt using the key with invalid material.");
             return false;
         }
@@ -2118,6 +2139,8 @@ get_aead_src_hdr(pgp_source_t *src, pgp_aead_hdr_t *hdr)
 
 #define MAX_RECIPIENTS 16384
 
+static rnp_result_t encrypted_read_body_hdr(pgp_source_encrypted_param_t *param, int ptype);
+
 static rnp_result_t
 encrypted_read_packet_data(pgp_source_encrypted_param_t *param)
 {
@@ -2195,7 +2218,13 @@ encrypted_read_packet_data(pgp_source_encrypted_param_t *param)
     if (errcode) {
         return errcode;
     }
+    return encrypted_read_body_hdr(param, ptype);
+}
 
+/* Read encryption parameters from the beginning of the encrypted packet's body */
+static rnp_result_t
+encrypted_read_body_hdr(pgp_source_encrypted_param_t *param, int ptype)
+{
     /* Reading header of encrypted packet */
     if (ptype == PGP_PKT_AEAD_ENCRYPTED) {
         param->auth_type = rnp::AuthType::AEADv1;
@@ -2399,15 +2428,15 @@ init_encrypted_src(pgp_parse_handler_t *handler, pgp_source_t *src, pgp_source_t
                 continue;
             }
             /* Decrypt key */
-            rnp::KeyLocker seclock(*seckey);
-            if (!seckey->unlock(*handler->password_provider, PGP_OP_DECRYPT)) {
+            rnp::KeyLocker seclock(*seckey, !handler->ctx->keep_unlocked);
+            if (!seclock.unlock(*handler->password_provider, PGP_OP_DECRYPT)) {
                 errcode = RNP_ERROR_BAD_PASSWORD;
                 continue;
             }
 
             /* Try to initialize the decryption */
             rnp::LogStop logstop(hidden);
-            if (encrypted_try_key(param, pubenc, *seckey, *handler->ctx->ctx)) {
+            if (encrypted_try_key(param, pubenc, *seckey, seclock, *handler->ctx->ctx)) {
                 have_key = true;
                 /* inform handler that we used this pubenc */
                 if (handler->on_decryption_start) {
@@ -2942,3 +2971,504 @@ finish:
     free(readbuf);
     return res;
 }
+
+/* Run of equal-sized parts of the packet body. Each part after the first one is preceded by
+ * the one-byte partial length header, so its position may be calculated. */
+typedef struct pgp_source_frame_t {
+    uint64_t off;   /* offset of the first frame's data within the packet body */
+    uint64_t pos;   /* position of the first frame's data within the underlying source */
+    uint64_t len;   /* number of data bytes in each frame */
+    uint64_t count; /* number of frames in the run */
+} pgp_source_frame_t;
+
+/* seekable source with the body of the (partial length) packet */
+typedef struct pgp_source_framed_param_t {
+    pgp_source_t *                  readsrc{};  /* seekable source to read the packet from */
+    bool                            ownsrc{};   /* close and delete readsrc on close */
+    bool                            complete{}; /* the last frame is already known */
+    uint64_t                        pos{};      /* current position within the packet body */
+    std::vector<pgp_source_frame_t> frames;     /* known frame runs, sorted by offset */
+} pgp_source_framed_param_t;
+
+static bool
+framed_src_read_len(pgp_source_t *readsrc, uint64_t pos, size_t &len, bool &last)
+{
+    if (!readsrc->seek(pos)) {
+        return false;
+    }
+    /* do not fill the whole cache as the data after the header may be skipped */
+    bool readahead = readsrc->cache->readahead;
+    readsrc->cache->readahead = false;
+    bool res = stream_read_partial_chunk_len(readsrc, &len, &last);
+    readsrc->cache->readahead = readahead;
+    return res;
+}
+
+/* Make sure that frame with the offset off is known, unless it is beyond the body end.
+ * Headers are never guessed: each of them is read, while frame data is skipped, and
+ * equal-sized frames are stored as a single run to keep the cache small. */
+static bool
+framed_src_locate(pgp_source_framed_param_t *param, uint64_t off)
+{
+    while (!param->complete) {
+        pgp_source_frame_t &prev = param->frames.back();
+        uint64_t            end = prev.off + prev.count * prev.len;
+        if (off < end) {
+            return true;
+        }
+        uint64_t hdrpos = prev.pos + prev.count * (prev.len + 1) - 1;
+        size_t   len = 0;
+        bool     last = false;
+        if (!framed_src_read_len(param->readsrc, hdrpos, len, last)) {
+            RNP_LOG("failed to read partial length");
+            return false;
+        }
+        uint64_t pos = param->readsrc->readb;
+        if (!last && (len == prev.len) && (pos == hdrpos + 1)) {
+            prev.count++;
+        } else {
+            param->frames.push_back({end, pos, len, 1});
+        }
+        param->complete = last;
+    }
+    return true;
+}
+
+static bool
+framed_src_read(pgp_source_t *src, void *buf, size_t len, size_t *readres)
+{
+    auto   param = (pgp_source_framed_param_t *) src->param;
+    size_t left = len;
+
+    while (left) {
+        if (!framed_src_locate(param, param->pos)) {
+            return false;
+        }
+        auto frame = std::upper_bound(
+          param->frames.begin(),
+          param->frames.end(),
+          param->pos,
+          [](uint64_t off, const pgp_source_frame_t &fr) { return off < fr.off; });
+        frame--;
+        if (param->pos >= frame->off + frame->count * frame->len) {
+            /* end of the packet body */
+            break;
+        }
+        uint64_t idx = (param->pos - frame->off) / frame->len;
+        uint64_t foff = param->pos - frame->off - idx * frame->len;
+        uint64_t fpos = frame->pos + idx * (frame->len + 1) + foff;
+        size_t   fleft = std::min<uint64_t>(left, frame->len - foff);
+        size_t   read = 0;
+        if ((param->readsrc->readb != fpos) && !param->readsrc->seek(fpos)) {
+            return false;
+        }
+        if (!param->readsrc->read(buf, fleft, &read)) {
+            return false;
+        }
+        if (!read) {
+            RNP_LOG("unexpected end of data");
+            return false;
+        }
+        buf = (uint8_t *) buf + read;
+        left -= read;
+        param->pos += read;
+    }
+    *readres = len - left;
+    return true;
+}
+
+static bool
+framed_src_seek(pgp_source_t *src, uint64_t pos)
+{
+    auto param = (pgp_source_framed_param_t *) src->param;
+    param->pos = pos;
+    return true;
+}
+
+static void
+framed_src_close(pgp_source_t *src)
+{
+    auto param = (pgp_source_framed_param_t *) src->param;
+    if (!param) {
+        return;
+    }
+    if (param->ownsrc) {
+        param->readsrc->close();
+        delete param->readsrc;
+    }
+    delete param;
+    src->param = NULL;
+}
+
+/* Init source with the packet body, starting with frame at pos of the readsrc */
+static rnp_result_t
+init_framed_src(pgp_source_t *src,
+                pgp_source_t *readsrc,
+                uint64_t      pos,
+                uint64_t      len,
+                bool          last)
+{
+    if (!init_src_common(src, 0)) {
+        return RNP_ERROR_OUT_OF_MEMORY; // LCOV_EXCL_LINE
+    }
+    auto param = new (std::nothrow) pgp_source_framed_param_t();
+    if (!param) {
+        /* LCOV_EXCL_START */
+        src->close();
+        return RNP_ERROR_OUT_OF_MEMORY;
+        /* LCOV_EXCL_END */
+    }
+    param->readsrc = readsrc;
+    param->complete = last;
+    param->frames.push_back({0, pos, len, 1});
+    src->param = param;
+    src->raw_read = framed_src_read;
+    src->raw_seek = framed_src_seek;
+    src->raw_close = framed_src_close;
+    src->type = PGP_STREAM_PARLEN_PACKET;
+    return RNP_SUCCESS;
+}
+
+#if defined(ENABLE_AEAD)
+/* chunk is kept in memory while accessed, so limit its size */
+#define PGP_AEAD_RANGE_MAX_CHUNK (4 * 1024 * 1024)
+
+/* seekable source with the decrypted contents of AEAD-encrypted packet */
+typedef struct pgp_source_aead_range_param_t {
+    pgp_source_encrypted_param_t enc;        /* encryption parameters */
+    pgp_source_t                 body{};     /* encrypted packet body, without the framing */
+    uint64_t                     hdrlen{};   /* length of the body header before chunks */
+    size_t                       taglen{};   /* length of the authentication tag */
+    std::vector<uint8_t>         chunk;      /* currently loaded chunk */
+    bool                         loaded{};   /* whether chunk is loaded */
+    size_t                       chunkidx{}; /* index of the loaded chunk */
+    size_t                       chunklen{}; /* number of decrypted bytes in the chunk */
+    uint64_t                     pos{};      /* current position within the decrypted data */
+} pgp_source_aead_range_param_t;
+
+/* Read and decrypt the chunk, checking the final tag if it is the last one */
+static bool
+aead_range_load_chunk(pgp_source_aead_range_param_t *param, size_t idx)
+{
+    auto &   enc = param->enc;
+    size_t   taglen = param->taglen;
+    uint8_t *buf = param->chunk.data();
+    /* read one more byte after the final tag to check whether it is the last chunk */
+    size_t need = enc.chunklen + 2 * taglen + 1;
+    size_t read = 0;
+
+    param->loaded = false;
+    if (!param->body.seek(param->hdrlen + (uint64_t) idx * (enc.chunklen + taglen)) ||
+        !param->body.read(buf, need, &read)) {
+        return false;
+    }
+    bool   last = read < need;
+    size_t datalen = enc.chunklen;
+    if (last && (read <= taglen) && (idx || (read == taglen))) {
+        /* only final tag or nothing: beyond the end, or empty message */
+        datalen = 0;
+    } else if (last) {
+        if (read < 2 * taglen) {
+            RNP_LOG("unexpected end of data");
+            return false;
+        }
+        datalen = read - 2 * taglen;
+        if (!datalen && idx) {
+            RNP_LOG("unexpected empty chunk");
+            return false;
+        }
+    }
+
+    if (datalen) {
+        if (!encrypted_start_aead_chunk(&enc, idx, false)) {
+            return false;
+        }
+        size_t gran = pgp_cipher_aead_granularity(&enc.decrypt);
+        size_t upd = datalen - datalen % gran;
+        size_t done = 0;
+        if (upd && !pgp_cipher_aead_update(enc.decrypt, buf, buf, upd, done)) {
+            RNP_LOG("failed to decrypt chunk %zu", idx);
+            return false;
+        }
+        if (!pgp_cipher_aead_finish(
+              &enc.decrypt, buf + done, buf + done, datalen + taglen - done)) {
+            RNP_LOG("failed to authenticate chunk %zu", idx);
+            return false;
+        }
+    }
+
+    if (last && (datalen || !idx)) {
+        /* final tag authenticates the total length of the data */
+        size_t   adlen = enc.aead_adlen;
+        uint8_t *tag = datalen ? buf + datalen + taglen : buf;
+        enc.chunkin = datalen;
+        bool res = encrypted_start_aead_chunk(&enc, datalen ? idx + 1 : idx, true) &&
+                   pgp_cipher_aead_finish(&enc.decrypt, tag, tag, taglen);
+        enc.aead_adlen = adlen;
+        if (!res) {
+            RNP_LOG("wrong final tag");
+            return false;
+        }
+    }
+
+    param->chunkidx = idx;
+    param->chunklen = datalen;
+    param->loaded = true;
+    return true;
+}
+
+static bool
+aead_range_src_read(pgp_source_t *src, void *buf, size_t len, size_t *readres)
+{
+    auto   param = (pgp_source_aead_range_param_t *) src->param;
+    size_t left = len;
+
+    while (left) {
+        size_t idx = param->pos / param->enc.chunklen;
+        size_t off = param->pos % param->enc.chunklen;
+        if ((!param->loaded || (param->chunkidx != idx)) &&
+            !aead_range_load_chunk(param, idx)) {
+            return false;
+        }
+        if (off >= param->chunklen) {
+            /* end of the data */
+            break;
+        }
+        size_t cnt = std::min(left, param->chunklen - off);
+        memcpy(buf, param->chunk.data() + off, cnt);
+        buf = (uint8_t *) buf + cnt;
+        left -= cnt;
+        param->pos += cnt;
+    }
+    *readres = len - left;
+    return true;
+}
+
+static bool
+aead_range_src_seek(pgp_source_t *src, uint64_t pos)
+{
+    auto param = (pgp_source_aead_range_param_t *) src->param;
+    param->pos = pos;
+    return true;
+}
+
+static void
+aead_range_src_close(pgp_source_t *src)
+{
+    auto param = (pgp_source_aead_range_param_t *) src->param;
+    if (!param) {
+        return;
+    }
+    pgp_cipher_aead_destroy(&param->enc.decrypt);
+    param->body.close();
+    delete param;
+    src->param = NULL;
+}
+
+/* Init source with decrypted contents of AEAD-encrypted packet, starting at readsrc's pos */
+static rnp_result_t
+init_aead_range_plain_src(pgp_source_t * src,
+                          pgp_source_t * readsrc,
+                          uint64_t       pos,
+                          const uint8_t *key,
+                          size_t         keylen)
+{
+    pgp_packet_hdr_t hdr = {};
+    rnp_result_t     ret = stream_peek_packet_hdr(readsrc, &hdr);
+    if (ret) {
+        return ret;
+    }
+    if ((hdr.tag != PGP_PKT_AEAD_ENCRYPTED) && (hdr.tag != PGP_PKT_SE_IP_DATA)) {
+        RNP_LOG("unsupported packet: %d", (int) hdr.tag);
+        return RNP_ERROR_NOT_SUPPORTED;
+    }
+    uint64_t bodypos = pos + hdr.hdr_len;
+    uint64_t bodylen = hdr.pkt_len;
+    if (hdr.partial) {
+        bodylen = get_partial_pkt_len(hdr.hdr[hdr.hdr_len - 1]);
+    } else if (hdr.indeterminate) {
+        if (!readsrc->knownsize || (readsrc->size < bodypos)) {
+            RNP_LOG("unknown packet length");
+            return RNP_ERROR_NOT_SUPPORTED;
+        }
+        bodylen = readsrc->size - bodypos;
+    }
+
+    if (!init_src_common(src, 0)) {
+        return RNP_ERROR_OUT_OF_MEMORY; // LCOV_EXCL_LINE
+    }
+    auto param = new (std::nothrow) pgp_source_aead_range_param_t();
+    if (!param) {
+        /* LCOV_EXCL_START */
+        src->close();
+        return RNP_ERROR_OUT_OF_MEMORY;
+        /* LCOV_EXCL_END */
+    }
+    src->param = param;
+    src->raw_read = aead_range_src_read;
+    src->raw_seek = aead_range_src_seek;
+    src->raw_close = aead_range_src_close;
+    src->type = PGP_STREAM_ENCRYPTED;
+
+    rnp::secure_array<uint8_t, PGP_MAX_KEY_SIZE> keybuf;
+    auto &                                       enc = param->enc;
+    ret = init_framed_src(&param->body, readsrc, bodypos, bodylen, !hdr.partial);
+    if (ret) {
+        goto finish;
+    }
+    enc.pkt.hdr = hdr;
+    enc.pkt.readsrc = &param->body;
+    if ((ret = encrypted_read_body_hdr(&enc, hdr.tag))) {
+        goto finish;
+    }
+    if (enc.use_cfb()) {
+        RNP_LOG("random access is available only for AEAD-encrypted data");
+        ret = RNP_ERROR_NOT_SUPPORTED;
+        goto finish;
+    }
+    if (enc.chunklen > PGP_AEAD_RANGE_MAX_CHUNK) {
+        RNP_LOG("too large chunk size: %zu", enc.chunklen);
+        ret = RNP_ERROR_NOT_SUPPORTED;
+        goto finish;
+    }
+    if (keylen != pgp_key_size(enc.aead_hdr.ealg)) {
+        RNP_LOG("wrong session key length");
+        ret = RNP_ERROR_BAD_PARAMETERS;
+        goto finish;
+    }
+    memcpy(keybuf.data(), key, keylen);
+    if (!encrypted_start_aead(&enc, enc.aead_hdr.ealg, keybuf.data())) {
+        RNP_LOG("failed to start decryption");
+        ret = RNP_ERROR_BAD_PARAMETERS;
+        goto finish;
+    }
+    try {
+        param->hdrlen = param->body.readb;
+        param->taglen = pgp_cipher_aead_tag_len(enc.aead_hdr.aalg);
+        param->chunk.resize(enc.chunklen + 2 * param->taglen + 1);
+    } catch (const std::exception &e) {
+        /* LCOV_EXCL_START */
+        RNP_LOG("%s", e.what());
+        ret = RNP_ERROR_OUT_OF_MEMORY;
+        /* LCOV_EXCL_END */
+    }
+finish:
+    if (ret) {
+        src->close();
+    }
+    return ret;
+}
+#endif
+
+rnp_result_t
+init_aead_range_src(pgp_source_t * src,
+                    pgp_source_t * readsrc,
+                    const uint8_t *key,
+                    size_t         keylen)
+{
+#if !defined(ENABLE_AEAD)
+    RNP_LOG("AEAD is not enabled.");
+    return RNP_ERROR_NOT_SUPPORTED;
+#else
+    if (!readsrc->seekable() || !readsrc->seek(0)) {
+        RNP_LOG("source is not seekable");
+        return RNP_ERROR_NOT_SUPPORTED;
+    }
+    if (readsrc->is_armored()) {
+        RNP_LOG("armored data is not supported");
+        return RNP_ERROR_NOT_SUPPORTED;
+    }
+
+    /* skip the session key packets */
+    pgp_packet_hdr_t hdr = {};
+    uint64_t         pos = 0;
+    rnp_result_t     ret = RNP_SUCCESS;
+    while (!(ret = stream_peek_packet_hdr(readsrc, &hdr))) {
+        if ((hdr.tag != PGP_PKT_PK_SESSION_KEY) && (hdr.tag != PGP_PKT_SK_SESSION_KEY) &&
+            (hdr.tag != PGP_PKT_MARKER)) {
+            break;
+        }
+        if (hdr.partial || hdr.indeterminate) {
+            RNP_LOG("wrong packet length");
+            return RNP_ERROR_BAD_FORMAT;
+        }
+        pos += hdr.hdr_len + hdr.pkt_len;
+        if (!readsrc->seek(pos)) {
+            return RNP_ERROR_READ;
+        }
+    }
+    if (ret) {
+        return ret;
+    }
+
+    pgp_source_t *plain = new (std::nothrow) pgp_source_t();
+    if (!plain) {
+        return RNP_ERROR_OUT_OF_MEMORY; // LCOV_EXCL_LINE
+    }
+    if ((ret = init_aead_range_plain_src(plain, readsrc, pos, key, keylen))) {
+        delete plain;
+        return ret;
+    }
+
+    /* skip one-pass signatures and find the literal data packet */
+    uint8_t  lithdr[2] = {};
+    uint64_t litpos = 0;
+    uint64_t litlen = 0;
+    pos = 0;
+    while (!(ret = stream_peek_packet_hdr(plain, &hdr))) {
+        if (hdr.tag == PGP_PKT_LITDATA) {
+            break;
+        }
+        if (hdr.tag == PGP_PKT_COMPRESSED) {
+            RNP_LOG("random access is not available for compressed data");
+            ret = RNP_ERROR_NOT_SUPPORTED;
+            goto finish;
+        }
+        if (((hdr.tag != PGP_PKT_ONE_PASS_SIG) && (hdr.tag != PGP_PKT_SIGNATURE) &&
+             (hdr.tag != PGP_PKT_MARKER)) ||
+            hdr.partial || hdr.indeterminate) {
+            RNP_LOG("unexpected packet %d", (int) hdr.tag);
+            ret = RNP_ERROR_BAD_FORMAT;
+            goto finish;
+        }
+        pos += hdr.hdr_len + hdr.pkt_len;
+        if (!plain->seek(pos)) {
+            ret = RNP_ERROR_READ;
+            goto finish;
+        }
+    }
+    if (ret) {
+        goto finish;
+    }
+    if (hdr.indeterminate) {
+        RNP_LOG("indeterminate literal data length is not supported");
+        ret = RNP_ERROR_NOT_SUPPORTED;
+        goto finish;
+    }
+    /* format, file name length, file name and timestamp */
+    plain->skip(hdr.hdr_len);
+    if (!plain->read_eq(lithdr, 2)) {
+        RNP_LOG("failed to read literal header");
+        ret = RNP_ERROR_READ;
+        goto finish;
+    }
+    litpos = pos + hdr.hdr_len + 6 + lithdr[1];
+    litlen = hdr.partial ? get_partial_pkt_len(hdr.hdr[hdr.hdr_len - 1]) : hdr.pkt_len;
+    if (litlen < 6U + lithdr[1]) {
+        RNP_LOG("wrong literal header");
+        ret = RNP_ERROR_BAD_FORMAT;
+        goto finish;
+    }
+    litlen -= 6 + lithdr[1];
+    if ((ret = init_framed_src(src, plain, litpos, litlen, !hdr.partial))) {
+        goto finish;
+    }
+    ((pgp_source_framed_param_t *) src->param)->ownsrc = true;
+    src->type = PGP_STREAM_LITERAL;
+    return RNP_SUCCESS;
+finish:
+    plain->close();
+    delete plain;
+    return ret;
+#endif
+}
@@ -55,6 +55,7 @@ typedef void pgp_decryption_info_func_t(bool           mdc,
                                         pgp_symm_alg_t salg,
                                         void *         param);
 typedef void pgp_decryption_done_func_t(bool validated, void *param);
+typedef void pgp_decryption_key_func_t(const uint8_t *key, size_t len, void *param);
 
 /* handler used to return needed information during pgp source processing */
 typedef struct pgp_parse_handler_t {
@@ -69,6 +70,7 @@ typedef struct pgp_parse_handler_t {
     pgp_decryption_start_func_t *on_decryption_start; /* called when decryption key obtained */
     pgp_decryption_info_func_t * on_decryption_info;  /* called when decryption is started */
     pgp_decryption_done_func_t * on_decryption_done;  /* called when decryption is finished */
+    pgp_decryption_key_func_t *  on_decryption_key;   /* called with the session key used */
     pgp_signatures_func_t *      on_signatures;       /* for signature verification results */
 
     rnp_ctx_t *ctx;   /* operation context */
@@ -127,4 +129,21 @@ bool get_seipdv2_src_hdr(pgp_source_t *src, pgp_seipdv2_hdr_t *hdr);
  */
 bool get_aead_src_hdr(pgp_source_t *src, pgp_aead_hdr_t *hdr);
 
+/* @brief Init seekable source with the literal data of AEAD-encrypted (v5 AEAD or SEIPDv2)
+ *        message, using the known session key. Only chunks, covering the data being read,
+ *        are read and decrypted, so any part of the large message may be accessed quickly.
+ *        Literal data must not be compressed. Partial lengths of the literal data packet
+ *        are expected to be of the same size: headers in between are not read when seeking
+ *        over them, but if guessed header doesn't match then all of them are read.
+ * @param src allocated pgp_source_t structure
+ * @param readsrc seekable source with the binary encrypted message. Must outlive src.
+ * @param key session key
+ * @param keylen length of the session key, must match the symmetric algorithm
+ * @return RNP_SUCCESS on success or error code otherwise
+ */
+rnp_result_t init_aead_range_src(pgp_source_t * src,
+                                 pgp_source_t * readsrc,
+                                 const uint8_t *key,
+                                 size_t         keylen);
+
 #endif
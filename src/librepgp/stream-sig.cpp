@@ -201,6 +201,39 @@ pgp_signature_t::operator!=(const pgp_signature_t &src) const
     return !(*this == src);
 }
 
+pgp_sig_subpkts_t::pgp_sig_subpkts_t(const pgp_sig_subpkts_t &src)
+{
+    /* source may be parsed by the other thread at the moment */
+    std::lock_guard<std::mutex> srclock(src.lock);
+    list = src.list;
+    parsed = src.parsed.load();
+}
+
+pgp_sig_subpkts_t::pgp_sig_subpkts_t(pgp_sig_subpkts_t &&src)
+    : list(std::move(src.list)), parsed(src.parsed.load())
+{
+}
+
+pgp_sig_subpkts_t &
+pgp_sig_subpkts_t::operator=(const pgp_sig_subpkts_t &src)
+{
+    if (&src == this) {
+        return *this;
+    }
+    std::lock_guard<std::mutex> srclock(src.lock);
+    list = src.list;
+    parsed = src.parsed.load();
+    return *this;
+}
+
+pgp_sig_subpkts_t &
+pgp_sig_subpkts_t::operator=(pgp_sig_subpkts_t &&src)
+{
+    list = std::move(src.list);
+    parsed = src.parsed.load();
+    return *this;
+}
+
 pgp_sig_id_t
 pgp_signature_t::get_id() const
 {
@@ -214,21 +247,51 @@ pgp_signature_t::get_id() const
     return res;
 }
 
+size_t
+pgp_signature_t::memory_usage() const noexcept
+{
+    size_t res = sizeof(*this) + hashed_data.capacity() + material_buf.capacity();
+    res += unhashed_data_.capacity();
+    std::lock_guard<std::mutex> lock(subpkts_.lock);
+    res += subpkts_.list.items.capacity() * sizeof(pgp::pkt::sigsub::RawPtr);
+    for (auto &subpkt : subpkts_.list.items) {
+        res += subpkt->memory_usage();
+    }
+#if defined(ENABLE_CRYPTO_REFRESH)
+    res += salt.capacity();
+#endif
+    return res;
+}
+
 /* Todo: remove once pgp_signature_t is renamed to pgp::pkt::Signature */
 using namespace pgp::pkt;
 
+sigsub::List &
+pgp_signature_t::subpkts()
+{
+    parse_subpackets();
+    return subpkts_.list;
+}
+
+const sigsub::List &
+pgp_signature_t::subpkts() const
+{
+    parse_subpackets();
+    return subpkts_.list;
+}
+
 sigsub::Raw *
 pgp_signature_t::get_subpkt(uint8_t stype, bool hashed)
 {
     size_t idx = find_subpkt(stype, hashed);
-    return idx == SIZE_MAX ? nullptr : subpkts[idx].get();
+    return idx == SIZE_MAX ? nullptr : subpkts_.list[idx].get();
 }
 
 const sigsub::Raw *
 pgp_signature_t::get_subpkt(uint8_t stype, bool hashed) const
 {
     size_t idx = find_subpkt(stype, hashed);
-    return idx == SIZE_MAX ? nullptr : subpkts[idx].get();
+    return idx == SIZE_MAX ? nullptr : subpkts_.list[idx].get();
 }
 
 sigsub::Raw *
@@ -246,6 +309,10 @@ pgp_signature_t::get_subpkt(sigsub::Type type, bool hashed) const
 bool
 pgp_signature_t::has_subpkt(uint8_t stype, bool hashed) const
 {
+    if (!subpkts_.parsed) {
+        auto &types = hashed ? cache_.hashed : cache_.any;
+        return (stype < types.size()) && types[stype];
+    }
     return find_subpkt(stype, hashed) != SIZE_MAX;
 }
 
@@ -265,7 +332,10 @@ pgp_signature_t::keyid() const noexcept
     }
 
     /* version 4 and up use subpackets */
-    if (version == PGP_V4) {
+    if ((version == PGP_V4) && has_subpkt(PGP_SIG_SUBPKT_ISSUER_KEY_ID, false)) {
+        if (!subpkts_.parsed) {
+            return cache_.keyid;
+        }
         auto sub = dynamic_cast<const sigsub::IssuerKeyID *>(
           get_subpkt(sigsub::Type::IssuerKeyID, false));
         if (sub) {
@@ -292,19 +362,15 @@ pgp_signature_t::set_keyid(const pgp_key_id_t &id)
 bool
 pgp_signature_t::has_keyfp() const
 {
-    auto sub = dynamic_cast<const sigsub::IssuerFingerprint *>(
-      get_subpkt(sigsub::Type::IssuerFingerprint));
-    if (!sub) {
-        return false;
-    }
+    /* keyfp() returns empty fingerprint if there is no subpacket */
     switch (version) {
     case PGP_V4:
-        return sub->fp().length == PGP_FINGERPRINT_V4_SIZE;
+        return keyfp().length == PGP_FINGERPRINT_V4_SIZE;
     case PGP_V5:
 #if defined(ENABLE_CRYPTO_REFRESH)
     case PGP_V6:
 #endif
-        return sub->fp().length == PGP_FINGERPRINT_V5_SIZE;
+        return keyfp().length == PGP_FINGERPRINT_V5_SIZE;
     default:
         return false;
     }
@@ -313,6 +379,9 @@ pgp_signature_t::has_keyfp() const
 pgp_fingerprint_t
 pgp_signature_t::keyfp() const noexcept
 {
+    if (!subpkts_.parsed) {
+        return cache_.keyfp;
+    }
     auto sub = dynamic_cast<const sigsub::IssuerFingerprint *>(
       get_subpkt(sigsub::Type::IssuerFingerprint));
     return sub ? sub->fp() : pgp_fingerprint_t{};
@@ -337,6 +406,9 @@ pgp_signature_t::creation() const
     if (version < PGP_V4) {
         return creation_time;
     }
+    if (!subpkts_.parsed) {
+        return cache_.creation;
+    }
     auto sub =
       dynamic_cast<const sigsub::CreationTime *>(get_subpkt(sigsub::Type::CreationTime));
     return sub ? sub->time() : 0;
@@ -357,6 +429,9 @@ pgp_signature_t::set_creation(uint32_t ctime)
 uint32_t
 pgp_signature_t::expiration() const
 {
+    if (!subpkts_.parsed) {
+        return cache_.expiration;
+    }
     auto sub =
       dynamic_cast<const sigsub::ExpirationTime *>(get_subpkt(sigsub::Type::ExpirationTime));
     return sub ? sub->time() : 0;
@@ -373,6 +448,9 @@ pgp_signature_t::set_expiration(uint32_t etime)
 uint32_t
 pgp_signature_t::key_expiration() const
 {
+    if (!subpkts_.parsed) {
+        return cache_.key_expiration;
+    }
     auto sub = dynamic_cast<const sigsub::KeyExpirationTime *>(
       get_subpkt(sigsub::Type::KeyExpirationTime));
     return sub ? sub->time() : 0;
@@ -389,6 +467,9 @@ pgp_signature_t::set_key_expiration(uint32_t etime)
 uint8_t
 pgp_signature_t::key_flags() const
 {
+    if (!subpkts_.parsed) {
+        return cache_.key_flags;
+    }
     auto sub = dynamic_cast<const sigsub::KeyFlags *>(get_subpkt(sigsub::Type::KeyFlags));
     return sub ? sub->flags() : 0;
 }
@@ -404,6 +485,9 @@ pgp_signature_t::set_key_flags(uint8_t flags)
 bool
 pgp_signature_t::primary_uid() const
 {
+    if (!subpkts_.parsed) {
+        return cache_.primary_uid;
+    }
     auto sub =
       dynamic_cast<const sigsub::PrimaryUserID *>(get_subpkt(sigsub::Type::PrimaryUserID));
     return sub ? sub->primary() : 0;
@@ -710,21 +794,23 @@ pgp_signature_t::add_subpkt(std::unique_ptr<pgp::pkt::sigsub::Raw> &&sub, bool r
     }
 
     sub->write();
+    auto &list = subpkts();
     if (replace) {
         auto idx = find_subpkt(sub->raw_type(), sub->hashed());
         if (idx != SIZE_MAX) {
-            subpkts[idx] = std::move(sub);
+            list[idx] = std::move(sub);
             return;
         }
     }
-    subpkts.items.push_back(std::move(sub));
+    list.items.push_back(std::move(sub));
 }
 
 void
 pgp_signature_t::remove_subpkt(size_t idx)
 {
-    if (idx < subpkts.size()) {
-        subpkts.items.erase(subpkts.begin() + idx);
+    auto &list = subpkts();
+    if (idx < list.size()) {
+        list.items.erase(list.begin() + idx);
     }
 }
 
@@ -784,58 +870,139 @@ pgp_signature_t::parse_v2v3(pgp_packet_body_t &pkt)
 
 #define MAX_SUBPACKETS 64
 
+/* Get the next subpacket from the subpackets area, advancing buf and len */
+static bool
+next_subpacket(const uint8_t *&buf, size_t &len, const uint8_t *&sub, size_t &splen)
+{
+    if (len < 2) {
+        RNP_LOG("got single byte %" PRIu8, *buf);
+        return false;
+    }
+
+    /* subpacket length */
+    splen = *buf++;
+    len--;
+    if ((splen >= 192) && (splen < 255)) {
+        splen = ((splen - 192) << 8) + *buf++ + 192;
+        len--;
+    } else if (splen == 255) {
+        if (len < 4) {
+            RNP_LOG("got 4-byte len but only %zu bytes in buffer", len);
+            return false;
+        }
+        splen = read_uint32(buf);
+        buf += 4;
+        len -= 4;
+    }
+
+    if (!splen) {
+        RNP_LOG("got subpacket with 0 length");
+        return false;
+    }
+
+    /* subpacket data */
+    if (len < splen) {
+        RNP_LOG("got subpacket len %zu, while only %zu bytes left", splen, len);
+        return false;
+    }
+    sub = buf;
+    len -= splen;
+    buf += splen;
+    return true;
+}
+
 bool
-pgp_signature_t::parse_subpackets(uint8_t *buf, size_t len, bool hashed)
+pgp_signature_t::scan_subpackets(const uint8_t *buf, size_t len, bool hashed)
 {
     bool res = true;
 
     while (len) {
-        if (subpkts.size() >= MAX_SUBPACKETS) {
+        if (cache_.count >= MAX_SUBPACKETS) {
             RNP_LOG("too many signature subpackets");
             return false;
         }
-        if (len < 2) {
-            RNP_LOG("got single byte %" PRIu8, *buf);
+        const uint8_t *sub = NULL;
+        size_t         splen = 0;
+        if (!next_subpacket(buf, len, sub, splen)) {
             return false;
         }
+        cache_.count++;
+        if (!sigsub::Raw::check(sub, splen)) {
+            res = false;
+            continue;
+        }
 
-        /* subpacket length */
-        size_t splen = *buf++;
-        len--;
-        if ((splen >= 192) && (splen < 255)) {
-            splen = ((splen - 192) << 8) + *buf++ + 192;
-            len--;
-        } else if (splen == 255) {
-            if (len < 4) {
-                RNP_LOG("got 4-byte len but only %zu bytes in buffer", len);
-                return false;
+        /* remember commonly used fields, sizes are checked by the call above */
+        uint8_t        type = sub[0] & 0x7f;
+        const uint8_t *data = sub + 1;
+        if ((type == PGP_SIG_SUBPKT_ISSUER_KEY_ID) && !cache_.any[type]) {
+            memcpy(cache_.keyid.data(), data, cache_.keyid.size());
+        }
+        if (hashed && !cache_.hashed[type]) {
+            switch (type) {
+            case PGP_SIG_SUBPKT_CREATION_TIME:
+                cache_.creation = read_uint32(data);
+                break;
+            case PGP_SIG_SUBPKT_EXPIRATION_TIME:
+                cache_.expiration = read_uint32(data);
+                break;
+            case PGP_SIG_SUBPKT_KEY_EXPIRY:
+                cache_.key_expiration = read_uint32(data);
+                break;
+            case PGP_SIG_SUBPKT_KEY_FLAGS:
+                cache_.key_flags = data[0];
+                break;
+            case PGP_SIG_SUBPKT_PRIMARY_USER_ID:
+                cache_.primary_uid = data[0];
+                break;
+            case PGP_SIG_SUBPKT_ISSUER_FPR:
+                cache_.keyfp.length = splen - 2;
+                memcpy(cache_.keyfp.fingerprint, data + 1, cache_.keyfp.length);
+                break;
+            default:
+                break;
             }
-            splen = read_uint32(buf);
-            buf += 4;
-            len -= 4;
         }
-
-        if (!splen) {
-            RNP_LOG("got subpacket with 0 length");
-            return false;
+        cache_.any.set(type);
+        if (hashed) {
+            cache_.hashed.set(type);
         }
+    }
+    return res;
+}
 
-        /* subpacket data */
-        if (len < splen) {
-            RNP_LOG("got subpacket len %zu, while only %zu bytes left", splen, len);
-            return false;
+void
+pgp_signature_t::parse_subpackets(const uint8_t *buf, size_t len, bool hashed) const
+{
+    while (len) {
+        const uint8_t *sub = NULL;
+        size_t         splen = 0;
+        if (!next_subpacket(buf, len, sub, splen)) {
+            return;
         }
-
-        auto subpkt = sigsub::Raw::create(buf, splen, hashed);
-        if (!subpkt) {
-            res = false;
-        } else {
-            subpkts.items.push_back(std::move(subpkt));
+        auto subpkt = sigsub::Raw::create(sub, splen, hashed);
+        if (subpkt) {
+            subpkts_.list.items.push_back(std::move(subpkt));
         }
-        len -= splen;
-        buf += splen;
     }
-    return res;
+}
+
+void
+pgp_signature_t::parse_subpackets() const
+{
+    if (subpkts_.parsed.load(std::memory_order_acquire)) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(subpkts_.lock);
+    if (subpkts_.parsed.load(std::memory_order_relaxed)) {
+        return;
+    }
+    /* subpackets areas were checked in scan_subpackets() */
+    size_t hoff = version == PGP_V6 ? 8 : 6;
+    subpkts_.list.items.reserve(cache_.count);
+    parse_subpackets(hashed_data.data() + hoff, hashed_data.size() - hoff, true);
+    parse_subpackets(unhashed_data_.data(), unhashed_data_.size(), false);
+    subpkts_.parsed.store(true, std::memory_order_release);
 }
 
 bool
@@ -873,8 +1040,9 @@ pgp_signature_t::find_subpkt(uint8_t stype, bool hashed, size_t skip) const
     if (version < PGP_V4) {
         return SIZE_MAX;
     }
-    for (size_t idx = 0; idx < subpkts.size(); idx++) {
-        if ((subpkts[idx]->raw_type() != stype) || (hashed && !subpkts[idx]->hashed())) {
+    auto &list = subpkts();
+    for (size_t idx = 0; idx < list.size(); idx++) {
+        if ((list[idx]->raw_type() != stype) || (hashed && !list[idx]->hashed())) {
             continue;
         }
         if (!skip) {
@@ -932,8 +1100,10 @@ pgp_signature_t::parse_v4up(pgp_packet_body_t &pkt)
         RNP_LOG("cannot get hashed subpackets data");
         return RNP_ERROR_BAD_FORMAT;
     }
-    /* parsing hashed subpackets */
-    if (!parse_subpackets(hashed_data.data() + 4 + splen_size, splen, true)) {
+    /* checking hashed subpackets, objects are created on first access */
+    subpkts_ = {};
+    cache_ = {};
+    if (!scan_subpackets(hashed_data.data() + 4 + splen_size, splen, true)) {
         RNP_LOG("failed to parse hashed subpackets");
         return RNP_ERROR_BAD_FORMAT;
     }
@@ -947,10 +1117,12 @@ pgp_signature_t::parse_v4up(pgp_packet_body_t &pkt)
         RNP_LOG("not enough data for unhashed subpackets");
         return RNP_ERROR_BAD_FORMAT;
     }
-    if (!parse_subpackets(pkt.cur(), splen, false)) {
+    if (!scan_subpackets(pkt.cur(), splen, false)) {
         RNP_LOG("failed to parse unhashed subpackets");
         return RNP_ERROR_BAD_FORMAT;
     }
+    unhashed_data_.assign(pkt.cur(), pkt.cur() + splen);
+    subpkts_.parsed = false;
     pkt.skip(splen);
     return RNP_SUCCESS;
 }
@@ -1156,7 +1328,11 @@ pgp_signature_t::write(pgp_dest_t &dst, bool hdr) const
     } else {
         /* for v4 sig->hashed_data must contain most of signature fields */
         pktbody.add(hashed_data);
-        pktbody.add_subpackets(*this, false);
+        if (subpkts_.parsed) {
+            pktbody.add_subpackets(*this, false);
+        } else {
+            pktbody.add_subpackets(unhashed_data_, version);
+        }
     }
     pktbody.add(lbits.data(), 2);
 #if defined(ENABLE_CRYPTO_REFRESH)
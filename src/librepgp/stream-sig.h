@@ -30,20 +30,58 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <sys/types.h>
+#include <bitset>
+#include <atomic>
+#include <mutex>
 #include "rnp.h"
 #include "stream-common.h"
 #include "stream-packet.h"
 #include "sig_subpacket.hpp"
 
+/* Commonly used subpacket fields, filled on parsing so subpackets are not created for them */
+typedef struct pgp_sig_subpkt_cache_t {
+    std::bitset<128>  hashed{};         /* types of the hashed subpackets */
+    std::bitset<128>  any{};            /* types of all the subpackets */
+    uint32_t          creation{};       /* first hashed signature creation time */
+    uint32_t          expiration{};     /* first hashed signature expiration time */
+    uint32_t          key_expiration{}; /* first hashed key expiration time */
+    uint8_t           key_flags{};      /* first hashed key flags */
+    bool              primary_uid{};    /* first hashed primary userid flag */
+    pgp_key_id_t      keyid{};          /* first issuer key id from any area */
+    pgp_fingerprint_t keyfp{};          /* first hashed issuer fingerprint */
+    size_t            count{};          /* number of subpackets in both areas */
+} pgp_sig_subpkt_cache_t;
+
+/* Subpackets, created from the raw data on first access. Const signature methods may be called
+ * from different threads, so subpackets are created and copied under the lock. */
+typedef struct pgp_sig_subpkts_t {
+    pgp::pkt::sigsub::List list;
+    std::atomic<bool>      parsed{true};
+    mutable std::mutex     lock;
+
+    pgp_sig_subpkts_t() = default;
+    pgp_sig_subpkts_t(const pgp_sig_subpkts_t &src);
+    pgp_sig_subpkts_t(pgp_sig_subpkts_t &&src);
+    pgp_sig_subpkts_t &operator=(const pgp_sig_subpkts_t &src);
+    pgp_sig_subpkts_t &operator=(pgp_sig_subpkts_t &&src);
+} pgp_sig_subpkts_t;
+
 typedef struct pgp_signature_t {
   private:
-    pgp_sig_type_t       type_;
+    pgp_sig_type_t type_;
+    /* subpackets are created from the hashed_data and unhashed_data_ on first access */
+    mutable pgp_sig_subpkts_t subpkts_;
+    std::vector<uint8_t>      unhashed_data_; /* raw unhashed subpackets, until parsed */
+    pgp_sig_subpkt_cache_t    cache_;
+
     std::vector<uint8_t> preferred(pgp::pkt::sigsub::Type type) const;
     void         set_preferred(const std::vector<uint8_t> &data, pgp::pkt::sigsub::Type type);
     rnp_result_t parse_v2v3(pgp_packet_body_t &pkt);
     rnp_result_t parse_v4up(pgp_packet_body_t &pkt);
     bool         get_subpkt_len(pgp_packet_body_t &pkt, size_t &len);
-    bool         parse_subpackets(uint8_t *buf, size_t len, bool hashed);
+    bool         scan_subpackets(const uint8_t *buf, size_t len, bool hashed);
+    void         parse_subpackets(const uint8_t *buf, size_t len, bool hashed) const;
+    void         parse_subpackets() const;
     static bool  version_supported(pgp_version_t version);
 
     const pgp::pkt::sigsub::RevocationKey *revoker_subpkt() const noexcept;
@@ -61,9 +99,6 @@ typedef struct pgp_signature_t {
     uint32_t     creation_time;
     pgp_key_id_t signer{};
 
-    /* common v4, v5 and v6 fields */
-    pgp::pkt::sigsub::List subpkts;
-
 #if defined(ENABLE_CRYPTO_REFRESH)
     /* v6 - only fields */
     std::vector<uint8_t> salt;
@@ -95,6 +130,15 @@ typedef struct pgp_signature_t {
 
     /** @brief Calculate the unique signature identifier by hashing signature's fields. */
     pgp_sig_id_t get_id() const;
+    /** @brief Approximate number of bytes occupied by the signature in memory. */
+    size_t memory_usage() const noexcept;
+
+    /**
+     * @brief Get v4 and up signature's subpackets. Subpackets of the parsed signature are
+     *        created on the first call, commonly used fields are available without it.
+     */
+    pgp::pkt::sigsub::List &      subpkts();
+    const pgp::pkt::sigsub::List &subpkts() const;
 
     size_t find_subpkt(uint8_t type, bool hashed = true, size_t skip = 0) const;
     size_t find_subpkt(pgp::pkt::sigsub::Type type, bool hashed = true, size_t skip = 0) const;
@@ -54,8 +54,11 @@
 #include "types.h"
 #include "crypto/signatures.h"
 #include "defaults.h"
+#include "thread-pool.hpp"
 #include <time.h>
 #include <algorithm>
+#include <atomic>
+#include <memory>
 #ifdef ENABLE_CRYPTO_REFRESH
 #include "v2_seipd.h"
 #endif
@@ -64,6 +67,15 @@
 #define PGP_PARTIAL_PKT_SIZE_BITS (13)
 #define PGP_PARTIAL_PKT_BLOCK_SIZE (1 << PGP_PARTIAL_PKT_SIZE_BITS)
 
+/* Size of the data sample, used to decide on compression in adaptive mode */
+#define PGP_COMPRESS_PROBE_SIZE (PGP_INPUT_CACHE_SIZE / 2)
+/* Store data uncompressed if the fastest compression saves less than 3% of the sample */
+#define PGP_COMPRESS_STORE_RATIO 97
+/* Use the fastest compression level if it saves less than 10% of the sample */
+#define PGP_COMPRESS_FAST_RATIO 90
+/* Approximate size of the compressed packet header and zlib/bzip2 framing */
+#define PGP_COMPRESS_OVERHEAD 16
+
 /* common fields for encrypted, compressed and literal data */
 typedef struct pgp_dest_packet_param_t {
     pgp_dest_t *writedst;                 /* destination to write to, could be partial */
@@ -82,9 +94,15 @@ typedef struct pgp_dest_compressed_param_t {
         z_stream  z;
         bz_stream bz;
     };
-    bool    zstarted;                        /* whether we initialize zlib/bzip2  */
-    uint8_t cache[PGP_INPUT_CACHE_SIZE / 2]; /* pre-allocated cache for compression */
-    size_t  len;                             /* number of bytes cached */
+    bool       zstarted;                        /* whether we initialize zlib/bzip2  */
+    uint8_t    cache[PGP_INPUT_CACHE_SIZE / 2]; /* pre-allocated cache for compression */
+    size_t     len;                             /* number of bytes cached */
+    rnp_ctx_t *ctx;                             /* to report the compression used */
+    int        zlevel;                          /* configured compression level */
+    bool       probing;                         /* collecting sample in adaptive mode */
+    bool       stored;                          /* data is written as is, uncompressed */
+    uint8_t    probe[PGP_COMPRESS_PROBE_SIZE];  /* data sample for the adaptive mode */
+    size_t     probelen;                        /* number of bytes in probe */
 } pgp_dest_compressed_param_t;
 
 typedef struct pgp_dest_encrypted_param_t {
@@ -145,10 +163,12 @@ typedef struct pgp_dest_signed_param_t {
     rnp_ctx_t *              ctx;      /* rnp operation context with additional parameters */
     pgp_password_provider_t *password_provider;   /* password provider from write handler */
     std::vector<pgp_dest_signer_info_t> siginfos; /* list of  pgp_dest_signer_info_t */
-    rnp::HashList hashes;              /* hashes to pass raw data through and then sign */
-    bool          clr_start;           /* we are on the start of the line */
-    uint8_t       clr_buf[CT_BUF_LEN]; /* buffer to hold partial line data */
-    size_t        clr_buflen;          /* number of bytes in buffer */
+    rnp::HashList hashes;               /* hashes to pass raw data through and then sign */
+    bool          clr_start;            /* we are on the start of the line */
+    uint8_t       clr_buf[CT_BUF_LEN];  /* buffer to hold partial line data */
+    size_t        clr_buflen;           /* number of bytes in buffer */
+    uint8_t       clr_hash[CT_BUF_LEN]; /* canonicalized text, waiting to be hashed */
+    size_t        clr_hashlen;          /* number of bytes in clr_hash */
 
     pgp_literal_hdr_t lhdr{}; /* literal packet header, needed for v5 sigs */
     bool              has_lhdr = false;
@@ -811,7 +831,7 @@ encrypted_start_cfb(pgp_dest_encrypted_param_t *param, uint8_t *enckey)
         dst_write(param->pkt.writedst, &mdcver, 1);
 
         try {
-            param->mdc = rnp::Hash::create(PGP_HASH_SHA1);
+            param->mdc = rnp::Hash::create_fast(PGP_HASH_SHA1);
         } catch (const std::exception &e) {
             /* LCOV_EXCL_START */
             RNP_LOG("cannot create sha1 hash: %s", e.what());
@@ -1118,69 +1138,105 @@ signed_dst_write(pgp_dest_t *dst, const void *buf, size_t len)
     return RNP_SUCCESS;
 }
 
+static void
+cleartext_dst_flush_hash(pgp_dest_signed_param_t *param)
+{
+    if (!param->clr_hashlen) {
+        return;
+    }
+    try {
+        param->hashes.add(param->clr_hash, param->clr_hashlen);
+    } catch (const std::exception &e) {
+        RNP_LOG("failed to hash data: %s", e.what()); // LCOV_EXCL_LINE
+    }
+    param->clr_hashlen = 0;
+}
+
+static void
+cleartext_dst_hash(pgp_dest_signed_param_t *param, const uint8_t *buf, size_t len)
+{
+    /* small chunks are collected to hash a number of lines at once */
+    if (param->clr_hashlen + len > sizeof(param->clr_hash)) {
+        cleartext_dst_flush_hash(param);
+    }
+    if (len < sizeof(param->clr_hash)) {
+        memcpy(param->clr_hash + param->clr_hashlen, buf, len);
+        param->clr_hashlen += len;
+        return;
+    }
+    try {
+        param->hashes.add(buf, len);
+    } catch (const std::exception &e) {
+        RNP_LOG("failed to hash data: %s", e.what()); // LCOV_EXCL_LINE
+    }
+}
+
+static bool
+cleartext_dst_escape(const pgp_dest_signed_param_t *param, const uint8_t *buf, size_t len)
+{
+    return param->clr_start && len &&
+           ((buf[0] == CH_DASH) || ((len >= 4) && !memcmp(buf, ST_FROM, 4)));
+}
+
+static void
+cleartext_dst_hashline(pgp_dest_signed_param_t *param,
+                       const uint8_t *          buf,
+                       size_t                   len,
+                       bool                     eol)
+{
+    if (!eol) {
+        /* hashing just line's data */
+        if (len > 0) {
+            cleartext_dst_hash(param, buf, len);
+            param->clr_start = false;
+        }
+        return;
+    }
+
+    bool           hashcrlf = false;
+    const uint8_t *ptr = buf + len - 1;
+
+    /* skipping trailing characters - space, tab, carriage return, line feed */
+    while ((ptr >= buf) && ((*ptr == CH_SPACE) || (*ptr == CH_TAB) || (*ptr == CH_CR) ||
+                            (*ptr == CH_LF))) {
+        if (*ptr == CH_LF) {
+            hashcrlf = true;
+        }
+        ptr--;
+    }
+
+    /* hashing line body and \r\n */
+    cleartext_dst_hash(param, buf, ptr + 1 - buf);
+    if (hashcrlf) {
+        cleartext_dst_hash(param, (const uint8_t *) ST_CRLF, 2);
+    }
+    param->clr_start = hashcrlf;
+}
+
 static void
 cleartext_dst_writeline(pgp_dest_signed_param_t *param,
                         const uint8_t *          buf,
                         size_t                   len,
                         bool                     eol)
 {
-    const uint8_t *ptr;
-
     /* dash-escaping line if needed */
-    if (param->clr_start && len &&
-        ((buf[0] == CH_DASH) || ((len >= 4) && !strncmp((const char *) buf, ST_FROM, 4)))) {
+    if (cleartext_dst_escape(param, buf, len)) {
         dst_write(param->writedst, ST_DASHSP, 2);
     }
-
     /* output data */
     dst_write(param->writedst, buf, len);
-
-    try {
-        if (eol) {
-            bool hashcrlf = false;
-            ptr = buf + len - 1;
-
-            /* skipping trailing characters - space, tab, carriage return, line feed */
-            while ((ptr >= buf) && ((*ptr == CH_SPACE) || (*ptr == CH_TAB) ||
-                                    (*ptr == CH_CR) || (*ptr == CH_LF))) {
-                if (*ptr == CH_LF) {
-                    hashcrlf = true;
-                }
-                ptr--;
-            }
-
-            /* hashing line body and \r\n */
-            param->hashes.add(buf, ptr + 1 - buf);
-            if (hashcrlf) {
-                param->hashes.add(ST_CRLF, 2);
-            }
-            param->clr_start = hashcrlf;
-        } else if (len > 0) {
-            /* hashing just line's data */
-            param->hashes.add(buf, len);
-            param->clr_start = false;
-        }
-    } catch (const std::exception &e) {
-        RNP_LOG("failed to hash data: %s", e.what()); // LCOV_EXCL_LINE
-    }
+    cleartext_dst_hashline(param, buf, len, eol);
 }
 
 static size_t
 cleartext_dst_scanline(const uint8_t *buf, size_t len, bool *eol)
 {
-    for (const uint8_t *ptr = buf, *end = buf + len; ptr < end; ptr++) {
-        if (*ptr == CH_LF) {
-            if (eol) {
-                *eol = true;
-            }
-            return ptr - buf + 1;
-        }
-    }
-
+    /* memchr() is vectorized by libc, so it is much faster than the byte-by-byte loop */
+    const uint8_t *lf = (const uint8_t *) memchr(buf, CH_LF, len);
     if (eol) {
-        *eol = false;
+        *eol = lf;
     }
-    return len;
+    return lf ? lf - buf + 1 : len;
 }
 
 static rnp_result_t
@@ -1227,29 +1283,65 @@ cleartext_dst_write(pgp_dest_t *dst, const void *buf, size_t len)
         len -= linelen;
     }
 
-    /* if we get here then we don't have data in param->clr_buf */
+    /* if we get here then we don't have data in param->clr_buf. Lines which do not need
+     * dash-escaping are written out from the caller's buffer at once. */
+    const uint8_t *outbg = linebg;
     while (len > 0) {
         linelen = cleartext_dst_scanline(linebg, len, &eol);
 
         if (!eol && (linelen < sizeof(param->clr_buf))) {
             memcpy(param->clr_buf, linebg, linelen);
             param->clr_buflen = linelen;
-            return RNP_SUCCESS;
+            break;
         }
 
-        cleartext_dst_writeline(param, linebg, linelen, eol);
+        if (cleartext_dst_escape(param, linebg, linelen)) {
+            dst_write(param->writedst, outbg, linebg - outbg);
+            dst_write(param->writedst, ST_DASHSP, 2);
+            outbg = linebg;
+        }
+        cleartext_dst_hashline(param, linebg, linelen, eol);
         linebg += linelen;
         len -= linelen;
     }
+    dst_write(param->writedst, outbg, linebg - outbg);
 
     return RNP_SUCCESS;
 }
 
+namespace {
+/* signature, prepared for the calculation */
+struct signed_sig_job_t {
+    pgp_signature_t                 sig;
+    std::unique_ptr<rnp::Hash>      hash;
+    pgp_dest_signer_info_t *        signer;
+    std::unique_ptr<rnp::KeyLocker> locker;
+    rnp_result_t                    ret;
+};
+} // namespace
+
 static void
-signed_fill_signature(pgp_dest_signed_param_t &param,
-                      pgp_signature_t &        sig,
-                      pgp_dest_signer_info_t & signer)
+signed_prepare_signature(pgp_dest_signed_param_t &param, signed_sig_job_t &job)
 {
+    auto &signer = *job.signer;
+    auto &sig = job.sig;
+    if (signer.onepass.version) {
+        signer.key->sign_init(param.ctx->ctx->rng,
+                              sig,
+                              signer.onepass.halg,
+                              param.ctx->ctx->time(),
+                              signer.key->version());
+        sig.palg = signer.onepass.palg;
+        sig.set_type(signer.onepass.type);
+    } else {
+        signer.key->sign_init(param.ctx->ctx->rng,
+                              sig,
+                              signer.halg,
+                              param.ctx->ctx->time(),
+                              signer.key->version());
+        /* line below should be checked */
+        sig.set_type(param.ctx->detached ? PGP_SIG_BINARY : PGP_SIG_TEXT);
+    }
     /* fill signature fields, assuming sign_init was called on it */
     if (signer.sigcreate) {
         sig.set_creation(signer.sigcreate);
@@ -1264,89 +1356,107 @@ signed_fill_signature(pgp_dest_signed_param_t &param,
         throw rnp::rnp_exception(RNP_ERROR_BAD_STATE);
         /* LCOV_EXCL_END */
     }
+    job.hash = listh->clone();
 
-    /* decrypt the secret key if needed */
-    rnp::KeyLocker keylock(*signer.key);
+    /* decrypt the secret key if needed, password provider is not required to be reentrant */
+    job.locker.reset(new rnp::KeyLocker(*signer.key));
     if (signer.key->encrypted() &&
-        !signer.key->unlock(*param.password_provider, PGP_OP_SIGN)) {
+        !job.locker->unlock(*param.password_provider, PGP_OP_SIGN)) {
         RNP_LOG("wrong secret key password");
         throw rnp::rnp_exception(RNP_ERROR_BAD_PASSWORD);
     }
-    /* calculate the signature */
-    auto hdr = param.has_lhdr ? &param.lhdr : NULL;
-    signature_calculate(
-      sig, *signer.key->pkt().material, *listh->clone(), *param.ctx->ctx, hdr);
+    /* unlocked material is validated here, so parallel jobs only read the cached status */
+    if (!job.locker->validate(*param.ctx->ctx)) {
+        RNP_LOG("attempt to sign with invalid key material");
+        throw rnp::rnp_exception(RNP_ERROR_BAD_PARAMETERS);
+    }
 }
 
-static rnp_result_t
-signed_write_signature(pgp_dest_signed_param_t *param,
-                       pgp_dest_signer_info_t * signer,
-                       pgp_dest_t *             writedst)
+static void
+signed_calculate_signature(pgp_dest_signed_param_t &param, signed_sig_job_t &job)
 {
     try {
-        pgp_signature_t sig;
-        if (signer->onepass.version) {
-            signer->key->sign_init(param->ctx->ctx->rng,
-                                   sig,
-                                   signer->onepass.halg,
-                                   param->ctx->ctx->time(),
-                                   signer->key->version());
-            sig.palg = signer->onepass.palg;
-            sig.set_type(signer->onepass.type);
-        } else {
-            signer->key->sign_init(param->ctx->ctx->rng,
-                                   sig,
-                                   signer->halg,
-                                   param->ctx->ctx->time(),
-                                   signer->key->version());
-            /* line below should be checked */
-            sig.set_type(param->ctx->detached ? PGP_SIG_BINARY : PGP_SIG_TEXT);
-        }
-        signed_fill_signature(*param, sig, *signer);
-        sig.write(*writedst);
-        return writedst->werr;
+        auto hdr = param.has_lhdr ? &param.lhdr : NULL;
+        signature_calculate(
+          job.sig, *job.signer->key->pkt().material, *job.hash, *param.ctx->ctx, hdr);
+        job.ret = RNP_SUCCESS;
     } catch (const rnp::rnp_exception &e) {
-        return e.code();
+        job.ret = e.code();
     } catch (const std::exception &e) {
         /* LCOV_EXCL_START */
-        RNP_LOG("Failed to write signature: %s", e.what());
-        return RNP_ERROR_WRITE;
+        RNP_LOG("Failed to calculate signature: %s", e.what());
+        job.ret = RNP_ERROR_SIGNING_FAILED;
         /* LCOV_EXCL_END */
     }
 }
 
+/* Calculate signatures for all of the signers and write them in the signers order. Each
+ * signature is calculated on own copy of the finalized hash, so public key operations for
+ * multiple signers are done in parallel. */
 static rnp_result_t
-signed_dst_finish(pgp_dest_t *dst)
+signed_write_signatures(pgp_dest_signed_param_t *param, pgp_dest_t *writedst)
 {
-    rnp_result_t             ret;
-    pgp_dest_signed_param_t *param = (pgp_dest_signed_param_t *) dst->param;
+    std::vector<signed_sig_job_t> jobs(param->siginfos.size());
+    try {
+        for (size_t idx = 0; idx < jobs.size(); idx++) {
+            jobs[idx].signer = &param->siginfos[idx];
+            jobs[idx].ret = RNP_ERROR_GENERIC;
+            signed_prepare_signature(*param, jobs[idx]);
+        }
+    } catch (const rnp::rnp_exception &e) {
+        return e.code();
+    } catch (const std::exception &e) {
+        /* LCOV_EXCL_START */
+        RNP_LOG("Failed to prepare signature: %s", e.what());
+        return RNP_ERROR_OUT_OF_MEMORY;
+        /* LCOV_EXCL_END */
+    }
 
-    /* attached signature, we keep onepasses in order of signatures */
-    for (auto &sinfo : param->siginfos) {
-        if ((ret = signed_write_signature(param, &sinfo, param->writedst))) {
+    std::atomic<size_t> next(0);
+    auto                worker = [&]() {
+        size_t idx;
+        while ((idx = next++) < jobs.size()) {
+            signed_calculate_signature(*param, jobs[idx]);
+        }
+    };
+    /* ctx->threads == 0 means pool's limit, i.e. the number of CPUs */
+    size_t count = param->ctx->threads ? param->ctx->threads : jobs.size();
+    rnp::ThreadPool::shared().run_parallel(std::min(jobs.size(), count), worker);
+
+    for (auto &job : jobs) {
+        if (job.ret) {
             RNP_LOG("failed to calculate signature");
-            return ret;
+            return job.ret;
+        }
+        try {
+            job.sig.write(*writedst);
+        } catch (const std::exception &e) {
+            /* LCOV_EXCL_START */
+            RNP_LOG("Failed to write signature: %s", e.what());
+            return RNP_ERROR_WRITE;
+            /* LCOV_EXCL_END */
+        }
+        if (writedst->werr) {
+            return writedst->werr;
         }
     }
-
     return RNP_SUCCESS;
 }
 
 static rnp_result_t
-signed_detached_dst_finish(pgp_dest_t *dst)
+signed_dst_finish(pgp_dest_t *dst)
 {
-    rnp_result_t             ret;
     pgp_dest_signed_param_t *param = (pgp_dest_signed_param_t *) dst->param;
+    /* attached signature, we keep onepasses in order of signatures */
+    return signed_write_signatures(param, param->writedst);
+}
 
+static rnp_result_t
+signed_detached_dst_finish(pgp_dest_t *dst)
+{
+    pgp_dest_signed_param_t *param = (pgp_dest_signed_param_t *) dst->param;
     /* just calculating and writing signatures to the output */
-    for (auto &sinfo : param->siginfos) {
-        if ((ret = signed_write_signature(param, &sinfo, param->writedst))) {
-            RNP_LOG("failed to calculate detached signature");
-            return ret;
-        }
-    }
-
-    return RNP_SUCCESS;
+    return signed_write_signatures(param, param->writedst);
 }
 
 static rnp_result_t
@@ -1358,6 +1468,7 @@ cleartext_dst_finish(pgp_dest_t *dst)
     if (param->clr_buflen > 0) {
         cleartext_dst_writeline(param, param->clr_buf, param->clr_buflen, true);
     }
+    cleartext_dst_flush_hash(param);
     /* trailing \r\n which is not hashed */
     dst_write(param->writedst, ST_CRLF, 2);
 
@@ -1365,11 +1476,9 @@ cleartext_dst_finish(pgp_dest_t *dst)
     try {
         rnp::ArmoredDest armor(*param->writedst, PGP_ARMORED_SIGNATURE);
         armor.set_discard(true);
-        for (auto &sinfo : param->siginfos) {
-            auto ret = signed_write_signature(param, &sinfo, &armor.dst());
-            if (ret) {
-                return ret;
-            }
+        auto ret = signed_write_signatures(param, &armor.dst());
+        if (ret) {
+            return ret;
         }
         armor.set_discard(false);
         return RNP_SUCCESS;
@@ -1413,9 +1522,9 @@ signed_add_signer(pgp_dest_signed_param_t *param, rnp_signer_info_t *signer, boo
         RNP_LOG("secret key required for signing");
         return RNP_ERROR_BAD_PARAMETERS;
     }
-    /* validate signing key material if didn't before */
-    signer->key->material()->validate(*param->ctx->ctx, false);
-    if (!signer->key->pkt().material->valid()) {
+    /* validate signing key material if didn't before, key may be used by other operations */
+    rnp::KeyLocker locker(*signer->key, false);
+    if (!locker.validate(*param->ctx->ctx)) {
         RNP_LOG("attempt to sign to the key with invalid material");
         return RNP_ERROR_NO_SUITABLE_KEY;
     }
@@ -1564,6 +1673,8 @@ finish:
     return ret;
 }
 
+static rnp_result_t compressed_dst_decide(pgp_dest_t *dst);
+
 static rnp_result_t
 compressed_dst_write(pgp_dest_t *dst, const void *buf, size_t len)
 {
@@ -1574,6 +1685,26 @@ compressed_dst_write(pgp_dest_t *dst, const void *buf, size_t len)
         return RNP_ERROR_BAD_PARAMETERS;
     }
 
+    if (param->probing) {
+        size_t part = std::min(len, sizeof(param->probe) - param->probelen);
+        memcpy(param->probe + param->probelen, buf, part);
+        param->probelen += part;
+        if (param->probelen < sizeof(param->probe)) {
+            return RNP_SUCCESS;
+        }
+        rnp_result_t ret = compressed_dst_decide(dst);
+        if (ret) {
+            return ret;
+        }
+        buf = (const uint8_t *) buf + part;
+        len -= part;
+    }
+
+    if (param->stored) {
+        dst_write(param->pkt.origdst, buf, len);
+        return param->pkt.origdst->werr;
+    }
+
     if ((param->alg == PGP_C_ZIP) || (param->alg == PGP_C_ZLIB)) {
         param->z.next_in = (unsigned char *) buf;
         param->z.avail_in = len;
@@ -1639,6 +1770,17 @@ compressed_dst_finish(pgp_dest_t *dst)
     int                          zret;
     pgp_dest_compressed_param_t *param = (pgp_dest_compressed_param_t *) dst->param;
 
+    /* data is shorter than the probe, so decide on what we have */
+    if (param->probing) {
+        rnp_result_t ret = compressed_dst_decide(dst);
+        if (ret) {
+            return ret;
+        }
+    }
+    if (param->stored) {
+        return param->pkt.origdst->werr;
+    }
+
     if ((param->alg == PGP_C_ZIP) || (param->alg == PGP_C_ZLIB)) {
         param->z.next_in = Z_NULL;
         param->z.avail_in = 0;
@@ -1718,82 +1860,157 @@ compressed_dst_close(pgp_dest_t *dst, bool discard)
 #endif
     }
 
-    close_streamed_packet(&param->pkt, discard);
+    /* packet is not started if data was stored as is or failed to initialize */
+    if (param->pkt.writedst) {
+        close_streamed_packet(&param->pkt, discard);
+    }
     free(param);
     dst->param = NULL;
 }
 
 static rnp_result_t
-init_compressed_dst(pgp_write_handler_t *handler, pgp_dest_t *dst, pgp_dest_t *writedst)
+compressed_dst_start(pgp_dest_compressed_param_t *param, int level)
 {
-    pgp_dest_compressed_param_t *param;
-    rnp_result_t                 ret = RNP_ERROR_GENERIC;
-    uint8_t                      buf;
-    int                          zret;
-
-    if (!init_dst_common(dst, sizeof(*param))) {
-        return RNP_ERROR_OUT_OF_MEMORY; // LCOV_EXCL_LINE
-    }
-
-    param = (pgp_dest_compressed_param_t *) dst->param;
-    dst->write = compressed_dst_write;
-    dst->finish = compressed_dst_finish;
-    dst->close = compressed_dst_close;
-    dst->type = PGP_STREAM_COMPRESSED;
-    param->alg = (pgp_compression_type_t) handler->ctx->zalg;
-    param->pkt.partial = true;
-    param->pkt.indeterminate = false;
-    param->pkt.tag = PGP_PKT_COMPRESSED;
-
     /* initializing partial length or indeterminate packet, writing header */
-    if (!init_streamed_packet(&param->pkt, writedst)) {
+    if (!init_streamed_packet(&param->pkt, param->pkt.origdst)) {
         /* LCOV_EXCL_START */
         RNP_LOG("failed to init streamed packet");
-        ret = RNP_ERROR_BAD_PARAMETERS;
-        goto finish;
+        return RNP_ERROR_BAD_PARAMETERS;
         /* LCOV_EXCL_END */
     }
 
     /* compression algorithm */
-    buf = param->alg;
+    uint8_t buf = param->alg;
     dst_write(param->pkt.writedst, &buf, 1);
 
     /* initializing compression */
+    int zret;
     switch (param->alg) {
     case PGP_C_ZIP:
     case PGP_C_ZLIB:
         (void) memset(&param->z, 0x0, sizeof(param->z));
         if (param->alg == PGP_C_ZIP) {
-            zret = deflateInit2(
-              &param->z, handler->ctx->zlevel, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY);
+            zret = deflateInit2(&param->z, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY);
         } else {
-            zret = deflateInit(&param->z, handler->ctx->zlevel);
+            zret = deflateInit(&param->z, level);
         }
 
         if (zret != Z_OK) {
             RNP_LOG("failed to init zlib, error %d", zret);
-            ret = RNP_ERROR_NOT_SUPPORTED;
-            goto finish;
+            return RNP_ERROR_NOT_SUPPORTED;
         }
         break;
 #ifdef HAVE_BZLIB_H
     case PGP_C_BZIP2:
         (void) memset(&param->bz, 0x0, sizeof(param->bz));
-        zret = BZ2_bzCompressInit(&param->bz, handler->ctx->zlevel, 0, 0);
+        zret = BZ2_bzCompressInit(&param->bz, level, 0, 0);
         if (zret != BZ_OK) {
             RNP_LOG("failed to init bz, error %d", zret);
-            ret = RNP_ERROR_NOT_SUPPORTED;
-            goto finish;
+            return RNP_ERROR_NOT_SUPPORTED;
         }
         break;
 #endif
     default:
         RNP_LOG("unknown compression algorithm");
-        ret = RNP_ERROR_NOT_SUPPORTED;
-        goto finish;
+        return RNP_ERROR_NOT_SUPPORTED;
     }
     param->zstarted = true;
-    ret = RNP_SUCCESS;
+    param->ctx->zalg_out = param->alg;
+    param->ctx->zlevel_out = level;
+    return RNP_SUCCESS;
+}
+
+/* Size of the sample, deflated with the fastest level, or len if it doesn't fit into out */
+static size_t
+compressed_probe_size(const uint8_t *data, size_t len, uint8_t *out, size_t outlen)
+{
+    z_stream z = {};
+    if (deflateInit2(&z, 1, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return len; // LCOV_EXCL_LINE
+    }
+    z.next_in = (unsigned char *) data;
+    z.avail_in = len;
+    z.next_out = out;
+    z.avail_out = std::min(outlen, len);
+    size_t res = deflate(&z, Z_FINISH) == Z_STREAM_END ? z.total_out : len;
+    deflateEnd(&z);
+    return res;
+}
+
+static rnp_result_t
+compressed_dst_decide(pgp_dest_t *dst)
+{
+    pgp_dest_compressed_param_t *param = (pgp_dest_compressed_param_t *) dst->param;
+    param->probing = false;
+
+    /* cache is not used yet, so may be used as the output buffer */
+    size_t zlen =
+      compressed_probe_size(param->probe, param->probelen, param->cache, sizeof(param->cache));
+    /* makes a difference for small messages, where compression wouldn't pay off */
+    zlen += PGP_COMPRESS_OVERHEAD;
+    if (zlen * 100 >= param->probelen * PGP_COMPRESS_STORE_RATIO) {
+        param->stored = true;
+        param->ctx->zalg_out = PGP_C_NONE;
+        param->ctx->zlevel_out = 0;
+        dst_write(param->pkt.origdst, param->probe, param->probelen);
+        return param->pkt.origdst->werr;
+    }
+
+    int level = param->zlevel;
+    /* bzip2 level is a block size, which doesn't change the speed much */
+    if ((param->alg != PGP_C_BZIP2) &&
+        (zlen * 100 >= param->probelen * PGP_COMPRESS_FAST_RATIO)) {
+        level = 1;
+    }
+    rnp_result_t ret = compressed_dst_start(param, level);
+    if (ret) {
+        return ret;
+    }
+    return compressed_dst_write(dst, param->probe, param->probelen);
+}
+
+static rnp_result_t
+init_compressed_dst(pgp_write_handler_t *handler, pgp_dest_t *dst, pgp_dest_t *writedst)
+{
+    pgp_dest_compressed_param_t *param;
+    rnp_result_t                 ret = RNP_ERROR_GENERIC;
+
+    if (!init_dst_common(dst, sizeof(*param))) {
+        return RNP_ERROR_OUT_OF_MEMORY; // LCOV_EXCL_LINE
+    }
+
+    param = (pgp_dest_compressed_param_t *) dst->param;
+    dst->write = compressed_dst_write;
+    dst->finish = compressed_dst_finish;
+    dst->close = compressed_dst_close;
+    dst->type = PGP_STREAM_COMPRESSED;
+    param->alg = (pgp_compression_type_t) handler->ctx->zalg;
+    param->zlevel = handler->ctx->zlevel;
+    param->ctx = handler->ctx;
+    param->pkt.partial = true;
+    param->pkt.indeterminate = false;
+    param->pkt.tag = PGP_PKT_COMPRESSED;
+    param->pkt.origdst = writedst;
+
+    if (!handler->ctx->zadaptive) {
+        ret = compressed_dst_start(param, param->zlevel);
+        goto finish;
+    }
+
+    /* adaptive mode: packet is started once the data sample is collected */
+    switch (param->alg) {
+    case PGP_C_ZIP:
+    case PGP_C_ZLIB:
+#ifdef HAVE_BZLIB_H
+    case PGP_C_BZIP2:
+#endif
+        param->probing = true;
+        ret = RNP_SUCCESS;
+        break;
+    default:
+        RNP_LOG("unknown compression algorithm");
+        ret = RNP_ERROR_NOT_SUPPORTED;
+    }
 finish:
     if (ret != RNP_SUCCESS) {
         compressed_dst_close(dst, true);
@@ -36,6 +36,7 @@
 #include <string.h>
 #include <string>
 #include <vector>
+#include <mutex>
 #include <iterator>
 #include <cassert>
 #include <ctype.h>
@@ -65,8 +66,6 @@
 
 #ifndef RNP_USE_STD_REGEX
 #include <regex.h>
-#else
-#include <regex>
 #endif
 
 #ifdef HAVE_SYS_RESOURCE_H
@@ -507,6 +506,25 @@ ffi_pass_callback_file(rnp_ffi_t        ffi,
     return true;
 }
 
+/* batch workers ask the parent's password source, one request at a time */
+static std::mutex worker_pass_lock;
+
+static bool
+ffi_pass_callback_worker(rnp_ffi_t        ffi,
+                         void *           app_ctx,
+                         rnp_key_handle_t key,
+                         const char *     pgp_context,
+                         char             buf[],
+                         size_t           buf_len)
+{
+    cli_rnp_t *                 parent = static_cast<cli_rnp_t *>(app_ctx);
+    std::lock_guard<std::mutex> lock(worker_pass_lock);
+    if (parent->passfp) {
+        return ffi_pass_callback_file(ffi, parent->passfp, key, pgp_context, buf, buf_len);
+    }
+    return ffi_pass_callback_stdin(ffi, parent, key, pgp_context, buf, buf_len);
+}
+
 static bool
 ffi_pass_callback_string(rnp_ffi_t        ffi,
                          void *           app_ctx,
@@ -720,6 +738,9 @@ cli_rnp_t::init(const rnp_cfg &cfg)
     if (cfg_.has(CFG_CURTIME)) {
         rnp_set_timestamp(ffi, cfg_.time());
     }
+    if (cfg_.has(CFG_THREADS)) {
+        rnp_set_key_load_threads(ffi, cfg_.get_int(CFG_THREADS));
+    }
     pswdtries = MAX_PASSWORD_ATTEMPTS;
     res = true;
 done:
@@ -730,6 +751,36 @@ done:
     return res;
 }
 
+bool
+cli_rnp_t::init_worker(cli_rnp_t &parent)
+{
+    rnp_cfg cfg;
+    cfg.copy(parent.cfg());
+    /* password input is shared with the parent */
+    cfg.unset(CFG_PASSFD);
+    if (!init(cfg)) {
+        return false;
+    }
+    /* password source of the parent is shared, and parent processes the inputs as well, so
+     * must take the same lock. Password, given in the command line, is used as is. */
+    if (!cfg_.has(CFG_PASSWD) &&
+        (rnp_ffi_set_pass_provider(parent.ffi, ffi_pass_callback_worker, &parent) ||
+         rnp_ffi_set_pass_provider(ffi, ffi_pass_callback_worker, &parent))) {
+        return false;
+    }
+
+    /* keys, unlocked by the parent, are copied unlocked, so password is not asked again */
+    uint32_t flags = RNP_LOAD_SAVE_PUBLIC_KEYS;
+    if (cfg_.get_bool(CFG_NEEDSSECKEY)) {
+        flags |= RNP_LOAD_SAVE_SECRET_KEYS;
+    }
+    if (rnp_copy_keys(ffi, parent.ffi, flags)) {
+        ERR_MSG("Failed to copy keys.");
+        return false;
+    }
+    return cli_rnp_setup(this);
+}
+
 void
 cli_rnp_t::end()
 {
@@ -776,16 +827,21 @@ cli_rnp_t::load_keyring(bool secret)
         return true;
     }
 
-    const char * format = secret ? secformat().c_str() : pubformat().c_str();
-    uint32_t     flags = secret ? RNP_LOAD_SAVE_SECRET_KEYS : RNP_LOAD_SAVE_PUBLIC_KEYS;
+    const char *format = secret ? secformat().c_str() : pubformat().c_str();
+    uint32_t    flags = secret ? RNP_LOAD_SAVE_SECRET_KEYS : RNP_LOAD_SAVE_PUBLIC_KEYS;
+    /* G10 key files are read on request, so key count is not checked then */
+    bool deferred = dir && cfg_.get_bool(CFG_DEFER_G10);
+    if (deferred) {
+        flags |= RNP_LOAD_SAVE_DEFERRED;
+    }
     rnp_result_t ret = rnp_load_keys(ffi, format, keyin, flags);
     if (ret) {
         ERR_MSG("Error: failed to load keyring from '%s'", path.c_str());
     }
     rnp_input_destroy(keyin);
 
-    if (ret) {
-        return false;
+    if (ret || deferred) {
+        return !ret;
     }
 
     size_t keycount = 0;
@@ -800,6 +856,75 @@ cli_rnp_t::load_keyring(bool secret)
     return true;
 }
 
+static bool
+cli_rnp_has_key(rnp_ffi_t ffi, const std::string &fp, bool secret)
+{
+    rnp_key_handle_t key = NULL;
+    bool             res = false;
+    if (rnp_locate_key(ffi, "fingerprint", fp.c_str(), &key) || !key) {
+        return false;
+    }
+    if (secret) {
+        (void) rnp_key_have_secret(key, &res);
+    } else {
+        (void) rnp_key_have_public(key, &res);
+    }
+    rnp_key_handle_destroy(key);
+    return res;
+}
+
+/* unload keys which are not present in the disk copy of the keyring */
+static bool
+cli_rnp_drop_missing_keys(rnp_ffi_t ffi, rnp_ffi_t disk, bool secret)
+{
+    rnp_identifier_iterator_t it = NULL;
+    if (rnp_identifier_iterator_create(ffi, &it, "fingerprint")) {
+        return false;
+    }
+    std::vector<std::string> fps;
+    const char *             fp = NULL;
+    while (!rnp_identifier_iterator_next(it, &fp) && fp) {
+        fps.push_back(fp);
+    }
+    rnp_identifier_iterator_destroy(it);
+
+    uint32_t flags = secret ? RNP_KEY_REMOVE_SECRET : RNP_KEY_REMOVE_PUBLIC;
+    for (auto &keyfp : fps) {
+        if (!cli_rnp_has_key(ffi, keyfp, secret) || cli_rnp_has_key(disk, keyfp, secret)) {
+            continue;
+        }
+        rnp_key_handle_t key = NULL;
+        if (rnp_locate_key(ffi, "fingerprint", keyfp.c_str(), &key) || !key ||
+            rnp_key_remove(key, flags)) {
+            rnp_key_handle_destroy(key);
+            return false;
+        }
+        rnp_key_handle_destroy(key);
+    }
+    return true;
+}
+
+bool
+cli_rnp_t::refresh_keyring(bool secret)
+{
+    /* keyring is read to the separate FFI object, so removed keys may be found */
+    rnp_ffi_t loaded = ffi;
+    if (rnp_ffi_create(&ffi, pubformat().c_str(), secformat().c_str())) {
+        ffi = loaded;
+        return false;
+    }
+    /* G10 secret keys need the public ones */
+    bool      res = load_keyring(false) && (!secret || load_keyring(true));
+    rnp_ffi_t disk = ffi;
+    ffi = loaded;
+
+    uint32_t flags = secret ? RNP_LOAD_SAVE_SECRET_KEYS : RNP_LOAD_SAVE_PUBLIC_KEYS;
+    res = res && cli_rnp_drop_missing_keys(ffi, disk, secret) &&
+          !rnp_copy_keys(ffi, disk, flags);
+    rnp_ffi_destroy(disk);
+    return res;
+}
+
 bool
 cli_rnp_t::load_keyrings(bool loadsecret)
 {
@@ -1527,6 +1652,143 @@ cli_rnp_print_key_info(FILE *fp, rnp_ffi_t ffi, rnp_key_handle_t key, bool psecr
     rnp_buffer_destroy(keyfp);
 }
 
+static bool
+json_obj_get_bool(json_object *obj, const char *key)
+{
+    json_object *fld = NULL;
+    return json_object_object_get_ex(obj, key, &fld) && json_object_get_boolean(fld);
+}
+
+static uint64_t
+json_obj_get_uint64(json_object *obj, const char *key)
+{
+    json_object *fld = NULL;
+    return json_object_object_get_ex(obj, key, &fld) ? json_object_get_int64(fld) : 0;
+}
+
+/* Print key from the rnp_list_keys() output, in the same format as cli_rnp_print_key_info()
+ * without signatures */
+static void
+cli_rnp_print_key_json(FILE *fp, json_object *jso, bool psecret)
+{
+    char buf[64] = {0};
+    bool primary = json_obj_get_bool(jso, "primary");
+    if (psecret && json_obj_get_bool(jso, "secret")) {
+        fprintf(fp, "%s%s   ", primary ? "\n" : "", primary ? "sec" : "ssb");
+    } else {
+        fprintf(fp, "%s%s   ", primary ? "\n" : "", primary ? "pub" : "sub");
+    }
+    const char *alg = json_obj_get_str(jso, "type");
+    fprintf(fp,
+            "%d/%s",
+            (int) json_obj_get_uint64(jso, "length"),
+            cli_rnp_normalize_key_alg(alg ? alg : ""));
+#if defined(ENABLE_PQC)
+    const char *param = json_obj_get_str(jso, "sphincsplus param");
+    if (param) {
+        fprintf(fp, "-%s", param);
+    }
+#endif
+    std::string keyid = json_obj_get_str(jso, "keyid");
+    fprintf(fp, " %s", rnp::lowercase(&keyid[0]));
+    uint32_t create = json_obj_get_uint64(jso, "creation time");
+    fprintf(fp, " %s", ptimestr(buf, sizeof(buf), create));
+    bool expired = json_obj_get_bool(jso, "expired");
+    bool revoked = json_obj_get_bool(jso, "revoked");
+    if (json_obj_get_bool(jso, "valid") || expired || revoked) {
+        /* the same order as in cli_key_usage_str() */
+        static const std::pair<const char *, char> usages[] = {
+          {"encrypt", 'E'}, {"sign", 'S'}, {"certify", 'C'}, {"authenticate", 'A'}};
+        json_object *usage = NULL;
+        json_object_object_get_ex(jso, "usage", &usage);
+        std::string flags;
+        for (auto &item : usages) {
+            for (size_t i = 0; usage && (i < json_object_array_length(usage)); i++) {
+                auto str = json_object_get_string(json_object_array_get_idx(usage, i));
+                if (!strcmp(str, item.first)) {
+                    flags.push_back(item.second);
+                }
+            }
+        }
+        fprintf(fp, " [%s]", flags.c_str());
+    } else {
+        fprintf(fp, " [INVALID]");
+    }
+    uint32_t expiry = json_obj_get_uint64(jso, "expiration");
+    if (expiry) {
+        ptimestr(buf, sizeof(buf), create + expiry);
+        fprintf(fp, " [%s %s]", expired ? "EXPIRED" : "EXPIRES", buf);
+    }
+    if (revoked) {
+        fprintf(fp, " [REVOKED]");
+    }
+    std::string keyfp = json_obj_get_str(jso, "fingerprint");
+    fprintf(fp, "\n      %s\n", rnp::lowercase(&keyfp[0]));
+
+    json_object *uids = NULL;
+    json_object *validity = NULL;
+    if (!json_object_object_get_ex(jso, "userids", &uids) ||
+        !json_object_object_get_ex(jso, "userids validity", &validity)) {
+        return;
+    }
+    for (size_t i = 0; i < json_object_array_length(uids); i++) {
+        auto uid = json_object_get_string(json_object_array_get_idx(uids, i));
+        auto uidval = json_object_array_get_idx(validity, i);
+        bool uidrevoked = json_obj_get_bool(uidval, "revoked");
+        bool uidvalid = json_obj_get_bool(uidval, "valid");
+        fprintf(fp, "uid           %s", cli_rnp_escape_string(uid).c_str());
+        fprintf(fp, "%s\n", uidrevoked ? " [REVOKED]" : uidvalid ? "" : " [INVALID]");
+    }
+}
+
+bool
+cli_rnp_list_keys(cli_rnp_t *rnp, FILE *fp, const std::string &filter, bool psecret)
+{
+    uint32_t flags = RNP_LOCATE_SUBKEYS_AFTER | (psecret ? RNP_LOCATE_SECRET : 0);
+#ifndef RNP_USE_STD_REGEX
+    std::string query = cli_rnp_unescape_for_regcomp(filter);
+#else
+    const std::string &query = filter;
+#endif
+    rnp_output_t output = NULL;
+    if (rnp_output_to_memory(&output, 0)) {
+        return false;
+    }
+    uint8_t *buf = NULL;
+    size_t   len = 0;
+    if (rnp_list_keys(rnp->ffi, query.c_str(), flags, RNP_LIST_ALL, output) ||
+        rnp_output_memory_get_buf(output, &buf, &len, false)) {
+        ERR_MSG("Invalid search query: %s", filter.c_str());
+        len = 0;
+    }
+    /* one JSON object per line */
+    std::vector<json_object *> keys;
+    std::string                listing((const char *) buf, len);
+    for (size_t pos = 0, end = 0; pos < listing.size(); pos = end + 1) {
+        end = listing.find('\n', pos);
+        if (end == std::string::npos) {
+            end = listing.size();
+        }
+        json_object *jso = json_tokener_parse(listing.substr(pos, end - pos).c_str());
+        if (jso) {
+            keys.push_back(jso);
+        }
+    }
+    rnp_output_destroy(output);
+
+    if (keys.empty()) {
+        fprintf(fp, "Key(s) not found.\n");
+        return false;
+    }
+    fprintf(fp, "%d key%s found\n", (int) keys.size(), (keys.size() == 1) ? "" : "s");
+    for (auto jso : keys) {
+        cli_rnp_print_key_json(fp, jso, psecret);
+        json_object_put(jso);
+    }
+    fprintf(fp, "\n");
+    return true;
+}
+
 bool
 cli_rnp_save_keyrings(cli_rnp_t *rnp)
 {
@@ -1556,20 +1818,32 @@ cli_rnp_save_keyrings(cli_rnp_t *rnp)
         }
     }
 
-    // public keyring
-    if (!(pub_ret = rnp_output_to_path(&output, ppath.c_str()))) {
+    // public keyring, written via the temporary file so it may be updated in-place
+    uint32_t flags = RNP_OUTPUT_FILE_OVERWRITE | RNP_OUTPUT_FILE_RANDOM;
+    if (!(pub_ret = rnp_output_to_file(&output, ppath.c_str(), flags))) {
         pub_ret =
           rnp_save_keys(rnp->ffi, rnp->pubformat().c_str(), output, RNP_LOAD_SAVE_PUBLIC_KEYS);
+        if (!pub_ret) {
+            pub_ret = rnp_output_finish(output);
+        }
         rnp_output_destroy(output);
     }
     if (pub_ret) {
         ERR_MSG("failed to write pubring to path '%s'", ppath.c_str());
     }
 
-    // secret keyring
-    if (!(sec_ret = rnp_output_to_path(&output, spath.c_str()))) {
+    // secret keyring, G10 one is a directory
+    if (rnp->secformat() == "G10") {
+        sec_ret = rnp_output_to_path(&output, spath.c_str());
+    } else {
+        sec_ret = rnp_output_to_file(&output, spath.c_str(), flags);
+    }
+    if (!sec_ret) {
         sec_ret =
           rnp_save_keys(rnp->ffi, rnp->secformat().c_str(), output, RNP_LOAD_SAVE_SECRET_KEYS);
+        if (!sec_ret) {
+            sec_ret = rnp_output_finish(output);
+        }
         rnp_output_destroy(output);
     }
     if (sec_ret) {
@@ -1805,112 +2079,6 @@ done:
     return res;
 }
 
-static bool
-key_matches_string(rnpffi::Key &key, const std::string &str)
-{
-    if (str.empty()) {
-        return true;
-    }
-    if (rnp::is_hex(str) && (str.length() >= RNP_KEYID_SIZE)) {
-        std::string hexstr = rnp::strip_hex(str);
-        size_t      len = hexstr.length();
-
-        /* check whether it's key id */
-        if ((len == RNP_KEYID_SIZE * 2) || (len == RNP_KEYID_SIZE)) {
-            auto keyid = key.keyid();
-            if (keyid.size() < len) {
-                return false;
-            }
-            if (!strncasecmp(hexstr.c_str(), keyid.c_str() + keyid.size() - len, len)) {
-                return true;
-            }
-        }
-
-        /* check fingerprint */
-        auto keyfp = key.fprint();
-        if ((len == keyfp.size()) && !strncasecmp(hexstr.c_str(), keyfp.c_str(), len)) {
-            return true;
-        }
-
-        /* check grip */
-        auto grip = key.grip();
-        if (len == grip.size()) {
-            if (!strncasecmp(hexstr.c_str(), grip.c_str(), len)) {
-                return true;
-            }
-        }
-        /* let then search for hex userid */
-    }
-
-    /* no need to check for userid over the subkey */
-    if (key.is_sub()) {
-        return false;
-    }
-    auto uid_count = key.uid_count();
-    if (!uid_count) {
-        return false;
-    }
-
-#ifndef RNP_USE_STD_REGEX
-    regex_t r = {};
-    /* match on full name or email address as a NOSUB, ICASE regexp */
-    if (regcomp(&r, cli_rnp_unescape_for_regcomp(str).c_str(), REG_EXTENDED | REG_ICASE) !=
-        0) {
-        return false;
-    }
-#else
-    std::regex re;
-    try {
-        re.assign(str, std::regex_constants::ECMAScript | std::regex_constants::icase);
-    } catch (const std::exception &e) {
-        ERR_MSG("Invalid regular expression : %s, error %s.", str.c_str(), e.what());
-        return false;
-    }
-#endif
-
-    bool matches = false;
-    for (size_t idx = 0; idx < uid_count; idx++) {
-        auto uid = key.uid_at(idx);
-#ifndef RNP_USE_STD_REGEX
-        if (regexec(&r, uid.c_str(), 0, NULL, 0) == 0) {
-            matches = true;
-            break;
-        }
-#else
-        if (std::regex_search(uid, re)) {
-            matches = true;
-            break;
-        }
-#endif
-    }
-#ifndef RNP_USE_STD_REGEX
-    regfree(&r);
-#endif
-    return matches;
-}
-
-static bool
-key_matches_flags(rnpffi::Key &key, int flags)
-{
-    /* check whether secret key search is requested */
-    if ((flags & CLI_SEARCH_SECRET) && !key.secret()) {
-        return false;
-    }
-    /* check whether no subkeys allowed */
-    if (!key.is_sub()) {
-        return true;
-    }
-    if (!(flags & CLI_SEARCH_SUBKEYS)) {
-        return false;
-    }
-    /* check whether subkeys should be put after primary (if it is available) */
-    if ((flags & CLI_SEARCH_SUBKEYS_AFTER) != CLI_SEARCH_SUBKEYS_AFTER) {
-        return true;
-    }
-
-    return key.primary_grip().empty();
-}
-
 void
 clear_key_handles(std::vector<rnp_key_handle_t> &keys)
 {
@@ -1920,52 +2088,32 @@ clear_key_handles(std::vector<rnp_key_handle_t> &keys)
     keys.clear();
 }
 
-static bool
-add_key_to_array(rnp_ffi_t                      ffi,
-                 std::vector<rnp_key_handle_t> &keys,
-                 rnp_key_handle_t               key,
-                 int                            flags)
+bool
+cli_rnp_t::unlock_signers(const std::vector<std::string> &signers)
 {
-    bool subkey = false;
-    bool subkeys = (flags & CLI_SEARCH_SUBKEYS_AFTER) == CLI_SEARCH_SUBKEYS_AFTER;
-    if (rnp_key_is_sub(key, &subkey)) {
-        return false;
-    }
-
-    try {
-        keys.push_back(key);
-    } catch (const std::exception &e) {
-        ERR_MSG("%s", e.what());
+    std::vector<rnp_key_handle_t> keys;
+    if (!keys_matching(keys,
+                       signers,
+                       CLI_SEARCH_SECRET | CLI_SEARCH_DEFAULT | CLI_SEARCH_SUBKEYS |
+                         CLI_SEARCH_FIRST_ONLY)) {
+        ERR_MSG("Failed to build signing keys list");
         return false;
     }
-    if (!subkeys || subkey) {
-        return true;
-    }
-
-    std::vector<rnp_key_handle_t> subs;
-    size_t                        sub_count = 0;
-    if (rnp_key_get_subkey_count(key, &sub_count)) {
-        goto error;
-    }
-
-    try {
-        for (size_t i = 0; i < sub_count; i++) {
-            rnp_key_handle_t sub_handle = NULL;
-            if (rnp_key_get_subkey_at(key, i, &sub_handle)) {
-                goto error;
-            }
-            subs.push_back(sub_handle);
+    bool res = true;
+    for (auto key : keys) {
+        /* primary key may delegate signing to the subkey */
+        bool             primary = false;
+        rnp_key_handle_t signer = NULL;
+        if (!rnp_key_is_primary(key, &primary) && primary &&
+            !rnp_key_get_default_key(key, "sign", 0, &signer)) {
+            res = !rnp_key_unlock(signer, NULL) && res;
+            rnp_key_handle_destroy(signer);
+            continue;
         }
-        std::move(subs.begin(), subs.end(), std::back_inserter(keys));
-    } catch (const std::exception &e) {
-        ERR_MSG("%s", e.what());
-        goto error;
+        res = !rnp_key_unlock(key, NULL) && res;
     }
-    return true;
-error:
-    keys.pop_back();
-    clear_key_handles(subs);
-    return false;
+    clear_key_handles(keys);
+    return res;
 }
 
 bool
@@ -1973,32 +2121,44 @@ cli_rnp_t::keys_matching(std::vector<rnp_key_handle_t> &keys,
                          const std::string &            str,
                          int                            flags)
 {
-    rnpffi::FFI ffiobj(ffi, false);
-
-    /* iterate through the keys */
-    auto it = ffiobj.iterator_create("fingerprint");
-    if (!it) {
+    uint32_t search_flags = 0;
+    if (flags & CLI_SEARCH_SECRET) {
+        search_flags |= RNP_LOCATE_SECRET;
+    }
+    if (flags & CLI_SEARCH_SUBKEYS) {
+        search_flags |= RNP_LOCATE_SUBKEYS;
+    }
+    if ((flags & CLI_SEARCH_SUBKEYS_AFTER) == CLI_SEARCH_SUBKEYS_AFTER) {
+        search_flags |= RNP_LOCATE_SUBKEYS_AFTER;
+    }
+    if (flags & CLI_SEARCH_FIRST_ONLY) {
+        search_flags |= RNP_LOCATE_FIRST_ONLY;
+    }
+#ifndef RNP_USE_STD_REGEX
+    std::string query = cli_rnp_unescape_for_regcomp(str);
+#else
+    const std::string &query = str;
+#endif
+    rnp_key_iterator_t it = NULL;
+    if (rnp_locate_keys(ffi, query.c_str(), search_flags, &it)) {
+        ERR_MSG("Invalid search query: %s", str.c_str());
         return false;
     }
 
-    std::string fp;
-    while (it->next(fp)) {
-        auto key = ffiobj.locate_key("fingerprint", fp);
-        if (!key) {
-            continue;
-        }
-        if (!key_matches_flags(*key, flags) || !key_matches_string(*key, str)) {
-            continue;
-        }
-        if (!add_key_to_array(ffi, keys, key->handle(), flags)) {
-            return false;
-        }
-        key->release();
-        if (flags & CLI_SEARCH_FIRST_ONLY) {
-            return true;
+    bool             res = true;
+    rnp_key_handle_t key = NULL;
+    try {
+        while (!rnp_key_iterator_next(it, &key) && key) {
+            keys.push_back(key);
+            key = NULL;
         }
+    } catch (const std::exception &e) {
+        ERR_MSG("%s", e.what());
+        rnp_key_handle_destroy(key);
+        res = false;
     }
-    return !keys.empty();
+    rnp_key_iterator_destroy(it);
+    return res && !keys.empty();
 }
 
 bool
@@ -73,12 +73,34 @@ class cli_rnp_t {
     void substitute_args(int *argc, char ***argv);
 #endif
     bool init(const rnp_cfg &cfg);
+    /**
+     * @brief Initialize object for the batch processing in a separate thread. Configuration
+     *        and loaded keys are taken from the already initialized parent object, since FFI
+     *        object cannot be shared between the threads. Keys, unlocked in the parent, stay
+     *        unlocked. Passwords are requested via the parent, one request at a time.
+     */
+    bool init_worker(cli_rnp_t &parent);
     void end();
 
     bool init_io(Operation op, rnp_input_t *input, rnp_output_t *output);
 
     bool load_keyrings(bool loadsecret = false);
 
+    /**
+     * @brief Load public or secret keyring from the disk on top of already loaded keys. Keys
+     *        are merged, so already unlocked secret keys are kept unlocked. Keys, removed from
+     *        the keyring on disk, are unloaded.
+     */
+    bool refresh_keyring(bool secret);
+
+    /**
+     * @brief Unlock signing key(s) so they may be used for a number of operations without
+     *        the further password requests.
+     *
+     * @param signers list of search strings, default key is used if it is empty.
+     */
+    bool unlock_signers(const std::vector<std::string> &signers);
+
     const std::string &
     defkey()
     {
@@ -222,6 +244,17 @@ rnp_output_t cli_rnp_output_to_specifier(cli_rnp_t &        rnp,
 bool cli_rnp_save_keyrings(cli_rnp_t *rnp);
 void cli_rnp_print_key_info(
   FILE *fp, rnp_ffi_t ffi, rnp_key_handle_t key, bool psecret, bool psigs);
+/**
+ * @brief Print keys matching the filter, without signatures, using the single
+ *        rnp_list_keys() call instead of the per-key getters.
+ *
+ * @param rnp initialized CLI object
+ * @param fp output stream
+ * @param filter search query, see cli_rnp_t::keys_matching(). Empty string lists all keys.
+ * @param psecret list only keys with secret part, and mark them as sec/ssb.
+ * @return true if at least one key was found, false otherwise.
+ */
+bool cli_rnp_list_keys(cli_rnp_t *rnp, FILE *fp, const std::string &filter, bool psecret);
 bool        cli_rnp_set_generate_params(rnp_cfg &cfg, bool subkey = false);
 bool        cli_rnp_generate_key(cli_rnp_t *rnp, const char *username);
 bool        cli_rnp_export_keys(cli_rnp_t *rnp, const char *filter);
@@ -237,6 +270,7 @@ bool        cli_rnp_check_old_ciphers(cli_rnp_t *rnp);
 bool        cli_rnp_setup(cli_rnp_t *rnp);
 bool        cli_rnp_protect_file(cli_rnp_t *rnp);
 bool        cli_rnp_process_file(cli_rnp_t *rnp);
+bool        cli_rnp_serve(cli_rnp_t *rnp);
 std::string cli_rnp_escape_string(const std::string &src);
 void        cli_rnp_print_praise(void);
 void        cli_rnp_print_feature(FILE *fp, const char *type, const char *printed_type);
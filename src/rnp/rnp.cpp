@@ -35,6 +35,12 @@
 #include <stdlib.h>
 #include <string.h>
 #include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <algorithm>
+#include <unordered_map>
 #ifdef _MSC_VER
 #include "uniwin.h"
 #else
@@ -50,7 +56,9 @@
 
 #include "fficli.h"
 #include "str-utils.h"
+#include "file-utils.h"
 #include "logging.h"
+#include "thread-pool.hpp"
 
 static const char *usage =
   "Sign, verify, encrypt, decrypt, inspect OpenPGP data.\n"
@@ -103,6 +111,10 @@ static const char *usage =
   "  --notty                 Do not output anything to the TTY.\n"
   "  --current-time          Override system's time.\n"
   "  --set-filename          Override file name, stored inside of OpenPGP message.\n"
+  "  --batch file            Process inputs listed in the file, using keys loaded once.\n"
+  "    --threads num         Number of threads used to process the inputs.\n"
+  "    --results file        Write JSON results to the file instead of stdout.\n"
+  "  --listen path           Serve requests over the Unix socket, using keys loaded once.\n"
   "\n"
   "See man page for a detailed listing and explanation.\n"
   "\n";
@@ -170,6 +182,9 @@ enum optdefs {
     OPT_ALLOW_HIDDEN,
     OPT_S2K_ITER,
     OPT_S2K_MSEC,
+    OPT_BATCH,
+    OPT_THREADS,
+    OPT_LISTEN,
 
     /* debug */
     OPT_DEBUG
@@ -243,6 +258,9 @@ static struct option options[] = {
   {"s2k-msec", required_argument, NULL, OPT_S2K_MSEC},
   {"allow-weak-hash", no_argument, NULL, OPT_ALLOW_WEAK_HASH},
   {"allow-sha1-key-sigs", no_argument, NULL, OPT_ALLOW_SHA1},
+  {"batch", required_argument, NULL, OPT_BATCH},
+  {"threads", required_argument, NULL, OPT_THREADS},
+  {"listen", required_argument, NULL, OPT_LISTEN},
 
   {NULL, 0, NULL, 0},
 };
@@ -558,6 +576,23 @@ setoption(rnp_cfg &cfg, int val, const char *arg)
         cfg.set_int(CFG_S2K_MSEC, msec);
         return true;
     }
+    case OPT_BATCH:
+        cfg.set_str(CFG_BATCH, arg);
+        return true;
+    case OPT_THREADS: {
+        int threads = 0;
+        if (!rnp::str_to_int(arg, threads) || (threads <= 0)) {
+            ERR_MSG("Incorrect value for --threads option: %s", arg);
+            return false;
+        }
+        cfg.set_int(CFG_THREADS, threads);
+        return true;
+    }
+    case OPT_LISTEN:
+        cfg.set_str(CFG_LISTEN, arg);
+        /* requests may need secret keys for signing or decryption */
+        cfg.set_bool(CFG_NEEDSSECKEY, true);
+        return true;
     case OPT_DEBUG:
         ERR_MSG("Option --debug is deprecated, ignoring.");
         return true;
@@ -622,6 +657,266 @@ set_short_option(rnp_cfg &cfg, int ch, const char *arg)
     return true;
 }
 
+/* batch mode input: cfg values, specific for the item, are stored here */
+struct rnp_batch_item_t {
+    std::string input;
+    std::string output;
+    std::string operation;
+    int         command{};
+    bool        encrypt_pk{};
+    bool        encrypt_sk{};
+    bool        sign{};
+    bool        cleartext{};
+    bool        detached{};
+    bool        no_output{};
+    bool        seckey{};
+    std::string armor_type;
+};
+
+static bool
+batch_item_store(rnp_batch_item_t &item, const rnp_cfg &cfg)
+{
+    item.command = cfg.get_int(CFG_COMMAND);
+    switch (item.command) {
+    case CMD_PROTECT:
+    case CMD_PROCESS:
+    case CMD_LIST_PACKETS:
+    case CMD_DEARMOR:
+    case CMD_ENARMOR:
+        break;
+    default:
+        ERR_MSG("No operation specified for the batch input %s", item.input.c_str());
+        return false;
+    }
+    item.encrypt_pk = cfg.get_bool(CFG_ENCRYPT_PK);
+    item.encrypt_sk = cfg.get_bool(CFG_ENCRYPT_SK);
+    item.sign = cfg.get_bool(CFG_SIGN_NEEDED);
+    item.cleartext = cfg.get_bool(CFG_CLEARTEXT);
+    item.detached = cfg.get_bool(CFG_DETACHED);
+    item.no_output = cfg.get_bool(CFG_NO_OUTPUT);
+    item.seckey = cfg.get_bool(CFG_NEEDSSECKEY);
+    item.armor_type = cfg.get_str(CFG_ARMOR_DATA_TYPE);
+    return true;
+}
+
+static void
+batch_item_apply(const rnp_batch_item_t &item, rnp_cfg &cfg)
+{
+    cfg.set_int(CFG_COMMAND, item.command);
+    cfg.set_bool(CFG_ENCRYPT_PK, item.encrypt_pk);
+    cfg.set_bool(CFG_ENCRYPT_SK, item.encrypt_sk);
+    cfg.set_bool(CFG_SIGN_NEEDED, item.sign);
+    cfg.set_bool(CFG_CLEARTEXT, item.cleartext);
+    cfg.set_bool(CFG_DETACHED, item.detached);
+    cfg.set_bool(CFG_NO_OUTPUT, item.no_output);
+    if (item.armor_type.empty()) {
+        cfg.unset(CFG_ARMOR_DATA_TYPE);
+    } else {
+        cfg.set_str(CFG_ARMOR_DATA_TYPE, item.armor_type);
+    }
+    cfg.set_str(CFG_INFILE, item.input);
+    if (item.output.empty()) {
+        cfg.unset(CFG_OUTFILE);
+    } else {
+        cfg.set_str(CFG_OUTFILE, item.output);
+    }
+}
+
+/* batch file line is either input path or JSON object with input, output and operation */
+static bool
+batch_item_parse(const std::string &line, const rnp_cfg &cfg, rnp_batch_item_t &item)
+{
+    if (line[0] != '{') {
+        item.input = line;
+        return batch_item_store(item, cfg);
+    }
+
+    json_object *jso = json_tokener_parse(line.c_str());
+    if (!jso || !json_object_is_type(jso, json_type_object)) {
+        ERR_MSG("Invalid batch file line: %s", line.c_str());
+        json_object_put(jso);
+        return false;
+    }
+    const char *input = json_obj_get_str(jso, "input");
+    const char *output = json_obj_get_str(jso, "output");
+    const char *operation = json_obj_get_str(jso, "operation");
+    item.input = input ? input : "";
+    item.output = output ? output : "";
+    item.operation = operation ? operation : "";
+    json_object_put(jso);
+
+    if (item.input.empty()) {
+        ERR_MSG("No input specified in batch file line: %s", line.c_str());
+        return false;
+    }
+    if (item.operation.empty()) {
+        return batch_item_store(item, cfg);
+    }
+
+    static const std::unordered_map<std::string, int> operations = {
+      {"encrypt", CMD_ENCRYPT},
+      {"sign", CMD_SIGN},
+      {"detached-sign", CMD_SIGN},
+      {"clearsign", CMD_CLEARSIGN},
+      {"decrypt", CMD_DECRYPT},
+      {"verify", CMD_VERIFY},
+      {"dearmor", CMD_DEARMOR},
+      {"enarmor", CMD_ENARMOR},
+      {"list-packets", CMD_LIST_PACKETS}};
+    auto it = operations.find(item.operation);
+    if (it == operations.end()) {
+        ERR_MSG("Unsupported batch operation: %s", item.operation.c_str());
+        return false;
+    }
+    rnp_cfg opcfg;
+    if (item.operation == "detached-sign") {
+        opcfg.set_bool(CFG_DETACHED, true);
+    }
+    return setcmd(opcfg, it->second, NULL) && batch_item_store(item, opcfg);
+}
+
+static bool
+batch_load(rnp_cfg &cfg, std::vector<rnp_batch_item_t> &items)
+{
+    const std::string &path = cfg.get_str(CFG_BATCH);
+    FILE *             fp = (path == "-") ? stdin : rnp_fopen(path.c_str(), "r");
+    if (!fp) {
+        ERR_MSG("Cannot open batch file %s", path.c_str());
+        return false;
+    }
+
+    bool        res = true;
+    std::string line;
+    while (res) {
+        int ch = fgetc(fp);
+        if ((ch != EOF) && (ch != '\n')) {
+            line.push_back((char) ch);
+            continue;
+        }
+        if (!line.empty() && (line.back() == '\r')) {
+            line.pop_back();
+        }
+        if (!line.empty()) {
+            items.emplace_back();
+            res = batch_item_parse(line, cfg, items.back());
+        }
+        line.clear();
+        if (ch == EOF) {
+            break;
+        }
+    }
+    if (fp != stdin) {
+        fclose(fp);
+    }
+    if (!res) {
+        return false;
+    }
+
+    /* operations, specified in the batch file, may require keys */
+    for (auto &item : items) {
+        if (item.seckey) {
+            cfg.set_bool(CFG_NEEDSSECKEY, true);
+        }
+        if (!item.operation.empty() &&
+            ((item.command == CMD_PROTECT) || (item.command == CMD_PROCESS)) &&
+            !cfg.has(CFG_KEYFILE)) {
+            cfg.set_bool(CFG_KEYSTORE_DISABLED, false);
+        }
+    }
+    return true;
+}
+
+static void
+batch_report(FILE *fp, size_t idx, const rnp_batch_item_t &item, bool success)
+{
+    json_object *jso = json_object_new_object();
+    if (!jso) {
+        return;
+    }
+    json_object_object_add(jso, "index", json_object_new_int64(idx));
+    json_object_object_add(jso, "input", json_object_new_string(item.input.c_str()));
+    if (!item.output.empty()) {
+        json_object_object_add(jso, "output", json_object_new_string(item.output.c_str()));
+    }
+    if (!item.operation.empty()) {
+        json_object_object_add(
+          jso, "operation", json_object_new_string(item.operation.c_str()));
+    }
+    json_object_object_add(
+      jso, "status", json_object_new_string(success ? "success" : "failure"));
+    fprintf(fp, "%s\n", json_object_to_json_string_ext(jso, JSON_C_TO_STRING_PLAIN));
+    fflush(fp);
+    json_object_put(jso);
+}
+
+/* process batch items using the keys, loaded once, and a number of threads */
+static bool
+rnp_batch(cli_rnp_t &rnp, const std::vector<rnp_batch_item_t> &items)
+{
+    FILE *             resfp = stdout;
+    const std::string &respath = rnp.cfg().get_str(CFG_RESULTS);
+    if (!respath.empty() && !(resfp = rnp_fopen(respath.c_str(), "w"))) {
+        ERR_MSG("Cannot open results %s for writing", respath.c_str());
+        return false;
+    }
+
+    size_t count = rnp.cfg().get_int(CFG_THREADS, 1);
+    count = std::max<size_t>(std::min(count, items.size()), 1);
+    bool sign = std::any_of(
+      items.begin(), items.end(), [](const rnp_batch_item_t &item) { return item.sign; });
+    bool setfname = rnp.cfg().has(CFG_SETFNAME);
+    auto signers = rnp.cfg().get_list(CFG_SIGNERS);
+
+    /* FFI object is not thread-safe, so each thread needs its own copy of the keys. Signers
+     * are unlocked once, and copied to the workers unlocked. */
+    std::vector<std::unique_ptr<cli_rnp_t>> workers;
+    std::vector<cli_rnp_t *>                slots = {&rnp};
+    bool                                    res = !sign || rnp.unlock_signers(signers);
+    for (size_t i = 1; res && (i < count); i++) {
+        std::unique_ptr<cli_rnp_t> worker(new cli_rnp_t());
+        res = worker->init_worker(rnp);
+        slots.push_back(worker.get());
+        workers.push_back(std::move(worker));
+    }
+    if (!res) {
+        ERR_MSG("fatal: failed to initialise batch processing");
+        if (resfp != stdout) {
+            fclose(resfp);
+        }
+        return false;
+    }
+
+    std::atomic<size_t> next(0);
+    std::atomic<size_t> slot(0);
+    std::atomic<bool>   success(true);
+    std::mutex          report_lock;
+    auto                process = [&]() {
+        cli_rnp_t *worker = slots[slot++];
+        size_t     idx;
+        while ((idx = next++) < items.size()) {
+            auto &item = items[idx];
+            batch_item_apply(item, worker->cfg());
+            /* could be set during the previous input processing */
+            if (!setfname) {
+                worker->cfg().unset(CFG_SETFNAME);
+            }
+            bool ok = rnp_cmd(worker);
+            if (!ok) {
+                success = false;
+            }
+            std::lock_guard<std::mutex> lock(report_lock);
+            batch_report(resfp, idx, item, ok);
+        }
+    };
+
+    rnp::ThreadPool pool(slots.size());
+    pool.run_parallel(slots.size(), process);
+    if (resfp != stdout) {
+        fclose(resfp);
+    }
+    return success;
+}
+
 #ifndef RNP_RUN_TESTS
 int
 main(int argc, char **argv)
@@ -676,10 +971,28 @@ rnp_main(int argc, char **argv)
     default:;
     }
 
+    if (cfg.has(CFG_LISTEN) && (cfg.has(CFG_BATCH) || (optind < argc))) {
+        ERR_MSG("Option --listen cannot be used together with --batch or input files.");
+        return EXIT_ERROR;
+    }
+
+    std::vector<rnp_batch_item_t> batch;
+    if (cfg.has(CFG_BATCH)) {
+        if (optind < argc) {
+            ERR_MSG("Input files cannot be specified together with --batch.");
+            return EXIT_ERROR;
+        }
+        if (!batch_load(cfg, batch)) {
+            return EXIT_ERROR;
+        }
+    }
+
     if (!cli_cfg_set_keystore_info(cfg)) {
         ERR_MSG("fatal: cannot set keystore info");
         return EXIT_ERROR;
     }
+    /* operations request secret keys by id, so there is no need to read all of the files */
+    cfg.set_bool(CFG_DEFER_G10, true);
 
     if (!rnp.init(cfg)) {
         ERR_MSG("fatal: cannot initialise");
@@ -714,6 +1027,14 @@ rnp_main(int argc, char **argv)
         return EXIT_ERROR;
     }
 
+    if (rnp.cfg().has(CFG_BATCH)) {
+        return cli_rnp_t::ret_code(rnp_batch(rnp, batch));
+    }
+
+    if (rnp.cfg().has(CFG_LISTEN)) {
+        return cli_rnp_t::ret_code(cli_rnp_serve(&rnp));
+    }
+
     /* now do the required action for each of the command line args */
     if (optind == argc) {
         return cli_rnp_t::ret_code(rnp_cmd(&rnp));
@@ -44,7 +44,7 @@
 #define CFG_NO_OUTPUT "no_output"        /* do not output any data - just verify or process */
 #define CFG_INFILE "infile"              /* name/path of the input file */
 #define CFG_SETFNAME "setfname"          /* file name to embed into the literal data packet */
-#define CFG_RESULTS "results"            /* name/path for results, not used right now */
+#define CFG_RESULTS "results"            /* name/path for batch mode results */
 #define CFG_KEYSTOREFMT "keystorefmt"    /* keyring format : GPG, G10, KBX */
 #define CFG_COREDUMPS "coredumps"        /* enable/disable core dumps. 1 or 0. */
 #define CFG_NEEDSSECKEY "needsseckey"    /* needs secret key for the ongoing operation */
@@ -101,6 +101,10 @@
 #define CFG_ALLOW_OLD_CIPHERS \
     "allow-old-ciphers" /* Allow to use 64-bit ciphers (CAST5, 3DES, IDEA, BLOWFISH) */
 #define CFG_ALLOW_HIDDEN "allow-hidden" /* allow hidden recipients */
+#define CFG_BATCH "batch"               /* file with the list of inputs to process */
+#define CFG_THREADS "threads"           /* number of threads used in batch mode */
+#define CFG_LISTEN "listen"             /* unix socket path for the service mode */
+#define CFG_DEFER_G10 "defer-g10"       /* read G10 key files only when key is requested */
 
 /* rnp keyring setup variables */
 #define CFG_KR_PUB_FORMAT "kr-pub-format"
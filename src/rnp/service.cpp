@@ -0,0 +1,716 @@
+/*
+ * Copyright (c) 2024 [Ribose Inc](https://www.ribose.com).
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1.  Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ * 2.  Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Service mode: keys are loaded and unlocked once, requests are served over the local Unix
+ * socket. Every message is sent as a sequence of frames: 4-byte big-endian length, followed by
+ * the data.
+ * Request:  JSON header frame, payload frames, empty frame.
+ * Response: output frames, empty frame, JSON result frame.
+ * The whole request is read before processing, and the whole output is produced before the
+ * response is sent, so client may send the request without reading the response. Both are
+ * limited in size. Connections are accepted from the processes of the same user only, and
+ * each one is served by the thread of the pool, so a stalled client does not block the other
+ * ones. FFI object is shared, so operations themselves are executed one at a time.
+ */
+
+#include "config.h"
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <errno.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/time.h>
+#include <poll.h>
+#include <unistd.h>
+#include <signal.h>
+#endif
+#include "fficli.h"
+#include "file-utils.h"
+#include "thread-pool.hpp"
+
+#ifdef _WIN32
+bool
+cli_rnp_serve(cli_rnp_t *rnp)
+{
+    ERR_MSG("Service mode is not supported on Windows.");
+    return false;
+}
+#else
+
+/* maximum size of the JSON request header */
+#define SERVICE_MAX_HEADER 65536
+/* maximum number of the simultaneous client connections */
+#define SERVICE_MAX_CLIENTS 64
+/* timeout for a single read or write within the request, in seconds */
+#define SERVICE_IO_TIMEOUT 30
+/* maximum size of the request payload */
+#define SERVICE_MAX_PAYLOAD (64 * 1024 * 1024)
+/* maximum size of the operation output */
+#define SERVICE_MAX_OUTPUT (256 * 1024 * 1024)
+
+namespace {
+struct service_t {
+    cli_rnp_t *       rnp{};
+    std::mutex        lock; /* FFI object is not thread-safe, so guards all operations */
+    int64_t           mtimes[2]{};
+    std::atomic<bool> shutdown{};
+    int               wake[2]{-1, -1}; /* pipe to wake up the accepting thread */
+    std::mutex        conns_lock;
+    std::set<int>     conns; /* connections being served */
+};
+
+bool
+sock_read(int fd, void *buf, size_t len)
+{
+    uint8_t *ptr = (uint8_t *) buf;
+    while (len) {
+        ssize_t res = read(fd, ptr, len);
+        if ((res < 0) && (errno == EINTR)) {
+            continue;
+        }
+        if (res <= 0) {
+            return false;
+        }
+        ptr += res;
+        len -= res;
+    }
+    return true;
+}
+
+bool
+sock_write(int fd, const void *buf, size_t len)
+{
+    const uint8_t *ptr = (const uint8_t *) buf;
+    while (len) {
+        ssize_t res = write(fd, ptr, len);
+        if ((res < 0) && (errno == EINTR)) {
+            continue;
+        }
+        if (res <= 0) {
+            return false;
+        }
+        ptr += res;
+        len -= res;
+    }
+    return true;
+}
+
+bool
+frame_read_len(int fd, uint32_t &len)
+{
+    uint8_t hdr[4] = {0};
+    if (!sock_read(fd, hdr, sizeof(hdr))) {
+        return false;
+    }
+    len = ((uint32_t) hdr[0] << 24) | ((uint32_t) hdr[1] << 16) | ((uint32_t) hdr[2] << 8) |
+          (uint32_t) hdr[3];
+    return true;
+}
+
+bool
+frame_write(int fd, const void *buf, uint32_t len)
+{
+    uint8_t hdr[4] = {
+      (uint8_t)(len >> 24), (uint8_t)(len >> 16), (uint8_t)(len >> 8), (uint8_t) len};
+    return sock_write(fd, hdr, sizeof(hdr)) && (!len || sock_write(fd, buf, len));
+}
+
+/* read all payload frames, so output may be written without blocking on the client */
+bool
+service_read_payload(int fd, std::vector<uint8_t> &payload)
+{
+    try {
+        while (true) {
+            uint32_t len = 0;
+            if (!frame_read_len(fd, len)) {
+                return false;
+            }
+            if (!len) {
+                return true;
+            }
+            size_t pos = payload.size();
+            if (len > SERVICE_MAX_PAYLOAD - pos) {
+                ERR_MSG("Service request payload is too large.");
+                return false;
+            }
+            payload.resize(pos + len);
+            if (!sock_read(fd, payload.data() + pos, len)) {
+                return false;
+            }
+        }
+    } catch (const std::exception &e) {
+        /* LCOV_EXCL_START */
+        ERR_MSG("Failed to read service request: %s", e.what());
+        return false;
+        /* LCOV_EXCL_END */
+    }
+}
+
+bool
+service_write_output(int fd, const uint8_t *buf, size_t len)
+{
+    /* empty frame marks end of the output, so must not be sent here */
+    while (len) {
+        uint32_t flen = (uint32_t) std::min<size_t>(len, 1U << 30);
+        if (!frame_write(fd, buf, flen)) {
+            return false;
+        }
+        buf += flen;
+        len -= flen;
+    }
+    return true;
+}
+
+void
+service_wake(service_t &svc)
+{
+    uint8_t ch = 0;
+    while ((write(svc.wake[1], &ch, 1) < 0) && (errno == EINTR)) {
+    }
+}
+
+bool
+service_bool(json_object *req, const char *key)
+{
+    json_object *fld = NULL;
+    return json_object_object_get_ex(req, key, &fld) && json_object_get_boolean(fld);
+}
+
+/* get list of key search strings from the request, or from the cfg if it is absent */
+std::vector<std::string>
+service_names(cli_rnp_t *rnp, json_object *req, const char *key, const char *cfgkey)
+{
+    json_object *arr = NULL;
+    if (!json_object_object_get_ex(req, key, &arr) ||
+        !json_object_is_type(arr, json_type_array)) {
+        return rnp->cfg().get_list(cfgkey);
+    }
+    std::vector<std::string> names;
+    for (size_t idx = 0; idx < json_object_array_length(arr); idx++) {
+        json_object *name = json_object_array_get_idx(arr, idx);
+        if (json_object_is_type(name, json_type_string)) {
+            names.push_back(json_object_get_string(name));
+        }
+    }
+    return names;
+}
+
+bool
+service_signers(cli_rnp_t *rnp, json_object *req, std::vector<rnp_key_handle_t> &keys)
+{
+    auto names = service_names(rnp, req, "signers", CFG_SIGNERS);
+    /* signing keys are kept unlocked between the requests */
+    if (!rnp->unlock_signers(names)) {
+        return false;
+    }
+    return rnp->keys_matching(keys,
+                              names,
+                              CLI_SEARCH_SECRET | CLI_SEARCH_DEFAULT | CLI_SEARCH_SUBKEYS |
+                                CLI_SEARCH_FIRST_ONLY);
+}
+
+rnp_result_t
+service_sign(cli_rnp_t *        rnp,
+             json_object *      req,
+             const std::string &op,
+             rnp_input_t        input,
+             rnp_output_t       output)
+{
+    rnp_op_sign_t sign = NULL;
+    rnp_result_t  ret = RNP_ERROR_GENERIC;
+    if (op == "clearsign") {
+        ret = rnp_op_sign_cleartext_create(&sign, rnp->ffi, input, output);
+    } else if (op == "detached-sign") {
+        ret = rnp_op_sign_detached_create(&sign, rnp->ffi, input, output);
+    } else {
+        ret = rnp_op_sign_create(&sign, rnp->ffi, input, output);
+    }
+    if (ret) {
+        return ret;
+    }
+
+    std::vector<rnp_key_handle_t> keys;
+    if (op != "clearsign") {
+        rnp_op_sign_set_armor(sign, service_bool(req, "armor"));
+    }
+    ret = rnp_op_sign_set_hash(sign, rnp->cfg().get_hashalg().c_str());
+    if (ret) {
+        goto done;
+    }
+    if (!service_signers(rnp, req, keys)) {
+        ret = RNP_ERROR_NO_SUITABLE_KEY;
+        goto done;
+    }
+    for (auto key : keys) {
+        if ((ret = rnp_op_sign_add_signature(sign, key, NULL))) {
+            goto done;
+        }
+    }
+    ret = rnp_op_sign_execute(sign);
+done:
+    clear_key_handles(keys);
+    rnp_op_sign_destroy(sign);
+    return ret;
+}
+
+rnp_result_t
+service_encrypt(cli_rnp_t *rnp, json_object *req, rnp_input_t input, rnp_output_t output)
+{
+    rnp_op_encrypt_t enc = NULL;
+    rnp_result_t     ret = rnp_op_encrypt_create(&enc, rnp->ffi, input, output);
+    if (ret) {
+        return ret;
+    }
+
+    std::vector<rnp_key_handle_t> keys;
+    json_object *                 fld = NULL;
+    rnp_op_encrypt_set_armor(enc, service_bool(req, "armor"));
+    if ((ret = rnp_op_encrypt_set_cipher(enc, rnp->cfg().get_cipher().c_str()))) {
+        goto done;
+    }
+    if (!rnp->keys_matching(keys,
+                            service_names(rnp, req, "recipients", CFG_RECIPIENTS),
+                            CLI_SEARCH_DEFAULT | CLI_SEARCH_SUBKEYS | CLI_SEARCH_FIRST_ONLY)) {
+        ret = RNP_ERROR_KEY_NOT_FOUND;
+        goto done;
+    }
+    for (auto key : keys) {
+        if ((ret = rnp_op_encrypt_add_recipient(enc, key))) {
+            goto done;
+        }
+    }
+    clear_key_handles(keys);
+    /* encrypt-and-sign if signers are specified */
+    if (json_object_object_get_ex(req, "signers", &fld)) {
+        if ((ret = rnp_op_encrypt_set_hash(enc, rnp->cfg().get_hashalg().c_str()))) {
+            goto done;
+        }
+        if (!service_signers(rnp, req, keys)) {
+            ret = RNP_ERROR_NO_SUITABLE_KEY;
+            goto done;
+        }
+        for (auto key : keys) {
+            if ((ret = rnp_op_encrypt_add_signature(enc, key, NULL))) {
+                goto done;
+            }
+        }
+    }
+    ret = rnp_op_encrypt_execute(enc);
+done:
+    clear_key_handles(keys);
+    rnp_op_encrypt_destroy(enc);
+    return ret;
+}
+
+void
+service_add_signatures(rnp_op_verify_t verify, json_object *res)
+{
+    size_t count = 0;
+    if (rnp_op_verify_get_signature_count(verify, &count) || !count) {
+        return;
+    }
+    json_object *sigs = json_object_new_array();
+    if (!sigs) {
+        return;
+    }
+    for (size_t idx = 0; idx < count; idx++) {
+        rnp_op_verify_signature_t sig = NULL;
+        rnp_signature_handle_t    handle = NULL;
+        char *                    keyid = NULL;
+        json_object *             jso = json_object_new_object();
+        if (!jso || rnp_op_verify_get_signature_at(verify, idx, &sig)) {
+            json_object_put(jso);
+            continue;
+        }
+        rnp_result_t status = rnp_op_verify_signature_get_status(sig);
+        json_object_object_add(
+          jso, "status", json_object_new_string(rnp_result_to_string(status)));
+        if (!rnp_op_verify_signature_get_handle(sig, &handle) &&
+            !rnp_signature_get_keyid(handle, &keyid) && keyid) {
+            json_object_object_add(jso, "keyid", json_object_new_string(keyid));
+        }
+        rnp_buffer_destroy(keyid);
+        rnp_signature_handle_destroy(handle);
+        json_object_array_add(sigs, jso);
+    }
+    json_object_object_add(res, "signatures", sigs);
+}
+
+rnp_result_t
+service_verify(cli_rnp_t *        rnp,
+               const std::string &op,
+               rnp_input_t        input,
+               rnp_output_t       output,
+               json_object *      res)
+{
+    rnp_op_verify_t verify = NULL;
+    rnp_output_t    discard = NULL;
+    bool            decrypt = op == "decrypt";
+    rnp_result_t    ret = RNP_ERROR_GENERIC;
+    if (!decrypt && (ret = rnp_output_to_null(&discard))) {
+        return ret;
+    }
+    ret = rnp_op_verify_create(&verify, rnp->ffi, input, decrypt ? output : discard);
+    if (ret) {
+        goto done;
+    }
+    {
+        /* decryption key is kept unlocked, so next requests do not need key derivation */
+        uint32_t flags = decrypt ?
+                           RNP_VERIFY_IGNORE_SIGS_ON_DECRYPT | RNP_VERIFY_KEEP_KEYS_UNLOCKED :
+                           RNP_VERIFY_REQUIRE_ALL_SIGS;
+        if (rnp->cfg().get_bool(CFG_ALLOW_HIDDEN)) {
+            flags |= RNP_VERIFY_ALLOW_HIDDEN_RECIPIENT;
+        }
+        if ((ret = rnp_op_verify_set_flags(verify, flags))) {
+            goto done;
+        }
+    }
+    ret = rnp_op_verify_execute(verify);
+    service_add_signatures(verify, res);
+done:
+    rnp_op_verify_destroy(verify);
+    rnp_output_destroy(discard);
+    return ret;
+}
+
+rnp_result_t
+service_locate(cli_rnp_t *rnp, json_object *req, json_object *res)
+{
+    const char *                  search = json_obj_get_str(req, "key");
+    std::vector<rnp_key_handle_t> keys;
+    if (!rnp->keys_matching(keys, search ? search : "", CLI_SEARCH_SUBKEYS_AFTER)) {
+        return RNP_ERROR_KEY_NOT_FOUND;
+    }
+    json_object *arr = json_object_new_array();
+    if (!arr) {
+        clear_key_handles(keys);
+        return RNP_ERROR_OUT_OF_MEMORY;
+    }
+    for (auto key : keys) {
+        char *fp = NULL;
+        if (!rnp_key_get_fprint(key, &fp)) {
+            json_object_array_add(arr, json_object_new_string(fp));
+        }
+        rnp_buffer_destroy(fp);
+    }
+    json_object_object_add(res, "keys", arr);
+    clear_key_handles(keys);
+    return RNP_SUCCESS;
+}
+
+/* load keyring again if it was changed on disk, unlocked keys are kept unlocked while keys,
+ * removed on disk, are unloaded */
+void
+service_refresh(cli_rnp_t *rnp, int64_t mtimes[2])
+{
+    if (rnp->cfg().get_bool(CFG_KEYSTORE_DISABLED)) {
+        return;
+    }
+    for (int secret = 0; secret < 2; secret++) {
+        const std::string &path = secret ? rnp->secpath() : rnp->pubpath();
+        int64_t            mtime = rnp_filemtime(path.c_str());
+        if (mtime == mtimes[secret]) {
+            continue;
+        }
+        mtimes[secret] = mtime;
+        if (!rnp->refresh_keyring(secret)) {
+            ERR_MSG("Warning: failed to refresh keyring '%s'.", path.c_str());
+        }
+    }
+}
+
+bool
+service_request(service_t &svc, int fd)
+{
+    uint32_t len = 0;
+    if (!frame_read_len(fd, len)) {
+        /* connection is closed */
+        return false;
+    }
+    if (!len || (len > SERVICE_MAX_HEADER)) {
+        ERR_MSG("Invalid service request header length: %u", (unsigned) len);
+        return false;
+    }
+    std::string          hdr(len, '\0');
+    std::vector<uint8_t> payload;
+    if (!sock_read(fd, &hdr[0], len) || !service_read_payload(fd, payload)) {
+        return false;
+    }
+
+    cli_rnp_t *  rnp = svc.rnp;
+    rnp_input_t  input = NULL;
+    rnp_output_t output = NULL;
+    rnp_result_t ret = RNP_ERROR_BAD_PARAMETERS;
+    json_object *req = json_tokener_parse(hdr.c_str());
+    json_object *res = json_object_new_object();
+    const char * opstr = req ? json_obj_get_str(req, "operation") : NULL;
+    std::string  op = opstr ? opstr : "";
+
+    if (!res) {
+        json_object_put(req);
+        return false;
+    }
+    if (!req || !json_object_is_type(req, json_type_object)) {
+        ERR_MSG("Invalid service request: %s", hdr.c_str());
+    } else if (rnp_input_from_memory(&input, payload.data(), payload.size(), false) ||
+               rnp_output_to_memory(&output, SERVICE_MAX_OUTPUT)) {
+        ret = RNP_ERROR_OUT_OF_MEMORY;
+    } else {
+        std::lock_guard<std::mutex> lock(svc.lock);
+        service_refresh(rnp, svc.mtimes);
+        if ((op == "sign") || (op == "detached-sign") || (op == "clearsign")) {
+            ret = service_sign(rnp, req, op, input, output);
+        } else if (op == "encrypt") {
+            ret = service_encrypt(rnp, req, input, output);
+        } else if ((op == "verify") || (op == "decrypt")) {
+            ret = service_verify(rnp, op, input, output, res);
+        } else if (op == "locate") {
+            ret = service_locate(rnp, req, res);
+        } else if (op == "shutdown") {
+            svc.shutdown = true;
+            service_wake(svc);
+            ret = RNP_SUCCESS;
+        } else {
+            ERR_MSG("Unsupported service operation: %s", op.c_str());
+        }
+    }
+    json_object_put(req);
+
+    /* output is sent without holding the lock, and only if operation succeeded */
+    uint8_t *buf = NULL;
+    size_t   buflen = 0;
+    if (!ret && output) {
+        ret = rnp_output_memory_get_buf(output, &buf, &buflen, false);
+    }
+    json_object_object_add(res, "status", json_object_new_string(ret ? "failure" : "success"));
+    if (ret) {
+        json_object_object_add(
+          res, "error", json_object_new_string(rnp_result_to_string(ret)));
+        buflen = 0;
+    }
+    const char *resstr = json_object_to_json_string_ext(res, JSON_C_TO_STRING_PLAIN);
+    bool ok = service_write_output(fd, buf, buflen) && frame_write(fd, NULL, 0) &&
+              frame_write(fd, resstr, strlen(resstr));
+    json_object_put(res);
+    rnp_input_destroy(input);
+    rnp_output_destroy(output);
+    return ok;
+}
+
+/* socket is created with owner-only permissions, however check the peer as well */
+bool
+service_peer_allowed(int fd)
+{
+#if defined(__linux__)
+    struct ucred cred = {};
+    socklen_t    len = sizeof(cred);
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len)) {
+        ERR_MSG("Failed to get peer credentials: %s", strerror(errno));
+        return false;
+    }
+    uid_t uid = cred.uid;
+#else
+    uid_t uid = 0;
+    gid_t gid = 0;
+    if (getpeereid(fd, &uid, &gid)) {
+        ERR_MSG("Failed to get peer credentials: %s", strerror(errno));
+        return false;
+    }
+#endif
+    if (uid != geteuid()) {
+        ERR_MSG("Rejected connection from the user %u.", (unsigned) uid);
+        return false;
+    }
+    return true;
+}
+
+/* stalled client must not block the other ones forever */
+bool
+service_set_timeouts(int fd)
+{
+    struct timeval tv = {};
+    tv.tv_sec = SERVICE_IO_TIMEOUT;
+    if (setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) ||
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv))) {
+        ERR_MSG("Failed to set socket timeouts: %s", strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+/* serve requests of the single connection, until it is closed or service is shut down */
+void
+service_connection(service_t &svc, int fd)
+{
+    struct pollfd pfd = {};
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    /* idle connection is kept open, shutdown() of the socket wakes up the poll() */
+    while (!svc.shutdown) {
+        int res = poll(&pfd, 1, -1);
+        if ((res < 0) && (errno == EINTR)) {
+            continue;
+        }
+        if ((res < 0) || !service_request(svc, fd)) {
+            break;
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(svc.conns_lock);
+        svc.conns.erase(fd);
+    }
+    close(fd);
+}
+
+void
+service_accept(service_t &svc, int sock, rnp::ThreadPool &pool)
+{
+    int conn = accept(sock, NULL, NULL);
+    if (conn < 0) {
+        if ((errno != EINTR) && (errno != ECONNABORTED)) {
+            ERR_MSG("Failed to accept connection: %s", strerror(errno));
+        }
+        return;
+    }
+    if (!service_peer_allowed(conn) || !service_set_timeouts(conn)) {
+        close(conn);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(svc.conns_lock);
+        if (svc.conns.size() >= SERVICE_MAX_CLIENTS) {
+            ERR_MSG("Too many service connections.");
+            close(conn);
+            return;
+        }
+        svc.conns.insert(conn);
+    }
+    /* pool has a thread per connection, so task is never queued for long */
+    if (!pool.push([&svc, conn]() { service_connection(svc, conn); })) {
+        /* LCOV_EXCL_START */
+        std::lock_guard<std::mutex> lock(svc.conns_lock);
+        svc.conns.erase(conn);
+        close(conn);
+        /* LCOV_EXCL_END */
+    }
+}
+} // namespace
+
+bool
+cli_rnp_serve(cli_rnp_t *rnp)
+{
+    const std::string &path = rnp->cfg().get_str(CFG_LISTEN);
+    struct sockaddr_un addr = {};
+    if (path.empty() || (path.size() >= sizeof(addr.sun_path))) {
+        ERR_MSG("Invalid socket path: %s", path.c_str());
+        return false;
+    }
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+    /* remove stale socket, left from the previous run */
+    struct stat st = {};
+    if (!rnp_stat(path.c_str(), &st)) {
+        if (!S_ISSOCK(st.st_mode)) {
+            ERR_MSG("Path %s already exists and is not a socket.", path.c_str());
+            return false;
+        }
+        rnp_unlink(path.c_str());
+    }
+
+    int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sock < 0) {
+        ERR_MSG("Failed to create socket: %s", strerror(errno));
+        return false;
+    }
+    /* socket must be accessible by the owner only */
+    mode_t mask = umask(077);
+    bool   res = !bind(sock, (struct sockaddr *) &addr, sizeof(addr));
+    umask(mask);
+    if (!res || listen(sock, SOMAXCONN)) {
+        ERR_MSG("Failed to listen on %s: %s", path.c_str(), strerror(errno));
+        close(sock);
+        return false;
+    }
+    /* client may close connection in the middle of the response */
+    signal(SIGPIPE, SIG_IGN);
+
+    service_t svc;
+    svc.rnp = rnp;
+    svc.mtimes[0] = rnp_filemtime(rnp->pubpath().c_str());
+    svc.mtimes[1] = rnp_filemtime(rnp->secpath().c_str());
+    if (pipe(svc.wake)) {
+        ERR_MSG("Failed to create pipe: %s", strerror(errno));
+        close(sock);
+        rnp_unlink(path.c_str());
+        return false;
+    }
+    auto signers = rnp->cfg().get_list(CFG_SIGNERS);
+    if (!signers.empty() && !rnp->unlock_signers(signers)) {
+        ERR_MSG("Warning: failed to unlock signing key(s).");
+    }
+
+    {
+        rnp::ThreadPool pool(SERVICE_MAX_CLIENTS);
+        struct pollfd   fds[2] = {};
+        fds[0].fd = sock;
+        fds[0].events = POLLIN;
+        fds[1].fd = svc.wake[0];
+        fds[1].events = POLLIN;
+        while (!svc.shutdown) {
+            if (poll(fds, 2, -1) < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                ERR_MSG("Failed to wait for connections: %s", strerror(errno));
+                break;
+            }
+            if (!svc.shutdown && (fds[0].revents & POLLIN)) {
+                service_accept(svc, sock, pool);
+            }
+        }
+        /* wake up the connections, pool destructor waits for them */
+        std::lock_guard<std::mutex> lock(svc.conns_lock);
+        for (int fd : svc.conns) {
+            ::shutdown(fd, SHUT_RDWR);
+        }
+    }
+    close(svc.wake[0]);
+    close(svc.wake[1]);
+    close(sock);
+    rnp_unlink(path.c_str());
+    return svc.shutdown;
+}
+#endif
@@ -159,6 +159,11 @@ print_keys_info(cli_rnp_t *rnp, FILE *fp, const char *filter)
     int  flags = CLI_SEARCH_SUBKEYS_AFTER | (psecret ? CLI_SEARCH_SECRET : 0);
     std::vector<rnp_key_handle_t> keys;
 
+    /* signatures are not a part of the bulk listing */
+    if (!psigs) {
+        return cli_rnp_list_keys(rnp, fp, filter ? filter : "", psecret);
+    }
+
     if (!rnp->keys_matching(keys, filter ? filter : "", flags)) {
         fprintf(fp, "Key(s) not found.\n");
         return false;
@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) 2026, [Ribose Inc](https://www.ribose.com).
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1.  Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ * 2.  Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/* Benchmark for the sha1cd unavoidable bitconditions check: compares the scalar ubc_check()
+ * baseline with ubc_check_simd(), and reports whole-block SHA1DC throughput with and
+ * without collision detection, so the share of the (still scalar) compression rounds is
+ * visible. Usage: bench_sha1cd [rounds]. Exits with non-zero code if masks differ. */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <random>
+#include <vector>
+#include "crypto/sha1cd/sha1.h"
+#include "crypto/sha1cd/ubc_check.h"
+
+#define BENCH_MSGS 1024
+
+static inline uint32_t
+rotl32(uint32_t x, unsigned n)
+{
+    return (x << n) | (x >> (32 - n));
+}
+
+static long long
+elapsed_us(std::chrono::steady_clock::time_point start)
+{
+    auto now = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::microseconds>(now - start).count();
+}
+
+static long long
+bench_hash(const std::vector<uint8_t> &data, size_t rounds, bool detect)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (size_t r = 0; r < rounds; r++) {
+        SHA1_CTX      ctx;
+        unsigned char digest[20];
+        SHA1DCInit(&ctx);
+        SHA1DCSetUseDetectColl(&ctx, detect);
+        SHA1DCUpdate(&ctx, (const char *) data.data(), data.size());
+        SHA1DCFinal(digest, &ctx);
+    }
+    return elapsed_us(start);
+}
+
+int
+main(int argc, char **argv)
+{
+    size_t rounds = argc > 1 ? strtoul(argv[1], NULL, 10) : 200;
+    if (!rounds) {
+        fprintf(stderr, "usage: %s [rounds]\n", argv[0]);
+        return 1;
+    }
+
+    /* expanded message blocks, as sha1_process() passes them to the check */
+    std::mt19937          rng(0x5a1);
+    std::vector<uint32_t> msgs(80 * BENCH_MSGS);
+    for (size_t i = 0; i < BENCH_MSGS; i++) {
+        uint32_t *W = &msgs[80 * i];
+        for (size_t j = 0; j < 16; j++) {
+            W[j] = rng();
+        }
+        for (size_t j = 16; j < 80; j++) {
+            W[j] = rotl32(W[j - 3] ^ W[j - 8] ^ W[j - 14] ^ W[j - 16], 1);
+        }
+    }
+
+    for (size_t i = 0; i < BENCH_MSGS; i++) {
+        uint32_t mask = 0, simd = 0;
+        ubc_check(&msgs[80 * i], &mask);
+        ubc_check_simd(&msgs[80 * i], &simd);
+        if (mask != simd) {
+            fprintf(stderr, "mask mismatch at block %zu: %x vs %x\n", i, mask, simd);
+            return 1;
+        }
+    }
+
+    uint32_t acc = 0;
+    auto     start = std::chrono::steady_clock::now();
+    for (size_t r = 0; r < rounds; r++) {
+        for (size_t i = 0; i < BENCH_MSGS; i++) {
+            uint32_t mask = 0;
+            ubc_check(&msgs[80 * i], &mask);
+            acc ^= mask;
+        }
+    }
+    long long scalar_us = elapsed_us(start);
+    start = std::chrono::steady_clock::now();
+    for (size_t r = 0; r < rounds; r++) {
+        for (size_t i = 0; i < BENCH_MSGS; i++) {
+            uint32_t mask = 0;
+            ubc_check_simd(&msgs[80 * i], &mask);
+            acc ^= mask;
+        }
+    }
+    long long simd_us = elapsed_us(start);
+    printf("ubc_check: %lld us, ubc_check_simd: %lld us (%x)\n", scalar_us, simd_us, acc);
+
+    std::vector<uint8_t> data(64 * BENCH_MSGS);
+    for (auto &byte : data) {
+        byte = (uint8_t) rng();
+    }
+    long long detect_us = bench_hash(data, rounds, true);
+    long long plain_us = bench_hash(data, rounds, false);
+    printf("sha1dc: %lld us, without collision detection: %lld us\n", detect_us, plain_us);
+    return 0;
+}
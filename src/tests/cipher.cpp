@@ -34,6 +34,7 @@
 #include "support.h"
 #include "fingerprint.h"
 #include "keygen.hpp"
+#include "crypto/sha1cd/ubc_check.h"
 
 TEST_F(rnp_tests, hash_test_success)
 {
@@ -85,7 +86,35 @@ TEST_F(rnp_tests, hash_test_success)
         hash->finish(hash_output);
 
         assert_true(bin_eq_hex(hash_output, hash_size, hash_alg_expected_outputs[i]));
+        /* backend implementation, i.e. SHA-1 without collision detection */
+        auto fast = rnp::Hash::create_fast(hash_algs[i]);
+        fast->add(test_input, sizeof(test_input));
+        fast->finish(hash_output);
+        assert_true(bin_eq_hex(hash_output, hash_size, hash_alg_expected_outputs[i]));
+    }
+}
+
+TEST_F(rnp_tests, sha1cd_ubc_check_simd)
+{
+    /* random expanded messages, and ones with small differences between the words, so
+     * unavoidable bitconditions are met for some of the disturbance vectors */
+    std::vector<uint32_t> msgs(80 * 2048);
+    global_ctx.rng.get((uint8_t *) msgs.data(), msgs.size() * sizeof(uint32_t));
+    for (size_t i = 1024; i < 2048; i++) {
+        uint32_t *W = &msgs[80 * i];
+        for (size_t j = 1; j < 80; j++) {
+            W[j] = W[0] ^ (W[j] & (W[j] >> 7) & (W[j] >> 13) & (W[j] >> 19));
+        }
     }
+    size_t nonzero = 0;
+    for (size_t i = 0; i < 2048; i++) {
+        uint32_t mask = 0, simd = 0;
+        ubc_check(&msgs[80 * i], &mask);
+        ubc_check_simd(&msgs[80 * i], &simd);
+        assert_int_equal(mask, simd);
+        nonzero += !!mask;
+    }
+    assert_true(nonzero > 0);
 }
 
 TEST_F(rnp_tests, cipher_test_success)
@@ -113,6 +142,54 @@ TEST_F(rnp_tests, cipher_test_success)
     assert_int_equal(0, pgp_cipher_cfb_finish(&crypt));
 }
 
+TEST_F(rnp_tests, cipher_test_pooled_contexts)
+{
+    /* backend contexts are reused within the thread, make sure no state leaks between uses */
+    const uint8_t test_input[3] = {'a', 'b', 'c'};
+    uint8_t       junk[100];
+    uint8_t       hash_output[PGP_MAX_HASH_SIZE];
+    memset(junk, 0x5A, sizeof(junk));
+
+    for (size_t i = 0; i < 10; i++) {
+        /* abandoned hash, which is not finished */
+        auto dropped = rnp::Hash::create_fast(PGP_HASH_SHA256);
+        dropped->add(junk, sizeof(junk));
+        dropped.reset();
+        /* hash which is finished without getting the output */
+        auto unused = rnp::Hash::create_fast(PGP_HASH_SHA256);
+        unused->add(junk, i);
+        assert_int_equal(unused->finish(), 32);
+
+        auto hash = rnp::Hash::create_fast(PGP_HASH_SHA256);
+        hash->add(test_input, sizeof(test_input));
+        assert_int_equal(hash->finish(hash_output), 32);
+        assert_true(bin_eq_hex(
+          hash_output,
+          32,
+          "BA7816BF8F01CFEA414140DE5DAE2223B00361A396177A9CB410FF61F20015AD"));
+    }
+
+    const uint8_t zero_key[16] = {0};
+    uint8_t       other_key[16];
+    uint8_t       iv[16];
+    memset(other_key, 0x11, sizeof(other_key));
+    memset(iv, 0x42, sizeof(iv));
+    for (size_t i = 0; i < 10; i++) {
+        pgp_crypt_t crypt;
+        assert_int_equal(1, pgp_cipher_cfb_start(&crypt, PGP_SA_AES_128, other_key, iv));
+        assert_int_equal(0, pgp_cipher_cfb_encrypt(&crypt, junk, junk, sizeof(junk)));
+        assert_int_equal(0, pgp_cipher_cfb_finish(&crypt));
+
+        uint8_t cfb_data[20] = {0};
+        assert_int_equal(1, pgp_cipher_cfb_start(&crypt, PGP_SA_AES_128, zero_key, iv));
+        assert_int_equal(
+          0, pgp_cipher_cfb_encrypt(&crypt, cfb_data, cfb_data, sizeof(cfb_data)));
+        assert_true(
+          bin_eq_hex(cfb_data, sizeof(cfb_data), "BFDAA57CB812189713A950AD9947887983021617"));
+        assert_int_equal(0, pgp_cipher_cfb_finish(&crypt));
+    }
+}
+
 TEST_F(rnp_tests, pkcs1_rsa_test_success)
 {
     uint8_t ptext[1024 / 8] = {'a', 'b', 'c', 0};
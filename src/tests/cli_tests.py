@@ -1,10 +1,14 @@
 #!/usr/bin/env python
 
+import json
 import logging
 import os
 import os.path
 import re
 import shutil
+import socket
+import struct
+import subprocess
 import sys
 import tempfile
 import time
@@ -3585,6 +3589,193 @@ class Misc(unittest.TestCase):
 
             clear_workfiles()
 
+    def test_batch_mode(self):
+        src1, sig1 = reg_workfiles('batch1', '.txt', '.txt.sig')
+        src2, sig2, enc2, dec2 = reg_workfiles('batch2', '.txt', '.txt.sig', '.txt.gpg', '.dec')
+        lst, res = reg_workfiles('batch', '.lst', '.json')
+        random_text(src1, 1000)
+        random_text(src2, 2000)
+        # Detached-sign both files, using command from the command line
+        with open(lst, 'w') as f:
+            f.write(src1 + '\n' + src2 + '\n')
+        ret, out, _ = run_proc(RNP, ['--homedir', RNPDIR, '--password', PASSWORD, '-u', KEY_SIGN_GPG,
+                                     '--sign', '--detach', '--batch', lst, '--threads', '2'])
+        self.assertEqual(ret, 0)
+        results = [json.loads(line) for line in out.splitlines()]
+        self.assertEqual(sorted(r['index'] for r in results), [0, 1])
+        self.assertTrue(all(r['status'] == 'success' for r in results))
+        self.assertTrue(os.path.isfile(sig1) and os.path.isfile(sig2))
+        # Signer is unlocked once, so password pipe with less lines than threads is enough
+        src3, sig3 = reg_workfiles('batch3', '.txt', '.txt.sig')
+        random_text(src3, 500)
+        os.remove(sig1)
+        os.remove(sig2)
+        with open(lst, 'w') as f:
+            f.write(src1 + '\n' + src2 + '\n' + src3 + '\n')
+        pipe = pswd_pipe(PASSWORD)
+        ret, out, _ = run_proc(RNP, ['--homedir', RNPDIR, '--pass-fd', str(pipe), '-u', KEY_SIGN_GPG,
+                                     '--sign', '--detach', '--batch', lst, '--threads', '3'])
+        os.close(pipe)
+        self.assertEqual(ret, 0)
+        results = [json.loads(line) for line in out.splitlines()]
+        self.assertEqual(sorted(r['index'] for r in results), [0, 1, 2])
+        self.assertTrue(all(r['status'] == 'success' for r in results))
+        self.assertTrue(all(os.path.isfile(sig) for sig in [sig1, sig2, sig3]))
+        # Verify and encrypt using operations from the batch file, one input is missing
+        with open(lst, 'w') as f:
+            f.write(json.dumps({'input': sig1, 'operation': 'verify'}) + '\n')
+            f.write(json.dumps({'input': sig2, 'operation': 'verify'}) + '\n')
+            f.write(json.dumps({'input': src2, 'output': enc2, 'operation': 'encrypt'}) + '\n')
+            f.write(json.dumps({'input': src1 + '.missing', 'operation': 'verify'}) + '\n')
+        ret, _, err = run_proc(RNP, ['--homedir', RNPDIR, '-r', KEY_ENCRYPT, '--batch', lst,
+                                     '--threads', '3', '--results', res])
+        self.assertEqual(ret, 1)
+        self.assertRegex(err, r'(?s)^.*Good signature made.*Good signature made.*')
+        results = {}
+        for line in file_text(res).splitlines():
+            item = json.loads(line)
+            results[item['index']] = item['status']
+        self.assertEqual(results, {0: 'success', 1: 'success', 2: 'success', 3: 'failure'})
+        rnp_decrypt_file(enc2, dec2)
+        compare_files(src2, dec2, RNP_DATA_DIFFERS)
+        # Wrong batch file contents
+        with open(lst, 'w') as f:
+            f.write(json.dumps({'input': src1, 'operation': 'unknown'}) + '\n')
+        ret, _, err = run_proc(RNP, ['--homedir', RNPDIR, '--batch', lst])
+        self.assertEqual(ret, 2)
+        self.assertRegex(err, r'(?s)^.*Unsupported batch operation: unknown.*')
+        ret, _, err = run_proc(RNP, ['--homedir', RNPDIR, '--verify', '--batch', lst, src1])
+        self.assertEqual(ret, 2)
+        self.assertRegex(err, r'(?s)^.*Input files cannot be specified together with --batch.*')
+
+    def test_service_mode(self):
+        if is_windows():
+            self.skipTest('Unix sockets are not available')
+        sock_path = os.path.join(WORKDIR, 'rnp.sock')
+
+        def frame(data):
+            return struct.pack('>I', len(data)) + data
+
+        def read_exact(conn, size):
+            data = b''
+            while len(data) < size:
+                chunk = conn.recv(size - len(data))
+                self.assertTrue(chunk)
+                data += chunk
+            return data
+
+        def request(conn, header, payload=b''):
+            msg = frame(json.dumps(header).encode())
+            if payload:
+                msg += frame(payload)
+            conn.sendall(msg + frame(b''))
+            output = b''
+            while True:
+                size = struct.unpack('>I', read_exact(conn, 4))[0]
+                if not size:
+                    break
+                output += read_exact(conn, size)
+            size = struct.unpack('>I', read_exact(conn, 4))[0]
+            return output, json.loads(read_exact(conn, size))
+
+        def bump_mtime(path, secs):
+            st = os.stat(path)
+            os.utime(path, (st.st_atime, st.st_mtime + secs))
+
+        # Service works on the copy of the keyring, since it is changed during the test
+        home = os.path.join(WORKDIR, 'service-home')
+        shutil.copytree(RNPDIR, home)
+        pubring = os.path.join(home, PUBRING)
+        proc = subprocess.Popen([RNP, '--homedir', home, '--password', PASSWORD, '-u', KEY_SIGN_GPG,
+                                 '--listen', sock_path], stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+        try:
+            for _ in range(100):
+                if os.path.exists(sock_path) or proc.poll() is not None:
+                    break
+                time.sleep(0.1)
+            conn = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+            conn.connect(sock_path)
+            # Sign and verify, reusing the same connection
+            data = b'Hello from the service client\n' * 100
+            signed, res = request(conn, {'operation': 'sign', 'armor': True}, data)
+            self.assertEqual(res['status'], 'success')
+            self.assertIn(b'-----BEGIN PGP MESSAGE-----', signed)
+            _, res = request(conn, {'operation': 'verify'}, signed)
+            self.assertEqual(res['status'], 'success')
+            self.assertEqual(len(res['signatures']), 1)
+            self.assertEqual(res['signatures'][0]['status'], 'Success')
+            # Encrypt and decrypt
+            enc, res = request(conn, {'operation': 'encrypt', 'recipients': [KEY_ENCRYPT]}, data)
+            self.assertEqual(res['status'], 'success')
+            dec, res = request(conn, {'operation': 'decrypt'}, enc)
+            self.assertEqual(res['status'], 'success')
+            self.assertEqual(dec, data)
+            # Large payload over the second connection, while the first one is kept open
+            conn2 = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+            conn2.connect(sock_path)
+            big = b'Large payload which should not deadlock the service\n' * 100000
+            enc, res = request(conn2, {'operation': 'encrypt', 'recipients': [KEY_ENCRYPT]}, big)
+            self.assertEqual(res['status'], 'success')
+            dec, res = request(conn2, {'operation': 'decrypt'}, enc)
+            self.assertEqual(res['status'], 'success')
+            self.assertEqual(dec, big)
+            conn2.close()
+            # Stalled client must not block the other ones
+            conn3 = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+            conn3.connect(sock_path)
+            conn3.sendall(struct.pack('>I', 100) + b'{')
+            start = time.time()
+            _, res = request(conn, {'operation': 'locate', 'key': KEY_SIGN_GPG})
+            self.assertEqual(res['status'], 'success')
+            self.assertLess(time.time() - start, 10)
+            # Payload above the limit closes the connection
+            conn4 = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+            conn4.connect(sock_path)
+            conn4.settimeout(20)
+            conn4.sendall(frame(json.dumps({'operation': 'verify'}).encode()) + struct.pack('>I', 0x7FFFFFFF))
+            self.assertEqual(conn4.recv(4), b'')
+            conn4.close()
+            conn3.close()
+            # Keys, added or removed on disk, are picked up
+            ret, _, _ = run_proc(RNPK, ['--homedir', home, '--import', data_path(KEY_ALICE_PUB)])
+            self.assertEqual(ret, 0)
+            bump_mtime(pubring, 10)
+            _, res = request(conn, {'operation': 'locate', 'key': 'alice@rnp'})
+            self.assertEqual(res['status'], 'success')
+            ret, _, _ = run_proc(RNPK, ['--homedir', home, '--remove-key', '0451409669FFDE3C', '--force'])
+            self.assertEqual(ret, 0)
+            bump_mtime(pubring, 20)
+            _, res = request(conn, {'operation': 'locate', 'key': 'alice@rnp'})
+            self.assertEqual(res['status'], 'failure')
+            # Signing key is still unlocked and usable
+            signed, res = request(conn, {'operation': 'sign'}, data)
+            self.assertEqual(res['status'], 'success')
+            # Locate keys and unknown operation
+            _, res = request(conn, {'operation': 'locate', 'key': KEY_SIGN_GPG})
+            self.assertEqual(res['status'], 'success')
+            self.assertTrue(len(res['keys']) >= 1)
+            _, res = request(conn, {'operation': 'locate', 'key': 'unknown@example.com'})
+            self.assertEqual(res['status'], 'failure')
+            _, res = request(conn, {'operation': 'unknown'}, data)
+            self.assertEqual(res['status'], 'failure')
+            _, res = request(conn, {'operation': 'shutdown'})
+            self.assertEqual(res['status'], 'success')
+            conn.close()
+            proc.wait(10)
+            self.assertEqual(proc.returncode, 0)
+            self.assertFalse(os.path.exists(sock_path))
+        finally:
+            if proc.poll() is None:
+                proc.kill()
+                proc.wait()
+            proc.stdout.close()
+            proc.stderr.close()
+            shutil.rmtree(home, ignore_errors=True)
+        # Conflicting options
+        ret, _, err = run_proc(RNP, ['--homedir', RNPDIR, '--listen', sock_path, '--batch', sock_path])
+        self.assertEqual(ret, 2)
+        self.assertRegex(err, r'(?s)^.*Option --listen cannot be used together with --batch.*')
+
     def test_onepass_edge_cases(self):
         key = data_path('test_key_validity/alice-pub.asc')
         onepass22 = data_path('test_messages/message.txt.signed-2-2-onepass-v10')
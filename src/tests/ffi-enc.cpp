@@ -998,6 +998,38 @@ TEST_F(rnp_tests, test_ffi_decrypt_pk_unlocked)
     assert_string_equal(file_to_str("decrypted").c_str(), plaintext);
     assert_int_equal(unlink("decrypted"), 0);
 
+    /* decrypt, keeping the decryption key unlocked */
+    assert_rnp_success(
+      rnp_ffi_set_pass_provider(ffi, ffi_string_password_provider, (void *) "password"));
+    assert_rnp_success(rnp_locate_key(ffi, "userid", "key0-uid2", &key));
+    assert_rnp_success(rnp_key_get_default_key(key, "encrypt", 0, &defkey));
+    bool locked = false;
+    assert_rnp_success(rnp_key_is_locked(defkey, &locked));
+    assert_true(locked);
+    rnp_op_verify_t verify = NULL;
+    assert_rnp_success(rnp_input_from_path(&input, "encrypted"));
+    assert_rnp_success(rnp_output_to_null(&output));
+    assert_rnp_success(rnp_op_verify_create(&verify, ffi, input, output));
+    assert_rnp_success(rnp_op_verify_set_flags(verify, RNP_VERIFY_KEEP_KEYS_UNLOCKED));
+    assert_rnp_success(rnp_op_verify_execute(verify));
+    rnp_op_verify_destroy(verify);
+    rnp_input_destroy(input);
+    rnp_output_destroy(output);
+    assert_rnp_success(rnp_key_is_locked(defkey, &locked));
+    assert_false(locked);
+    /* pass provider should not be called now */
+    assert_rnp_success(rnp_ffi_set_pass_provider(ffi, ffi_asserting_password_provider, NULL));
+    assert_rnp_success(rnp_input_from_path(&input, "encrypted"));
+    assert_rnp_success(rnp_output_to_path(&output, "decrypted"));
+    assert_rnp_success(rnp_decrypt(ffi, input, output));
+    rnp_input_destroy(input);
+    rnp_output_destroy(output);
+    assert_string_equal(file_to_str("decrypted").c_str(), plaintext);
+    assert_int_equal(unlink("decrypted"), 0);
+    assert_rnp_success(rnp_key_lock(defkey));
+    rnp_key_handle_destroy(key);
+    rnp_key_handle_destroy(defkey);
+
     // final cleanup
     rnp_ffi_destroy(ffi);
 }
@@ -1891,6 +1923,104 @@ TEST_F(rnp_tests, test_ffi_encrypt_no_wrap)
     rnp_ffi_destroy(ffi);
 }
 
+static void
+encrypt_adaptive(rnp_ffi_t                   ffi,
+                 const std::vector<uint8_t> &data,
+                 const char *                zalg,
+                 int                         zlevel,
+                 bool                        adaptive,
+                 const char *                exp_zalg,
+                 int                         exp_zlevel)
+{
+    rnp_input_t  input = NULL;
+    rnp_output_t output = NULL;
+    assert_rnp_success(rnp_input_from_memory(&input, data.data(), data.size(), false));
+    assert_rnp_success(rnp_output_to_memory(&output, 0));
+    rnp_op_encrypt_t op = NULL;
+    assert_rnp_success(rnp_op_encrypt_create(&op, ffi, input, output));
+    assert_rnp_success(rnp_op_encrypt_add_password(op, "password", NULL, 0, NULL));
+    assert_rnp_success(rnp_op_encrypt_set_compression(op, zalg, zlevel));
+    if (adaptive) {
+        assert_rnp_success(rnp_op_encrypt_set_flags(op, RNP_ENCRYPT_ADAPTIVE_COMPRESSION));
+    }
+    char *alg = NULL;
+    int   level = -1;
+    assert_int_equal(rnp_op_encrypt_get_compression(op, &alg, &level), RNP_ERROR_BAD_STATE);
+    assert_rnp_success(rnp_op_encrypt_execute(op));
+    assert_rnp_success(rnp_op_encrypt_get_compression(op, &alg, NULL));
+    assert_string_equal(alg, exp_zalg);
+    rnp_buffer_destroy(alg);
+    assert_rnp_success(rnp_op_encrypt_get_compression(op, NULL, &level));
+    assert_int_equal(level, exp_zlevel);
+    assert_rnp_success(rnp_op_encrypt_destroy(op));
+    assert_rnp_success(rnp_input_destroy(input));
+
+    /* make sure data is decrypted correctly */
+    uint8_t *buf = NULL;
+    size_t   len = 0;
+    assert_rnp_success(rnp_output_memory_get_buf(output, &buf, &len, false));
+    assert_rnp_success(rnp_input_from_memory(&input, buf, len, false));
+    rnp_output_t decrypted = NULL;
+    assert_rnp_success(rnp_output_to_memory(&decrypted, 0));
+    assert_rnp_success(rnp_decrypt(ffi, input, decrypted));
+    assert_rnp_success(rnp_output_memory_get_buf(decrypted, &buf, &len, false));
+    assert_int_equal(len, data.size());
+    assert_int_equal(memcmp(buf, data.data(), len), 0);
+    assert_rnp_success(rnp_input_destroy(input));
+    assert_rnp_success(rnp_output_destroy(decrypted));
+    assert_rnp_success(rnp_output_destroy(output));
+}
+
+TEST_F(rnp_tests, test_ffi_encrypt_adaptive_compression)
+{
+    rnp_ffi_t ffi = NULL;
+    assert_rnp_success(rnp_ffi_create(&ffi, "GPG", "GPG"));
+    assert_rnp_success(
+      rnp_ffi_set_pass_provider(ffi, ffi_string_password_provider, (void *) "password"));
+    assert_int_equal(rnp_op_encrypt_get_compression(NULL, NULL, NULL),
+                     RNP_ERROR_NULL_POINTER);
+
+    /* random bytes are not compressible at all, ones from the 180-symbol alphabet are
+     * compressible by ~5% only, and text compresses well */
+    std::vector<uint8_t> random(100000);
+    std::vector<uint8_t> limited(random.size());
+    std::vector<uint8_t> text;
+    uint32_t             seed = 12345;
+    for (size_t i = 0; i < random.size(); i++) {
+        seed = seed * 1103515245 + 12345;
+        random[i] = seed >> 16;
+        limited[i] = (seed >> 8) % 180;
+    }
+    while (text.size() < random.size()) {
+        auto line = "Line " + std::to_string(text.size()) + " of the compressible text.\n";
+        text.insert(text.end(), line.begin(), line.end());
+    }
+    std::vector<uint8_t> small = {'d', 'a', 't', 'a', '1'};
+
+    /* without the flag compression is applied as configured */
+    encrypt_adaptive(ffi, random, "ZLIB", 6, false, "ZLIB", 6);
+    encrypt_adaptive(ffi, small, "ZIP", 9, false, "ZIP", 9);
+    /* adaptive mode */
+    encrypt_adaptive(ffi, random, "ZLIB", 6, true, "Uncompressed", 0);
+    encrypt_adaptive(ffi, random, "ZIP", 9, true, "Uncompressed", 0);
+    encrypt_adaptive(ffi, small, "ZLIB", 6, true, "Uncompressed", 0);
+    encrypt_adaptive(ffi, limited, "ZLIB", 6, true, "ZLIB", 1);
+    encrypt_adaptive(ffi, limited, "ZIP", 9, true, "ZIP", 1);
+    encrypt_adaptive(ffi, text, "ZLIB", 6, true, "ZLIB", 6);
+    encrypt_adaptive(ffi, text, "ZIP", 9, true, "ZIP", 9);
+    /* compression level 0 disables compression at all */
+    encrypt_adaptive(ffi, text, "ZLIB", 0, true, "Uncompressed", 0);
+    bool bzip2 = false;
+    assert_rnp_success(rnp_supports_feature(RNP_FEATURE_COMP_ALG, "BZip2", &bzip2));
+    if (bzip2) {
+        encrypt_adaptive(ffi, random, "BZip2", 9, true, "Uncompressed", 0);
+        encrypt_adaptive(ffi, limited, "BZip2", 9, true, "BZip2", 9);
+        encrypt_adaptive(ffi, text, "BZip2", 9, true, "BZip2", 9);
+    }
+
+    rnp_ffi_destroy(ffi);
+}
+
 TEST_F(rnp_tests, test_ffi_v5_signatures)
 {
     rnp_ffi_t ffi = NULL;
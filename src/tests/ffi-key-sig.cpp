@@ -914,6 +914,78 @@ TEST_F(rnp_tests, test_ffi_sig_validity)
     assert_rnp_success(rnp_ffi_destroy(ffi));
 }
 
+static size_t
+uid_sig_count(rnp_ffi_t ffi, const char *userid)
+{
+    rnp_key_handle_t key = NULL;
+    rnp_uid_handle_t uid = NULL;
+    size_t           count = 0;
+    if (rnp_locate_key(ffi, "userid", userid, &key) || !key ||
+        rnp_key_get_uid_handle_at(key, 0, &uid) || rnp_uid_get_signature_count(uid, &count)) {
+        count = SIZE_MAX;
+    }
+    rnp_uid_handle_destroy(uid);
+    rnp_key_handle_destroy(key);
+    return count;
+}
+
+TEST_F(rnp_tests, test_ffi_certifications_limit)
+{
+    rnp_ffi_t ffi = NULL;
+    assert_rnp_success(rnp_ffi_create(&ffi, "GPG", "GPG"));
+    assert_rnp_failure(rnp_set_certifications_limit(NULL, 0));
+
+    /* Basil is signed by Alice: by default all certifications are stored */
+    assert_true(import_pub_keys(ffi, KEYSIG_PATH "case2/pubring.gpg"));
+    assert_int_equal(uid_sig_count(ffi, "Basil <basil@rnp>"), 2);
+    assert_rnp_success(rnp_unload_keys(ffi, RNP_KEY_UNLOAD_PUBLIC));
+
+    /* store only self-signatures */
+    assert_rnp_success(rnp_set_certifications_limit(ffi, 0));
+    assert_true(import_pub_keys(ffi, KEYSIG_PATH "case2/pubring.gpg"));
+    assert_int_equal(uid_sig_count(ffi, "Basil <basil@rnp>"), 1);
+    rnp_key_handle_t key = NULL;
+    assert_rnp_success(rnp_locate_key(ffi, "userid", "Basil <basil@rnp>", &key));
+    bool valid = false;
+    assert_rnp_success(rnp_key_is_valid(key, &valid));
+    assert_true(valid);
+    rnp_uid_handle_t uid = NULL;
+    assert_rnp_success(rnp_key_get_uid_handle_at(key, 0, &uid));
+    rnp_signature_handle_t sig = NULL;
+    assert_rnp_success(rnp_uid_get_signature_at(uid, 0, &sig));
+    char *sigtype = NULL;
+    assert_rnp_success(rnp_signature_get_type(sig, &sigtype));
+    assert_string_equal(sigtype, "certification (positive)");
+    rnp_buffer_destroy(sigtype);
+    assert_rnp_success(rnp_signature_is_valid(sig, 0));
+    rnp_signature_handle_destroy(sig);
+    rnp_uid_handle_destroy(uid);
+    rnp_key_handle_destroy(key);
+    /* Alice has only Basil's certification, so her userid has no signatures at all */
+    assert_rnp_success(rnp_unload_keys(ffi, RNP_KEY_UNLOAD_PUBLIC));
+    assert_true(import_pub_keys(ffi, KEYSIG_PATH "case3/pubring.gpg"));
+    assert_rnp_success(
+      rnp_locate_key(ffi, "fingerprint", "73EDCC9119AFC8E2DBBDCDE50451409669FFDE3C", &key));
+    assert_rnp_success(rnp_key_get_uid_handle_at(key, 0, &uid));
+    size_t count = 0;
+    assert_rnp_success(rnp_uid_get_signature_count(uid, &count));
+    assert_int_equal(count, 0);
+    rnp_uid_handle_destroy(uid);
+    rnp_key_handle_destroy(key);
+
+    /* limit is applied during the merge as well */
+    assert_rnp_success(rnp_set_certifications_limit(ffi, 1));
+    assert_true(import_pub_keys(ffi, KEYSIG_PATH "case2/pubring.gpg"));
+    assert_int_equal(uid_sig_count(ffi, "Basil <basil@rnp>"), 2);
+    /* and to the keys loaded from the keyring */
+    assert_rnp_success(rnp_unload_keys(ffi, RNP_KEY_UNLOAD_PUBLIC));
+    assert_rnp_success(rnp_set_certifications_limit(ffi, 0));
+    assert_true(load_keys_gpg(ffi, KEYSIG_PATH "case2/pubring.gpg"));
+    assert_int_equal(uid_sig_count(ffi, "Basil <basil@rnp>"), 1);
+
+    rnp_ffi_destroy(ffi);
+}
+
 TEST_F(rnp_tests, test_ffi_get_signature_type)
 {
     rnp_ffi_t ffi = NULL;
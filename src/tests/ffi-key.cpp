@@ -3405,6 +3405,98 @@ TEST_F(rnp_tests, test_ffi_iterated_key_import)
     rnp_ffi_destroy(ffi);
 }
 
+static void
+import_key_callback(rnp_ffi_t   ffi,
+                    void *      app_ctx,
+                    const char *fingerprint,
+                    const char *pub_status,
+                    const char *sec_status)
+{
+    auto statuses = (std::vector<std::string> *) app_ctx;
+    statuses->push_back(std::string(fingerprint) + ":" + pub_status + ":" + sec_status);
+}
+
+TEST_F(rnp_tests, test_ffi_streamed_key_import)
+{
+    rnp_ffi_t   ffi = NULL;
+    rnp_input_t input = NULL;
+    uint32_t    flags = RNP_LOAD_SAVE_PUBLIC_KEYS | RNP_LOAD_SAVE_SECRET_KEYS;
+
+    assert_rnp_success(rnp_ffi_create(&ffi, "GPG", "GPG"));
+    assert_rnp_success(rnp_input_from_path(&input, "data/keyrings/1/pubring.gpg"));
+    /* invalid parameters */
+    assert_rnp_failure(rnp_import_keys_stream(NULL, input, flags, NULL, NULL));
+    assert_rnp_failure(rnp_import_keys_stream(ffi, NULL, flags, NULL, NULL));
+    assert_rnp_failure(rnp_import_keys_stream(ffi, input, 0, NULL, NULL));
+    assert_rnp_failure(
+      rnp_import_keys_stream(ffi, input, flags | RNP_LOAD_SAVE_SINGLE, NULL, NULL));
+    /* binary keyring */
+    std::vector<std::string> statuses;
+    assert_rnp_success(
+      rnp_import_keys_stream(ffi, input, flags, import_key_callback, &statuses));
+    rnp_input_destroy(input);
+    assert_int_equal(statuses.size(), 7);
+    assert_string_equal(statuses[0].c_str(),
+                        "e95a3cbf583aa80a2ccc53aa7bc6709b15c23a4a:new:none");
+    assert_string_equal(statuses[3].c_str(),
+                        "5cd46d2a0bd0b8cfe0b130ae8a05b89fad5aded1:new:none");
+    assert_string_equal(statuses[4].c_str(),
+                        "be1c4ab951f4c2f6b604c7f82fcadf05ffa501bb:new:none");
+    assert_string_equal(statuses[6].c_str(),
+                        "57f8ed6e5c197db63c60ffaf326ef111425d14a5:new:none");
+    size_t count = 0;
+    assert_rnp_success(rnp_get_public_key_count(ffi, &count));
+    assert_int_equal(count, 7);
+
+    /* armored keyring, keys are already imported */
+    statuses.clear();
+    assert_rnp_success(rnp_input_from_path(&input, "data/keyrings/1/pubring.gpg.asc"));
+    assert_rnp_success(
+      rnp_import_keys_stream(ffi, input, flags, import_key_callback, &statuses));
+    rnp_input_destroy(input);
+    assert_int_equal(statuses.size(), 7);
+    assert_string_equal(statuses[0].c_str(),
+                        "e95a3cbf583aa80a2ccc53aa7bc6709b15c23a4a:unchanged:none");
+
+    /* public + secret key, armored separately, without callback */
+    assert_rnp_success(rnp_input_from_path(&input, "data/test_stream_key_merge/key-both.asc"));
+    assert_rnp_success(rnp_import_keys_stream(ffi, input, flags, NULL, NULL));
+    rnp_input_destroy(input);
+    assert_rnp_success(rnp_get_public_key_count(ffi, &count));
+    assert_int_equal(count, 10);
+    assert_rnp_success(rnp_get_secret_key_count(ffi, &count));
+    assert_int_equal(count, 3);
+
+    /* secret keys only */
+    statuses.clear();
+    assert_rnp_success(rnp_unload_keys(ffi, RNP_KEY_UNLOAD_PUBLIC | RNP_KEY_UNLOAD_SECRET));
+    assert_rnp_success(rnp_input_from_path(&input, "data/test_stream_key_merge/key-both.asc"));
+    assert_rnp_success(rnp_import_keys_stream(
+      ffi, input, RNP_LOAD_SAVE_SECRET_KEYS, import_key_callback, &statuses));
+    rnp_input_destroy(input);
+    assert_int_equal(statuses.size(), 3);
+    assert_string_equal(statuses[0].c_str(),
+                        "090bd712a1166be572252c3c9747d2a6b3a63124:new:new");
+
+    /* malformed certification */
+    assert_rnp_success(rnp_unload_keys(ffi, RNP_KEY_UNLOAD_PUBLIC | RNP_KEY_UNLOAD_SECRET));
+    assert_rnp_success(
+      rnp_input_from_path(&input, "data/test_key_edge_cases/pubring-malf-cert.pgp"));
+    assert_rnp_failure(rnp_import_keys_stream(ffi, input, flags, NULL, NULL));
+    rnp_input_destroy(input);
+    assert_rnp_success(rnp_get_public_key_count(ffi, &count));
+    assert_int_equal(count, 0);
+    assert_rnp_success(
+      rnp_input_from_path(&input, "data/test_key_edge_cases/pubring-malf-cert.pgp"));
+    assert_rnp_success(
+      rnp_import_keys_stream(ffi, input, flags | RNP_LOAD_SAVE_PERMISSIVE, NULL, NULL));
+    rnp_input_destroy(input);
+    assert_rnp_success(rnp_get_public_key_count(ffi, &count));
+    assert_int_equal(count, 7);
+
+    rnp_ffi_destroy(ffi);
+}
+
 TEST_F(rnp_tests, test_ffi_stripped_keys_import)
 {
     rnp_ffi_t   ffi = NULL;
@@ -4962,3 +5054,374 @@ TEST_F(rnp_tests, test_armored_keys_extra_line)
 
     rnp_ffi_destroy(ffi);
 }
+
+static uint64_t
+memory_usage_value(json_object *jso, const char *ring, const char *field)
+{
+    json_object *jsoring = NULL;
+    json_object *jsoval = NULL;
+    if (ring && !json_object_object_get_ex(jso, ring, &jsoring)) {
+        return UINT64_MAX;
+    }
+    if (!json_object_object_get_ex(ring ? jsoring : jso, field, &jsoval)) {
+        return UINT64_MAX;
+    }
+    return json_object_get_uint64(jsoval);
+}
+
+TEST_F(rnp_tests, test_ffi_memory_usage)
+{
+    rnp_ffi_t ffi = NULL;
+    assert_rnp_success(rnp_ffi_create(&ffi, "GPG", "GPG"));
+    char *usage = NULL;
+    assert_rnp_failure(rnp_get_memory_usage(NULL, &usage));
+    assert_rnp_failure(rnp_get_memory_usage(ffi, NULL));
+    /* empty keyrings */
+    assert_rnp_success(rnp_get_memory_usage(ffi, &usage));
+    json_object *jso = json_tokener_parse(usage);
+    rnp_buffer_destroy(usage);
+    assert_non_null(jso);
+    assert_int_equal(memory_usage_value(jso, "public", "keys"), 0);
+    assert_int_equal(memory_usage_value(jso, "secret", "keys"), 0);
+    assert_int_equal(memory_usage_value(jso, "public", "key bytes"), 0);
+    json_object_put(jso);
+    rnp_ffi_destroy(ffi);
+
+    /* loaded keyrings */
+    test_ffi_init(&ffi);
+    assert_rnp_success(rnp_get_memory_usage(ffi, &usage));
+    jso = json_tokener_parse(usage);
+    rnp_buffer_destroy(usage);
+    assert_non_null(jso);
+    for (auto ring : {"public", "secret"}) {
+        assert_int_equal(memory_usage_value(jso, ring, "keys"), 7);
+        assert_int_equal(memory_usage_value(jso, ring, "userids"), 6);
+        assert_true(memory_usage_value(jso, ring, "signatures") >= 12);
+        uint64_t keys = memory_usage_value(jso, ring, "key bytes");
+        uint64_t sigs = memory_usage_value(jso, ring, "signature bytes");
+        uint64_t uids = memory_usage_value(jso, ring, "userid bytes");
+        assert_true(keys >= 7 * sizeof(pgp_key_t));
+        assert_true(sigs >= 12 * sizeof(pgp_subsig_t));
+        assert_true(uids >= 6 * sizeof(pgp_userid_t));
+        assert_true(memory_usage_value(jso, ring, "total bytes") > keys + sigs + uids);
+    }
+    uint64_t pubtotal = memory_usage_value(jso, "public", "total bytes");
+    uint64_t sectotal = memory_usage_value(jso, "secret", "total bytes");
+    assert_int_equal(memory_usage_value(jso, NULL, "total bytes"), pubtotal + sectotal);
+    json_object_put(jso);
+
+    /* unload secret keys */
+    assert_rnp_success(rnp_unload_keys(ffi, RNP_KEY_UNLOAD_SECRET));
+    assert_rnp_success(rnp_get_memory_usage(ffi, &usage));
+    jso = json_tokener_parse(usage);
+    rnp_buffer_destroy(usage);
+    assert_non_null(jso);
+    assert_int_equal(memory_usage_value(jso, "secret", "keys"), 0);
+    assert_int_equal(memory_usage_value(jso, "public", "total bytes"), pubtotal);
+    assert_true(memory_usage_value(jso, NULL, "total bytes") < pubtotal + sectotal);
+    json_object_put(jso);
+    rnp_ffi_destroy(ffi);
+
+    /* subpackets account for their own fields */
+    pgp::pkt::sigsub::IssuerFingerprint issuer;
+    assert_true(issuer.memory_usage() >= sizeof(issuer));
+    pgp::pkt::sigsub::NotationData notation;
+    size_t                         notation_size = notation.memory_usage();
+    notation.set_name(std::string(100, 'n'));
+    notation.set_value(std::vector<uint8_t>(200, 'v'));
+    assert_true(notation.memory_usage() >= notation_size + 300);
+}
+
+static void
+locate_keys_ids(rnp_ffi_t                 ffi,
+                const char *              query,
+                uint32_t                  flags,
+                std::vector<std::string> &res)
+{
+    rnp_key_iterator_t it = NULL;
+    assert_rnp_success(rnp_locate_keys(ffi, query, flags, &it));
+    size_t count = 0;
+    assert_rnp_success(rnp_key_iterator_get_count(it, &count));
+    res.clear();
+    rnp_key_handle_t key = NULL;
+    while (!rnp_key_iterator_next(it, &key) && key) {
+        char *keyid = NULL;
+        assert_rnp_success(rnp_key_get_keyid(key, &keyid));
+        res.push_back(keyid);
+        rnp_buffer_destroy(keyid);
+        rnp_key_handle_destroy(key);
+    }
+    assert_int_equal(res.size(), count);
+    rnp_key_iterator_destroy(it);
+}
+
+static std::vector<std::string>
+locate_keys_ids(rnp_ffi_t ffi, const char *query, uint32_t flags)
+{
+    std::vector<std::string> res;
+    locate_keys_ids(ffi, query, flags, res);
+    return res;
+}
+
+TEST_F(rnp_tests, test_ffi_locate_keys)
+{
+    rnp_ffi_t ffi = NULL;
+    test_ffi_init(&ffi);
+
+    rnp_key_iterator_t it = NULL;
+    assert_rnp_failure(rnp_locate_keys(NULL, "key0", 0, &it));
+    assert_rnp_failure(rnp_locate_keys(ffi, NULL, 0, &it));
+    assert_rnp_failure(rnp_locate_keys(ffi, "key0", 0, NULL));
+    assert_rnp_failure(rnp_locate_keys(ffi, "key0", 1U << 20, &it));
+    assert_rnp_failure(rnp_locate_keys(ffi, "key0-uid(", 0, &it));
+    assert_null(it);
+    size_t count = 0;
+    assert_rnp_failure(rnp_key_iterator_get_count(NULL, &count));
+    rnp_key_handle_t key = NULL;
+    assert_rnp_failure(rnp_key_iterator_next(NULL, &key));
+    assert_rnp_success(rnp_key_iterator_destroy(NULL));
+
+    /* empty query matches everything */
+    auto ids = locate_keys_ids(ffi, "", 0);
+    assert_true(ids == std::vector<std::string>({"7BC6709B15C23A4A", "2FCADF05FFA501BB"}));
+    assert_int_equal(locate_keys_ids(ffi, "", RNP_LOCATE_SUBKEYS).size(), 7);
+    ids = locate_keys_ids(ffi, "", RNP_LOCATE_FIRST_ONLY);
+    assert_true(ids == std::vector<std::string>({"7BC6709B15C23A4A"}));
+    /* userid regex, case-insensitive */
+    ids = locate_keys_ids(ffi, "KEY1-uid[0-9]", 0);
+    assert_true(ids == std::vector<std::string>({"2FCADF05FFA501BB"}));
+    assert_true(locate_keys_ids(ffi, "key2", RNP_LOCATE_SUBKEYS).empty());
+    /* subkeys after the primary key */
+    ids = locate_keys_ids(ffi, "key0-uid", RNP_LOCATE_SUBKEYS_AFTER);
+    assert_true(ids == std::vector<std::string>({"7BC6709B15C23A4A",
+                                                 "1ED63EE56FADC34D",
+                                                 "1D7E8A5393C997A8",
+                                                 "8A05B89FAD5ADED1"}));
+    ids = locate_keys_ids(ffi, "", RNP_LOCATE_SUBKEYS_AFTER | RNP_LOCATE_FIRST_ONLY);
+    assert_int_equal(ids.size(), 4);
+    /* key id, its lower 32 bits, fingerprint and grip */
+    ids = locate_keys_ids(ffi, "0x2fcadf05ffa501bb", 0);
+    assert_true(ids == std::vector<std::string>({"2FCADF05FFA501BB"}));
+    ids = locate_keys_ids(ffi, "ffa5 01bb", 0);
+    assert_true(ids == std::vector<std::string>({"2FCADF05FFA501BB"}));
+    assert_true(locate_keys_ids(ffi, "6a4a970e", 0).empty());
+    ids = locate_keys_ids(ffi, "6a4a970e", RNP_LOCATE_SUBKEYS);
+    assert_true(ids == std::vector<std::string>({"54505A936A4A970E"}));
+    assert_true(locate_keys_ids(ffi, "6a4a970e", RNP_LOCATE_SUBKEYS_AFTER).empty());
+    ids = locate_keys_ids(ffi, "E95A3CBF583AA80A2CCC53AA7BC6709B15C23A4A", 0);
+    assert_true(ids == std::vector<std::string>({"7BC6709B15C23A4A"}));
+    ids = locate_keys_ids(ffi, "66D6A0800A3FACDE0C0EB60B16B3669ED380FDFA", 0);
+    assert_true(ids == std::vector<std::string>({"7BC6709B15C23A4A"}));
+    /* usage flags */
+    std::vector<std::pair<uint32_t, const char *>> usages = {
+      {RNP_LOCATE_USAGE_SIGN, "sign"}, {RNP_LOCATE_USAGE_ENCRYPT, "encrypt"}};
+    for (auto &usage : usages) {
+        uint32_t flags = RNP_LOCATE_SUBKEYS | usage.first;
+        assert_rnp_success(rnp_locate_keys(ffi, "", flags, &it));
+        assert_rnp_success(rnp_key_iterator_get_count(it, &count));
+        assert_true(count > 0);
+        while (!rnp_key_iterator_next(it, &key) && key) {
+            bool allows = false;
+            assert_rnp_success(rnp_key_allows_usage(key, usage.second, &allows));
+            assert_true(allows);
+            rnp_key_handle_destroy(key);
+        }
+        assert_rnp_success(rnp_key_iterator_destroy(it));
+    }
+    /* subkeys after the primary key must pass the filters as well */
+    for (auto &usage : usages) {
+        uint32_t flags = RNP_LOCATE_SUBKEYS_AFTER | RNP_LOCATE_SECRET | usage.first;
+        assert_rnp_success(rnp_locate_keys(ffi, "key0-uid", flags, &it));
+        assert_rnp_success(rnp_key_iterator_get_count(it, &count));
+        assert_true(count > 0);
+        while (!rnp_key_iterator_next(it, &key) && key) {
+            bool allows = false;
+            assert_rnp_success(rnp_key_allows_usage(key, usage.second, &allows));
+            assert_true(allows);
+            bool secret = false;
+            assert_rnp_success(rnp_key_have_secret(key, &secret));
+            assert_true(secret);
+            rnp_key_handle_destroy(key);
+        }
+        assert_rnp_success(rnp_key_iterator_destroy(it));
+    }
+    /* secret keys */
+    assert_int_equal(locate_keys_ids(ffi, "", RNP_LOCATE_SECRET).size(), 2);
+    assert_rnp_success(rnp_unload_keys(ffi, RNP_KEY_UNLOAD_SECRET));
+    assert_true(locate_keys_ids(ffi, "", RNP_LOCATE_SECRET).empty());
+    assert_int_equal(locate_keys_ids(ffi, "", RNP_LOCATE_SUBKEYS).size(), 7);
+    rnp_ffi_destroy(ffi);
+}
+
+TEST_F(rnp_tests, test_ffi_list_keys)
+{
+    rnp_ffi_t ffi = NULL;
+    test_ffi_init(&ffi);
+
+    rnp_output_t output = NULL;
+    assert_rnp_success(rnp_output_to_memory(&output, 0));
+    assert_rnp_failure(rnp_list_keys(NULL, NULL, 0, RNP_LIST_ALL, output));
+    assert_rnp_failure(rnp_list_keys(ffi, NULL, 0, RNP_LIST_ALL, NULL));
+    assert_rnp_failure(rnp_list_keys(ffi, NULL, 0, 0, output));
+    assert_rnp_failure(rnp_list_keys(ffi, NULL, 0, RNP_LIST_ALL + 1, output));
+    assert_rnp_failure(rnp_list_keys(ffi, NULL, 1U << 20, RNP_LIST_ALL, output));
+    assert_rnp_failure(rnp_list_keys(ffi, "key0-uid(", 0, RNP_LIST_ALL, output));
+    /* all the keys, with subkeys after the primary */
+    assert_rnp_success(
+      rnp_list_keys(ffi, NULL, RNP_LOCATE_SUBKEYS_AFTER, RNP_LIST_ALL, output));
+    uint8_t *buf = NULL;
+    size_t   len = 0;
+    assert_rnp_success(rnp_output_memory_get_buf(output, &buf, &len, false));
+    std::vector<std::string> lines;
+    std::string              listing((char *) buf, len);
+    for (size_t pos = 0, end = 0; pos < listing.size(); pos = end + 1) {
+        end = listing.find('\n', pos);
+        assert_true(end != std::string::npos);
+        lines.push_back(listing.substr(pos, end - pos));
+    }
+    assert_int_equal(lines.size(), 7);
+    json_object *jso = json_tokener_parse(lines[0].c_str());
+    assert_non_null(jso);
+    assert_true(check_json_field_str(jso, "keyid", "7BC6709B15C23A4A"));
+    assert_true(
+      check_json_field_str(jso, "fingerprint", "E95A3CBF583AA80A2CCC53AA7BC6709B15C23A4A"));
+    assert_true(check_json_field_str(jso, "grip", "66D6A0800A3FACDE0C0EB60B16B3669ED380FDFA"));
+    assert_true(check_json_field_str(jso, "type", "RSA"));
+    assert_true(check_json_field_int(jso, "length", 1024));
+    assert_false(json_object_object_get_ex(jso, "curve", NULL));
+    for (auto field :
+         {"valid", "expired", "revoked", "creation time", "expiration", "usage"}) {
+        assert_true(json_object_object_get_ex(jso, field, NULL));
+    }
+    assert_true(check_json_field_bool(jso, "public", true));
+    assert_true(check_json_field_bool(jso, "secret", true));
+    assert_true(check_json_field_bool(jso, "primary", true));
+    json_object *uids = NULL;
+    assert_true(json_object_object_get_ex(jso, "userids", &uids));
+    assert_int_equal(json_object_array_length(uids), 3);
+    assert_string_equal(json_object_get_string(json_object_array_get_idx(uids, 0)),
+                        "key0-uid0");
+    assert_true(json_object_object_get_ex(jso, "userids validity", &uids));
+    assert_int_equal(json_object_array_length(uids), 3);
+    assert_true(check_json_field_bool(json_object_array_get_idx(uids, 0), "valid", true));
+    assert_true(check_json_field_bool(json_object_array_get_idx(uids, 0), "revoked", false));
+    json_object_put(jso);
+    jso = json_tokener_parse(lines[1].c_str());
+    assert_non_null(jso);
+    assert_true(check_json_field_str(jso, "keyid", "1ED63EE56FADC34D"));
+    assert_true(check_json_field_bool(jso, "primary", false));
+    assert_true(check_json_field_str(
+      jso, "primary fingerprint", "E95A3CBF583AA80A2CCC53AA7BC6709B15C23A4A"));
+    assert_false(json_object_object_get_ex(jso, "userids", NULL));
+    assert_false(json_object_object_get_ex(jso, "userids validity", NULL));
+    json_object_put(jso);
+    rnp_output_destroy(output);
+
+    /* selected fields only */
+    assert_rnp_success(rnp_output_to_memory(&output, 0));
+    assert_rnp_success(rnp_list_keys(ffi, "key1", 0, RNP_LIST_KEYID, output));
+    assert_rnp_success(rnp_output_memory_get_buf(output, &buf, &len, false));
+    assert_string_equal(std::string((char *) buf, len).c_str(),
+                        "{\"keyid\":\"2FCADF05FFA501BB\"}\n");
+    rnp_output_destroy(output);
+    /* nothing found */
+    assert_rnp_success(rnp_output_to_memory(&output, 0));
+    assert_rnp_success(rnp_list_keys(ffi, "key2", 0, RNP_LIST_ALL, output));
+    assert_rnp_success(rnp_output_memory_get_buf(output, &buf, &len, false));
+    assert_int_equal(len, 0);
+    rnp_output_destroy(output);
+    rnp_ffi_destroy(ffi);
+}
+
+TEST_F(rnp_tests, test_ffi_copy_keys)
+{
+    rnp_ffi_t src = NULL;
+    rnp_ffi_t dst = NULL;
+    assert_rnp_success(rnp_ffi_create(&src, "GPG", "GPG"));
+    assert_rnp_success(rnp_ffi_create(&dst, "GPG", "GPG"));
+    assert_true(
+      load_keys_gpg(src, "data/keyrings/1/pubring.gpg", "data/keyrings/1/secring.gpg"));
+    /* wrong parameters */
+    assert_rnp_failure(rnp_copy_keys(NULL, src, RNP_LOAD_SAVE_PUBLIC_KEYS));
+    assert_rnp_failure(rnp_copy_keys(dst, NULL, RNP_LOAD_SAVE_PUBLIC_KEYS));
+    assert_rnp_failure(rnp_copy_keys(dst, dst, RNP_LOAD_SAVE_PUBLIC_KEYS));
+    assert_rnp_failure(rnp_copy_keys(dst, src, 0));
+    assert_rnp_failure(rnp_copy_keys(dst, src, RNP_LOAD_SAVE_PUBLIC_KEYS | (1U << 31)));
+
+    rnp_key_handle_t key = NULL;
+    assert_rnp_success(rnp_locate_key(src, "keyid", "7bc6709b15c23a4a", &key));
+    assert_rnp_success(rnp_key_unlock(key, "password"));
+    rnp_key_handle_destroy(key);
+
+    /* public keys only */
+    assert_rnp_success(rnp_copy_keys(dst, src, RNP_LOAD_SAVE_PUBLIC_KEYS));
+    size_t count = 0;
+    assert_rnp_success(rnp_get_public_key_count(dst, &count));
+    assert_int_equal(count, 7);
+    assert_rnp_success(rnp_get_secret_key_count(dst, &count));
+    assert_int_equal(count, 0);
+
+    /* secret keys keep the unlocked state, and password is not requested */
+    assert_rnp_success(rnp_ffi_set_pass_provider(dst, ffi_failing_password_provider, NULL));
+    assert_rnp_success(rnp_copy_keys(dst, src, RNP_LOAD_SAVE_SECRET_KEYS));
+    assert_rnp_success(rnp_get_secret_key_count(dst, &count));
+    assert_int_equal(count, 7);
+    bool locked = false;
+    assert_rnp_success(rnp_locate_key(dst, "keyid", "7bc6709b15c23a4a", &key));
+    assert_rnp_success(rnp_key_is_locked(key, &locked));
+    assert_false(locked);
+    rnp_key_handle_destroy(key);
+    assert_rnp_success(rnp_locate_key(dst, "keyid", "1ed63ee56fadc34d", &key));
+    assert_rnp_success(rnp_key_is_locked(key, &locked));
+    assert_true(locked);
+    rnp_key_handle_destroy(key);
+
+    rnp_input_t  input = NULL;
+    rnp_output_t output = NULL;
+    rnp_op_sign_t op = NULL;
+    const char * data = "data to sign";
+    assert_rnp_success(rnp_input_from_memory(&input, (uint8_t *) data, strlen(data), false));
+    assert_rnp_success(rnp_output_to_null(&output));
+    assert_rnp_success(rnp_op_sign_create(&op, dst, input, output));
+    assert_rnp_success(rnp_locate_key(dst, "keyid", "7bc6709b15c23a4a", &key));
+    assert_rnp_success(rnp_op_sign_add_signature(op, key, NULL));
+    rnp_key_handle_destroy(key);
+    assert_rnp_success(rnp_op_sign_execute(op));
+    rnp_op_sign_destroy(op);
+    rnp_input_destroy(input);
+    rnp_output_destroy(output);
+
+    /* copy is independent from the source */
+    assert_rnp_success(rnp_unload_keys(src, RNP_KEY_UNLOAD_PUBLIC | RNP_KEY_UNLOAD_SECRET));
+    assert_rnp_success(rnp_get_public_key_count(dst, &count));
+    assert_int_equal(count, 7);
+    rnp_ffi_destroy(src);
+    rnp_ffi_destroy(dst);
+}
+
+TEST_F(rnp_tests, test_ffi_uid_index)
+{
+    rnp_ffi_t ffi = NULL;
+    assert_rnp_success(rnp_ffi_create(&ffi, "GPG", "GPG"));
+    assert_rnp_failure(rnp_set_uid_index(NULL, true));
+    /* index enabled before and after the keys are loaded */
+    assert_rnp_success(rnp_set_uid_index(ffi, true));
+    assert_true(load_keys_gpg(ffi, "data/keyrings/1/pubring.gpg"));
+    auto located = [ffi](const char *uid, const char *keyid) {
+        rnp_key_handle_t key = NULL;
+        assert_rnp_success(rnp_locate_key(ffi, "userid", uid, &key));
+        assert_non_null(key);
+        assert_true(cmp_keyid(key->pub->keyid(), keyid));
+        rnp_key_handle_destroy(key);
+    };
+    located("key1-uid2", "2FCADF05FFA501BB");
+    assert_rnp_success(rnp_set_uid_index(ffi, false));
+    located("key1-uid2", "2FCADF05FFA501BB");
+    assert_rnp_success(rnp_set_uid_index(ffi, true));
+    located("key1-uid2", "2FCADF05FFA501BB");
+    located("key0-uid0", "7BC6709B15C23A4A");
+    rnp_key_handle_t key = NULL;
+    assert_rnp_success(rnp_locate_key(ffi, "userid", "key3-uid0", &key));
+    assert_null(key);
+    rnp_ffi_destroy(ffi);
+}
@@ -30,6 +30,11 @@
 #include <set>
 #include <utility>
 #include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
 #include <rnp/rnp.h>
 #include "rnp_tests.h"
@@ -1102,6 +1107,714 @@ TEST_F(rnp_tests, test_ffi_signatures_detached)
     assert_rnp_success(rnp_ffi_destroy(ffi));
 }
 
+TEST_F(rnp_tests, test_ffi_signatures_multiple_signers)
+{
+    rnp_ffi_t ffi = NULL;
+    test_ffi_init(&ffi);
+    assert_rnp_success(
+      rnp_ffi_set_pass_provider(ffi, ffi_string_password_provider, (void *) "password"));
+    const char *signers[] = {"key0-uid0", "key1-uid0", "key0-uid1", "key1-uid1"};
+    const char *keyids[] = {
+      "7BC6709B15C23A4A", "2FCADF05FFA501BB", "7BC6709B15C23A4A", "2FCADF05FFA501BB"};
+    const std::string msg = "Message, signed by multiple signers.";
+    // signatures are calculated in parallel, but must be written in the signers order
+    for (int mode = 0; mode < 3; mode++) {
+        rnp_input_t   input = NULL;
+        rnp_output_t  output = NULL;
+        rnp_op_sign_t op = NULL;
+        assert_rnp_success(
+          rnp_input_from_memory(&input, (const uint8_t *) msg.data(), msg.size(), false));
+        assert_rnp_success(rnp_output_to_memory(&output, 0));
+        if (mode == 0) {
+            assert_rnp_success(rnp_op_sign_create(&op, ffi, input, output));
+        } else if (mode == 1) {
+            assert_rnp_success(rnp_op_sign_detached_create(&op, ffi, input, output));
+        } else {
+            assert_rnp_success(rnp_op_sign_cleartext_create(&op, ffi, input, output));
+        }
+        for (auto signer : signers) {
+            rnp_key_handle_t key = NULL;
+            assert_rnp_success(rnp_locate_key(ffi, "userid", signer, &key));
+            assert_rnp_success(rnp_op_sign_add_signature(op, key, NULL));
+            rnp_key_handle_destroy(key);
+        }
+        assert_rnp_success(rnp_op_sign_execute(op));
+        rnp_op_sign_destroy(op);
+        rnp_input_destroy(input);
+        uint8_t *buf = NULL;
+        size_t   len = 0;
+        assert_rnp_success(rnp_output_memory_get_buf(output, &buf, &len, false));
+
+        rnp_input_t     sigin = NULL;
+        rnp_output_t    verout = NULL;
+        rnp_op_verify_t verify = NULL;
+        assert_rnp_success(rnp_input_from_memory(&sigin, buf, len, false));
+        if (mode == 1) {
+            assert_rnp_success(rnp_input_from_memory(
+              &input, (const uint8_t *) msg.data(), msg.size(), false));
+            assert_rnp_success(rnp_op_verify_detached_create(&verify, ffi, input, sigin));
+        } else {
+            input = NULL;
+            assert_rnp_success(rnp_output_to_null(&verout));
+            assert_rnp_success(rnp_op_verify_create(&verify, ffi, sigin, verout));
+        }
+        assert_rnp_success(rnp_op_verify_execute(verify));
+        size_t count = 0;
+        assert_rnp_success(rnp_op_verify_get_signature_count(verify, &count));
+        assert_int_equal(count, 4);
+        for (size_t idx = 0; idx < count; idx++) {
+            rnp_op_verify_signature_t sig = NULL;
+            rnp_key_handle_t          key = NULL;
+            char *                    keyid = NULL;
+            assert_rnp_success(rnp_op_verify_get_signature_at(verify, idx, &sig));
+            assert_rnp_success(rnp_op_verify_signature_get_status(sig));
+            assert_rnp_success(rnp_op_verify_signature_get_key(sig, &key));
+            assert_rnp_success(rnp_key_get_keyid(key, &keyid));
+            assert_string_equal(keyid, keyids[idx]);
+            rnp_buffer_destroy(keyid);
+            rnp_key_handle_destroy(key);
+        }
+        rnp_op_verify_destroy(verify);
+        rnp_input_destroy(sigin);
+        rnp_input_destroy(input);
+        rnp_output_destroy(verout);
+        rnp_output_destroy(output);
+    }
+    rnp_ffi_destroy(ffi);
+}
+
+TEST_F(rnp_tests, test_ffi_sign_cleartext_lines)
+{
+    rnp_ffi_t ffi = NULL;
+    test_ffi_init(&ffi);
+    assert_rnp_success(
+      rnp_ffi_set_pass_provider(ffi, ffi_string_password_provider, (void *) "password"));
+    /* mix of short, dash-escaped, whitespace-trailed, CRLF and very long lines */
+    std::string msg;
+    std::string expected;
+    for (size_t i = 0; i < 3000; i++) {
+        std::string line = "line " + std::to_string(i);
+        std::string stripped = line;
+        std::string eol = "\n";
+        switch (i % 7) {
+        case 1:
+            line = stripped = "- dashed " + line;
+            break;
+        case 2:
+            line = stripped = "From " + line;
+            break;
+        case 3:
+            line += " \t  ";
+            break;
+        case 4:
+            eol = "\r\n";
+            break;
+        case 5:
+            line = stripped = "";
+            break;
+        case 6:
+            if (!(i % 5)) {
+                line = stripped = std::string(10000 + i, 'x');
+            }
+            break;
+        default:
+            break;
+        }
+        msg += line + eol;
+        expected += stripped + eol;
+    }
+
+    rnp_input_t   input = NULL;
+    rnp_output_t  output = NULL;
+    rnp_op_sign_t op = NULL;
+    assert_rnp_success(
+      rnp_input_from_memory(&input, (const uint8_t *) msg.data(), msg.size(), false));
+    assert_rnp_success(rnp_output_to_memory(&output, 0));
+    assert_rnp_success(rnp_op_sign_cleartext_create(&op, ffi, input, output));
+    rnp_key_handle_t key = NULL;
+    assert_rnp_success(rnp_locate_key(ffi, "userid", "key0-uid0", &key));
+    assert_rnp_success(rnp_op_sign_add_signature(op, key, NULL));
+    rnp_key_handle_destroy(key);
+    assert_rnp_success(rnp_op_sign_execute(op));
+    rnp_op_sign_destroy(op);
+    rnp_input_destroy(input);
+    uint8_t *buf = NULL;
+    size_t   len = 0;
+    assert_rnp_success(rnp_output_memory_get_buf(output, &buf, &len, false));
+    /* dash-escaped lines must be escaped once more */
+    std::string signed_msg((const char *) buf, len);
+    assert_true(signed_msg.find("\n- - dashed line 1\n") != std::string::npos);
+    assert_true(signed_msg.find("\n- From line 2\n") != std::string::npos);
+
+    rnp_output_t    verout = NULL;
+    rnp_op_verify_t verify = NULL;
+    assert_rnp_success(rnp_input_from_memory(&input, buf, len, false));
+    assert_rnp_success(rnp_output_to_memory(&verout, 0));
+    assert_rnp_success(rnp_op_verify_create(&verify, ffi, input, verout));
+    assert_rnp_success(rnp_op_verify_execute(verify));
+    rnp_op_verify_signature_t sig = NULL;
+    assert_rnp_success(rnp_op_verify_get_signature_at(verify, 0, &sig));
+    assert_rnp_success(rnp_op_verify_signature_get_status(sig));
+    rnp_op_verify_destroy(verify);
+    rnp_input_destroy(input);
+    rnp_output_destroy(output);
+    /* verified text has escaping and trailing whitespace removed */
+    assert_rnp_success(rnp_output_memory_get_buf(verout, &buf, &len, false));
+    assert_true(len >= expected.size());
+    assert_int_equal(memcmp(buf, expected.data(), expected.size()), 0);
+    rnp_output_destroy(verout);
+    rnp_ffi_destroy(ffi);
+}
+
+static void
+push_op_notify(void *app_ctx)
+{
+    (*(std::atomic<size_t> *) app_ctx)++;
+}
+
+/* wait until the operation reports any of the state flags */
+template <typename T>
+static void
+push_op_wait(T op, rnp_result_t (*get_state)(T, uint32_t *), uint32_t flags, uint32_t *state)
+{
+    for (size_t i = 0; i < 10000; i++) {
+        assert_rnp_success(get_state(op, state));
+        if (*state & flags) {
+            return;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    FAIL() << "operation state timeout";
+}
+
+static void
+push_op_wait(rnp_op_verify_t op, uint32_t flags, uint32_t *state)
+{
+    push_op_wait(op, rnp_op_verify_get_state, flags, state);
+}
+
+TEST_F(rnp_tests, test_ffi_verify_push)
+{
+    rnp_ffi_t ffi = NULL;
+    test_ffi_init(&ffi);
+    assert_rnp_success(
+      rnp_ffi_set_pass_provider(ffi, ffi_string_password_provider, (void *) "password"));
+    std::string msg;
+    for (size_t i = 0; i < 5000; i++) {
+        msg += "Line " + std::to_string(i) + " of the message, processed incrementally.\n";
+    }
+    /* sign the message */
+    rnp_input_t   input = NULL;
+    rnp_output_t  output = NULL;
+    rnp_op_sign_t sign = NULL;
+    assert_rnp_success(
+      rnp_input_from_memory(&input, (const uint8_t *) msg.data(), msg.size(), false));
+    assert_rnp_success(rnp_output_to_memory(&output, 0));
+    assert_rnp_success(rnp_op_sign_create(&sign, ffi, input, output));
+    rnp_key_handle_t key = NULL;
+    assert_rnp_success(rnp_locate_key(ffi, "userid", "key0-uid0", &key));
+    assert_rnp_success(rnp_op_sign_add_signature(sign, key, NULL));
+    rnp_key_handle_destroy(key);
+    assert_rnp_success(rnp_op_sign_execute(sign));
+    rnp_op_sign_destroy(sign);
+    rnp_input_destroy(input);
+    uint8_t *buf = NULL;
+    size_t   len = 0;
+    assert_rnp_success(rnp_output_memory_get_buf(output, &buf, &len, false));
+    std::vector<uint8_t> signed_msg(buf, buf + len);
+    rnp_output_destroy(output);
+
+    /* bad parameters */
+    assert_rnp_failure(rnp_input_from_push(NULL));
+    assert_rnp_failure(rnp_output_to_pull(NULL, 0));
+    assert_rnp_success(rnp_input_from_memory(&input, signed_msg.data(), 1, false));
+    assert_rnp_failure(rnp_input_push(input, signed_msg.data(), 1));
+    assert_rnp_failure(rnp_input_push_finish(input));
+    rnp_input_destroy(input);
+    assert_rnp_success(rnp_output_to_null(&output));
+    uint8_t chunk[100];
+    size_t  read = 0;
+    assert_rnp_failure(rnp_output_pull(output, chunk, sizeof(chunk), &read));
+    rnp_output_destroy(output);
+    /* pull output is not a memory one */
+    assert_rnp_success(rnp_output_to_pull(&output, 0));
+    assert_int_equal(rnp_output_memory_get_buf(output, &buf, &len, false),
+                     RNP_ERROR_BAD_PARAMETERS);
+    assert_int_equal(rnp_output_memory_get_buf(output, &buf, &len, true),
+                     RNP_ERROR_BAD_PARAMETERS);
+    size_t segcount = 0;
+    assert_int_equal(rnp_output_memory_get_segment_count(output, &segcount),
+                     RNP_ERROR_BAD_PARAMETERS);
+    rnp_output_destroy(output);
+
+    /* feed the signed data in small chunks, pulling the output as it is available */
+    std::atomic<size_t> notified(0);
+    rnp_op_verify_t     verify = NULL;
+    assert_rnp_success(rnp_input_from_push(&input));
+    assert_rnp_success(rnp_output_to_pull(&output, 1024));
+    assert_rnp_success(rnp_op_verify_create(&verify, ffi, input, output));
+    uint32_t state = 0;
+    assert_int_equal(rnp_op_verify_get_state(verify, &state), RNP_ERROR_BAD_STATE);
+    assert_int_equal(rnp_op_verify_finish(verify), RNP_ERROR_BAD_STATE);
+    assert_rnp_success(rnp_op_verify_start(verify, push_op_notify, &notified));
+    assert_int_equal(rnp_op_verify_start(verify, NULL, NULL), RNP_ERROR_BAD_STATE);
+    std::string verified;
+    size_t      pos = 0;
+    do {
+        push_op_wait(verify,
+                     RNP_OP_STATE_NEED_INPUT | RNP_OP_STATE_HAVE_OUTPUT | RNP_OP_STATE_DONE,
+                     &state);
+        if (state & RNP_OP_STATE_HAVE_OUTPUT) {
+            assert_rnp_success(rnp_output_pull(output, chunk, sizeof(chunk), &read));
+            verified.append((const char *) chunk, read);
+        }
+        if ((state & RNP_OP_STATE_NEED_INPUT) && (pos < signed_msg.size())) {
+            size_t clen = std::min((size_t) 777, signed_msg.size() - pos);
+            assert_rnp_success(rnp_input_push(input, signed_msg.data() + pos, clen));
+            pos += clen;
+            if (pos == signed_msg.size()) {
+                assert_rnp_success(rnp_input_push_finish(input));
+                assert_int_equal(rnp_input_push(input, chunk, 1), RNP_ERROR_BAD_STATE);
+            }
+        }
+    } while (!(state & RNP_OP_STATE_DONE) || (state & RNP_OP_STATE_HAVE_OUTPUT));
+    assert_rnp_success(rnp_op_verify_finish(verify));
+    assert_true(notified > 0);
+    assert_true(verified == msg);
+    size_t count = 0;
+    assert_rnp_success(rnp_op_verify_get_signature_count(verify, &count));
+    assert_int_equal(count, 1);
+    rnp_op_verify_signature_t sig = NULL;
+    assert_rnp_success(rnp_op_verify_get_signature_at(verify, 0, &sig));
+    assert_rnp_success(rnp_op_verify_signature_get_status(sig));
+    rnp_op_verify_destroy(verify);
+    rnp_input_destroy(input);
+    rnp_output_destroy(output);
+
+    /* destroy operation while it waits for the input */
+    assert_rnp_success(rnp_input_from_push(&input));
+    assert_rnp_success(rnp_output_to_pull(&output, 0));
+    assert_rnp_success(rnp_op_verify_create(&verify, ffi, input, output));
+    assert_rnp_success(rnp_op_verify_start(verify, NULL, NULL));
+    assert_rnp_success(rnp_input_push(input, signed_msg.data(), 100));
+    push_op_wait(verify, RNP_OP_STATE_NEED_INPUT, &state);
+    rnp_op_verify_destroy(verify);
+    rnp_input_destroy(input);
+    rnp_output_destroy(output);
+
+    /* truncated input */
+    assert_rnp_success(rnp_input_from_push(&input));
+    assert_rnp_success(rnp_output_to_pull(&output, 0));
+    assert_rnp_success(rnp_op_verify_create(&verify, ffi, input, output));
+    assert_rnp_success(rnp_op_verify_start(verify, NULL, NULL));
+    assert_rnp_success(rnp_input_push(input, signed_msg.data(), signed_msg.size() - 10));
+    assert_rnp_success(rnp_input_push_finish(input));
+    assert_rnp_failure(rnp_op_verify_finish(verify));
+    rnp_op_verify_destroy(verify);
+    rnp_input_destroy(input);
+    rnp_output_destroy(output);
+    rnp_ffi_destroy(ffi);
+}
+
+TEST_F(rnp_tests, test_ffi_sign_encrypt_push)
+{
+    rnp_ffi_t ffi = NULL;
+    test_ffi_init(&ffi);
+    assert_rnp_success(
+      rnp_ffi_set_pass_provider(ffi, ffi_string_password_provider, (void *) "password"));
+    /* single worker, so started operations are processed one by one */
+    assert_rnp_success(rnp_ffi_set_async_limits(ffi, 1, 0));
+    std::string msg;
+    for (size_t i = 0; i < 3000; i++) {
+        msg += "Line " + std::to_string(i) + " of the message, encrypted incrementally.\n";
+    }
+
+    rnp_input_t      input = NULL;
+    rnp_output_t     output = NULL;
+    rnp_op_encrypt_t enc = NULL;
+    assert_rnp_success(rnp_input_from_push(&input));
+    assert_rnp_success(rnp_output_to_pull(&output, 1024));
+    assert_rnp_success(rnp_op_encrypt_create(&enc, ffi, input, output));
+    assert_rnp_success(rnp_op_encrypt_add_password(enc, "password", NULL, 0, NULL));
+    uint32_t state = 0;
+    assert_int_equal(rnp_op_encrypt_get_state(enc, &state), RNP_ERROR_BAD_STATE);
+    assert_int_equal(rnp_op_encrypt_finish(enc), RNP_ERROR_BAD_STATE);
+    assert_rnp_failure(rnp_op_encrypt_start(NULL, NULL, NULL));
+    assert_rnp_success(rnp_op_encrypt_start(enc, NULL, NULL));
+    assert_int_equal(rnp_op_encrypt_start(enc, NULL, NULL), RNP_ERROR_BAD_STATE);
+    assert_int_equal(rnp_op_encrypt_execute_async(enc, NULL, NULL), RNP_ERROR_BAD_STATE);
+    push_op_wait(enc, rnp_op_encrypt_get_state, RNP_OP_STATE_NEED_INPUT, &state);
+
+    /* worker is busy, so this one is queued, and may be destroyed without waiting */
+    rnp_input_t   sinput = NULL;
+    rnp_output_t  soutput = NULL;
+    rnp_op_sign_t sign = NULL;
+    assert_rnp_success(rnp_input_from_push(&sinput));
+    assert_rnp_success(rnp_output_to_pull(&soutput, 0));
+    assert_rnp_success(rnp_op_sign_create(&sign, ffi, sinput, soutput));
+    rnp_key_handle_t key = NULL;
+    assert_rnp_success(rnp_locate_key(ffi, "userid", "key0-uid0", &key));
+    assert_rnp_success(rnp_op_sign_add_signature(sign, key, NULL));
+    rnp_key_handle_destroy(key);
+    assert_rnp_success(rnp_op_sign_start(sign, NULL, NULL));
+    assert_rnp_success(rnp_op_sign_get_state(sign, &state));
+    assert_int_equal(state, 0);
+    size_t queued = 0;
+    assert_rnp_success(rnp_ffi_get_async_stats(ffi, &queued, NULL, NULL));
+    assert_int_equal(queued, 1);
+    rnp_op_sign_destroy(sign);
+    rnp_input_destroy(sinput);
+    rnp_output_destroy(soutput);
+
+    std::string encrypted;
+    size_t      pos = 0;
+    uint8_t     chunk[100];
+    size_t      read = 0;
+    do {
+        push_op_wait(enc,
+                     rnp_op_encrypt_get_state,
+                     RNP_OP_STATE_NEED_INPUT | RNP_OP_STATE_HAVE_OUTPUT | RNP_OP_STATE_DONE,
+                     &state);
+        if (state & RNP_OP_STATE_HAVE_OUTPUT) {
+            assert_rnp_success(rnp_output_pull(output, chunk, sizeof(chunk), &read));
+            encrypted.append((const char *) chunk, read);
+        }
+        if ((state & RNP_OP_STATE_NEED_INPUT) && (pos < msg.size())) {
+            size_t clen = std::min((size_t) 555, msg.size() - pos);
+            auto data = (const uint8_t *) msg.data() + pos;
+            assert_rnp_success(rnp_input_push(input, data, clen));
+            pos += clen;
+            if (pos == msg.size()) {
+                assert_rnp_success(rnp_input_push_finish(input));
+            }
+        }
+    } while (!(state & RNP_OP_STATE_DONE) || (state & RNP_OP_STATE_HAVE_OUTPUT));
+    assert_rnp_success(rnp_op_encrypt_finish(enc));
+    rnp_op_encrypt_destroy(enc);
+    rnp_input_destroy(input);
+    rnp_output_destroy(output);
+
+    /* decrypt it back */
+    rnp_op_verify_t verify = NULL;
+    assert_rnp_success(rnp_input_from_memory(
+      &input, (const uint8_t *) encrypted.data(), encrypted.size(), false));
+    assert_rnp_success(rnp_output_to_memory(&output, 0));
+    assert_rnp_success(rnp_op_verify_create(&verify, ffi, input, output));
+    assert_rnp_success(rnp_op_verify_execute(verify));
+    uint8_t *buf = NULL;
+    size_t   len = 0;
+    assert_rnp_success(rnp_output_memory_get_buf(output, &buf, &len, false));
+    assert_true(std::string((const char *) buf, len) == msg);
+    rnp_op_verify_destroy(verify);
+    rnp_input_destroy(input);
+    rnp_output_destroy(output);
+    rnp_ffi_destroy(ffi);
+}
+
+struct async_results_t {
+    std::mutex                lock;
+    std::condition_variable   cond;
+    std::vector<rnp_result_t> results;
+};
+
+static void
+async_complete(void *app_ctx, rnp_result_t result)
+{
+    auto                        res = (async_results_t *) app_ctx;
+    std::lock_guard<std::mutex> lock(res->lock);
+    res->results.push_back(result);
+    res->cond.notify_all();
+}
+
+static void
+async_wait(async_results_t &res, size_t count)
+{
+    std::unique_lock<std::mutex> lock(res.lock);
+    assert_true(res.cond.wait_for(lock, std::chrono::seconds(60), [&res, count]() {
+        return res.results.size() >= count;
+    }));
+    for (auto ret : res.results) {
+        assert_rnp_success(ret);
+    }
+}
+
+TEST_F(rnp_tests, test_ffi_execute_async)
+{
+    rnp_ffi_t ffi = NULL;
+    test_ffi_init(&ffi);
+    assert_rnp_success(
+      rnp_ffi_set_pass_provider(ffi, ffi_string_password_provider, (void *) "password"));
+    assert_rnp_failure(rnp_ffi_set_async_limits(NULL, 2, 0));
+    assert_rnp_success(rnp_ffi_set_async_limits(ffi, 2, 0));
+    size_t queued = 10, running = 10, completed = 10;
+    assert_rnp_success(rnp_ffi_get_async_stats(ffi, &queued, &running, &completed));
+    assert_int_equal(queued + running + completed, 0);
+
+    /* sign a number of messages in parallel */
+    const size_t                count = 8;
+    const std::string           msg = "Message to be processed asynchronously.";
+    std::vector<rnp_input_t>    inputs(count);
+    std::vector<rnp_output_t>   outputs(count);
+    std::vector<rnp_op_sign_t>  signs(count);
+    async_results_t             sres;
+    rnp_key_handle_t            key = NULL;
+    assert_rnp_success(rnp_locate_key(ffi, "userid", "key0-uid0", &key));
+    for (size_t i = 0; i < count; i++) {
+        assert_rnp_success(rnp_input_from_memory(
+          &inputs[i], (const uint8_t *) msg.data(), msg.size(), false));
+        assert_rnp_success(rnp_output_to_memory(&outputs[i], 0));
+        assert_rnp_success(rnp_op_sign_create(&signs[i], ffi, inputs[i], outputs[i]));
+        assert_rnp_success(rnp_op_sign_add_signature(signs[i], key, NULL));
+        assert_rnp_failure(rnp_op_sign_execute_async(NULL, async_complete, &sres));
+        assert_rnp_success(rnp_op_sign_execute_async(signs[i], async_complete, &sres));
+    }
+    rnp_key_handle_destroy(key);
+    async_wait(sres, count);
+    assert_rnp_success(rnp_ffi_get_async_stats(ffi, &queued, &running, &completed));
+    assert_int_equal(queued, 0);
+    assert_int_equal(completed, count);
+    for (size_t i = 0; i < count; i++) {
+        rnp_op_sign_destroy(signs[i]);
+        rnp_input_destroy(inputs[i]);
+    }
+
+    /* verify them, destroying operations without waiting for the callback */
+    std::vector<rnp_op_verify_t> verifies(count);
+    std::vector<rnp_output_t>    verouts(count);
+    async_results_t              vres;
+    for (size_t i = 0; i < count; i++) {
+        uint8_t *buf = NULL;
+        size_t   len = 0;
+        assert_rnp_success(rnp_output_memory_get_buf(outputs[i], &buf, &len, false));
+        assert_rnp_success(rnp_input_from_memory(&inputs[i], buf, len, false));
+        assert_rnp_success(rnp_output_to_memory(&verouts[i], 0));
+        assert_rnp_success(rnp_op_verify_create(&verifies[i], ffi, inputs[i], verouts[i]));
+        assert_rnp_success(rnp_op_verify_execute_async(verifies[i], async_complete, &vres));
+        assert_int_equal(rnp_op_verify_start(verifies[i], NULL, NULL), RNP_ERROR_BAD_STATE);
+    }
+    for (size_t i = 0; i < count; i++) {
+        rnp_op_verify_destroy(verifies[i]);
+        uint8_t *buf = NULL;
+        size_t   len = 0;
+        assert_rnp_success(rnp_output_memory_get_buf(verouts[i], &buf, &len, false));
+        assert_true(std::string((const char *) buf, len) == msg);
+        rnp_output_destroy(verouts[i]);
+        rnp_input_destroy(inputs[i]);
+        rnp_output_destroy(outputs[i]);
+    }
+    async_wait(vres, count);
+
+    /* encrypt with password */
+    rnp_input_t      input = NULL;
+    rnp_output_t     output = NULL;
+    rnp_op_encrypt_t enc = NULL;
+    async_results_t  eres;
+    assert_rnp_success(
+      rnp_input_from_memory(&input, (const uint8_t *) msg.data(), msg.size(), false));
+    assert_rnp_success(rnp_output_to_memory(&output, 0));
+    assert_rnp_success(rnp_op_encrypt_create(&enc, ffi, input, output));
+    assert_rnp_success(rnp_op_encrypt_add_password(enc, "password", NULL, 0, NULL));
+    assert_rnp_success(rnp_op_encrypt_execute_async(enc, async_complete, &eres));
+    async_wait(eres, 1);
+    rnp_op_encrypt_destroy(enc);
+    rnp_input_destroy(input);
+    uint8_t *buf = NULL;
+    size_t   len = 0;
+    assert_rnp_success(rnp_output_memory_get_buf(output, &buf, &len, false));
+    rnp_output_t decout = NULL;
+    assert_rnp_success(rnp_input_from_memory(&input, buf, len, false));
+    assert_rnp_success(rnp_output_to_memory(&decout, 0));
+    assert_rnp_success(rnp_decrypt(ffi, input, decout));
+    assert_rnp_success(rnp_output_memory_get_buf(decout, &buf, &len, false));
+    assert_true(std::string((const char *) buf, len) == msg);
+    rnp_output_destroy(decout);
+    rnp_input_destroy(input);
+    rnp_output_destroy(output);
+
+    /* generate key */
+    rnp_op_generate_t gen = NULL;
+    async_results_t   gres;
+    assert_rnp_success(rnp_op_generate_create(&gen, ffi, "ECDSA"));
+    assert_rnp_success(rnp_op_generate_set_curve(gen, "NIST P-256"));
+    assert_rnp_success(rnp_op_generate_set_userid(gen, "async_key"));
+    assert_rnp_success(rnp_op_generate_execute_async(gen, async_complete, &gres));
+    async_wait(gres, 1);
+    assert_rnp_success(rnp_op_generate_get_key(gen, &key));
+    assert_non_null(key);
+    rnp_key_handle_destroy(key);
+    rnp_op_generate_destroy(gen);
+    assert_rnp_success(rnp_locate_key(ffi, "userid", "async_key", &key));
+    assert_non_null(key);
+    rnp_key_handle_destroy(key);
+
+    /* queue limit: the single worker is busy with the operation, waiting for input */
+    assert_rnp_success(rnp_ffi_set_async_limits(ffi, 1, 1));
+    rnp_input_t     pinput = NULL;
+    rnp_op_verify_t pverify = NULL;
+    async_results_t pres;
+    assert_rnp_success(rnp_input_from_push(&pinput));
+    assert_rnp_success(rnp_output_to_null(&output));
+    assert_rnp_success(rnp_op_verify_create(&pverify, ffi, pinput, output));
+    assert_rnp_success(rnp_op_verify_execute_async(pverify, async_complete, &pres));
+    for (size_t i = 0; i < 10000; i++) {
+        assert_rnp_success(rnp_ffi_get_async_stats(ffi, NULL, &running, NULL));
+        if (running) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    assert_int_equal(running, 1);
+    assert_int_equal(rnp_op_verify_execute_async(pverify, NULL, NULL), RNP_ERROR_BAD_STATE);
+    assert_rnp_success(
+      rnp_input_from_memory(&input, (const uint8_t *) msg.data(), msg.size(), false));
+    assert_rnp_success(rnp_output_to_null(&decout));
+    assert_rnp_success(rnp_op_encrypt_create(&enc, ffi, input, decout));
+    assert_rnp_success(rnp_op_encrypt_add_password(enc, "password", NULL, 0, NULL));
+    assert_rnp_success(rnp_op_encrypt_execute_async(enc, async_complete, &eres));
+    assert_rnp_success(rnp_ffi_get_async_stats(ffi, &queued, NULL, NULL));
+    assert_int_equal(queued, 1);
+    assert_rnp_success(rnp_op_generate_create(&gen, ffi, "ECDSA"));
+    assert_rnp_success(rnp_op_generate_set_curve(gen, "NIST P-256"));
+    assert_rnp_success(rnp_op_generate_set_userid(gen, "async_key_2"));
+    assert_int_equal(rnp_op_generate_execute_async(gen, NULL, NULL), RNP_ERROR_BAD_STATE);
+    rnp_op_generate_destroy(gen);
+    assert_int_equal(rnp_ffi_set_async_limits(ffi, 2, 0), RNP_ERROR_BAD_STATE);
+    /* let the first operation complete: it fails on the non-OpenPGP data */
+    assert_rnp_success(rnp_input_push(pinput, (const uint8_t *) msg.data(), msg.size()));
+    assert_rnp_success(rnp_input_push_finish(pinput));
+    {
+        std::unique_lock<std::mutex> lock(pres.lock);
+        assert_true(pres.cond.wait_for(
+          lock, std::chrono::seconds(60), [&pres]() { return !pres.results.empty(); }));
+        assert_rnp_failure(pres.results[0]);
+    }
+    async_wait(eres, 2);
+    rnp_op_verify_destroy(pverify);
+    rnp_op_encrypt_destroy(enc);
+    rnp_input_destroy(pinput);
+    rnp_input_destroy(input);
+    rnp_output_destroy(output);
+    rnp_output_destroy(decout);
+    assert_rnp_success(rnp_ffi_set_async_limits(ffi, 0, 0));
+    rnp_ffi_destroy(ffi);
+}
+
+static bool
+getpasscb_count(rnp_ffi_t        ffi,
+                void *           app_ctx,
+                rnp_key_handle_t key,
+                const char *     pgp_context,
+                char *           buf,
+                size_t           buf_len)
+{
+    (*(size_t *) app_ctx)++;
+    return ffi_string_password_provider(
+      ffi, (void *) "password", key, pgp_context, buf, buf_len);
+}
+
+TEST_F(rnp_tests, test_ffi_sign_batch)
+{
+    rnp_ffi_t ffi = NULL;
+    test_ffi_init(&ffi);
+    size_t asked = 0;
+    assert_rnp_success(rnp_ffi_set_pass_provider(ffi, getpasscb_count, &asked));
+
+    rnp_op_sign_batch_t op = NULL;
+    assert_rnp_failure(rnp_op_sign_batch_create(NULL, ffi));
+    assert_rnp_failure(rnp_op_sign_batch_create(&op, NULL));
+    assert_rnp_success(rnp_op_sign_batch_create(&op, ffi));
+    // nothing to execute
+    assert_int_equal(rnp_op_sign_batch_execute(op), RNP_ERROR_BAD_STATE);
+    assert_rnp_success(rnp_op_sign_batch_destroy(op));
+
+    assert_rnp_success(rnp_op_sign_batch_create(&op, ffi));
+    rnp_key_handle_t key = NULL;
+    assert_rnp_success(rnp_locate_key(ffi, "userid", "key0-uid0", &key));
+    assert_rnp_failure(rnp_op_sign_batch_add_signature(NULL, key, NULL));
+    assert_rnp_success(rnp_op_sign_batch_add_signature(op, key, NULL));
+    rnp_key_handle_destroy(key);
+    assert_rnp_success(rnp_locate_key(ffi, "userid", "key1-uid0", &key));
+    rnp_op_sign_signature_t sig = NULL;
+    assert_rnp_success(rnp_op_sign_batch_add_signature(op, key, &sig));
+    assert_rnp_success(rnp_op_sign_signature_set_hash(sig, "SHA512"));
+    rnp_key_handle_destroy(key);
+    assert_rnp_success(rnp_op_sign_batch_set_armor(op, true));
+    assert_rnp_success(rnp_op_sign_batch_set_hash(op, "SHA384"));
+    assert_rnp_success(rnp_op_sign_batch_set_creation_time(op, 1516211899));
+    assert_rnp_success(rnp_op_sign_batch_set_expiration_time(op, 2000000000));
+    assert_rnp_success(rnp_op_sign_batch_set_threads(op, 3));
+
+    const size_t              count = 10;
+    std::vector<std::string>  msgs;
+    std::vector<rnp_input_t>  inputs;
+    std::vector<rnp_output_t> outputs;
+    for (size_t i = 0; i < count; i++) {
+        msgs.push_back("Batch signed message #" + std::to_string(i));
+    }
+    for (size_t i = 0; i < count; i++) {
+        rnp_input_t  input = NULL;
+        rnp_output_t output = NULL;
+        assert_rnp_success(rnp_input_from_memory(
+          &input, (const uint8_t *) msgs[i].data(), msgs[i].size(), false));
+        assert_rnp_success(rnp_output_to_memory(&output, 0));
+        size_t idx = 0;
+        assert_rnp_failure(rnp_op_sign_batch_add_input(op, NULL, output, &idx));
+        assert_rnp_failure(rnp_op_sign_batch_add_input(op, input, NULL, &idx));
+        assert_rnp_success(rnp_op_sign_batch_add_input(op, input, output, &idx));
+        assert_int_equal(idx, i);
+        inputs.push_back(input);
+        outputs.push_back(output);
+    }
+    rnp_result_t result = RNP_SUCCESS;
+    assert_rnp_failure(rnp_op_sign_batch_get_result(op, 0, &result));
+    assert_rnp_success(rnp_op_sign_batch_execute(op));
+    // each key is unlocked only once
+    assert_int_equal(asked, 2);
+    assert_int_equal(rnp_op_sign_batch_execute(op), RNP_ERROR_BAD_STATE);
+    assert_rnp_failure(rnp_op_sign_batch_get_result(op, count, &result));
+    assert_rnp_failure(rnp_op_sign_batch_get_result(op, 0, NULL));
+    // keys are locked back
+    assert_rnp_success(rnp_locate_key(ffi, "userid", "key0-uid0", &key));
+    bool locked = false;
+    assert_rnp_success(rnp_key_is_locked(key, &locked));
+    assert_true(locked);
+    rnp_key_handle_destroy(key);
+
+    for (size_t i = 0; i < count; i++) {
+        assert_rnp_success(rnp_op_sign_batch_get_result(op, i, &result));
+        assert_rnp_success(result);
+        uint8_t *buf = NULL;
+        size_t   len = 0;
+        assert_rnp_success(rnp_output_memory_get_buf(outputs[i], &buf, &len, false));
+        assert_true(starts_with(std::string((char *) buf, len), "-----BEGIN PGP SIGNATURE"));
+
+        rnp_input_t     data = NULL;
+        rnp_input_t     sigs = NULL;
+        rnp_op_verify_t verify = NULL;
+        assert_rnp_success(rnp_input_from_memory(
+          &data, (const uint8_t *) msgs[i].data(), msgs[i].size(), false));
+        assert_rnp_success(rnp_input_from_memory(&sigs, buf, len, false));
+        assert_rnp_success(rnp_op_verify_detached_create(&verify, ffi, data, sigs));
+        assert_rnp_success(rnp_op_verify_execute(verify));
+        size_t sigcount = 0;
+        assert_rnp_success(rnp_op_verify_get_signature_count(verify, &sigcount));
+        assert_int_equal(sigcount, 2);
+        rnp_op_verify_signature_t vsig = NULL;
+        char *                    hash = NULL;
+        assert_rnp_success(rnp_op_verify_get_signature_at(verify, 1, &vsig));
+        assert_rnp_success(rnp_op_verify_signature_get_hash(vsig, &hash));
+        assert_string_equal(hash, "SHA512");
+        rnp_buffer_destroy(hash);
+        rnp_op_verify_destroy(verify);
+        rnp_input_destroy(data);
+        rnp_input_destroy(sigs);
+        rnp_input_destroy(inputs[i]);
+        rnp_output_destroy(outputs[i]);
+    }
+    assert_rnp_success(rnp_op_sign_batch_destroy(op));
+    rnp_ffi_destroy(ffi);
+}
+
 TEST_F(rnp_tests, test_ffi_signatures_dump)
 {
     rnp_ffi_t       ffi = NULL;
@@ -2842,6 +3555,97 @@ TEST_F(rnp_tests, test_ffi_stdout_output)
     rnp_ffi_destroy(ffi);
 }
 
+TEST_F(rnp_tests, test_ffi_memory_output_segments)
+{
+    std::vector<uint8_t> data(300000);
+    for (size_t i = 0; i < data.size(); i++) {
+        data[i] = (uint8_t)(i * 7 + i / 251);
+    }
+    /* bad parameters */
+    rnp_output_t output = NULL;
+    assert_rnp_failure(rnp_output_to_memory_ex(NULL, 0, 0, 0));
+    assert_rnp_failure(rnp_output_to_memory_ex(&output, 0, 0, 0x80));
+    assert_null(output);
+
+    for (uint32_t flags : {0U, (uint32_t) RNP_OUTPUT_MEMORY_SEGMENTED}) {
+        /* limit on the allocated memory */
+        assert_rnp_success(rnp_output_to_memory_ex(&output, 1000, 100, flags));
+        size_t written = 0;
+        assert_rnp_success(rnp_output_write(output, data.data(), 600, &written));
+        assert_rnp_failure(rnp_output_write(output, data.data(), 600, &written));
+        rnp_output_destroy(output);
+
+        /* no data written */
+        assert_rnp_success(rnp_output_to_memory_ex(&output, 0, 0, flags));
+        size_t count = 10;
+        assert_rnp_failure(rnp_output_memory_get_segment_count(output, NULL));
+        assert_rnp_success(rnp_output_memory_get_segment_count(output, &count));
+        assert_int_equal(count, 0);
+        const uint8_t *seg = NULL;
+        size_t         seglen = 0;
+        assert_int_equal(rnp_output_memory_get_segment_at(output, 0, &seg, &seglen),
+                         RNP_ERROR_NOT_FOUND);
+
+        /* write data in chunks of different size */
+        size_t chunk = 1;
+        for (size_t pos = 0; pos < data.size(); pos += chunk, chunk = chunk * 3 + 1) {
+            chunk = std::min(chunk, data.size() - pos);
+            assert_rnp_success(rnp_output_write(output, data.data() + pos, chunk, &written));
+            assert_int_equal(written, chunk);
+        }
+        assert_rnp_success(rnp_output_memory_get_segment_count(output, &count));
+        if (flags) {
+            assert_true(count > 1);
+        } else {
+            assert_int_equal(count, 1);
+        }
+        std::vector<uint8_t> joined;
+        for (size_t idx = 0; idx < count; idx++) {
+            assert_rnp_failure(rnp_output_memory_get_segment_at(output, idx, NULL, &seglen));
+            assert_rnp_success(rnp_output_memory_get_segment_at(output, idx, &seg, &seglen));
+            joined.insert(joined.end(), seg, seg + seglen);
+        }
+        assert_true(joined == data);
+        /* copy doesn't need segments to be merged */
+        uint8_t *buf = NULL;
+        size_t   len = 0;
+        assert_rnp_success(rnp_output_memory_get_buf(output, &buf, &len, true));
+        assert_int_equal(len, data.size());
+        assert_int_equal(memcmp(buf, data.data(), len), 0);
+        rnp_buffer_destroy(buf);
+        size_t newcount = 0;
+        assert_rnp_success(rnp_output_memory_get_segment_count(output, &newcount));
+        assert_int_equal(newcount, count);
+        /* contiguous buffer */
+        assert_rnp_success(rnp_output_memory_get_buf(output, &buf, &len, false));
+        assert_int_equal(len, data.size());
+        assert_int_equal(memcmp(buf, data.data(), len), 0);
+        assert_rnp_success(rnp_output_memory_get_segment_count(output, &count));
+        assert_int_equal(count, 1);
+        /* write after the merge */
+        assert_rnp_success(rnp_output_write(output, data.data(), 100, &written));
+        assert_rnp_success(rnp_output_memory_get_buf(output, &buf, &len, false));
+        assert_int_equal(len, data.size() + 100);
+        assert_int_equal(memcmp(buf + data.size(), data.data(), 100), 0);
+        rnp_output_destroy(output);
+    }
+
+    /* size hint for the segmented output */
+    assert_rnp_success(
+      rnp_output_to_memory_ex(&output, 0, data.size(), RNP_OUTPUT_MEMORY_SEGMENTED));
+    size_t written = 0;
+    assert_rnp_success(rnp_output_write(output, data.data(), data.size(), &written));
+    size_t count = 0;
+    assert_rnp_success(rnp_output_memory_get_segment_count(output, &count));
+    assert_int_equal(count, 1);
+    rnp_output_destroy(output);
+
+    /* not a memory output */
+    assert_rnp_success(rnp_output_to_null(&output));
+    assert_rnp_failure(rnp_output_memory_get_segment_count(output, &count));
+    rnp_output_destroy(output);
+}
+
 /* shrink the length to 1 packet
  * set packet length type as PGP_PTAG_OLD_LEN_1 and remove one octet from length header
  */
@@ -3656,6 +4460,192 @@ TEST_F(rnp_tests, test_ffi_aead_params)
     rnp_ffi_destroy(ffi);
 }
 
+static void
+encrypt_range_msg(rnp_ffi_t          ffi,
+                  const std::string &data,
+                  const char *       aead,
+                  const char *       zalg,
+                  const char *       path)
+{
+    rnp_input_t      input = NULL;
+    rnp_output_t     output = NULL;
+    rnp_op_encrypt_t op = NULL;
+    assert_rnp_success(
+      rnp_input_from_memory(&input, (const uint8_t *) data.data(), data.size(), false));
+    assert_rnp_success(rnp_output_to_path(&output, path));
+    assert_rnp_success(rnp_op_encrypt_create(&op, ffi, input, output));
+    assert_rnp_success(rnp_op_encrypt_set_aead(op, aead));
+    if (strcmp(aead, "None")) {
+        assert_rnp_success(rnp_op_encrypt_set_aead_bits(op, 4));
+    }
+    assert_rnp_success(rnp_op_encrypt_set_compression(op, zalg, 6));
+    assert_rnp_success(rnp_op_encrypt_set_file_name(op, "range.txt"));
+    assert_rnp_success(rnp_op_encrypt_add_password(op, "password", NULL, 1024, NULL));
+    assert_rnp_success(rnp_op_encrypt_execute(op));
+    rnp_op_encrypt_destroy(op);
+    rnp_input_destroy(input);
+    rnp_output_destroy(output);
+}
+
+static void
+get_range_session_key(rnp_ffi_t ffi, const char *path, std::vector<uint8_t> &sesskey)
+{
+    rnp_input_t     input = NULL;
+    rnp_output_t    output = NULL;
+    rnp_op_verify_t verify = NULL;
+    uint8_t *       key = NULL;
+    size_t          keylen = 0;
+    assert_rnp_success(rnp_input_from_path(&input, path));
+    assert_rnp_success(rnp_output_to_null(&output));
+    assert_rnp_success(rnp_op_verify_create(&verify, ffi, input, output));
+    assert_rnp_success(rnp_op_verify_set_flags(verify, RNP_VERIFY_KEEP_SESSION_KEY));
+    assert_rnp_success(rnp_op_verify_execute(verify));
+    assert_rnp_success(rnp_op_verify_get_session_key(verify, &key, &keylen));
+    sesskey.assign(key, key + keylen);
+    rnp_buffer_clear(key, keylen);
+    rnp_buffer_destroy(key);
+    rnp_op_verify_destroy(verify);
+    rnp_output_destroy(output);
+    rnp_input_destroy(input);
+}
+
+static void
+check_decrypt_range(rnp_op_decrypt_range_t op,
+                    const std::string &    data,
+                    uint64_t               offset,
+                    uint64_t               length)
+{
+    rnp_output_t output = NULL;
+    assert_rnp_success(rnp_output_to_memory(&output, 0));
+    assert_rnp_success(rnp_op_decrypt_range_execute(op, offset, length, output));
+    uint8_t *buf = NULL;
+    size_t   len = 0;
+    assert_rnp_success(rnp_output_memory_get_buf(output, &buf, &len, false));
+    std::string expected = offset < data.size() ? data.substr(offset, length) : "";
+    assert_true(std::string((const char *) buf, len) == expected);
+    rnp_output_destroy(output);
+}
+
+TEST_F(rnp_tests, test_ffi_decrypt_range)
+{
+    if (!aead_ocb_enabled()) {
+        return;
+    }
+    rnp_ffi_t ffi = NULL;
+    assert_rnp_success(rnp_ffi_create(&ffi, "GPG", "GPG"));
+    assert_rnp_success(
+      rnp_ffi_set_pass_provider(ffi, ffi_string_password_provider, (void *) "password"));
+    /* 1024-byte chunks and 8192-byte partial lengths of literal and encrypted packets */
+    std::string data;
+    for (size_t i = 0; data.size() < 150000; i++) {
+        data += std::to_string(i) + ",";
+    }
+    encrypt_range_msg(ffi, data, "OCB", "Uncompressed", "encrypted");
+
+    /* get the session key */
+    rnp_input_t     input = NULL;
+    rnp_output_t    output = NULL;
+    rnp_op_verify_t verify = NULL;
+    uint8_t *       key = NULL;
+    size_t          keylen = 0;
+    assert_rnp_success(rnp_input_from_path(&input, "encrypted"));
+    assert_rnp_success(rnp_output_to_null(&output));
+    assert_rnp_success(rnp_op_verify_create(&verify, ffi, input, output));
+    assert_int_equal(rnp_op_verify_get_session_key(verify, &key, &keylen),
+                     RNP_ERROR_BAD_STATE);
+    assert_rnp_success(rnp_op_verify_set_flags(verify, RNP_VERIFY_KEEP_SESSION_KEY));
+    assert_int_equal(rnp_op_verify_get_session_key(verify, &key, &keylen),
+                     RNP_ERROR_NOT_FOUND);
+    assert_rnp_success(rnp_op_verify_execute(verify));
+    assert_rnp_failure(rnp_op_verify_get_session_key(NULL, &key, &keylen));
+    assert_rnp_failure(rnp_op_verify_get_session_key(verify, NULL, &keylen));
+    assert_rnp_failure(rnp_op_verify_get_session_key(verify, &key, NULL));
+    assert_rnp_success(rnp_op_verify_get_session_key(verify, &key, &keylen));
+    assert_int_equal(keylen, 32);
+    rnp_op_verify_destroy(verify);
+    rnp_output_destroy(output);
+
+    /* random access to the file */
+    rnp_op_decrypt_range_t op = NULL;
+    assert_rnp_failure(rnp_op_decrypt_range_create(NULL, ffi, input, key, keylen));
+    assert_rnp_failure(rnp_op_decrypt_range_create(&op, NULL, input, key, keylen));
+    assert_rnp_failure(rnp_op_decrypt_range_create(&op, ffi, NULL, key, keylen));
+    assert_rnp_failure(rnp_op_decrypt_range_create(&op, ffi, input, NULL, keylen));
+    assert_int_equal(rnp_op_decrypt_range_create(&op, ffi, input, key, 16),
+                     RNP_ERROR_BAD_PARAMETERS);
+    assert_rnp_success(rnp_op_decrypt_range_create(&op, ffi, input, key, keylen));
+    assert_rnp_failure(rnp_op_decrypt_range_execute(NULL, 0, 10, NULL));
+    assert_rnp_failure(rnp_op_decrypt_range_execute(op, 0, 10, NULL));
+    check_decrypt_range(op, data, 0, 10);
+    check_decrypt_range(op, data, 100000, 5000);
+    check_decrypt_range(op, data, 8100, 200);
+    check_decrypt_range(op, data, 1000, 30000);
+    check_decrypt_range(op, data, 0, 0);
+    check_decrypt_range(op, data, data.size() - 5, 100);
+    check_decrypt_range(op, data, data.size(), 10);
+    check_decrypt_range(op, data, data.size() + 100000, 10);
+    check_decrypt_range(op, data, 50000, 1);
+    check_decrypt_range(op, data, 0, data.size());
+    assert_rnp_success(rnp_op_decrypt_range_destroy(op));
+    rnp_input_destroy(input);
+
+    /* memory input */
+    auto msg = file_to_vec("encrypted");
+    assert_rnp_success(rnp_input_from_memory(&input, msg.data(), msg.size(), false));
+    assert_rnp_success(rnp_op_decrypt_range_create(&op, ffi, input, key, keylen));
+    for (size_t off = 0; off < data.size(); off += 7919) {
+        check_decrypt_range(op, data, data.size() - off, 3000);
+    }
+    rnp_op_decrypt_range_destroy(op);
+    rnp_input_destroy(input);
+
+    /* wrong session key */
+    key[0] ^= 0xff;
+    assert_rnp_success(rnp_input_from_memory(&input, msg.data(), msg.size(), false));
+    assert_int_equal(rnp_op_decrypt_range_create(&op, ffi, input, key, keylen),
+                     RNP_ERROR_READ);
+    rnp_input_destroy(input);
+    key[0] ^= 0xff;
+
+    /* corrupted chunk */
+    msg[msg.size() / 2] ^= 0xff;
+    assert_rnp_success(rnp_input_from_memory(&input, msg.data(), msg.size(), false));
+    assert_rnp_success(rnp_op_decrypt_range_create(&op, ffi, input, key, keylen));
+    check_decrypt_range(op, data, 0, 1000);
+    assert_rnp_success(rnp_output_to_memory(&output, 0));
+    assert_int_equal(rnp_op_decrypt_range_execute(op, 0, data.size(), output),
+                     RNP_ERROR_READ);
+    rnp_output_destroy(output);
+    rnp_op_decrypt_range_destroy(op);
+    rnp_input_destroy(input);
+
+    /* non-seekable input */
+    assert_rnp_success(rnp_input_from_push(&input));
+    assert_int_equal(rnp_op_decrypt_range_create(&op, ffi, input, key, keylen),
+                     RNP_ERROR_NOT_SUPPORTED);
+    rnp_input_destroy(input);
+
+    /* compressed data */
+    std::vector<uint8_t> zkey;
+    encrypt_range_msg(ffi, data, "OCB", "ZIP", "compressed");
+    get_range_session_key(ffi, "compressed", zkey);
+    assert_rnp_success(rnp_input_from_path(&input, "compressed"));
+    assert_int_equal(rnp_op_decrypt_range_create(&op, ffi, input, zkey.data(), zkey.size()),
+                     RNP_ERROR_NOT_SUPPORTED);
+    rnp_input_destroy(input);
+
+    /* CFB-encrypted data */
+    encrypt_range_msg(ffi, data, "None", "Uncompressed", "cfb");
+    assert_rnp_success(rnp_input_from_path(&input, "cfb"));
+    assert_int_equal(rnp_op_decrypt_range_create(&op, ffi, input, key, keylen),
+                     RNP_ERROR_NOT_SUPPORTED);
+    rnp_input_destroy(input);
+
+    rnp_buffer_clear(key, keylen);
+    rnp_buffer_destroy(key);
+    rnp_ffi_destroy(ffi);
+}
+
 TEST_F(rnp_tests, test_ffi_detached_verify_input)
 {
     rnp_ffi_t    ffi = NULL;
@@ -24,6 +24,8 @@
  * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <atomic>
+#include <thread>
 #include "pgp-key.h"
 
 #include "rnp_tests.h"
@@ -324,3 +326,64 @@ TEST_F(rnp_tests, test_key_protect_sec_data)
     assert_int_equal(ssubpkt->sec_protection.s2k.specifier, PGP_S2KS_ITERATED_AND_SALTED);
     delete ssubpkt;
 }
+
+TEST_F(rnp_tests, test_key_locker_users)
+{
+    rnp::KeyStore ks(PGP_KEY_STORE_GPG, "data/keyrings/1/secring.gpg", global_ctx);
+    assert_true(ks.load());
+    auto key = rnp_tests_get_key_by_id(&ks, "7bc6709b15c23a4a");
+    assert_non_null(key);
+    assert_true(key->is_locked());
+
+    pgp_password_provider_t pprov(string_copy_password_callback, (void *) "password");
+    {
+        std::unique_ptr<rnp::KeyLocker> first(new rnp::KeyLocker(*key));
+        assert_true(first->unlock(pprov, PGP_OP_SIGN));
+        {
+            /* key must not be wiped while it is used by the other locker */
+            rnp::KeyLocker second(*key);
+            assert_true(second.unlock(pprov, PGP_OP_SIGN));
+            first.reset();
+            assert_false(key->is_locked());
+            assert_true(rsa_sec_filled(*key->material()));
+        }
+        /* last user locks the key back */
+        assert_true(key->is_locked());
+        assert_true(rsa_sec_empty(*key->material()));
+    }
+    /* key, unlocked before, is kept unlocked */
+    assert_true(key->unlock(pprov));
+    {
+        rnp::KeyLocker locker(*key);
+    }
+    assert_false(key->is_locked());
+    /* the same if first user doesn't want to lock the key back */
+    assert_true(key->lock());
+    {
+        rnp::KeyLocker keep(*key, false);
+        assert_true(keep.unlock(pprov, PGP_OP_DECRYPT));
+        rnp::KeyLocker other(*key);
+    }
+    assert_false(key->is_locked());
+    /* validation is serialized with the other users of the key */
+    assert_true(key->lock());
+    {
+        rnp::KeyLocker           locker(*key);
+        std::vector<std::thread> threads;
+        std::atomic<size_t>      valid{0};
+        for (size_t i = 0; i < 4; i++) {
+            threads.emplace_back([&]() {
+                rnp::KeyLocker user(*key);
+                if (user.unlock(pprov, PGP_OP_SIGN) && user.validate(global_ctx)) {
+                    valid++;
+                }
+            });
+        }
+        for (auto &thread : threads) {
+            thread.join();
+        }
+        assert_int_equal(valid.load(), 4);
+        assert_true(key->material()->valid());
+    }
+    assert_true(key->is_locked());
+}
@@ -232,3 +232,99 @@ TEST_F(rnp_tests, test_key_store_search_by_name)
     delete pub_store;
     delete sec_store;
 }
+
+static std::vector<pgp_key_t *>
+key_store_search_iterate(rnp::KeyStore &store, const rnp::KeySearch &search)
+{
+    std::vector<pgp_key_t *> res;
+    for (auto key = store.search(search); key; key = store.search(search, key)) {
+        res.push_back(key);
+    }
+    return res;
+}
+
+TEST_F(rnp_tests, test_key_store_search_uid_index)
+{
+    rnp::KeyStore plain(PGP_KEY_STORE_GPG, "data/keyrings/1/pubring.gpg", global_ctx);
+    assert_true(plain.load());
+    rnp::KeyStore indexed(PGP_KEY_STORE_GPG, "data/keyrings/1/pubring.gpg", global_ctx);
+    indexed.set_uid_index(true);
+    assert_true(indexed.load());
+
+    auto fps = [](const std::vector<pgp_key_t *> &keys) {
+        std::vector<pgp_fingerprint_t> res;
+        for (auto key : keys) {
+            res.push_back(key->fp());
+        }
+        return res;
+    };
+    /* indexed search must give the same results as the full scan */
+    std::vector<std::unique_ptr<rnp::KeySearch>> searches;
+    for (auto uid : {"key0-uid0", "key1-uid2", "KEY1-UID2", "key2-uid0", "ke"}) {
+        searches.emplace_back(new rnp::KeyUIDSearch(uid));
+    }
+    for (auto query : {"uid", "UID1", "-uid", "key1-", "y0-u", "xyz", "ke", "key[01]-uid2"}) {
+        searches.emplace_back(new rnp::KeyQuerySearch(query));
+    }
+    for (auto &search : searches) {
+        auto expected = fps(plain.search_all(*search));
+        assert_true(fps(indexed.search_all(*search)) == expected);
+        assert_true(fps(key_store_search_iterate(indexed, *search)) == expected);
+        assert_true(fps(key_store_search_iterate(plain, *search)) == expected);
+    }
+    rnp::KeyQuerySearch uidq("UID");
+    assert_true(uidq.literal());
+    assert_int_equal(indexed.search_all(uidq).size(), 2);
+    assert_int_equal(indexed.search_all(rnp::KeyUIDSearch("key1-uid1")).size(), 1);
+    assert_true(indexed.search_all(rnp::KeyQuerySearch("uid3")).empty());
+    assert_false(rnp::KeyQuerySearch("key[01]").literal());
+    assert_false(rnp::KeyQuerySearch("7BC6709B15C23A4A").literal());
+
+    /* search may continue after any key, including subkeys without userids */
+    for (auto &key : indexed.keys) {
+        auto next = indexed.search(uidq, &key);
+        auto plainnext = plain.search(uidq, plain.get_key(key.fp()));
+        assert_true(!next == !plainnext);
+        assert_true(!next || (next->fp() == plainnext->fp()));
+    }
+    /* index may be enabled for the already loaded keystore */
+    plain.set_uid_index(true);
+    for (auto &search : searches) {
+        assert_true(fps(plain.search_all(*search)) == fps(indexed.search_all(*search)));
+    }
+    plain.set_uid_index(false);
+
+    /* index must follow the keystore changes */
+    auto key0 = rnp_tests_get_key_by_id(&indexed, "7BC6709B15C23A4A");
+    assert_non_null(key0);
+    pgp_key_t key0copy(*key0);
+    assert_true(indexed.remove_key(*key0, true));
+    auto found = indexed.search_all(uidq);
+    assert_int_equal(found.size(), 1);
+    assert_true(found[0] == rnp_tests_get_key_by_id(&indexed, "2FCADF05FFA501BB"));
+    assert_true(indexed.search_all(rnp::KeyQuerySearch("key0")).empty());
+    assert_non_null(indexed.add_key(key0copy));
+    found = indexed.search_all(uidq);
+    assert_int_equal(found.size(), 2);
+    /* re-added key goes to the end of the list */
+    assert_true(found[1]->fp() == key0copy.fp());
+    assert_int_equal(indexed.search_all(rnp::KeyQuerySearch("key0")).size(), 1);
+
+    /* userid, added directly to the key */
+    auto key1 = rnp_tests_get_key_by_id(&indexed, "2FCADF05FFA501BB");
+    assert_non_null(key1);
+    pgp_transferable_userid_t tuid;
+    tuid.uid.tag = PGP_PKT_USER_ID;
+    std::string newuid = "Alice <alice@example.com>";
+    tuid.uid.uid.assign(newuid.begin(), newuid.end());
+    key1->add_uid(tuid);
+    assert_true(indexed.search_all(rnp::KeyQuerySearch("ALICE@example")).empty());
+    indexed.update_uid_index(*key1);
+    found = indexed.search_all(rnp::KeyQuerySearch("ALICE@example"));
+    assert_int_equal(found.size(), 1);
+    assert_true(found[0] == key1);
+    /* keys from the other keystore are ignored */
+    plain.update_uid_index(*key1);
+    indexed.clear();
+    assert_true(indexed.search_all(uidq).empty());
+}
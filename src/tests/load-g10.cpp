@@ -24,7 +24,9 @@
  * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <librepgp/stream-ctx.h>
 #include "pgp-key.h"
+#include "ffi-priv-types.h"
 
 #include "rnp_tests.h"
 #include "support.h"
@@ -125,3 +127,111 @@ TEST_F(rnp_tests, test_load_g10)
     delete pub_store;
     delete sec_store;
 }
+
+TEST_F(rnp_tests, test_load_g10_deferred)
+{
+    rnp::KeyProvider key_provider(rnp_key_provider_store);
+    auto             pub_store = new rnp::KeyStore(
+      PGP_KEY_STORE_KBX, "data/test_stream_key_load/g10/pubring.kbx", global_ctx);
+    assert_true(pub_store->load());
+    key_provider.userdata = pub_store;
+
+    /* key files must be read only when key is requested */
+    auto sec_store = new rnp::KeyStore(
+      PGP_KEY_STORE_G10, "data/test_stream_key_load/g10/private-keys-v1.d", global_ctx);
+    sec_store->defer_g10 = true;
+    assert_true(sec_store->load(&key_provider));
+    assert_int_equal(sec_store->key_count(), 0);
+    /* search by keygrip reads just a single file */
+    auto pub = rnp_tests_get_key_by_id(pub_store, "CC786278981B0728");
+    assert_non_null(pub);
+    auto key = rnp_tests_get_key_by_grip(sec_store, pub->grip());
+    assert_non_null(key);
+    assert_true(key->is_secret());
+    assert_int_equal(sec_store->key_count(), 1);
+    /* search by keyid and fingerprint goes via the public key */
+    assert_true(test_load_gpg_check_key(pub_store, sec_store, "941822A0FC1B30A5"));
+    assert_int_equal(sec_store->key_count(), 2);
+    pub = rnp_tests_get_key_by_id(pub_store, "C711187E594376AF");
+    assert_non_null(pub);
+    assert_non_null(sec_store->get_key(pub->fp()));
+    assert_int_equal(sec_store->key_count(), 3);
+    /* unknown key must not trigger any load */
+    assert_null(rnp_tests_get_key_by_id(sec_store, "1111111111111111"));
+    assert_int_equal(sec_store->key_count(), 3);
+    /* load the rest */
+    assert_true(sec_store->load_deferred());
+    assert_true(sec_store->key_count() > 3);
+
+    /* parallel load must give the same result */
+    auto par_store = new rnp::KeyStore(
+      PGP_KEY_STORE_G10, "data/test_stream_key_load/g10/private-keys-v1.d", global_ctx);
+    par_store->g10_threads = 4;
+    assert_true(par_store->load(&key_provider));
+    assert_int_equal(par_store->key_count(), sec_store->key_count());
+    for (auto &seckey : sec_store->keys) {
+        assert_non_null(par_store->get_key(seckey.fp()));
+    }
+    assert_true(test_load_gpg_check_key(pub_store, par_store, "2FB9179118898E8B"));
+    assert_true(test_load_gpg_check_key(pub_store, par_store, "6E2F73008F8B8D6E"));
+
+    delete pub_store;
+    delete sec_store;
+    delete par_store;
+}
+
+TEST_F(rnp_tests, test_ffi_g10_deferred_load)
+{
+    rnp_ffi_t ffi = NULL;
+    assert_rnp_success(rnp_ffi_create(&ffi, "KBX", "G10"));
+    assert_rnp_failure(rnp_set_key_load_threads(NULL, 2));
+    assert_rnp_failure(rnp_set_key_load_threads(ffi, 0));
+    assert_rnp_success(rnp_set_key_load_threads(ffi, 4));
+    assert_int_equal(ffi->secring->g10_threads, 4);
+
+    /* full load, to get the number of keys */
+    rnp_input_t input = NULL;
+    assert_rnp_success(
+      rnp_input_from_path(&input, "data/test_stream_key_load/g10/private-keys-v1.d"));
+    assert_rnp_success(rnp_load_keys(ffi, "G10", input, RNP_LOAD_SAVE_SECRET_KEYS));
+    rnp_input_destroy(input);
+    size_t total = 0;
+    assert_rnp_success(rnp_get_secret_key_count(ffi, &total));
+    assert_true(total > 3);
+    assert_rnp_success(rnp_unload_keys(ffi, RNP_KEY_UNLOAD_SECRET));
+
+    assert_rnp_success(
+      rnp_input_from_path(&input, "data/test_stream_key_load/g10/pubring.kbx"));
+    assert_rnp_success(rnp_load_keys(ffi, "KBX", input, RNP_LOAD_SAVE_PUBLIC_KEYS));
+    rnp_input_destroy(input);
+    assert_rnp_success(
+      rnp_input_from_path(&input, "data/test_stream_key_load/g10/private-keys-v1.d"));
+    assert_rnp_success(rnp_load_keys(
+      ffi, "G10", input, RNP_LOAD_SAVE_SECRET_KEYS | RNP_LOAD_SAVE_DEFERRED));
+    rnp_input_destroy(input);
+    /* keyring keeps the path, while key files are not read yet */
+    assert_int_equal(ffi->secring->key_count(), 0);
+    assert_true(ffi->secring->path == "data/test_stream_key_load/g10/private-keys-v1.d");
+    /* key file is read when the key is requested, public key gives the keygrip */
+    rnp_key_handle_t key = NULL;
+    assert_rnp_success(rnp_locate_key(ffi, "keyid", "CC786278981B0728", &key));
+    assert_non_null(key);
+    bool secret = false;
+    assert_rnp_success(rnp_key_have_secret(key, &secret));
+    assert_true(secret);
+    rnp_key_handle_destroy(key);
+    assert_int_equal(ffi->secring->key_count(), 1);
+    /* key count reads the rest */
+    size_t count = 0;
+    assert_rnp_success(rnp_get_secret_key_count(ffi, &count));
+    assert_int_equal(count, total);
+
+    /* keyring is not empty, so flag is ignored and all key files are read at once */
+    assert_rnp_success(
+      rnp_input_from_path(&input, "data/test_stream_key_load/g10/private-keys-v1.d"));
+    assert_rnp_success(rnp_load_keys(
+      ffi, "G10", input, RNP_LOAD_SAVE_SECRET_KEYS | RNP_LOAD_SAVE_DEFERRED));
+    rnp_input_destroy(input);
+    assert_int_equal(ffi->secring->key_count(), total);
+    rnp_ffi_destroy(ffi);
+}
@@ -24,7 +24,9 @@
  * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <librepgp/stream-ctx.h>
 #include "pgp-key.h"
+#include "ffi-priv-types.h"
 
 #include "rnp_tests.h"
 #include "support.h"
@@ -546,3 +548,268 @@ TEST_F(rnp_tests, test_invalid_kbx)
 
     rnp_ffi_destroy(ffi);
 }
+
+TEST_F(rnp_tests, test_kbx_inplace_update)
+{
+    /* create KBX keystore from the GPG one */
+    rnp::KeyStore gpgstore(PGP_KEY_STORE_GPG, "data/keyrings/1/pubring.gpg", global_ctx);
+    assert_true(gpgstore.load());
+    assert_int_equal(gpgstore.key_count(), 7);
+    auto kbxstore = new rnp::KeyStore(PGP_KEY_STORE_KBX, "pubring.kbx", global_ctx);
+    for (auto &key : gpgstore.keys) {
+        assert_non_null(kbxstore->add_key(key));
+    }
+    assert_true(kbxstore->write());
+    off_t full_size = file_size("pubring.kbx");
+    delete kbxstore;
+
+    /* remove key with its subkey: blob must be marked as empty in-place */
+    kbxstore = new rnp::KeyStore(PGP_KEY_STORE_KBX, "pubring.kbx", global_ctx);
+    assert_true(kbxstore->load());
+    assert_int_equal(kbxstore->key_count(), 7);
+    pgp_key_t *key = rnp_tests_get_key_by_id(kbxstore, "2fcadf05ffa501bb");
+    assert_non_null(key);
+    assert_int_equal(key->subkey_count(), 2);
+    assert_true(kbxstore->remove_key(*key, true));
+    assert_int_equal(kbxstore->key_count(), 4);
+    assert_true(kbxstore->write());
+    assert_int_equal(file_size("pubring.kbx"), full_size);
+    /* unchanged keystore must not be rewritten */
+    assert_true(kbxstore->write());
+    assert_int_equal(file_size("pubring.kbx"), full_size);
+    delete kbxstore;
+
+    /* add key back: new blob must be appended */
+    kbxstore = new rnp::KeyStore(PGP_KEY_STORE_KBX, "pubring.kbx", global_ctx);
+    assert_true(kbxstore->load());
+    assert_int_equal(kbxstore->key_count(), 4);
+    assert_null(rnp_tests_get_key_by_id(kbxstore, "2fcadf05ffa501bb"));
+    key = rnp_tests_get_key_by_id(&gpgstore, "2fcadf05ffa501bb");
+    assert_non_null(key);
+    assert_non_null(kbxstore->add_key(*key));
+    for (size_t i = 0; i < key->subkey_count(); i++) {
+        assert_non_null(kbxstore->add_key(*gpgstore.get_subkey(*key, i)));
+    }
+    assert_true(kbxstore->write());
+    off_t upd_size = file_size("pubring.kbx");
+    assert_true(upd_size > full_size);
+    delete kbxstore;
+
+    /* make sure all keys are available, and compact the keystore */
+    kbxstore = new rnp::KeyStore(PGP_KEY_STORE_KBX, "pubring.kbx", global_ctx);
+    assert_true(kbxstore->load());
+    assert_int_equal(kbxstore->key_count(), 7);
+    key = rnp_tests_get_key_by_id(kbxstore, "2fcadf05ffa501bb");
+    assert_non_null(key);
+    assert_int_equal(key->subkey_count(), 2);
+    assert_true(kbxstore->compact());
+    assert_int_equal(file_size("pubring.kbx"), full_size);
+    delete kbxstore;
+
+    /* removing larger key leaves more than half of the file empty, so it is rewritten */
+    kbxstore = new rnp::KeyStore(PGP_KEY_STORE_KBX, "pubring.kbx", global_ctx);
+    assert_true(kbxstore->load());
+    assert_int_equal(kbxstore->key_count(), 7);
+    key = rnp_tests_get_key_by_id(kbxstore, "7bc6709b15c23a4a");
+    assert_non_null(key);
+    assert_int_equal(key->subkey_count(), 3);
+    assert_true(kbxstore->remove_key(*key, true));
+    assert_int_equal(kbxstore->key_count(), 3);
+    assert_true(kbxstore->write());
+    assert_true(file_size("pubring.kbx") < full_size / 2);
+    delete kbxstore;
+
+    kbxstore = new rnp::KeyStore(PGP_KEY_STORE_KBX, "pubring.kbx", global_ctx);
+    assert_true(kbxstore->load());
+    assert_int_equal(kbxstore->key_count(), 3);
+    assert_null(rnp_tests_get_key_by_id(kbxstore, "7bc6709b15c23a4a"));
+    assert_non_null(rnp_tests_get_key_by_id(kbxstore, "2fcadf05ffa501bb"));
+    delete kbxstore;
+}
+
+TEST_F(rnp_tests, test_kbx_deferred_load)
+{
+    /* GnuPG-created keybox */
+    auto kbxstore =
+      new rnp::KeyStore(PGP_KEY_STORE_KBX, "data/keyrings/3/pubring.kbx", global_ctx);
+    kbxstore->defer_kbx = true;
+    assert_true(kbxstore->load());
+    assert_int_equal(kbxstore->key_count(), 0);
+    /* keyblock is parsed on the first request */
+    pgp_key_t *key = rnp_tests_get_key_by_id(kbxstore, "4be147bb22df1e60");
+    assert_non_null(key);
+    assert_int_equal(kbxstore->key_count(), 2);
+    assert_non_null(rnp_tests_get_key_by_id(kbxstore, "a49bae05c16e8bc8"));
+    assert_true(rnp_tests_key_search(kbxstore, "test1") == key);
+    assert_null(rnp_tests_key_search(kbxstore, "test2"));
+    assert_int_equal(kbxstore->key_count(), 2);
+    delete kbxstore;
+
+    /* lookup by userid */
+    kbxstore = new rnp::KeyStore(PGP_KEY_STORE_KBX, "data/keyrings/3/pubring.kbx", global_ctx);
+    kbxstore->defer_kbx = true;
+    assert_true(kbxstore->load());
+    assert_non_null(rnp_tests_key_search(kbxstore, "test1"));
+    assert_int_equal(kbxstore->key_count(), 2);
+    delete kbxstore;
+
+    /* RNP-created keybox */
+    rnp::KeyStore gpgstore(PGP_KEY_STORE_GPG, "data/keyrings/1/pubring.gpg", global_ctx);
+    assert_true(gpgstore.load());
+    kbxstore = new rnp::KeyStore(PGP_KEY_STORE_KBX, "pubring.kbx", global_ctx);
+    for (auto &key : gpgstore.keys) {
+        assert_non_null(kbxstore->add_key(key));
+    }
+    assert_true(kbxstore->write());
+    delete kbxstore;
+
+    kbxstore = new rnp::KeyStore(PGP_KEY_STORE_KBX, "pubring.kbx", global_ctx);
+    kbxstore->defer_kbx = true;
+    assert_true(kbxstore->load());
+    assert_int_equal(kbxstore->key_count(), 0);
+    key = rnp_tests_key_search(kbxstore, "key1-uid0");
+    assert_non_null(key);
+    assert_true(cmp_keyid(key->keyid(), "2FCADF05FFA501BB"));
+    assert_int_equal(kbxstore->key_count(), 3);
+    /* subkey lookup by fingerprint */
+    key = rnp_tests_get_key_by_fpr(kbxstore, "E332B27CAF4742A11BAA677F1ED63EE56FADC34D");
+    assert_non_null(key);
+    assert_int_equal(kbxstore->key_count(), 7);
+    delete kbxstore;
+
+    /* keygrip is not available in blob, so all keyblocks are parsed */
+    kbxstore = new rnp::KeyStore(PGP_KEY_STORE_KBX, "pubring.kbx", global_ctx);
+    kbxstore->defer_kbx = true;
+    assert_true(kbxstore->load());
+    key = rnp_tests_get_key_by_grip(kbxstore, "66D6A0800A3FACDE0C0EB60B16B3669ED380FDFA");
+    assert_non_null(key);
+    assert_int_equal(kbxstore->key_count(), 7);
+    delete kbxstore;
+
+    /* keystore must be fully loaded before writing */
+    kbxstore = new rnp::KeyStore(PGP_KEY_STORE_KBX, "pubring.kbx", global_ctx);
+    kbxstore->defer_kbx = true;
+    assert_true(kbxstore->load());
+    assert_non_null(rnp_tests_get_key_by_id(kbxstore, "7bc6709b15c23a4a"));
+    assert_int_equal(kbxstore->key_count(), 4);
+    assert_true(kbxstore->write());
+    assert_int_equal(kbxstore->key_count(), 7);
+    delete kbxstore;
+
+    kbxstore = new rnp::KeyStore(PGP_KEY_STORE_KBX, "pubring.kbx", global_ctx);
+    assert_true(kbxstore->load());
+    assert_int_equal(kbxstore->key_count(), 7);
+    delete kbxstore;
+}
+
+TEST_F(rnp_tests, test_ffi_kbx_deferred_load)
+{
+    rnp_ffi_t ffi = NULL;
+    assert_rnp_success(rnp_ffi_create(&ffi, "KBX", "G10"));
+    rnp_input_t input = NULL;
+    assert_rnp_success(rnp_input_from_path(&input, "data/keyrings/3/pubring.kbx"));
+    assert_rnp_success(rnp_load_keys(
+      ffi, "KBX", input, RNP_LOAD_SAVE_PUBLIC_KEYS | RNP_LOAD_SAVE_DEFERRED));
+    rnp_input_destroy(input);
+    assert_int_equal(ffi->pubring->key_count(), 0);
+    /* keyblock is parsed on the first request */
+    rnp_key_handle_t key = NULL;
+    assert_rnp_success(rnp_locate_key(ffi, "keyid", "A49BAE05C16E8BC8", &key));
+    assert_non_null(key);
+    rnp_key_handle_destroy(key);
+    assert_int_equal(ffi->pubring->key_count(), 2);
+    assert_rnp_success(rnp_unload_keys(ffi, RNP_KEY_UNLOAD_PUBLIC));
+
+    /* key count parses everything */
+    assert_rnp_success(rnp_input_from_path(&input, "data/keyrings/3/pubring.kbx"));
+    assert_rnp_success(rnp_load_keys(
+      ffi, "KBX", input, RNP_LOAD_SAVE_PUBLIC_KEYS | RNP_LOAD_SAVE_DEFERRED));
+    rnp_input_destroy(input);
+    assert_int_equal(ffi->pubring->key_count(), 0);
+    size_t count = 0;
+    assert_rnp_success(rnp_get_public_key_count(ffi, &count));
+    assert_int_equal(count, 2);
+    /* keyring is not empty, so flag is ignored */
+    assert_rnp_success(rnp_input_from_path(&input, "data/keyrings/1/pubring.gpg"));
+    assert_rnp_success(rnp_load_keys(
+      ffi, "GPG", input, RNP_LOAD_SAVE_PUBLIC_KEYS | RNP_LOAD_SAVE_DEFERRED));
+    rnp_input_destroy(input);
+    assert_int_equal(ffi->pubring->key_count(), 9);
+    assert_rnp_success(rnp_input_from_path(&input, "data/keyrings/3/pubring.kbx"));
+    assert_rnp_success(rnp_load_keys(
+      ffi, "KBX", input, RNP_LOAD_SAVE_PUBLIC_KEYS | RNP_LOAD_SAVE_DEFERRED));
+    rnp_input_destroy(input);
+    assert_int_equal(ffi->pubring->key_count(), 9);
+    rnp_ffi_destroy(ffi);
+}
+
+static ino_t
+file_inode(const char *path)
+{
+    struct stat st = {};
+    return rnp_stat(path, &st) ? 0 : st.st_ino;
+}
+
+static void
+save_keyring(rnp_ffi_t ffi, const char *format, const char *path, uint32_t flags)
+{
+    rnp_output_t output = NULL;
+    assert_rnp_success(
+      rnp_output_to_file(&output, path, RNP_OUTPUT_FILE_OVERWRITE | RNP_OUTPUT_FILE_RANDOM));
+    assert_rnp_success(rnp_save_keys(ffi, format, output, flags));
+    assert_rnp_success(rnp_output_finish(output));
+    rnp_output_destroy(output);
+}
+
+TEST_F(rnp_tests, test_ffi_kbx_inplace_save)
+{
+    /* create KBX keystore without one of the keys */
+    rnp::KeyStore gpgstore(PGP_KEY_STORE_GPG, "data/keyrings/1/pubring.gpg", global_ctx);
+    assert_true(gpgstore.load());
+    auto kbxstore = new rnp::KeyStore(PGP_KEY_STORE_KBX, "pubring.kbx", global_ctx);
+    for (auto &key : gpgstore.keys) {
+        assert_non_null(kbxstore->add_key(key));
+    }
+    pgp_key_t *key = rnp_tests_get_key_by_id(kbxstore, "2fcadf05ffa501bb");
+    assert_non_null(key);
+    assert_true(kbxstore->remove_key(*key, true));
+    assert_true(kbxstore->write());
+    delete kbxstore;
+    off_t size = file_size("pubring.kbx");
+    ino_t inode = file_inode("pubring.kbx");
+
+    /* keyring, loaded from the path, is updated in-place when saved to the same path */
+    rnp_ffi_t ffi = NULL;
+    assert_rnp_success(rnp_ffi_create(&ffi, "KBX", "G10"));
+    rnp_input_t input = NULL;
+    assert_rnp_success(rnp_input_from_path(&input, "pubring.kbx"));
+    assert_rnp_success(rnp_load_keys(ffi, "KBX", input, RNP_LOAD_SAVE_PUBLIC_KEYS));
+    rnp_input_destroy(input);
+    assert_int_equal(ffi->pubring->key_count(), 4);
+    assert_true(import_pub_keys(ffi, "data/keyrings/1/pubring.gpg"));
+    assert_int_equal(ffi->pubring->key_count(), 7);
+    save_keyring(ffi, "KBX", "pubring.kbx", RNP_LOAD_SAVE_PUBLIC_KEYS);
+    assert_true(file_inode("pubring.kbx") == inode);
+    assert_true(file_size("pubring.kbx") > size);
+    size = file_size("pubring.kbx");
+    /* unchanged keyring is not written at all */
+    save_keyring(ffi, "KBX", "pubring.kbx", RNP_LOAD_SAVE_PUBLIC_KEYS);
+    assert_true(file_inode("pubring.kbx") == inode);
+    assert_int_equal(file_size("pubring.kbx"), size);
+    /* saving to the other path still writes a full copy */
+    save_keyring(ffi, "KBX", "pubring-copy.kbx", RNP_LOAD_SAVE_PUBLIC_KEYS);
+    assert_true(file_size("pubring-copy.kbx") <= size);
+    rnp_ffi_destroy(ffi);
+
+    /* make sure all keys are saved */
+    assert_rnp_success(rnp_ffi_create(&ffi, "KBX", "G10"));
+    for (auto path : {"pubring.kbx", "pubring-copy.kbx"}) {
+        assert_rnp_success(rnp_input_from_path(&input, path));
+        assert_rnp_success(rnp_load_keys(ffi, "KBX", input, RNP_LOAD_SAVE_PUBLIC_KEYS));
+        rnp_input_destroy(input);
+        assert_int_equal(ffi->pubring->key_count(), 7);
+        assert_non_null(rnp_tests_get_key_by_id(ffi->pubring, "2fcadf05ffa501bb"));
+        assert_rnp_success(rnp_unload_keys(ffi, RNP_KEY_UNLOAD_PUBLIC));
+    }
+    rnp_ffi_destroy(ffi);
+}
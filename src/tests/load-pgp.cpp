@@ -31,6 +31,7 @@
 
 #include "rnp_tests.h"
 #include "support.h"
+#include <fstream>
 
 /* This test loads a .gpg pubring with a single V3 key,
  * and confirms that appropriate key flags are set.
@@ -182,6 +183,43 @@ TEST_F(rnp_tests, test_load_keyring_and_count_pgp)
       "data/keyrings/1/secring.gpg", primary_count, subkey_counts, global_ctx);
 }
 
+TEST_F(rnp_tests, test_load_move_keys_between_stores)
+{
+    rnp::KeyStore src(PGP_KEY_STORE_GPG, "data/keyrings/1/secring.gpg", global_ctx);
+    assert_true(src.load());
+    size_t count = src.key_count();
+    assert_int_equal(count, 7);
+
+    // move keys to the empty store: subkeys must be linked, keys must be valid
+    rnp::KeyStore dst(PGP_KEY_STORE_GPG, "", global_ctx);
+    for (auto &srckey : src.keys) {
+        assert_non_null(dst.add_key(std::move(srckey)));
+    }
+    assert_int_equal(dst.key_count(), count);
+    auto key = rnp_tests_get_key_by_id(&dst, "7BC6709B15C23A4A");
+    assert_non_null(key);
+    assert_true(key->is_secret());
+    assert_true(key->valid());
+    assert_int_equal(key->subkey_count(), 3);
+    assert_int_equal(key->uid_count(), 3);
+    auto sub = rnp_tests_get_key_by_id(&dst, "1ED63EE56FADC34D");
+    assert_non_null(sub);
+    assert_true(sub->valid());
+    assert_true(sub->primary_fp() == key->fp());
+    assert_true(dst.primary_key(*sub) == key);
+
+    // moving the same keys once again must merge them
+    rnp::KeyStore src2(PGP_KEY_STORE_GPG, "data/keyrings/1/pubring.gpg", global_ctx);
+    assert_true(src2.load());
+    for (auto &srckey : src2.keys) {
+        assert_non_null(dst.add_key(std::move(srckey)));
+    }
+    assert_int_equal(dst.key_count(), count);
+    assert_true(rnp_tests_get_key_by_id(&dst, "7BC6709B15C23A4A") == key);
+    assert_true(key->is_secret());
+    assert_int_equal(key->uid_count(), 3);
+}
+
 /* This test loads a V4 keyring and confirms that certain
  * bitfields and time fields are set correctly.
  */
@@ -982,3 +1020,198 @@ TEST_F(rnp_tests, test_load_subkey)
 
     delete key_store;
 }
+
+TEST_F(rnp_tests, test_load_save_journal)
+{
+    rnp::KeyStore srcstore(PGP_KEY_STORE_GPG, "data/keyrings/1/pubring.gpg", global_ctx);
+    assert_true(srcstore.load());
+    assert_int_equal(srcstore.key_count(), 7);
+    /* initial write of the keyring */
+    auto ks = new rnp::KeyStore(PGP_KEY_STORE_GPG, "pubring.gpg", global_ctx);
+    ks->journal = true;
+    for (auto &key : srcstore.keys) {
+        assert_non_null(ks->add_key(key));
+    }
+    assert_true(ks->write());
+    assert_false(rnp_file_exists(ks->journal_file().c_str()));
+    off_t base_size = file_size("pubring.gpg");
+    /* nothing is changed */
+    assert_true(ks->write());
+    assert_false(rnp_file_exists(ks->journal_file().c_str()));
+    delete ks;
+
+    /* remove key with subkeys */
+    ks = new rnp::KeyStore(PGP_KEY_STORE_GPG, "pubring.gpg", global_ctx);
+    ks->journal = true;
+    assert_true(ks->load());
+    assert_int_equal(ks->key_count(), 7);
+    pgp_key_t *key = rnp_tests_get_key_by_id(ks, "2fcadf05ffa501bb");
+    assert_non_null(key);
+    assert_true(ks->remove_key(*key, true));
+    assert_true(ks->write());
+    assert_int_equal(file_size("pubring.gpg"), base_size);
+    assert_true(rnp_file_exists("pubring.gpg.journal"));
+    delete ks;
+    /* journal is not used */
+    ks = new rnp::KeyStore(PGP_KEY_STORE_GPG, "pubring.gpg", global_ctx);
+    assert_true(ks->load());
+    assert_int_equal(ks->key_count(), 7);
+    delete ks;
+    /* journal is replayed */
+    ks = new rnp::KeyStore(PGP_KEY_STORE_GPG, "pubring.gpg", global_ctx);
+    ks->journal = true;
+    assert_true(ks->load());
+    assert_int_equal(ks->key_count(), 4);
+    assert_null(rnp_tests_get_key_by_id(ks, "2fcadf05ffa501bb"));
+
+    /* add key back and add a signature to other key */
+    key = rnp_tests_get_key_by_id(&srcstore, "2fcadf05ffa501bb");
+    assert_non_null(ks->add_key(*key));
+    for (size_t i = 0; i < key->subkey_count(); i++) {
+        assert_non_null(ks->add_key(*srcstore.get_subkey(*key, i)));
+    }
+    key = rnp_tests_get_key_by_id(ks, "7bc6709b15c23a4a");
+    assert_non_null(key);
+    size_t sigs = key->sig_count();
+    assert_true(sigs > 1);
+    key->del_sig(key->get_sig(0).sigid);
+    off_t jsize = file_size("pubring.gpg.journal");
+    assert_true(ks->write());
+    assert_int_equal(file_size("pubring.gpg"), base_size);
+    assert_true(file_size("pubring.gpg.journal") > jsize);
+    delete ks;
+
+    ks = new rnp::KeyStore(PGP_KEY_STORE_GPG, "pubring.gpg", global_ctx);
+    ks->journal = true;
+    assert_true(ks->load());
+    assert_int_equal(ks->key_count(), 7);
+    key = rnp_tests_get_key_by_id(ks, "2fcadf05ffa501bb");
+    assert_non_null(key);
+    assert_int_equal(key->subkey_count(), 2);
+    key = rnp_tests_get_key_by_id(ks, "7bc6709b15c23a4a");
+    assert_int_equal(key->sig_count(), sigs - 1);
+    /* compact journal into the keyring */
+    assert_true(ks->compact());
+    assert_false(rnp_file_exists("pubring.gpg.journal"));
+    assert_true(file_size("pubring.gpg") < base_size);
+    delete ks;
+
+    ks = new rnp::KeyStore(PGP_KEY_STORE_GPG, "pubring.gpg", global_ctx);
+    assert_true(ks->load());
+    assert_int_equal(ks->key_count(), 7);
+    key = rnp_tests_get_key_by_id(ks, "7bc6709b15c23a4a");
+    assert_int_equal(key->sig_count(), sigs - 1);
+    delete ks;
+
+    /* truncated journal: last record is ignored */
+    ks = new rnp::KeyStore(PGP_KEY_STORE_GPG, "pubring.gpg", global_ctx);
+    ks->journal = true;
+    assert_true(ks->load());
+    key = rnp_tests_get_key_by_id(ks, "2fcadf05ffa501bb");
+    assert_true(ks->remove_key(*key, true));
+    assert_true(ks->write());
+    delete ks;
+    auto journal = file_to_vec("pubring.gpg.journal");
+    journal.pop_back();
+    std::ofstream out("pubring.gpg.journal", std::ios::out | std::ios::binary);
+    out.write((const char *) journal.data(), journal.size());
+    out.close();
+    ks = new rnp::KeyStore(PGP_KEY_STORE_GPG, "pubring.gpg", global_ctx);
+    ks->journal = true;
+    assert_true(ks->load());
+    assert_int_equal(ks->key_count(), 5);
+    /* invalid journal is dropped during the next write */
+    assert_true(ks->write());
+    assert_false(rnp_file_exists("pubring.gpg.journal"));
+    delete ks;
+    /* subkey without primary key is not saved */
+    ks = new rnp::KeyStore(PGP_KEY_STORE_GPG, "pubring.gpg", global_ctx);
+    ks->journal = true;
+    assert_true(ks->load());
+    assert_int_equal(ks->key_count(), 4);
+
+    /* keyring with the same size but different contents: journal is ignored */
+    key = rnp_tests_get_key_by_id(&srcstore, "2fcadf05ffa501bb");
+    assert_non_null(ks->add_key(*key));
+    assert_true(ks->write());
+    assert_true(rnp_file_exists("pubring.gpg.journal"));
+    delete ks;
+    ks = new rnp::KeyStore(PGP_KEY_STORE_GPG, "pubring.gpg", global_ctx);
+    ks->journal = true;
+    assert_true(ks->load());
+    assert_int_equal(ks->key_count(), 5);
+    delete ks;
+    auto        keyring = file_to_vec("pubring.gpg");
+    std::string uid = "key0-uid0";
+    auto        pos = std::search(keyring.begin(), keyring.end(), uid.begin(), uid.end());
+    assert_true(pos != keyring.end());
+    pos[3] = '9';
+    out.open("pubring.gpg", std::ios::out | std::ios::binary);
+    out.write((const char *) keyring.data(), keyring.size());
+    out.close();
+    ks = new rnp::KeyStore(PGP_KEY_STORE_GPG, "pubring.gpg", global_ctx);
+    ks->journal = true;
+    assert_true(ks->load());
+    assert_int_equal(ks->key_count(), 4);
+    delete ks;
+}
+
+TEST_F(rnp_tests, test_ffi_save_journal)
+{
+    rnp::KeyStore srcstore(PGP_KEY_STORE_GPG, "data/keyrings/1/pubring.gpg", global_ctx);
+    assert_true(srcstore.load());
+    auto ks = new rnp::KeyStore(PGP_KEY_STORE_GPG, "pubring.gpg", global_ctx);
+    for (auto &key : srcstore.keys) {
+        assert_non_null(ks->add_key(key));
+    }
+    assert_true(ks->write());
+    delete ks;
+    off_t       base_size = file_size("pubring.gpg");
+    struct stat st = {};
+    assert_int_equal(rnp_stat("pubring.gpg", &st), 0);
+    ino_t inode = st.st_ino;
+
+    /* remove key with subkeys and save keyring to the same path */
+    rnp_ffi_t ffi = NULL;
+    assert_rnp_success(rnp_ffi_create(&ffi, "GPG", "GPG"));
+    rnp_input_t input = NULL;
+    assert_rnp_success(rnp_input_from_path(&input, "pubring.gpg"));
+    assert_rnp_success(
+      rnp_load_keys(ffi, "GPG", input, RNP_LOAD_SAVE_PUBLIC_KEYS | RNP_LOAD_SAVE_JOURNAL));
+    rnp_input_destroy(input);
+    rnp_key_handle_t key = NULL;
+    assert_rnp_success(rnp_locate_key(ffi, "keyid", "2fcadf05ffa501bb", &key));
+    assert_rnp_success(rnp_key_remove(key, RNP_KEY_REMOVE_PUBLIC | RNP_KEY_REMOVE_SUBKEYS));
+    rnp_key_handle_destroy(key);
+    rnp_output_t output = NULL;
+    assert_rnp_success(rnp_output_to_file(
+      &output, "pubring.gpg", RNP_OUTPUT_FILE_OVERWRITE | RNP_OUTPUT_FILE_RANDOM));
+    assert_rnp_success(rnp_save_keys(ffi, "GPG", output, RNP_LOAD_SAVE_PUBLIC_KEYS));
+    assert_rnp_success(rnp_output_finish(output));
+    rnp_output_destroy(output);
+    rnp_ffi_destroy(ffi);
+    /* keyring is not rewritten, change is appended to the journal */
+    assert_int_equal(rnp_stat("pubring.gpg", &st), 0);
+    assert_true(st.st_ino == inode);
+    assert_int_equal(file_size("pubring.gpg"), base_size);
+    assert_true(rnp_file_exists("pubring.gpg.journal"));
+
+    /* journal is applied only if requested */
+    assert_rnp_success(rnp_ffi_create(&ffi, "GPG", "GPG"));
+    assert_rnp_success(rnp_input_from_path(&input, "pubring.gpg"));
+    assert_rnp_success(rnp_load_keys(ffi, "GPG", input, RNP_LOAD_SAVE_PUBLIC_KEYS));
+    rnp_input_destroy(input);
+    size_t count = 0;
+    assert_rnp_success(rnp_get_public_key_count(ffi, &count));
+    assert_int_equal(count, 7);
+    assert_rnp_success(rnp_unload_keys(ffi, RNP_KEY_UNLOAD_PUBLIC));
+    assert_rnp_success(rnp_input_from_path(&input, "pubring.gpg"));
+    assert_rnp_success(
+      rnp_load_keys(ffi, "GPG", input, RNP_LOAD_SAVE_PUBLIC_KEYS | RNP_LOAD_SAVE_JOURNAL));
+    rnp_input_destroy(input);
+    assert_rnp_success(rnp_get_public_key_count(ffi, &count));
+    assert_int_equal(count, 4);
+    assert_rnp_success(rnp_locate_key(ffi, "keyid", "2fcadf05ffa501bb", &key));
+    assert_null(key);
+    rnp_ffi_destroy(ffi);
+}
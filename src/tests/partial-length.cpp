@@ -226,3 +226,103 @@ TEST_F(rnp_tests, test_partial_length_first_packet_length)
     assert_rnp_success(rnp_output_destroy(output));
     assert_rnp_success(rnp_ffi_destroy(ffi));
 }
+
+static void
+check_range(rnp_op_decrypt_range_t op, const std::string &data, uint64_t off, uint64_t len)
+{
+    rnp_output_t output = NULL;
+    assert_rnp_success(rnp_output_to_memory(&output, 0));
+    assert_rnp_success(rnp_op_decrypt_range_execute(op, off, len, output));
+    uint8_t *buf = NULL;
+    size_t   size = 0;
+    assert_rnp_success(rnp_output_memory_get_buf(output, &buf, &size, false));
+    std::string expected = off < data.size() ? data.substr(off, len) : "";
+    assert_true(std::string((const char *) buf, size) == expected);
+    assert_rnp_success(rnp_output_destroy(output));
+}
+
+TEST_F(rnp_tests, test_partial_length_irregular_range)
+{
+    if (!aead_ocb_enabled()) {
+        return;
+    }
+    std::string data;
+    for (size_t i = 0; data.size() < 40000; i++) {
+        data += std::to_string(i) + ",";
+    }
+    /* literal data packet with partial lengths of different sizes. Data bytes, placed where
+     * the header would be for the equal-sized chunks, look like the final length header. */
+    std::string body = std::string("b\x00\x00\x00\x00\x00", 6) + data;
+    std::string pkt(1, (char) (PGP_PTAG_ALWAYS_SET | PGP_PTAG_NEW_FORMAT | PGP_PKT_LITDATA));
+    const std::vector<uint8_t> bits = {9, 11, 10, 9, 12, 10, 11, 9};
+    std::vector<size_t>        bounds;
+    size_t                     pos = 0;
+    for (size_t i = 0; body.size() - pos > ((size_t) 1 << 12); i++) {
+        size_t len = (size_t) 1 << bits[i % bits.size()];
+        pkt += (char) (0xE0 + bits[i % bits.size()]);
+        pkt += body.substr(pos, len);
+        pos += len;
+        bounds.push_back(pos - 6);
+    }
+    size_t left = body.size() - pos;
+    pkt += std::string("\xFF\x00\x00", 3) + (char) (left >> 8) + (char) (left & 0xff);
+    pkt += body.substr(pos);
+
+    /* encrypt it as is, so framing of the literal packet is kept */
+    rnp_ffi_t        ffi = NULL;
+    rnp_input_t      input = NULL;
+    rnp_output_t     output = NULL;
+    rnp_op_encrypt_t op = NULL;
+    assert_rnp_success(rnp_ffi_create(&ffi, "GPG", "GPG"));
+    assert_rnp_success(
+      rnp_input_from_memory(&input, (const uint8_t *) pkt.data(), pkt.size(), false));
+    assert_rnp_success(rnp_output_to_memory(&output, 0));
+    assert_rnp_success(rnp_op_encrypt_create(&op, ffi, input, output));
+    assert_rnp_success(rnp_op_encrypt_set_flags(op, RNP_ENCRYPT_NOWRAP));
+    assert_rnp_success(rnp_op_encrypt_set_aead(op, "OCB"));
+    assert_rnp_success(rnp_op_encrypt_set_compression(op, "Uncompressed", 0));
+    assert_rnp_success(rnp_op_encrypt_add_password(op, "password", NULL, 1024, NULL));
+    assert_rnp_success(rnp_op_encrypt_execute(op));
+    assert_rnp_success(rnp_op_encrypt_destroy(op));
+    assert_rnp_success(rnp_input_destroy(input));
+    uint8_t *buf = NULL;
+    size_t   len = 0;
+    assert_rnp_success(rnp_output_memory_get_buf(output, &buf, &len, true));
+    std::vector<uint8_t> msg(buf, buf + len);
+    rnp_buffer_destroy(buf);
+    assert_rnp_success(rnp_output_destroy(output));
+
+    /* get the session key */
+    rnp_op_verify_t verify = NULL;
+    uint8_t *       key = NULL;
+    size_t          keylen = 0;
+    assert_rnp_success(
+      rnp_ffi_set_pass_provider(ffi, ffi_string_password_provider, (void *) "password"));
+    assert_rnp_success(rnp_input_from_memory(&input, msg.data(), msg.size(), false));
+    assert_rnp_success(rnp_output_to_null(&output));
+    assert_rnp_success(rnp_op_verify_create(&verify, ffi, input, output));
+    assert_rnp_success(rnp_op_verify_set_flags(verify, RNP_VERIFY_KEEP_SESSION_KEY));
+    assert_rnp_success(rnp_op_verify_execute(verify));
+    assert_rnp_success(rnp_op_verify_get_session_key(verify, &key, &keylen));
+    assert_rnp_success(rnp_op_verify_destroy(verify));
+    assert_rnp_success(rnp_output_destroy(output));
+    assert_rnp_success(rnp_input_destroy(input));
+
+    /* seek forward and back across the chunk boundaries */
+    rnp_op_decrypt_range_t range = NULL;
+    assert_rnp_success(rnp_input_from_memory(&input, msg.data(), msg.size(), false));
+    assert_rnp_success(rnp_op_decrypt_range_create(&range, ffi, input, key, keylen));
+    check_range(range, data, bounds[5] - 7, 20);
+    check_range(range, data, bounds[1] - 1, 2);
+    for (auto it = bounds.rbegin(); it != bounds.rend(); it++) {
+        check_range(range, data, *it - 3, 5);
+    }
+    check_range(range, data, bounds[2] + 100, bounds[7] - bounds[2]);
+    check_range(range, data, data.size() - 10, 100);
+    check_range(range, data, 0, data.size());
+    assert_rnp_success(rnp_op_decrypt_range_destroy(range));
+    assert_rnp_success(rnp_input_destroy(input));
+    rnp_buffer_clear(key, keylen);
+    rnp_buffer_destroy(key);
+    assert_rnp_success(rnp_ffi_destroy(ffi));
+}
@@ -40,6 +40,7 @@
 #include <librepgp/stream-armor.h>
 #include <librepgp/stream-write.h>
 #include <algorithm>
+#include <thread>
 #include "time-utils.h"
 
 static bool
@@ -1082,6 +1083,101 @@ TEST_F(rnp_tests, test_stream_key_signatures)
     delete pubring;
 }
 
+static void
+check_sig_subpkts_lazy(const pgp_signature_t &src)
+{
+    /* fields from the subpackets cache */
+    pgp_signature_t sig = src;
+    auto            creation = sig.creation();
+    auto            expiration = sig.expiration();
+    auto            key_expiration = sig.key_expiration();
+    auto            key_flags = sig.key_flags();
+    auto            primary_uid = sig.primary_uid();
+    auto            keyid = sig.keyid();
+    auto            keyfp = sig.keyfp();
+    auto            has_keyfp = sig.has_keyfp();
+    auto            has_flags = sig.has_subpkt(PGP_SIG_SUBPKT_KEY_FLAGS);
+    auto            has_issuer = sig.has_subpkt(PGP_SIG_SUBPKT_ISSUER_KEY_ID, false);
+    auto            written = sig.write();
+    /* now create subpackets and compare */
+    assert_true(sig.subpkts().size() > 0);
+    assert_int_equal(sig.creation(), creation);
+    assert_int_equal(sig.expiration(), expiration);
+    assert_int_equal(sig.key_expiration(), key_expiration);
+    assert_int_equal(sig.key_flags(), key_flags);
+    assert_int_equal(sig.primary_uid(), primary_uid);
+    assert_true(sig.keyid() == keyid);
+    assert_true(sig.keyfp() == keyfp);
+    assert_int_equal(sig.has_keyfp(), has_keyfp);
+    assert_int_equal(sig.has_subpkt(PGP_SIG_SUBPKT_KEY_FLAGS), has_flags);
+    assert_int_equal(sig.has_subpkt(PGP_SIG_SUBPKT_ISSUER_KEY_ID, false), has_issuer);
+    assert_true(sig.write() == written);
+    assert_true(src.write() == written);
+    /* modification must be reflected */
+    sig.set_key_flags(0x42);
+    assert_int_equal(sig.key_flags(), 0x42);
+    assert_int_equal(src.key_flags(), key_flags);
+}
+
+TEST_F(rnp_tests, test_stream_signature_lazy_subpackets)
+{
+    pgp_source_t       keysrc = {0};
+    pgp_key_sequence_t keyseq;
+
+    for (auto path : {"data/keyrings/1/pubring.gpg",
+                      "data/test_key_edge_cases/key-critical-notations.pgp",
+                      "data/test_key_edge_cases/key-unhashed-subpkts.pgp"}) {
+        assert_rnp_success(init_file_src(&keysrc, path));
+        assert_rnp_success(process_pgp_keys(keysrc, keyseq, false));
+        keysrc.close();
+        assert_false(keyseq.keys.empty());
+        for (auto &key : keyseq.keys) {
+            for (auto &sig : key.signatures) {
+                check_sig_subpkts_lazy(sig);
+            }
+            for (auto &uid : key.userids) {
+                for (auto &sig : uid.signatures) {
+                    check_sig_subpkts_lazy(sig);
+                }
+            }
+            for (auto &subkey : key.subkeys) {
+                for (auto &sig : subkey.signatures) {
+                    check_sig_subpkts_lazy(sig);
+                }
+            }
+        }
+        keyseq.keys.clear();
+    }
+}
+
+TEST_F(rnp_tests, test_stream_signature_subpackets_threads)
+{
+    pgp_source_t       keysrc = {0};
+    pgp_key_sequence_t keyseq;
+    assert_rnp_success(init_file_src(&keysrc, "data/keyrings/1/pubring.gpg"));
+    assert_rnp_success(process_pgp_keys(keysrc, keyseq, false));
+    keysrc.close();
+    assert_false(keyseq.keys.empty());
+    assert_false(keyseq.keys[0].userids.empty());
+    /* subpackets are created on first access, which may be done from different threads */
+    const pgp_signature_t &  sig = keyseq.keys[0].userids[0].signatures[0];
+    std::vector<size_t>      counts(8);
+    std::vector<std::thread> threads;
+    for (size_t idx = 0; idx < counts.size(); idx++) {
+        threads.emplace_back([&sig, &counts, idx]() {
+            pgp_signature_t copy = sig;
+            counts[idx] = sig.subpkts().size() + copy.subpkts().size();
+            assert_non_null(sig.get_subpkt(pgp::pkt::sigsub::Type::CreationTime));
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    for (auto count : counts) {
+        assert_int_equal(count, 2 * sig.subpkts().size());
+    }
+}
+
 static bool
 validate_key_sigs(const char *path, rnp::SecurityContext &global_ctx)
 {